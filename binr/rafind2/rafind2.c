@@ -11,6 +11,10 @@
 #include <r_cons.h>
 #include <r_lib.h>
 #include <r_io.h>
+#include <r_th.h>
+#if __UNIX__
+#include <sys/mman.h>
+#endif
 
 #include "../blob/version.c"
 
@@ -31,57 +35,61 @@ static int hexstr = 0;
 static int widestr = 0;
 static RPrint *pr = NULL;
 static RList *keywords;
+static int jobs = 0;
 
-static int hit(RSearchKeyword *kw, void *user, ut64 addr) {
-	int delta = addr - cur;
-	if (cur > addr && (cur - addr == kw->keyword_length - 1)) {
-		// This case occurs when there is hit in search left over
-		delta = cur - addr;
-	}
-	if (delta < 0 || delta >= bsize) {
-		eprintf ("Invalid delta\n");
-		return 0;
-	}
+static void print_hit(int count, ut64 addr, const ut8 *data, int len) {
 	if (rad) {
-		printf ("f hit%d_%d 0x%08"PFMT64x" ; %s\n", 0, kw->count, addr, curfile);
+		printf ("f hit%d_%d 0x%08"PFMT64x" ; %s\n", 0, count, addr, curfile);
 	} else {
 		if (showstr) {
 			if (widestr) {
-				char *str = calloc (1, bsize);
+				char str[96] = {0};
 				int i, j = 0;
-				for (i = delta; buf[i] && i < bsize; i++) {
-					if (!IS_PRINTABLE (buf[i])) {
+				for (i = 0; i < len && data[i]; i++) {
+					if (!IS_PRINTABLE (data[i])) {
 						break;
 					}
-					str[j++] = buf[i++];
+					str[j++] = data[i++];
 					if (j > 80) {
 						strcpy (str + j, "...");
 						j += 3;
 						break;
 					}
-					if (buf[i]) {
+					if (i < len && data[i]) {
 						break;
 					}
 				}
 				str[j] = 0;
 				printf ("0x%"PFMT64x" %s\n", addr, str);
-				free (str);
 			} else {
-				printf ("0x%"PFMT64x" %s\n", addr, buf + delta);
+				printf ("0x%"PFMT64x" %.*s\n", addr, len, data);
 			}
 		} else {
 			printf ("0x%"PFMT64x"\n", addr);
 			if (pr) {
-				r_print_hexdump (pr, addr, (ut8*)buf + delta, 78, 16, 1, 1);
+				r_print_hexdump (pr, addr, data, R_MIN (78, len), 16, 1, 1);
 				r_cons_flush ();
 			}
 		}
 	}
+}
+
+static int hit(RSearchKeyword *kw, void *user, ut64 addr) {
+	int delta = addr - cur;
+	if (cur > addr && (cur - addr == kw->keyword_length - 1)) {
+		// This case occurs when there is hit in search left over
+		delta = cur - addr;
+	}
+	if (delta < 0 || delta >= bsize) {
+		eprintf ("Invalid delta\n");
+		return 0;
+	}
+	print_hit (kw->count, addr, buf + delta, bsize - delta);
 	return 1;
 }
 
 static int show_help(char *argv0, int line) {
-	printf ("Usage: %s [-mXnzZhqv] [-a align] [-b sz] [-f/t from/to] [-[e|s|S] str] [-x hex] file|dir ..\n", argv0);
+	printf ("Usage: %s [-mXnzZhqv] [-a align] [-b sz] [-j threads] [-f/t from/to] [-[e|s|S] str] [-x hex] file|dir ..\n", argv0);
 	if (line) {
 		return 0;
 	}
@@ -92,6 +100,7 @@ static int show_help(char *argv0, int line) {
 	" -f [from]  start searching from address 'from'\n"
 	" -h         show this help\n"
 	" -i         identify filetype (r2 -nqcpm file)\n"
+	" -j [n]     search keywords in parallel using n threads and mmaped windows\n"
 	" -m         magic search, file-type carver\n"
 	" -M [str]   set a binary mask to be applied on keywords\n"
 	" -n         do not stop on read errors\n"
@@ -109,6 +118,20 @@ static int show_help(char *argv0, int line) {
 	return 0;
 }
 
+static void add_keywords(RSearch *rs) {
+	RListIter *iter;
+	const char *kw;
+	r_list_foreach (keywords, iter, kw) {
+		if (hexstr) {
+			r_search_kw_add (rs, r_search_keyword_new_hex (kw, mask, NULL));
+		} else if (widestr) {
+			r_search_kw_add (rs, r_search_keyword_new_wide (kw, mask, NULL, 0));
+		} else {
+			r_search_kw_add (rs, r_search_keyword_new_str (kw, mask, NULL, 0));
+		}
+	}
+}
+
 static int rafind_open(char *file);
 
 static int rafind_open_file(char *file) {
@@ -195,15 +218,7 @@ static int rafind_open_file(char *file) {
 		goto done;
 	}
 	if (mode == R_SEARCH_KEYWORD) {
-		r_list_foreach (keywords, iter, kw) {
-			if (hexstr) {
-				r_search_kw_add (rs, r_search_keyword_new_hex (kw, mask, NULL));
-			} else if (widestr) {
-				r_search_kw_add (rs, r_search_keyword_new_wide (kw, mask, NULL, 0));
-			} else {
-				r_search_kw_add (rs, r_search_keyword_new_str (kw, mask, NULL, 0));
-			}
-		}
+		add_keywords (rs);
 	} else if (mode == R_SEARCH_STRING) {
 		r_search_kw_add (rs, r_search_keyword_new_hexmask ("00", NULL)); //XXX
 	}
@@ -276,11 +291,421 @@ static int rafind_open(char *file) {
 	return rafind_open_file (file);
 }
 
+/* parallel keyword search: files and big file ranges are spread across a
+ * pool of workers, each one searching a large mmaped window at once. The
+ * hits are kept per task and printed in file and address order. */
+
+#define RANGE_SIZE (64 * 1024 * 1024)
+#define HIT_DATA 256
+
+typedef struct {
+	ut64 addr;
+	int kw;
+	int len;
+	ut8 *data; // bytes at the hit for -Z and -X
+} RafindHit;
+
+typedef struct {
+	int file;
+	ut64 from;
+	ut64 to; // hits starting after this are found by the next task
+	ut64 end; // the window also covers the keywords crossing 'to'
+	RVector hits;
+	bool done;
+	bool failed;
+} RafindTask;
+
+typedef struct {
+	char **files;
+	int nfiles;
+	int *first; // first task of each file
+	RafindTask *tasks;
+	int ntasks;
+	int next;
+	ut32 *kwlen;
+	ut64 *last;
+	int *count;
+	int nkws;
+	RThreadLock *lock;
+	RThreadCond *cond;
+	struct rafind_worker_t *rescan; // main thread search for print_file
+} RafindPool;
+
+typedef struct rafind_worker_t {
+	RafindPool *pool;
+	RSearch *rs;
+	RafindTask *task;
+	const ut8 *buf;
+	ut64 len;
+	void *map;
+	ut64 maplen;
+} RafindWorker;
+
+static bool window_map(RafindWorker *w, const char *file, ut64 from, ut64 len) {
+#if __UNIX__
+	long pagesize = sysconf (_SC_PAGESIZE);
+	ut64 off = pagesize > 0? from - (from % pagesize): from;
+	int fd = r_sandbox_open (file, O_RDONLY, 0);
+	if (fd == -1) {
+		return false;
+	}
+	w->maplen = len + from - off;
+	w->map = mmap (NULL, w->maplen, PROT_READ, MAP_PRIVATE, fd, off);
+	close (fd);
+	if (w->map == MAP_FAILED) {
+		w->map = NULL;
+		return false;
+	}
+#ifdef MADV_SEQUENTIAL
+	madvise (w->map, w->maplen, MADV_SEQUENTIAL);
+#endif
+	w->buf = (const ut8 *)w->map + (from - off);
+	w->len = len;
+	return true;
+#else
+	int sz = 0;
+	w->map = r_file_slurp_range (file, from, len, &sz);
+	w->buf = w->map;
+	w->len = sz;
+	return w->map && sz == len;
+#endif
+}
+
+static void window_unmap(RafindWorker *w) {
+#if __UNIX__
+	if (w->map) {
+		munmap (w->map, w->maplen);
+	}
+#else
+	free (w->map);
+#endif
+	w->map = NULL;
+	w->buf = NULL;
+	w->len = 0;
+}
+
+static int parallel_hit(RSearchKeyword *kw, void *user, ut64 addr) {
+	RafindWorker *w = user;
+	RafindHit h = { addr, kw->kwidx, 0, NULL };
+	if (addr >= w->task->to) {
+		return 1;
+	}
+	if (showstr || pr) {
+		ut64 delta = addr - w->task->from;
+		h.len = R_MIN (HIT_DATA, w->len - delta);
+		h.data = r_mem_dup ((void *)(w->buf + delta), h.len);
+	}
+	return r_vector_push (&w->task->hits, &h) != NULL;
+}
+
+static int hit_cmp(const void *a, const void *b) {
+	const RafindHit *ha = a, *hb = b;
+	if (ha->addr != hb->addr) {
+		return ha->addr < hb->addr? -1: 1;
+	}
+	return ha->kw - hb->kw;
+}
+
+// search the window of a task, the keywords with a last hit set start
+// from there instead of from the beginning of the range
+static void search_task(RafindWorker *w, RafindTask *task) {
+	w->task = task;
+	if (window_map (w, w->pool->files[task->file], task->from, task->end - task->from)) {
+		w->rs->nhits = 0;
+		if (r_search_update (w->rs, task->from, w->buf, w->len) == -1) {
+			task->failed = true;
+		}
+		window_unmap (w);
+	} else {
+		task->failed = true;
+	}
+	qsort (task->hits.a, task->hits.len, sizeof (RafindHit), hit_cmp);
+}
+
+static void rafind_work(RafindWorker *w) {
+	RafindPool *pool = w->pool;
+	for (;;) {
+		r_th_lock_enter (pool->lock);
+		int i = pool->next < pool->ntasks? pool->next++: -1;
+		r_th_lock_leave (pool->lock);
+		if (i < 0) {
+			break;
+		}
+		RafindTask *task = &pool->tasks[i];
+		r_search_begin (w->rs);
+		// the leftover of the previous task belongs to another range
+		R_FREE (w->rs->data);
+		search_task (w, task);
+		r_th_lock_enter (pool->lock);
+		task->done = true;
+		r_th_cond_signal (pool->cond);
+		r_th_lock_leave (pool->lock);
+	}
+}
+
+static RThreadFunctionRet rafind_worker(RThread *th) {
+	rafind_work (th->user);
+	return R_TH_STOP;
+}
+
+// the workers start every range with no hit pending, when a hit of the
+// previous range overlaps this one the sequential search would have
+// started after it, so search the range again from there
+static void rescan_task(RafindPool *pool, RafindTask *task) {
+	RafindWorker *w = pool->rescan;
+	RSearchKeyword *kw;
+	RListIter *iter;
+	RafindHit *h;
+
+	r_vector_foreach (&task->hits, h) {
+		free (h->data);
+	}
+	r_vector_clear (&task->hits);
+	r_search_begin (w->rs);
+	R_FREE (w->rs->data);
+	r_list_foreach (w->rs->kws, iter, kw) {
+		if (pool->last[kw->kwidx] > task->from) {
+			kw->count = 1;
+			kw->last = pool->last[kw->kwidx];
+		}
+	}
+	search_task (w, task);
+}
+
+static void collect_files(RList *files, const char *path) {
+	if (r_file_is_directory (path)) {
+		RListIter *iter;
+		char *fname;
+		RList *list = r_sys_dir (path);
+		r_list_foreach (list, iter, fname) {
+			/* Filter-out unwanted entries */
+			if (*fname == '.') {
+				continue;
+			}
+			char *fullpath = r_str_newf ("%s"R_SYS_DIR"%s", path, fname);
+			collect_files (files, fullpath);
+			free (fullpath);
+		}
+		r_list_free (list);
+	} else {
+		r_list_append (files, strdup (path));
+	}
+}
+
+// print the hits of every range of a file, dropping the ones a sequential
+// search would have skipped because they overlap a hit of the previous range
+static void print_file(RafindPool *pool, int f) {
+	RafindHit *h;
+	int t, k;
+
+	curfile = pool->files[f];
+	if (!quiet) {
+		printf ("File: %s\n", curfile);
+	}
+	memset (pool->last, 0, sizeof (ut64) * pool->nkws);
+	memset (pool->count, 0, sizeof (int) * pool->nkws);
+	for (t = pool->first[f]; t < pool->first[f + 1]; t++) {
+		RafindTask *task = &pool->tasks[t];
+		for (k = 0; k < pool->nkws && !task->failed; k++) {
+			if (pool->last[k] > task->from) {
+				rescan_task (pool, task);
+				break;
+			}
+		}
+		if (task->failed) {
+			eprintf ("Cannot read '%s' at 0x%08"PFMT64x"\n", curfile, task->from);
+		}
+		r_vector_foreach (&task->hits, h) {
+			ut64 *last = &pool->last[h->kw];
+			if (*last && h->addr < *last) {
+				// already covered by the previous hit
+			} else if (*last && h->addr == *last) {
+				// same as the 'Sequencial hit ignored' case of r_search_hit_new
+				*last += pool->kwlen[h->kw];
+			} else {
+				*last = h->addr + pool->kwlen[h->kw];
+				print_hit (pool->count[h->kw]++, h->addr, h->data, h->len);
+			}
+			free (h->data);
+		}
+		r_vector_clear (&task->hits);
+	}
+}
+
+static int rafind_parallel(char **paths, int npaths, int nthreads) {
+	RafindPool pool = {0};
+	RafindWorker rescan = {0};
+	RafindWorker *workers = NULL;
+	RThread **threads = NULL;
+	RSearchKeyword *kw;
+	RListIter *iter;
+	char *file;
+	ut64 bytes = 0, overlap = 0;
+	int i, f, t, result = 1;
+
+	RList *files = r_list_newf (free);
+	RSearch *rs = r_search_new (mode);
+	if (!files || !rs) {
+		goto beach;
+	}
+	add_keywords (rs);
+	pool.nkws = rs->n_kws;
+	pool.kwlen = calloc (pool.nkws + 1, sizeof (ut32));
+	pool.last = calloc (pool.nkws + 1, sizeof (ut64));
+	pool.count = calloc (pool.nkws + 1, sizeof (int));
+	if (!pool.kwlen || !pool.last || !pool.count) {
+		goto beach;
+	}
+	r_list_foreach (rs->kws, iter, kw) {
+		pool.kwlen[kw->kwidx] = kw->keyword_length;
+		overlap = R_MAX (overlap, kw->keyword_length - 1);
+	}
+	if (showstr || pr) {
+		overlap = R_MAX (overlap, HIT_DATA);
+	}
+	for (i = 0; i < npaths; i++) {
+		collect_files (files, paths[i]);
+	}
+
+	pool.nfiles = r_list_length (files);
+	pool.files = calloc (pool.nfiles + 1, sizeof (char *));
+	pool.first = calloc (pool.nfiles + 1, sizeof (int));
+	ut64 *sizes = calloc (pool.nfiles + 1, sizeof (ut64));
+	if (!pool.files || !pool.first || !sizes) {
+		free (sizes);
+		goto beach;
+	}
+	f = 0;
+	r_list_foreach (files, iter, file) {
+		ut64 size = r_file_size (file);
+		if (!r_file_exists (file)) {
+			eprintf ("Cannot open file '%s'\n", file);
+		}
+		if (to != UT64_MAX && to < size) {
+			size = to;
+		}
+		pool.files[f] = file;
+		pool.first[f] = pool.ntasks;
+		sizes[f++] = size;
+		if (size > from) {
+			pool.ntasks += (size - from + RANGE_SIZE - 1) / RANGE_SIZE;
+		}
+	}
+	pool.first[f] = pool.ntasks;
+	pool.tasks = calloc (pool.ntasks + 1, sizeof (RafindTask));
+	if (!pool.tasks) {
+		free (sizes);
+		goto beach;
+	}
+	for (f = 0, t = 0; f < pool.nfiles; f++) {
+		ut64 at;
+		for (at = from; at < sizes[f]; at += RANGE_SIZE, t++) {
+			RafindTask *task = &pool.tasks[t];
+			task->file = f;
+			task->from = at;
+			task->to = R_MIN (at + RANGE_SIZE, sizes[f]);
+			task->end = R_MIN (task->to + overlap, sizes[f]);
+			r_vector_init (&task->hits, sizeof (RafindHit), NULL, NULL);
+			bytes += task->to - task->from;
+		}
+	}
+	free (sizes);
+
+	pool.lock = r_th_lock_new (false);
+	pool.cond = r_th_cond_new ();
+	workers = calloc (nthreads, sizeof (RafindWorker));
+	threads = calloc (nthreads, sizeof (RThread *));
+	if (!pool.lock || !pool.cond || !workers || !threads) {
+		goto beach;
+	}
+	for (i = 0; i < nthreads; i++) {
+		workers[i].pool = &pool;
+		workers[i].rs = r_search_new (mode);
+		if (!workers[i].rs) {
+			goto beach;
+		}
+		workers[i].rs->align = align;
+		// adjacent hits are dropped by print_file, across ranges too
+		workers[i].rs->contiguous = true;
+		add_keywords (workers[i].rs);
+		r_search_set_callback (workers[i].rs, &parallel_hit, &workers[i]);
+	}
+	rescan.pool = &pool;
+	rescan.rs = rs;
+	rs->align = align;
+	rs->contiguous = true;
+	r_search_set_callback (rs, &parallel_hit, &rescan);
+	pool.rescan = &rescan;
+	if (pr && !r_cons_new ()) {
+		goto beach;
+	}
+
+	ut64 start = r_sys_now ();
+	int started = 0;
+	for (i = 0; i < nthreads; i++) {
+		threads[i] = r_th_new (rafind_worker, &workers[i], 0);
+		if (threads[i]) {
+			started++;
+		}
+	}
+	if (!started) {
+		// the tasks still have to run for the loop below to end
+		rafind_work (&workers[0]);
+	}
+	for (f = 0; f < pool.nfiles; f++) {
+		r_th_lock_enter (pool.lock);
+		for (t = pool.first[f]; t < pool.first[f + 1]; t++) {
+			while (!pool.tasks[t].done) {
+				r_th_cond_wait (pool.cond, pool.lock);
+			}
+		}
+		r_th_lock_leave (pool.lock);
+		print_file (&pool, f);
+	}
+	for (i = 0; i < nthreads; i++) {
+		if (threads[i]) {
+			r_th_wait (threads[i]);
+			r_th_free (threads[i]);
+		}
+	}
+	double secs = (r_sys_now () - start) / 1000000.0;
+	double mb = bytes / (1024.0 * 1024.0);
+	if (secs <= 0) {
+		secs = 0.000001;
+	}
+	fflush (stdout);
+	eprintf ("%d files, %.2f MB in %.3fs (%.2f MB/s, %.2f files/s)\n",
+		pool.nfiles, mb, secs, mb / secs, pool.nfiles / secs);
+	if (pr) {
+		r_cons_free ();
+	}
+	result = 0;
+beach:
+	if (workers) {
+		for (i = 0; i < nthreads; i++) {
+			r_search_free (workers[i].rs);
+		}
+	}
+	free (workers);
+	free (threads);
+	free (pool.tasks);
+	free (pool.first);
+	free (pool.files);
+	free (pool.kwlen);
+	free (pool.last);
+	free (pool.count);
+	r_th_cond_free (pool.cond);
+	r_th_lock_free (pool.lock);
+	r_search_free (rs);
+	r_list_free (files);
+	return result;
+}
+
 int main(int argc, char **argv) {
 	int c;
 
 	keywords = r_list_new ();
-	while ((c = getopt (argc, argv, "a:ie:b:mM:s:S:x:Xzf:t:E:rqnhvZ")) != -1) {
+	while ((c = getopt (argc, argv, "a:ie:b:j:mM:s:S:x:Xzf:t:E:rqnhvZ")) != -1) {
 		switch (c) {
 		case 'a':
 			align = r_num_math (NULL, optarg);
@@ -321,6 +746,9 @@ int main(int argc, char **argv) {
 		case 'b':
 			bsize = r_num_math (NULL, optarg);
 			break;
+		case 'j':
+			jobs = r_num_math (NULL, optarg);
+			break;
 		case 'x':
 			mode = R_SEARCH_KEYWORD;
 			hexstr = 1;
@@ -364,6 +792,9 @@ int main(int argc, char **argv) {
 	if (optind + 1 == argc && !r_file_is_directory (argv[optind])) {
 		quiet = true;
 	}
+	if (jobs > 1 && mode == R_SEARCH_KEYWORD && !identify) {
+		return rafind_parallel (argv + optind, argc - optind, jobs);
+	}
 	for (; optind < argc; optind++) {
 		rafind_open (argv[optind]);
 	}
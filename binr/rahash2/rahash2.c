@@ -137,10 +137,244 @@ static int do_hash_internal(RHash *ctx, ut64 hash, const ut8 *buf, int len, int
 	return 1;
 }
 
+// blocks in flight between the reader and the per algorithm workers
+#define HASH_PIPE_SLOTS 4
+// bytes read at once in per-block mode
+#define HASH_BATCH_SIZE (64 * 1024 * 1024)
+// memory for the digests of a batch, small blocks would need too many
+#define HASH_DIGEST_BUDGET (16 * 1024 * 1024)
+
+typedef struct {
+	ut8 *buf[HASH_PIPE_SLOTS];
+	int len[HASH_PIPE_SLOTS];
+	ut64 nblocks; // blocks read so far
+	bool done;
+	RThreadLock *lock;
+	RThreadCond *cond;
+} HashPipe;
+
+typedef struct {
+	HashPipe *pipe;
+	RHash *ctx;
+	ut64 hashbit;
+	ut64 nblocks; // blocks hashed so far
+} HashWorker;
+
+typedef struct {
+	ut8 digest[128];
+	double entropy;
+} HashDigest;
+
+typedef struct {
+	const ut8 *buf;
+	int bsize;
+	int len; // bytes in the batch
+	int id;
+	int step;
+	ut64 *algos;
+	int nalgos;
+	HashDigest *out; // one per block and algorithm
+} HashBatch;
+
+static RThreadFunctionRet hash_worker(RThread *th) {
+	HashWorker *w = th->user;
+	HashPipe *pipe = w->pipe;
+	for (;;) {
+		r_th_lock_enter (pipe->lock);
+		while (w->nblocks == pipe->nblocks && !pipe->done) {
+			r_th_cond_wait (pipe->cond, pipe->lock);
+		}
+		if (w->nblocks == pipe->nblocks) {
+			r_th_lock_leave (pipe->lock);
+			break;
+		}
+		int slot = w->nblocks % HASH_PIPE_SLOTS;
+		r_th_lock_leave (pipe->lock);
+		do_hash_internal (w->ctx, w->hashbit, pipe->buf[slot], pipe->len[slot], 0, 0, 0);
+		r_th_lock_enter (pipe->lock);
+		w->nblocks++;
+		r_th_cond_signal_all (pipe->cond);
+		r_th_lock_leave (pipe->lock);
+	}
+	return R_TH_STOP;
+}
+
+static void hash_pipe_stop(HashPipe *pipe, RThread **th, int n) {
+	int i;
+	r_th_lock_enter (pipe->lock);
+	pipe->done = true;
+	r_th_cond_signal_all (pipe->cond);
+	r_th_lock_leave (pipe->lock);
+	for (i = 0; i < n; i++) {
+		r_th_wait (th[i]);
+		r_th_free (th[i]);
+	}
+}
+
+// read the range once and feed every block to all the workers, each
+// algorithm runs on its own thread when there are cpus to spare
+static bool hash_pipe(RIO *io, HashWorker *w, int nw, int bsize) {
+	RThread *th[R_HASH_NBITS] = {0};
+	HashPipe pipe = {{0}};
+	bool threaded = nw > 1 && r_th_ncpus () > 1;
+	int i, nslots = threaded? HASH_PIPE_SLOTS: 1;
+	bool ok = false;
+	ut64 j;
+
+	for (i = 0; i < nslots; i++) {
+		if (!(pipe.buf[i] = calloc (1, bsize + 1))) {
+			eprintf ("rahash2: Cannot allocate %d bytes\n", bsize + 1);
+			goto beach;
+		}
+	}
+	if (threaded) {
+		pipe.lock = r_th_lock_new (false);
+		pipe.cond = r_th_cond_new ();
+		threaded = pipe.lock && pipe.cond;
+		for (i = 0; threaded && i < nw; i++) {
+			w[i].pipe = &pipe;
+			if (!(th[i] = r_th_new (hash_worker, &w[i], 0))) {
+				// hash everything on this thread instead
+				hash_pipe_stop (&pipe, th, i);
+				threaded = false;
+			}
+		}
+	}
+	for (j = from; j < to; j += bsize) {
+		int len = ((j + bsize) > to)? (to - j): bsize;
+		if (!threaded) {
+			r_io_pread_at (io, j, pipe.buf[0], len);
+			for (i = 0; i < nw; i++) {
+				do_hash_internal (w[i].ctx, w[i].hashbit, pipe.buf[0], len, 0, 0, 0);
+			}
+			continue;
+		}
+		// wait for the slowest worker to release the slot
+		int slot = pipe.nblocks % nslots;
+		r_th_lock_enter (pipe.lock);
+		for (i = 0; i < nw; i++) {
+			while (pipe.nblocks - w[i].nblocks >= nslots) {
+				r_th_cond_wait (pipe.cond, pipe.lock);
+			}
+		}
+		r_th_lock_leave (pipe.lock);
+		r_io_pread_at (io, j, pipe.buf[slot], len);
+		pipe.len[slot] = len;
+		r_th_lock_enter (pipe.lock);
+		pipe.nblocks++;
+		r_th_cond_signal_all (pipe.cond);
+		r_th_lock_leave (pipe.lock);
+	}
+	if (threaded) {
+		hash_pipe_stop (&pipe, th, nw);
+	}
+	ok = true;
+beach:
+	r_th_lock_free (pipe.lock);
+	r_th_cond_free (pipe.cond);
+	for (i = 0; i < nslots; i++) {
+		free (pipe.buf[i]);
+	}
+	return ok;
+}
+
+static void hash_batch(HashBatch *hb) {
+	RHash *ctx = r_hash_new (true, 0);
+	int b, a, nblocks = (hb->len + hb->bsize - 1) / hb->bsize;
+	if (!ctx) {
+		return;
+	}
+	for (b = hb->id; b < nblocks; b += hb->step) {
+		int len = R_MIN (hb->bsize, hb->len - b * hb->bsize);
+		for (a = 0; a < hb->nalgos; a++) {
+			HashDigest *d = &hb->out[b * hb->nalgos + a];
+			int dlen = r_hash_calculate (ctx, hb->algos[a], hb->buf + b * hb->bsize, len);
+			memcpy (d->digest, ctx->digest, R_MIN (dlen, sizeof (d->digest)));
+			d->entropy = ctx->entropy;
+		}
+	}
+	r_hash_free (ctx);
+}
+
+static RThreadFunctionRet hash_batch_th(RThread *th) {
+	hash_batch (th->user);
+	return R_TH_STOP;
+}
+
+// hash the blocks of the range a batch at a time, the blocks of a batch are
+// spread across the cpus and printed in order once all of them are done
+static bool hash_blocks(RIO *io, RHash *ctx, ut64 *algos, int nalgos, int bsize, int rad, int ule) {
+	int i, ntasks = R_MAX (1, r_th_ncpus ());
+	// no more blocks than the range has, nor digests than the budget allows
+	ut64 perbatch = R_MAX (1, HASH_BATCH_SIZE / bsize);
+	perbatch = R_MIN (perbatch, (to - from + bsize - 1) / bsize);
+	perbatch = R_MAX (1, R_MIN (perbatch, HASH_DIGEST_BUDGET / (R_MAX (1, nalgos) * sizeof (HashDigest))));
+	ut8 *buf = malloc (perbatch * bsize);
+	HashDigest *out = calloc (perbatch * nalgos, sizeof (HashDigest));
+	HashBatch *tasks = calloc (ntasks, sizeof (HashBatch));
+	RThread **th = calloc (ntasks, sizeof (RThread *));
+	ut64 j, ofrom = from, oto = to;
+	bool first = true, ok = buf && out && tasks && th;
+
+	if (!ok) {
+		eprintf ("rahash2: Cannot allocate %"PFMT64u" blocks of %d bytes\n", perbatch, bsize);
+	}
+	for (j = ofrom; ok && j < oto; j += perbatch * bsize) {
+		int b, a, len = R_MIN (perbatch * bsize, oto - j);
+		int nblocks = (len + bsize - 1) / bsize;
+		int n = R_MIN (ntasks, nblocks);
+		r_io_pread_at (io, j, buf, len);
+		for (i = 0; i < n; i++) {
+			HashBatch hb = { buf, bsize, len, i, n, algos, nalgos, out };
+			tasks[i] = hb;
+		}
+		if (n == 1) {
+			hash_batch (&tasks[0]);
+		} else {
+			for (i = 0; i < n; i++) {
+				th[i] = r_th_new (hash_batch_th, &tasks[i], 0);
+				if (!th[i]) {
+					hash_batch (&tasks[i]);
+				}
+			}
+			for (i = 0; i < n; i++) {
+				r_th_wait (th[i]);
+				r_th_free (th[i]);
+			}
+		}
+		for (b = 0; b < nblocks; b++) {
+			from = j + (ut64)b * bsize;
+			to = R_MIN (from + bsize, oto);
+			for (a = 0; a < nalgos; a++) {
+				HashDigest *d = &out[b * nalgos + a];
+				memcpy (ctx->digest, d->digest, sizeof (d->digest));
+				ctx->entropy = d->entropy;
+				if (iterations > 0) {
+					r_hash_do_spice (ctx, algos[a], iterations, _s);
+				}
+				if (rad == 'j') {
+					if (first) {
+						first = false;
+					} else {
+						printf (",");
+					}
+				}
+				do_hash_print (ctx, algos[a], r_hash_size (algos[a]), rad, ule);
+			}
+		}
+	}
+	from = ofrom;
+	to = oto;
+	free (buf);
+	free (out);
+	free (tasks);
+	free (th);
+	return ok;
+}
+
 static int do_hash(const char *file, const char *algo, RIO *io, int bsize, int rad, int ule, const ut8 *compare) {
-	ut64 j, fsize, algobit = r_hash_name_to_bits (algo);
+	ut64 fsize, algobit = r_hash_name_to_bits (algo);
 	RHash *ctx;
-	ut8 *buf;
 	int ret = 0;
 	ut64 i;
 	bool first = true;
@@ -170,90 +404,90 @@ static int do_hash(const char *file, const char *algo, RIO *io, int bsize, int r
 		eprintf ("rahash2: Unknown file size\n");
 		return 1;
 	}
-	buf = calloc (1, bsize + 1);
-	if (!buf) {
+	ctx = r_hash_new (true, algobit);
+	if (!ctx) {
 		return 1;
 	}
-	ctx = r_hash_new (true, algobit);
 
 	if (rad == 'j') {
 		printf ("[");
 	}
 	if (incremental) {
+		HashWorker w[R_HASH_NBITS] = {{0}};
+		int k, nw = 0;
 		for (i = 1; i < R_HASH_ALL; i <<= 1) {
 			if (algobit & i) {
-				ut64 hashbit = i & algobit;
-				int dlen = r_hash_size (hashbit);
-				r_hash_do_begin (ctx, i);
-				if (s.buf && s.prefix) {
-					do_hash_internal (ctx, hashbit, s.buf, s.len, rad, 0, ule);
+				RHash *hctx = r_hash_new (true, i);
+				if (!hctx) {
+					ret = 1;
+					break;
 				}
-				for (j = from; j < to; j += bsize) {
-					int len = ((j + bsize) > to)? (to - j): bsize;
-					r_io_pread_at (io, j, buf, len);
-					do_hash_internal (ctx, hashbit, buf, len, rad, 0, ule);
-				}
-				if (s.buf && !s.prefix) {
-					do_hash_internal (ctx, hashbit, s.buf, s.len, rad, 0, ule);
-				}
-				r_hash_do_end (ctx, i);
-				if (iterations > 0) {
-					r_hash_do_spice (ctx, i, iterations, _s);
-				}
-				if (!*r_hash_name (i)) {
-					continue;
-				}
-				if (rad == 'j') {
-					if (first) {
-						first = false;
-					} else {
-						printf (",");
-					}
-				}
-				if (!quiet && rad != 'j') {
-					printf ("%s: ", file);
+				r_hash_do_begin (hctx, i);
+				if (s.buf && s.prefix) {
+					do_hash_internal (hctx, i, s.buf, s.len, rad, 0, ule);
 				}
-				do_hash_print (ctx, i, dlen, quiet? 'n': rad, ule);
-				if (quiet == 1) {
-					printf (" %s\n", file);
+				w[nw].ctx = hctx;
+				w[nw].hashbit = i;
+				nw++;
+			}
+		}
+		if (!ret && !hash_pipe (io, w, nw, bsize)) {
+			ret = 1;
+		}
+		for (k = 0; !ret && k < nw; k++) {
+			RHash *hctx = w[k].ctx;
+			ut64 hashbit = w[k].hashbit;
+			int dlen = r_hash_size (hashbit);
+			if (s.buf && !s.prefix) {
+				do_hash_internal (hctx, hashbit, s.buf, s.len, rad, 0, ule);
+			}
+			r_hash_do_end (hctx, hashbit);
+			if (iterations > 0) {
+				r_hash_do_spice (hctx, hashbit, iterations, _s);
+			}
+			memcpy (ctx->digest, hctx->digest, sizeof (ctx->digest));
+			if (!*r_hash_name (hashbit)) {
+				continue;
+			}
+			if (rad == 'j') {
+				if (first) {
+					first = false;
 				} else {
-					if (quiet && !rad) {
-						printf ("\n");
-					}
+					printf (",");
+				}
+			}
+			if (!quiet && rad != 'j') {
+				printf ("%s: ", file);
+			}
+			do_hash_print (hctx, hashbit, dlen, quiet? 'n': rad, ule);
+			if (quiet == 1) {
+				printf (" %s\n", file);
+			} else {
+				if (quiet && !rad) {
+					printf ("\n");
 				}
 			}
 		}
+		for (k = 0; k < nw; k++) {
+			r_hash_free (w[k].ctx);
+		}
 		if (_s) {
 			free (_s->buf);
 		}
 	} else {
-		/* iterate over all algorithm bits */
+		ut64 algos[R_HASH_NBITS];
+		int nalgos = 0;
 		if (s.buf) {
 			eprintf ("Warning: Seed ignored on per-block hashing.\n");
 		}
 		for (i = 1; i < R_HASH_ALL; i <<= 1) {
-			ut64 f, t, ofrom, oto;
 			if (algobit & i) {
-				ut64 hashbit = i & algobit;
-				ofrom = from;
-				oto = to;
-				f = from;
-				t = to;
-				for (j = f; j < t; j += bsize) {
-					int nsize = (j + bsize < fsize)? bsize: (fsize - j);
-					r_io_pread_at (io, j, buf, bsize);
-					from = j;
-					to = j + bsize;
-					if (to > fsize) {
-						to = fsize;
-					}
-					do_hash_internal (ctx, hashbit, buf, nsize, rad, 0, ule);
-				}
-				do_hash_internal (ctx, hashbit, NULL, 0, rad, 1, ule);
-				from = ofrom;
-				to = oto;
+				algos[nalgos++] = i;
 			}
 		}
+		if (!hash_blocks (io, ctx, algos, nalgos, bsize, rad, ule)) {
+			ret = 1;
+		}
 	}
 	if (rad == 'j') {
 		printf ("]\n");
@@ -261,7 +495,6 @@ static int do_hash(const char *file, const char *algo, RIO *io, int bsize, int r
 
 	compare_hashes (ctx, compare, r_hash_size (algobit), &ret);
 	r_hash_free (ctx);
-	free (buf);
 	return ret;
 }
 
@@ -176,7 +176,8 @@ R_API RAnal *r_anal_new() {
 	r_event_hook (anal->zign_spaces.event, R_SPACE_EVENT_RENAME, zign_rename_for, NULL);
 	anal->sdb_fcns = sdb_ns (anal->sdb, "fcns", 1);
 	anal->sdb_meta = sdb_ns (anal->sdb, "meta", 1);
-	anal->sdb_hints = sdb_ns (anal->sdb, "hints", 1);
+	anal->meta_ranges = NULL;
+	anal->hints = NULL;
 	anal->hint_cbs.on_bits = __anal_hint_on_bits;
 	anal->sdb_types = sdb_ns (anal->sdb, "types", 1);
 	anal->sdb_fmts = sdb_ns (anal->sdb, "spec", 1);
@@ -237,8 +238,9 @@ R_API RAnal *r_anal_free(RAnal *a) {
 	r_reg_free (a->reg);
 	r_anal_op_free (a->queued);
 	r_rbtree_free (a->rb_hints_ranges, __anal_hint_range_tree_free);
-	ht_up_free (a->dict_refs);
-	ht_up_free (a->dict_xrefs);
+	r_anal_hint_clear (a);
+	r_meta_free (a);
+	r_anal_xrefs_fini (a);
 	a->sdb = NULL;
 	sdb_ns_free (a->sdb);
 	if (a->esil) {
@@ -490,7 +492,8 @@ R_API bool r_anal_op_is_eob (RAnalOp *op) {
 R_API int r_anal_purge (RAnal *anal) {
 	sdb_reset (anal->sdb_fcns);
 	sdb_reset (anal->sdb_meta);
-	sdb_reset (anal->sdb_hints);
+	r_meta_free (anal);
+	r_anal_hint_clear (anal);
 	sdb_reset (anal->sdb_types);
 	sdb_reset (anal->sdb_zigns);
 	sdb_reset (anal->sdb_classes);
@@ -765,27 +768,37 @@ R_API int r_anal_range_tree_find_bits_at(RBNode *root, ut64 addr) {
 	return bits;
 }
 
+static bool collect_hint(void *user, const RAnalHint *hint) {
+	r_vector_push (user, (void *)&hint->addr);
+	return true;
+}
+
 R_API void r_anal_merge_hint_ranges(RAnal *a) {
 	if (a->merge_hints) {
-		SdbListIter *iter;
-		SdbKv *kv;
-		SdbList *sdb_range = sdb_foreach_list (a->sdb_hints, true);
+		RVector *addrs = r_vector_new (sizeof (ut64), NULL, NULL);
+		ut64 *addr;
 		int range_bits = 0;
+		if (!addrs) {
+			return;
+		}
 		r_rbtree_free (a->rb_hints_ranges, __anal_hint_range_tree_free);
 		a->rb_hints_ranges = NULL;
-		ls_foreach (sdb_range, iter, kv) {
-			ut64 addr = sdb_atoi (sdbkv_key (kv) + 5);
-			int bits = r_anal_hint_get_bits_at (a, addr,  sdbkv_value (kv));
+		// unsetting bits may drop the hint, so walk a snapshot of the addresses
+		r_anal_hint_foreach (a, collect_hint, addrs);
+		r_vector_foreach (addrs, addr) {
+			RAnalHint *hint = r_anal_hint_at (a, *addr);
+			int bits = hint? hint->bits: 0;
 			if (bits && range_bits == bits) {
-				r_anal_hint_unset_bits (a, addr);
+				r_anal_hint_unset_bits (a, *addr);
 			} else {
 				RAnalRange *range = R_NEW0 (RAnalRange);
 				range->bits = bits;
-				range->from = addr;
+				range->from = *addr;
 				__anal_range_hint_tree_insert (&a->rb_hints_ranges, range);
 			}
 			range_bits = bits;
 		}
+		r_vector_free (addrs);
 		a->merge_hints = false;
 	}
 }
@@ -170,11 +170,303 @@ R_API bool r_anal_diff_bb(RAnal *anal, RAnalFunction *fcn, RAnalFunction *fcn2)
 	return true;
 }
 
+// functions are paired by name first, then with an identical fingerprint of
+// the other binary, and the rest only against the few functions sharing a
+// minhash band with them, whose distances are computed in parallel
+#define DIFF_BANDS 16
+#define DIFF_ROWS 3
+#define DIFF_HASHES (DIFF_BANDS * DIFF_ROWS)
+#define DIFF_SHINGLE 4
+#define DIFF_CANDS 32 // closest candidates kept per function
+#define DIFF_BUCKET_MAX 1024 // functions looked at per band
+
+enum {
+	DIFF_PASS_NAME,
+	DIFF_PASS_SIG,
+	DIFF_PASS_CANDS,
+};
+
+typedef struct {
+	int idx; // in fcns2
+	double t;
+} DiffCand;
+
+typedef struct {
+	RAnal *anal;
+	int pass;
+	RAnalFunction **f[2];
+	int n[2];
+	int *pair; // fcns2 index of the function with the same name, or -1
+	bool *first; // whether the fingerprint of that one is still there
+	double *pt;
+	ut64 a[DIFF_HASHES], b[DIFF_HASHES];
+	ut32 *sig[2];
+	bool *todo;
+	HtUP *exact; // fingerprint hash -> first fcns2 index + 1
+	int *exact_next;
+	HtUP *bands; // band hash -> first fcns2 index + 1
+	int *band_next; // per fcns2 index and band
+	DiffCand *cands;
+	int *ncands; // -1 until computed
+} DiffCtx;
+
+typedef struct {
+	DiffCtx *ctx;
+	int w, step;
+	int stamp;
+	int *seen, *hits, *list; // per fcns2 index
+} DiffTask;
+
+static void diff_pair(RAnal *anal, RAnalFunction *fcn, RAnalFunction *fcn2, double t) {
+	/* Set flag in matched functions */
+	fcn->diff->type = fcn2->diff->type = (t >= 1)
+		? R_ANAL_DIFF_TYPE_MATCH
+		: R_ANAL_DIFF_TYPE_UNMATCH;
+	fcn->diff->dist = fcn2->diff->dist = t;
+	R_FREE (fcn->fingerprint);
+	R_FREE (fcn2->fingerprint);
+	fcn->diff->addr = fcn2->addr;
+	fcn2->diff->addr = fcn->addr;
+	fcn->diff->size = r_anal_fcn_size (fcn2);
+	fcn2->diff->size = r_anal_fcn_size (fcn);
+	R_FREE (fcn->diff->name);
+	if (fcn2->name) {
+		fcn->diff->name = strdup (fcn2->name);
+	}
+	R_FREE (fcn2->diff->name);
+	if (fcn->name) {
+		fcn2->diff->name = strdup (fcn->name);
+	}
+	r_anal_diff_bb (anal, fcn, fcn2);
+}
+
+static double diff_dist(RAnalFunction *fcn, RAnalFunction *fcn2) {
+	double t = 0;
+	r_diff_buffers_distance (NULL, fcn->fingerprint, r_anal_fcn_size (fcn),
+			fcn2->fingerprint, r_anal_fcn_size (fcn2), NULL, &t);
+	return t;
+}
+
+static bool diff_eligible(RAnal *anal, ut32 size, RAnalFunction *fcn2) {
+	ut64 size2 = r_anal_fcn_size (fcn2);
+	ut64 maxsize = R_MAX (size, size2), minsize = R_MIN (size, size2);
+	return !(maxsize * anal->diff_thfcn > minsize)
+		&& fcn2->diff->type == R_ANAL_DIFF_TYPE_NULL
+		&& (fcn2->type == R_ANAL_FCN_TYPE_FCN || fcn2->type == R_ANAL_FCN_TYPE_SYM);
+}
+
+static ut64 diff_fp_hash(RAnalFunction *fcn) {
+	ut32 i, size = r_anal_fcn_size (fcn);
+	ut64 h = 0xcbf29ce484222325ULL ^ size;
+	for (i = 0; i < size; i++) {
+		h = (h ^ fcn->fingerprint[i]) * 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static ut64 diff_band_key(const ut32 *sig, int band) {
+	ut64 h = 0xcbf29ce484222325ULL ^ band;
+	int r;
+	for (r = 0; r < DIFF_ROWS; r++) {
+		h = (h ^ sig[band * DIFF_ROWS + r]) * 0x100000001b3ULL;
+	}
+	return h;
+}
+
+// minhash of the byte shingles of the fingerprint, whose operands are
+// already masked out when diffing opcodes only
+static void diff_minhash(DiffCtx *ctx, int l, int i) {
+	RAnalFunction *fcn = ctx->f[l][i];
+	ut32 *sig = ctx->sig[l] + (size_t)i * DIFF_HASHES;
+	ut32 size = r_anal_fcn_size (fcn), j;
+	int m;
+	memset (sig, 0xff, sizeof (ut32) * DIFF_HASHES);
+	if (!fcn->fingerprint || !size) {
+		return;
+	}
+	for (j = 0; j + DIFF_SHINGLE <= size || !j; j++) {
+		ut8 sh[DIFF_SHINGLE] = {0};
+		memcpy (sh, fcn->fingerprint + j, R_MIN (size, DIFF_SHINGLE));
+		ut64 x = r_read_le32 (sh);
+		for (m = 0; m < DIFF_HASHES; m++) {
+			ut32 v = (ctx->a[m] * x + ctx->b[m]) >> 32;
+			if (v < sig[m]) {
+				sig[m] = v;
+			}
+		}
+	}
+}
+
+static int diff_cmp_int(const void *a, const void *b) {
+	return *(const int *)a - *(const int *)b;
+}
+
+// distances to the functions sharing the most bands with this one
+static void diff_candidates(DiffTask *task, int i) {
+	DiffCtx *ctx = task->ctx;
+	RAnalFunction *fcn = ctx->f[0][i];
+	const ut32 *sig = ctx->sig[0] + (size_t)i * DIFF_HASHES;
+	DiffCand *cands = ctx->cands + (size_t)i * DIFF_CANDS;
+	ut32 size = r_anal_fcn_size (fcn);
+	int cnt[DIFF_BANDS + 1] = {0};
+	int b, j, k, n = 0, min, have, room, stamp = ++task->stamp;
+	ctx->ncands[i] = 0;
+	if (!fcn->fingerprint || !size) {
+		return;
+	}
+	for (b = 0; b < DIFF_BANDS; b++) {
+		bool found = false;
+		int head = (int)(size_t)ht_up_find (ctx->bands, diff_band_key (sig, b), &found);
+		for (j = head - 1, k = 0; found && j >= 0 && k < DIFF_BUCKET_MAX; k++) {
+			if (task->seen[j] != stamp) {
+				task->seen[j] = stamp;
+				task->hits[j] = diff_eligible (ctx->anal, size, ctx->f[1][j]);
+				if (task->hits[j]) {
+					task->list[n++] = j;
+				}
+			} else if (task->hits[j]) {
+				task->hits[j]++;
+			}
+			j = ctx->band_next[(size_t)j * DIFF_BANDS + b];
+		}
+	}
+	qsort (task->list, n, sizeof (int), diff_cmp_int);
+	for (k = 0; k < n; k++) {
+		cnt[task->hits[task->list[k]]]++;
+	}
+	for (min = DIFF_BANDS, have = cnt[min]; min > 1 && have < DIFF_CANDS; ) {
+		have += cnt[--min];
+	}
+	room = DIFF_CANDS - (have - cnt[min]);
+	for (k = 0; k < n; k++) {
+		j = task->list[k];
+		if (task->hits[j] > min || (task->hits[j] == min && room-- > 0)) {
+			cands[ctx->ncands[i]].idx = j;
+			cands[ctx->ncands[i]].t = diff_dist (fcn, ctx->f[1][j]);
+			ctx->ncands[i]++;
+		}
+	}
+}
+
+// first function not diffed yet with the very same fingerprint
+static int diff_exact(DiffCtx *ctx, int i) {
+	RAnalFunction *fcn = ctx->f[0][i], *fcn2;
+	ut32 size = r_anal_fcn_size (fcn);
+	bool found = false;
+	if (!fcn->fingerprint || ctx->anal->diff_thfcn >= 1) {
+		return -1;
+	}
+	ut64 key = diff_fp_hash (fcn);
+	int j, head = (int)(size_t)ht_up_find (ctx->exact, key, &found);
+	if (!found) {
+		return -1;
+	}
+	for (j = head - 1; j >= 0 && ctx->f[1][j]->diff->type != R_ANAL_DIFF_TYPE_NULL; ) {
+		j = ctx->exact_next[j];
+	}
+	if (j + 1 != head) {
+		ht_up_update (ctx->exact, key, (void *)(size_t)(j + 1));
+	}
+	for (; j >= 0; j = ctx->exact_next[j]) {
+		fcn2 = ctx->f[1][j];
+		if (fcn2->diff->type == R_ANAL_DIFF_TYPE_NULL && fcn2->fingerprint
+				&& r_anal_fcn_size (fcn2) == size
+				&& !memcmp (fcn->fingerprint, fcn2->fingerprint, size)) {
+			return j;
+		}
+	}
+	return -1;
+}
+
+static void diff_work(DiffTask *task) {
+	DiffCtx *ctx = task->ctx;
+	int i, n = ctx->n[0];
+	switch (ctx->pass) {
+	case DIFF_PASS_NAME:
+		for (i = task->w; i < n; i += task->step) {
+			if (ctx->pair[i] >= 0 && ctx->first[i]) {
+				ctx->pt[i] = diff_dist (ctx->f[0][i], ctx->f[1][ctx->pair[i]]);
+			}
+		}
+		break;
+	case DIFF_PASS_SIG:
+		for (i = task->w; i < n + ctx->n[1]; i += task->step) {
+			RAnalFunction *fcn = i < n? ctx->f[0][i]: ctx->f[1][i - n];
+			if (i < n? fcn->diff->type == R_ANAL_DIFF_TYPE_NULL
+					: diff_eligible (ctx->anal, r_anal_fcn_size (fcn), fcn)) {
+				diff_minhash (ctx, i >= n, i < n? i: i - n);
+			}
+		}
+		break;
+	case DIFF_PASS_CANDS:
+		for (i = task->w; i < n; i += task->step) {
+			if (ctx->todo[i]) {
+				diff_candidates (task, i);
+			}
+		}
+		break;
+	}
+}
+
+static RThreadFunctionRet diff_th(RThread *th) {
+	diff_work (th->user);
+	return R_TH_STOP;
+}
+
+static void diff_run(DiffCtx *ctx, DiffTask *tasks, int ntasks, int pass) {
+	RThread **th = ntasks > 1? calloc (ntasks, sizeof (RThread *)): NULL;
+	int i;
+	ctx->pass = pass;
+	if (!th) {
+		for (i = 0; i < ntasks; i++) {
+			diff_work (&tasks[i]);
+		}
+		return;
+	}
+	for (i = 0; i < ntasks; i++) {
+		th[i] = r_th_new (diff_th, &tasks[i], 0);
+		if (!th[i]) {
+			diff_work (&tasks[i]);
+		}
+	}
+	for (i = 0; i < ntasks; i++) {
+		r_th_wait (th[i]);
+		r_th_free (th[i]);
+	}
+	free (th);
+}
+
+static void diff_ctx_fini(DiffCtx *ctx, DiffTask *tasks, int ntasks) {
+	int i;
+	for (i = 0; tasks && i < ntasks; i++) {
+		free (tasks[i].seen);
+		free (tasks[i].hits);
+		free (tasks[i].list);
+	}
+	free (tasks);
+	free (ctx->f[0]);
+	free (ctx->f[1]);
+	free (ctx->pair);
+	free (ctx->first);
+	free (ctx->pt);
+	free (ctx->sig[0]);
+	free (ctx->sig[1]);
+	free (ctx->todo);
+	ht_up_free (ctx->exact);
+	free (ctx->exact_next);
+	ht_up_free (ctx->bands);
+	free (ctx->band_next);
+	free (ctx->cands);
+	free (ctx->ncands);
+}
+
 R_API int r_anal_diff_fcn(RAnal *anal, RList *fcns, RList *fcns2) {
-	RAnalFunction *fcn, *fcn2, *mfcn, *mfcn2;
-	RListIter *iter, *iter2;
-	ut64 maxsize, minsize;
-	double t, ot;
+	RAnalFunction *fcn, *fcn2;
+	RListIter *iter;
+	DiffCtx ctx = {0};
+	int i, j, k, b, null2 = -1;
+	bool *used = NULL, ret = false;
+	HtPP *names = NULL;
 
 	if (!anal) {
 		return false;
@@ -182,110 +474,153 @@ R_API int r_anal_diff_fcn(RAnal *anal, RList *fcns, RList *fcns2) {
 	if (anal->cur && anal->cur->diff_fcn) {
 		return (anal->cur->diff_fcn (anal, fcns, fcns2));
 	}
-	/* Compare functions with the same name */
-	if (fcns) {
-		r_list_foreach (fcns, iter, fcn) {
-			r_list_foreach (fcns2, iter2, fcn2) {
-				if (fcn->name && fcn2->name && strcmp (fcn->name, fcn2->name)) {
-					continue;
-				}
-				r_diff_buffers_distance (NULL, fcn->fingerprint, r_anal_fcn_size (fcn),
-						fcn2->fingerprint, r_anal_fcn_size (fcn2),
-						NULL, &t);
-				/* Set flag in matched functions */
-				fcn->diff->type = fcn2->diff->type = (t >= 1)
-					? R_ANAL_DIFF_TYPE_MATCH
-					: R_ANAL_DIFF_TYPE_UNMATCH;
-				fcn->diff->dist = fcn2->diff->dist = t;
-				R_FREE (fcn->fingerprint);
-				R_FREE (fcn2->fingerprint);
-				fcn->diff->addr = fcn2->addr;
-				fcn2->diff->addr = fcn->addr;
-				fcn->diff->size = r_anal_fcn_size (fcn2);
-				fcn2->diff->size = r_anal_fcn_size (fcn);
-				R_FREE (fcn->diff->name);
-				if (fcn2->name) {
-					fcn->diff->name = strdup (fcn2->name);
-				}
-				R_FREE (fcn2->diff->name);
-				if (fcn->name) {
-					fcn2->diff->name = strdup (fcn->name);
-				}
-				r_anal_diff_bb (anal, fcn, fcn2);
-				break;
+	int n = ctx.n[0] = fcns? r_list_length (fcns): 0;
+	int n2 = ctx.n[1] = fcns2? r_list_length (fcns2): 0;
+	int ntasks = R_MAX (1, R_MIN (r_th_ncpus (), n));
+	DiffTask *tasks = calloc (ntasks, sizeof (DiffTask));
+	ctx.anal = anal;
+	ctx.f[0] = calloc (n + 1, sizeof (RAnalFunction *));
+	ctx.f[1] = calloc (n2 + 1, sizeof (RAnalFunction *));
+	ctx.pair = calloc (n + 1, sizeof (int));
+	ctx.first = calloc (n + 1, sizeof (bool));
+	ctx.pt = calloc (n + 1, sizeof (double));
+	used = calloc (n2 + 1, sizeof (bool));
+	names = ht_pp_new0 ();
+	if (!tasks || !ctx.f[0] || !ctx.f[1] || !ctx.pair || !ctx.first || !ctx.pt || !used || !names) {
+		goto beach;
+	}
+	for (i = 0; i < ntasks; i++) {
+		tasks[i].ctx = &ctx;
+		tasks[i].w = i;
+		tasks[i].step = ntasks;
+	}
+	i = 0;
+	r_list_foreach (fcns, iter, fcn) {
+		ctx.f[0][i++] = fcn;
+	}
+	j = 0;
+	r_list_foreach (fcns2, iter, fcn2) {
+		if (fcn2->name) {
+			ht_pp_insert (names, fcn2->name, (void *)(size_t)(j + 1));
+		} else if (null2 < 0) {
+			null2 = j;
+		}
+		ctx.f[1][j++] = fcn2;
+	}
+	/* Compare functions with the same name, anonymous ones match anything */
+	for (i = 0; i < n; i++) {
+		fcn = ctx.f[0][i];
+		j = n2? 0: -1;
+		if (fcn->name) {
+			bool found = false;
+			j = (int)(size_t)ht_pp_find (names, fcn->name, &found) - 1;
+			if (!found || (null2 >= 0 && null2 < j)) {
+				j = null2;
 			}
 		}
+		ctx.pair[i] = j;
+		// the fingerprint is freed once matched, so only the first is known
+		if (j >= 0 && !used[j]) {
+			used[j] = ctx.first[i] = true;
+		}
+	}
+	diff_run (&ctx, tasks, ntasks, DIFF_PASS_NAME);
+	for (i = 0; i < n; i++) {
+		j = ctx.pair[i];
+		if (j >= 0) {
+			fcn = ctx.f[0][i];
+			fcn2 = ctx.f[1][j];
+			diff_pair (anal, fcn, fcn2, ctx.first[i]? ctx.pt[i]: diff_dist (fcn, fcn2));
+		}
 	}
 	/* Compare remaining functions */
-	r_list_foreach (fcns, iter, fcn) {
-/*
-		if ((fcn->type != R_ANAL_FCN_TYPE_FCN &&
-			fcn->type != R_ANAL_FCN_TYPE_SYM) ||
-			fcn->diff->type != R_ANAL_DIFF_TYPE_NULL) {
+	ctx.sig[0] = calloc ((size_t)(n + 1) * DIFF_HASHES, sizeof (ut32));
+	ctx.sig[1] = calloc ((size_t)(n2 + 1) * DIFF_HASHES, sizeof (ut32));
+	ctx.todo = calloc (n + 1, sizeof (bool));
+	ctx.exact = ht_up_new0 ();
+	ctx.exact_next = calloc (n2 + 1, sizeof (int));
+	ctx.bands = ht_up_new0 ();
+	ctx.band_next = calloc ((size_t)(n2 + 1) * DIFF_BANDS, sizeof (int));
+	ctx.cands = calloc ((size_t)(n + 1) * DIFF_CANDS, sizeof (DiffCand));
+	ctx.ncands = calloc (n + 1, sizeof (int));
+	if (!ctx.sig[0] || !ctx.sig[1] || !ctx.todo || !ctx.exact || !ctx.exact_next
+			|| !ctx.bands || !ctx.band_next || !ctx.cands || !ctx.ncands) {
+		goto beach;
+	}
+	for (i = 0; i < ntasks; i++) {
+		tasks[i].seen = calloc (n2 + 1, sizeof (int));
+		tasks[i].hits = calloc (n2 + 1, sizeof (int));
+		tasks[i].list = calloc (n2 + 1, sizeof (int));
+		if (!tasks[i].seen || !tasks[i].hits || !tasks[i].list) {
+			goto beach;
+		}
+	}
+	// fixed seeds keep the shortlists, and so the results, reproducible
+	ut64 seed = 0x9e3779b97f4a7c15ULL;
+	for (k = 0; k < DIFF_HASHES; k++) {
+		ctx.a[k] = (seed = seed * 6364136223846793005ULL + 1442695040888963407ULL) | 1;
+		ctx.b[k] = (seed = seed * 6364136223846793005ULL + 1442695040888963407ULL);
+	}
+	diff_run (&ctx, tasks, ntasks, DIFF_PASS_SIG);
+	// the buckets are chained in list order
+	for (j = n2 - 1; j >= 0; j--) {
+		fcn2 = ctx.f[1][j];
+		ut32 size2 = r_anal_fcn_size (fcn2);
+		if (!fcn2->fingerprint || !diff_eligible (anal, size2, fcn2)) {
 			continue;
 		}
-*/
+		ut64 key = diff_fp_hash (fcn2);
+		ctx.exact_next[j] = (int)(size_t)ht_up_find (ctx.exact, key, NULL) - 1;
+		ht_up_update (ctx.exact, key, (void *)(size_t)(j + 1));
+		for (b = 0; size2 && b < DIFF_BANDS; b++) {
+			key = diff_band_key (ctx.sig[1] + (size_t)j * DIFF_HASHES, b);
+			ctx.band_next[(size_t)j * DIFF_BANDS + b] = (int)(size_t)ht_up_find (ctx.bands, key, NULL) - 1;
+			ht_up_update (ctx.bands, key, (void *)(size_t)(j + 1));
+		}
+	}
+	for (i = 0; i < n; i++) {
+		ctx.ncands[i] = -1;
+		ctx.todo[i] = ctx.f[0][i]->diff->type == R_ANAL_DIFF_TYPE_NULL && diff_exact (&ctx, i) < 0;
+	}
+	diff_run (&ctx, tasks, ntasks, DIFF_PASS_CANDS);
+	// the same greedy matching in list order as comparing every pair
+	for (i = 0; i < n; i++) {
+		fcn = ctx.f[0][i];
 		if (fcn->diff->type != R_ANAL_DIFF_TYPE_NULL) {
 			continue;
 		}
-		ot = 0;
-		mfcn = mfcn2 = NULL;
-		r_list_foreach (fcns2, iter2, fcn2) {
-			int fcn_size = r_anal_fcn_size (fcn);
-			int fcn2_size = r_anal_fcn_size (fcn2);
-			if (fcn_size > fcn2_size) {
-				maxsize = fcn_size;
-				minsize = fcn2_size;
-			} else {
-				maxsize = fcn2_size;
-				minsize = fcn_size;
-			}
-			if (maxsize * anal->diff_thfcn > minsize) {
-				eprintf ("Exceeded anal threshold while diffing %s and %s\n", fcn->name, fcn2->name);
-				continue;
-			}
-			if (fcn2->diff->type != R_ANAL_DIFF_TYPE_NULL) {
-				eprintf ("Function %s already diffed\n", fcn2->name);
-				continue;
-			}
-			if ((fcn2->type != R_ANAL_FCN_TYPE_FCN && fcn2->type != R_ANAL_FCN_TYPE_SYM)) {
-				eprintf ("Function %s type not supported\n", fcn2->name);
-				continue;
+		double ot = 0;
+		int m = diff_exact (&ctx, i);
+		if (m >= 0) {
+			ot = 1;
+		} else {
+			if (ctx.ncands[i] < 0) {
+				diff_candidates (&tasks[0], i);
 			}
-			r_diff_buffers_distance (NULL, fcn->fingerprint, fcn_size, fcn2->fingerprint, fcn2_size, NULL, &t);
-			fcn->diff->dist = fcn2->diff->dist = t;
-			if (t > anal->diff_thfcn && t > ot) {
-				ot = t;
-				mfcn = fcn;
-				mfcn2 = fcn2;
-				if (t == 1) {
-					break;
+			DiffCand *cands = ctx.cands + (size_t)i * DIFF_CANDS;
+			for (k = 0; k < ctx.ncands[i]; k++) {
+				if (ctx.f[1][cands[k].idx]->diff->type != R_ANAL_DIFF_TYPE_NULL) {
+					continue;
+				}
+				if (cands[k].t > anal->diff_thfcn && cands[k].t > ot) {
+					ot = cands[k].t;
+					m = cands[k].idx;
+					if (ot == 1) {
+						break;
+					}
 				}
 			}
 		}
-		if (mfcn && mfcn2) {
-			/* Set flag in matched functions */
-			mfcn->diff->type = mfcn2->diff->type = (ot == 1)
-				? R_ANAL_DIFF_TYPE_MATCH
-				: R_ANAL_DIFF_TYPE_UNMATCH;
-			R_FREE (mfcn->fingerprint);
-			R_FREE (mfcn2->fingerprint);
-			mfcn->diff->addr = mfcn2->addr;
-			mfcn2->diff->addr = mfcn->addr;
-			mfcn->diff->size = r_anal_fcn_size (mfcn2);
-			mfcn2->diff->size = r_anal_fcn_size (mfcn);
-			R_FREE (mfcn->diff->name);
-			if (mfcn2->name) {
-				mfcn->diff->name = strdup (mfcn2->name);
-			}
-			R_FREE (mfcn2->diff->name);
-			if (mfcn->name) {
-				mfcn2->diff->name = strdup (mfcn->name);
-			}
-			r_anal_diff_bb (anal, mfcn, mfcn2);
+		if (m >= 0) {
+			diff_pair (anal, fcn, ctx.f[1][m], ot);
 		}
 	}
-	return true;
+	ret = true;
+beach:
+	ht_pp_free (names);
+	free (used);
+	diff_ctx_fini (&ctx, tasks, ntasks);
+	return ret;
 }
 
 R_API int r_anal_diff_eval(RAnal *anal) {
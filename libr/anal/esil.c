@@ -58,9 +58,147 @@ static bool ispackedreg(RAnalEsil *esil, const char *str) {
 	return ri? ri->packed_size > 0: false;
 }
 
-static bool isregornum(RAnalEsil *esil, const char *str, ut64 *num) {
-	if (!r_anal_esil_reg_read (esil, str, num, NULL)) {
-		if (!isnum (esil, str, num)) {
+/* stack items: numbers keep their value, so the operators only go through
+ * the string based helpers for registers and internal vars */
+#define ESIL_NUMSTR_SIZE 32
+#define ESIL_WORDS_MAX 1024
+
+static void esil_item_set(RAnalEsilItem *it, const char *str) {
+	int i;
+	it->str = str;
+	it->num = 0;
+	it->type = R_ANAL_ESIL_ITEM_REG;
+	// same rules as r_anal_esil_get_parm_type()
+	if (str[0] == ESIL_INTERNAL_PREFIX && str[1]) {
+		it->type = R_ANAL_ESIL_ITEM_STR;
+		return;
+	}
+	if (strncmp (str, "0x", 2)) {
+		if (!IS_DIGIT (str[0]) && str[0] != '-') {
+			return;
+		}
+		for (i = 1; str[i]; i++) {
+			if (!IS_DIGIT (str[i])) {
+				if (IS_DIGIT (str[0])) {
+					it->type = R_ANAL_ESIL_ITEM_STR;
+				}
+				return;
+			}
+		}
+	}
+	it->type = R_ANAL_ESIL_ITEM_NUM;
+	it->num = r_num_get (NULL, str);
+}
+
+static const char *esil_item_str(const RAnalEsilItem *it, char *buf) {
+	if (it->str || it->type != R_ANAL_ESIL_ITEM_NUM) {
+		return it->str;
+	}
+	snprintf (buf, ESIL_NUMSTR_SIZE, "0x%" PFMT64x, it->num);
+	return buf;
+}
+
+/* words pushed as strings are interned, so the items can point to them */
+static const char *esil_word_intern(RAnalEsil *esil, const char *str) {
+	HtPPKv *kv = ht_pp_find_kv (esil->words, str, NULL);
+	if (!kv) {
+		ht_pp_insert (esil->words, str, NULL);
+		kv = ht_pp_find_kv (esil->words, str, NULL);
+	}
+	return kv? kv->key: NULL;
+}
+
+static void esil_words_flush(RAnalEsil *esil) {
+	if (esil->words && !esil->words->count) {
+		return;
+	}
+	ht_pp_free (esil->words);
+	esil->words = ht_pp_new0 ();
+}
+
+static RAnalEsilItem esil_pop_item(RAnalEsil *esil) {
+	RAnalEsilItem it = {0};
+	if (esil && esil->stackptr > 0) {
+		it = esil->stack[--esil->stackptr];
+	}
+	return it;
+}
+
+static bool esil_push_item(RAnalEsil *esil, const RAnalEsilItem *it) {
+	if (!it->type || esil->stackptr > (esil->stacksize - 1)) {
+		return false;
+	}
+	esil->stack[esil->stackptr++] = *it;
+	return true;
+}
+
+static int esil_item_get_parm_size(RAnalEsil *esil, const RAnalEsilItem *it, ut64 *num, int *size) {
+	if (it->type == R_ANAL_ESIL_ITEM_NUM) {
+		*num = it->num;
+		if (size) {
+			*size = esil->anal->bits;
+		}
+		return true;
+	}
+	return r_anal_esil_get_parm_size (esil, it->str, num, size);
+}
+
+static int esil_item_get_parm(RAnalEsil *esil, const RAnalEsilItem *it, ut64 *num) {
+	return esil_item_get_parm_size (esil, it, num, NULL);
+}
+
+static int esil_item_get_parm_type(RAnalEsil *esil, const RAnalEsilItem *it) {
+	if (it->type == R_ANAL_ESIL_ITEM_NUM) {
+		return R_ANAL_ESIL_PARM_NUM;
+	}
+	return r_anal_esil_get_parm_type (esil, it->str);
+}
+
+static int esil_item_reg_read(RAnalEsil *esil, const RAnalEsilItem *it, ut64 *num, int *size) {
+	char buf[ESIL_NUMSTR_SIZE];
+	if (it->type == R_ANAL_ESIL_ITEM_NUM && !esil->cb.hook_reg_read) {
+		// numbers are not registers, only the hooks want to see them
+		if (num) {
+			*num = 0LL;
+		}
+		if (size) {
+			*size = esil->anal->bits;
+		}
+		return false;
+	}
+	return r_anal_esil_reg_read (esil, esil_item_str (it, buf), num, size);
+}
+
+static int esil_item_reg_read_nocallback(RAnalEsil *esil, const RAnalEsilItem *it, ut64 *num, int *size) {
+	int ret;
+	void *old_hook_reg_read = (void *) esil->cb.hook_reg_read;
+	esil->cb.hook_reg_read = NULL;
+	ret = esil_item_reg_read (esil, it, num, size);
+	esil->cb.hook_reg_read = old_hook_reg_read;
+	return ret;
+}
+
+static int esil_item_reg_write(RAnalEsil *esil, const RAnalEsilItem *it, ut64 num) {
+	char buf[ESIL_NUMSTR_SIZE];
+	if (it->type == R_ANAL_ESIL_ITEM_NUM && !esil->cb.hook_reg_write) {
+		return false;
+	}
+	return r_anal_esil_reg_write (esil, esil_item_str (it, buf), num);
+}
+
+static bool esil_item_isnum(RAnalEsil *esil, const RAnalEsilItem *it, ut64 *num) {
+	if (it->type == R_ANAL_ESIL_ITEM_NUM && (!it->str || IS_DIGIT (*it->str))) {
+		if (num) {
+			*num = it->num;
+		}
+		return true;
+	}
+	return isnum (esil, it->str, num);
+}
+
+static bool esil_item_regornum(RAnalEsil *esil, const RAnalEsilItem *it, ut64 *num) {
+	if (!esil_item_reg_read (esil, it, num, NULL)) {
+		if (!esil_item_isnum (esil, it, num)) {
 			return false;
 		}
 	}
@@ -69,15 +207,61 @@ static bool isregornum(RAnalEsil *esil, const char *str, ut64 *num) {
 
 /* pop Register or Number */
 static bool popRN(RAnalEsil *esil, ut64 *n) {
-	char *str = r_anal_esil_pop (esil);
-	if (str) {
-		bool ret = isregornum (esil, str, n);
-		free (str);
-		return ret;
+	RAnalEsilItem it = esil_pop_item (esil);
+	if (it.type) {
+		return esil_item_regornum (esil, &it, n);
 	}
 	return false;
 }
 
+/* compiled expressions, see r_anal_esil_parse() */
+#define ESIL_CODE_MAX 8192
+#define ESIL_WORD_MAX 62
+
+enum {
+	ESIL_WORD_PUSH = 0,
+	ESIL_WORD_OP,
+	ESIL_WORD_IF,
+	ESIL_WORD_ELSE,
+	ESIL_WORD_ENDIF,
+};
+
+typedef struct {
+	ut8 type;
+	int off; // offset of the word in the source string
+	const char *str;
+	RAnalEsilOp op;
+	RAnalEsilItem item; // pushed when there is no op
+} EsilCodeWord;
+
+typedef struct {
+	int refs;
+	int count;
+	int size;
+	char *text; // copy of the source string with the commas replaced by nul
+	EsilCodeWord words[];
+} EsilCode;
+
+static void esil_code_unref(EsilCode *code) {
+	if (code && --code->refs < 1) {
+		free (code->text);
+		free (code);
+	}
+}
+
+static void esil_code_kv_free(HtPPKv *kv) {
+	free (kv->key);
+	esil_code_unref (kv->value);
+}
+
+static void esil_code_flush(RAnalEsil *esil) {
+	if (esil->code && !esil->code->count) {
+		return;
+	}
+	ht_pp_free (esil->code);
+	esil->code = ht_pp_new (NULL, esil_code_kv_free, NULL);
+}
+
 /* R_ANAL_ESIL API */
 
 R_API RAnalEsil *r_anal_esil_new(int stacksize, int iotrap, unsigned int addrsize) {
@@ -89,7 +273,7 @@ R_API RAnalEsil *r_anal_esil_new(int stacksize, int iotrap, unsigned int addrsiz
 		free (esil);
 		return NULL;
 	}
-	if (!(esil->stack = calloc (sizeof (char *), stacksize))) {
+	if (!(esil->stack = calloc (sizeof (RAnalEsilItem), stacksize))) {
 		free (esil);
 		return NULL;
 	}
@@ -97,6 +281,8 @@ R_API RAnalEsil *r_anal_esil_new(int stacksize, int iotrap, unsigned int addrsiz
 	esil->stacksize = stacksize;
 	esil->parse_goto_count = R_ANAL_ESIL_GOTO_LIMIT;
 	esil->ops = sdb_new0 ();
+	esil->code = ht_pp_new (NULL, esil_code_kv_free, NULL);
+	esil->words = ht_pp_new0 ();
 	esil->iotrap = iotrap;
 	r_anal_esil_sources_init (esil);
 	r_anal_esil_interrupts_init (esil);
@@ -112,6 +298,7 @@ R_API int r_anal_esil_set_op(RAnalEsil *esil, const char *op, RAnalEsilOp code)
 	}
 	char *h = sdb_itoa (sdb_hash (op), t, 16);
 	sdb_num_set (esil->ops, h, (ut64)(size_t)code, 0);
+	esil_code_flush (esil);
 	if (!sdb_num_exists (esil->ops, h)) {
 		eprintf ("can't set esil-op %s\n", op);
 		return false;
@@ -161,14 +348,17 @@ R_API void r_anal_esil_free(RAnalEsil *esil) {
 	}
 	sdb_free (esil->ops);
 	esil->ops = NULL;
+	ht_pp_free (esil->code);
+	esil->code = NULL;
 	r_anal_esil_interrupts_fini (esil);
 	r_anal_esil_sources_fini (esil);
 	sdb_free (esil->stats);
 	esil->stats = NULL;
-	sdb_free (esil->db_trace);
-	esil->db_trace = NULL;
+	r_anal_esil_trace_free (esil->trace);
+	esil->trace = NULL;
 	r_anal_esil_stack_free (esil);
 	free (esil->stack);
+	ht_pp_free (esil->words);
 	if (esil->anal && esil->anal->cur && esil->anal->cur->esil_fini) {
 		esil->anal->cur->esil_fini (esil);
 	}
@@ -452,24 +642,32 @@ static bool esil_internal_overflow_check(RAnalEsil *esil) {
 }
 
 R_API int r_anal_esil_pushnum(RAnalEsil *esil, ut64 num) {
-	char str[64];
-	snprintf (str, sizeof (str) - 1, "0x%" PFMT64x, num);
-	return r_anal_esil_push (esil, str);
+	if (!esil || esil->stackptr > (esil->stacksize - 1)) {
+		return false;
+	}
+	RAnalEsilItem *it = &esil->stack[esil->stackptr++];
+	it->type = R_ANAL_ESIL_ITEM_NUM;
+	it->num = num;
+	it->str = NULL;
+	return true;
 }
 
 R_API bool r_anal_esil_push(RAnalEsil *esil, const char *str) {
 	if (!str || !esil || !*str || esil->stackptr > (esil->stacksize - 1)) {
 		return false;
 	}
-	esil->stack[esil->stackptr++] = strdup (str);
+	if (!(str = esil_word_intern (esil, str))) {
+		return false;
+	}
+	esil_item_set (&esil->stack[esil->stackptr++], str);
 	return true;
 }
 
 R_API char *r_anal_esil_pop(RAnalEsil *esil) {
-	if (!esil || esil->stackptr < 1) {
-		return NULL;
-	}
-	return esil->stack[--esil->stackptr];
+	char buf[ESIL_NUMSTR_SIZE];
+	RAnalEsilItem it = esil_pop_item (esil);
+	const char *str = esil_item_str (&it, buf);
+	return str? strdup (str): NULL;
 }
 
 R_API int r_anal_esil_get_parm_type(RAnalEsil *esil, const char *str) {
@@ -704,25 +902,24 @@ R_API int r_anal_esil_reg_read(RAnalEsil *esil, const char *regname, ut64 *num,
 static int esil_eq(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 num, num2;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (ispackedreg (esil, dst)) {
-		char *src2 = r_anal_esil_pop (esil);
-		char *newreg = r_str_newf ("%sl", dst);
-		if (r_anal_esil_get_parm (esil, src2, &num2)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (ispackedreg (esil, dst.str)) {
+		RAnalEsilItem src2 = esil_pop_item (esil);
+		char *newreg = r_str_newf ("%sl", dst.str);
+		if (esil_item_get_parm (esil, &src2, &num2)) {
 			ret = r_anal_esil_reg_write (esil, newreg, num2);
 		}
 		free (newreg);
-		free (src2);
 	}
 
-	if (src && dst && r_anal_esil_reg_read_nocallback (esil, dst, &num, NULL)) {
-		if (r_anal_esil_get_parm (esil, src, &num2)) {
-			ret = r_anal_esil_reg_write (esil, dst, num2);
-			if (ret && r_anal_esil_get_parm_type (esil, src) != R_ANAL_ESIL_PARM_INTERNAL) { //necessary for some flag-things
+	if (src.type && dst.type && esil_item_reg_read_nocallback (esil, &dst, &num, NULL)) {
+		if (esil_item_get_parm (esil, &src, &num2)) {
+			ret = esil_item_reg_write (esil, &dst, num2);
+			if (ret && esil_item_get_parm_type (esil, &src) != R_ANAL_ESIL_PARM_INTERNAL) { //necessary for some flag-things
 				esil->cur = num2;
 				esil->old = num;
-				esil->lastsz = esil_internal_sizeof_reg (esil, dst);
+				esil->lastsz = esil_internal_sizeof_reg (esil, dst.str);
 			}
 		} else {
 			ERR ("esil_eq: invalid src");
@@ -730,46 +927,42 @@ static int esil_eq(RAnalEsil *esil) {
 	} else {
 		ERR ("esil_eq: invalid parameters");
 	}
-	free (src);
-	free (dst);
 	return ret;
 }
 
 static int esil_neg(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 num;
-	char *src = r_anal_esil_pop (esil);
-	if (src) {
-		if (r_anal_esil_get_parm (esil, src, &num)) {
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (src.type) {
+		if (esil_item_get_parm (esil, &src, &num)) {
 			r_anal_esil_pushnum (esil, !num);
 			ret = 1;
 		} else {
-			if (isregornum (esil, src, &num)) {
+			if (esil_item_regornum (esil, &src, &num)) {
 				ret = 1;
 				r_anal_esil_pushnum (esil, !num);
 			} else {
-				eprintf ("0x%08"PFMT64x" esil_neg: unknown reg %s\n", esil->address, src);
+				eprintf ("0x%08"PFMT64x" esil_neg: unknown reg %s\n", esil->address, src.str);
 			}
 		}
 	} else {
 		ERR ("esil_neg: empty stack");
 	}
-	free (src);
 	return ret;
 }
 
 static int esil_negeq(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 num;
-	char *src = r_anal_esil_pop (esil);
-	if (src && r_anal_esil_reg_read (esil, src, &num, NULL)) {
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (src.type && esil_item_reg_read (esil, &src, &num, NULL)) {
 		num = !num;
-		r_anal_esil_reg_write (esil, src, num);
+		esil_item_reg_write (esil, &src, num);
 		ret = 1;
 	} else {
 		ERR ("esil_negeq: empty stack");
 	}
-	free (src);
 	//r_anal_esil_pushnum (esil, ret);
 	return ret;
 }
@@ -781,69 +974,63 @@ static int esil_nop(RAnalEsil *esil) {
 static int esil_andeq(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 num, num2;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (dst && r_anal_esil_reg_read (esil, dst, &num, NULL)) {
-		if (src && r_anal_esil_get_parm (esil, src, &num2)) {
-			if (r_anal_esil_get_parm_type (esil, src) != R_ANAL_ESIL_PARM_INTERNAL) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (dst.type && esil_item_reg_read (esil, &dst, &num, NULL)) {
+		if (src.type && esil_item_get_parm (esil, &src, &num2)) {
+			if (esil_item_get_parm_type (esil, &src) != R_ANAL_ESIL_PARM_INTERNAL) {
 				esil->old = num;
 				esil->cur = num & num2;
-				esil->lastsz = esil_internal_sizeof_reg (esil, dst);
+				esil->lastsz = esil_internal_sizeof_reg (esil, dst.str);
 			}
-			r_anal_esil_reg_write (esil, dst, num & num2);
+			esil_item_reg_write (esil, &dst, num & num2);
 			ret = 1;
 		} else {
 			ERR ("esil_andeq: empty stack");
 		}
 	}
-	free (src);
-	free (dst);
 	return ret;
 }
 
 static int esil_oreq(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 num, num2;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (dst && r_anal_esil_reg_read (esil, dst, &num, NULL)) {
-		if (src && r_anal_esil_get_parm (esil, src, &num2)) {
-			if (r_anal_esil_get_parm_type (esil, src) != R_ANAL_ESIL_PARM_INTERNAL) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (dst.type && esil_item_reg_read (esil, &dst, &num, NULL)) {
+		if (src.type && esil_item_get_parm (esil, &src, &num2)) {
+			if (esil_item_get_parm_type (esil, &src) != R_ANAL_ESIL_PARM_INTERNAL) {
 				esil->old = num;
 				esil->cur = num | num2;
-				esil->lastsz = esil_internal_sizeof_reg (esil, dst);
+				esil->lastsz = esil_internal_sizeof_reg (esil, dst.str);
 			}
-			r_anal_esil_reg_write (esil, dst, num | num2);
+			esil_item_reg_write (esil, &dst, num | num2);
 			ret = 1;
 		} else {
 			ERR ("esil_ordeq: empty stack");
 		}
 	}
-	free (src);
-	free (dst);
 	return ret;
 }
 
 static int esil_xoreq(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 num, num2;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (dst && r_anal_esil_reg_read (esil, dst, &num, NULL)) {
-		if (src && r_anal_esil_get_parm (esil, src, &num2)) {
-			if (r_anal_esil_get_parm_type (esil, src) != R_ANAL_ESIL_PARM_INTERNAL) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (dst.type && esil_item_reg_read (esil, &dst, &num, NULL)) {
+		if (src.type && esil_item_get_parm (esil, &src, &num2)) {
+			if (esil_item_get_parm_type (esil, &src) != R_ANAL_ESIL_PARM_INTERNAL) {
 				esil->old = num;
 				esil->cur = num ^ num2;
-				esil->lastsz = esil_internal_sizeof_reg (esil, dst);
+				esil->lastsz = esil_internal_sizeof_reg (esil, dst.str);
 			}
-			r_anal_esil_reg_write (esil, dst, num ^ num2);
+			esil_item_reg_write (esil, &dst, num ^ num2);
 			ret = 1;
 		} else {
 			ERR ("esil_xoreq: empty stack");
 		}
 	}
-	free (src);
-	free (dst);
 	return ret;
 }
 
@@ -938,25 +1125,23 @@ static int esil_interrupt(RAnalEsil *esil) {
 static int esil_cmp(RAnalEsil *esil) {
 	ut64 num, num2;
 	int ret = 0;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (dst && r_anal_esil_get_parm (esil, dst, &num)) {
-		if (src && r_anal_esil_get_parm (esil, src, &num2)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (dst.type && esil_item_get_parm (esil, &dst, &num)) {
+		if (src.type && esil_item_get_parm (esil, &src, &num2)) {
 			esil->old = num;
 			esil->cur = num - num2;
 			ret = 1;
-			if (r_reg_get (esil->anal->reg, dst, -1)) {
-				esil->lastsz = esil_internal_sizeof_reg (esil, dst);
-			} else if (r_reg_get (esil->anal->reg, src, -1)) {
-				esil->lastsz = esil_internal_sizeof_reg (esil, src);
+			if (r_reg_get (esil->anal->reg, dst.str, -1)) {
+				esil->lastsz = esil_internal_sizeof_reg (esil, dst.str);
+			} else if (r_reg_get (esil->anal->reg, src.str, -1)) {
+				esil->lastsz = esil_internal_sizeof_reg (esil, src.str);
 			} else {
 				// default size is set to 64 as internally operands are ut64
 				esil->lastsz = 64;
 			}
 		}
 	}
-	free (dst);
-	free (src);
 	return ret;
 }
 
@@ -1025,15 +1210,14 @@ static int esil_if(RAnalEsil *esil) {
 		esil->skip++;
 		return true;
 	}
-	char *src = r_anal_esil_pop (esil);
-	if (src) {
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (src.type) {
 		// TODO: check return value
-		(void)r_anal_esil_get_parm (esil, src, &num);
+		(void)esil_item_get_parm (esil, &src, &num);
 		// condition not matching, skipping until }
 		if (!num) {
 			esil->skip++;
 		}
-		free (src);
 		return true;
 	}
 	return false;
@@ -1042,10 +1226,10 @@ static int esil_if(RAnalEsil *esil) {
 static int esil_lsl(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 num, num2;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (dst && r_anal_esil_get_parm (esil, dst, &num)) {
-		if (src && r_anal_esil_get_parm (esil, src, &num2)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (dst.type && esil_item_get_parm (esil, &dst, &num)) {
+		if (src.type && esil_item_get_parm (esil, &src, &num2)) {
 			if (num2 > sizeof (ut64) * 8) {
 				ERR ("esil_lsl: shift is too big");
 			} else {
@@ -1060,18 +1244,16 @@ static int esil_lsl(RAnalEsil *esil) {
 			ERR ("esil_lsl: empty stack");
 		}
 	}
-	free (src);
-	free (dst);
 	return ret;
 }
 
 static int esil_lsleq(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 num, num2;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (dst && r_anal_esil_reg_read (esil, dst, &num, NULL)) {
-		if (src && r_anal_esil_get_parm (esil, src, &num2)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (dst.type && esil_item_reg_read (esil, &dst, &num, NULL)) {
+		if (src.type && esil_item_get_parm (esil, &src, &num2)) {
 			if (num2 > sizeof (ut64) * 8) {
 				ERR ("esil_lsleq: shift is too big");
 			} else {
@@ -1082,26 +1264,24 @@ static int esil_lsleq(RAnalEsil *esil) {
 					num <<= num2;
 				}
 				esil->cur = num;
-				esil->lastsz = esil_internal_sizeof_reg (esil, dst);
-				r_anal_esil_reg_write (esil, dst, num);
+				esil->lastsz = esil_internal_sizeof_reg (esil, dst.str);
+				esil_item_reg_write (esil, &dst, num);
 				ret = 1;
 			}
 		} else {
 			ERR ("esil_lsleq: empty stack");
 		}
 	}
-	free (src);
-	free (dst);
 	return ret;
 }
 
 static int esil_lsr(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 num, num2;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (dst && r_anal_esil_get_parm (esil, dst, &num)) {
-		if (src && r_anal_esil_get_parm (esil, src, &num2)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (dst.type && esil_item_get_parm (esil, &dst, &num)) {
+		if (src.type && esil_item_get_parm (esil, &src, &num2)) {
 			ut64 res = num >> R_MIN(num2, 63);
 			r_anal_esil_pushnum (esil, res);
 			ret = 1;
@@ -1109,18 +1289,16 @@ static int esil_lsr(RAnalEsil *esil) {
 			ERR ("esil_lsr: empty stack");
 		}
 	}
-	free (src);
-	free (dst);
 	return ret;
 }
 
 static int esil_lsreq(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 num, num2;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (dst && r_anal_esil_reg_read (esil, dst, &num, NULL)) {
-		if (src && r_anal_esil_get_parm (esil, src, &num2)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (dst.type && esil_item_reg_read (esil, &dst, &num, NULL)) {
+		if (src.type && esil_item_get_parm (esil, &src, &num2)) {
 			if (num2 > 63) {
 				eprintf ("Invalid shift at 0x%08"PFMT64x"\n", esil->address);
 				num2 = 63;
@@ -1128,25 +1306,23 @@ static int esil_lsreq(RAnalEsil *esil) {
 			esil->old = num;
 			num >>= num2;
 			esil->cur = num;
-			esil->lastsz = esil_internal_sizeof_reg (esil, dst);
-			r_anal_esil_reg_write (esil, dst, num);
+			esil->lastsz = esil_internal_sizeof_reg (esil, dst.str);
+			esil_item_reg_write (esil, &dst, num);
 			ret = 1;
 		} else {
 			ERR ("esil_lsreq: empty stack");
 		}
 	}
-	free (src);
-	free (dst);
 	return ret;
 }
 
 static int esil_asreq(RAnalEsil *esil) {
 	int regsize = 0, ret = 0;
 	ut64 op_num, param_num;
-	char *op = r_anal_esil_pop (esil);
-	char *param = r_anal_esil_pop (esil);
-	if (op && r_anal_esil_get_parm_size (esil, op, &op_num, &regsize)) {
-		if (param && r_anal_esil_get_parm (esil, param, &param_num)) {
+	RAnalEsilItem op = esil_pop_item (esil);
+	RAnalEsilItem param = esil_pop_item (esil);
+	if (op.type && esil_item_get_parm_size (esil, &op, &op_num, &regsize)) {
+		if (param.type && esil_item_get_parm (esil, &param, &param_num)) {
 			ut64 mask = (regsize - 1);
 			param_num &= mask;
 			bool isNegative;
@@ -1194,26 +1370,24 @@ static int esil_asreq(RAnalEsil *esil) {
 			}
 			ut64 res = op_num;
 			esil->cur = res;
-			esil->lastsz = esil_internal_sizeof_reg (esil, op);
-			r_anal_esil_reg_write (esil, op, res);
+			esil->lastsz = esil_internal_sizeof_reg (esil, op.str);
+			esil_item_reg_write (esil, &op, res);
 			// r_anal_esil_pushnum (esil, res);
 			ret = 1;
 		} else {
 			ERR ("esil_asr: empty stack");
 		}
 	}
-	free (param);
-	free (op);
 	return ret;
 }
 
 static int esil_asr(RAnalEsil *esil) {
 	int regsize = 0, ret = 0;
 	ut64 op_num = 0, param_num = 0;
-	char *op = r_anal_esil_pop (esil);
-	char *param = r_anal_esil_pop (esil);
-	if (op && r_anal_esil_get_parm_size (esil, op, &op_num, &regsize)) {
-		if (param && r_anal_esil_get_parm (esil, param, &param_num)) {
+	RAnalEsilItem op = esil_pop_item (esil);
+	RAnalEsilItem param = esil_pop_item (esil);
+	if (op.type && esil_item_get_parm_size (esil, &op, &op_num, &regsize)) {
+		if (param.type && esil_item_get_parm (esil, &param, &param_num)) {
 			if (param_num > regsize - 1) {
 				// capstone bug?
 				eprintf ("Invalid asr shift of %"PFMT64d" at 0x%"PFMT64x"\n", param_num, esil->address);
@@ -1246,18 +1420,16 @@ static int esil_asr(RAnalEsil *esil) {
 			ERR ("esil_asr: empty stack");
 		}
 	}
-	free (param);
-	free (op);
 	return ret;
 }
 
 static int esil_ror(RAnalEsil *esil) {
 	int regsize, ret = 0;
 	ut64 num, num2;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (dst && r_anal_esil_get_parm_size (esil, dst, &num, &regsize)) {
-		if (src && r_anal_esil_get_parm (esil, src, &num2)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (dst.type && esil_item_get_parm_size (esil, &dst, &num, &regsize)) {
+		if (src.type && esil_item_get_parm (esil, &src, &num2)) {
 			ut64 mask = (regsize - 1);
 			num2 &= mask;
 			ut64 res = (num >> num2) | (num << ((-(st64)num2) & mask));
@@ -1267,18 +1439,16 @@ static int esil_ror(RAnalEsil *esil) {
 			ERR ("esil_ror: empty stack");
 		}
 	}
-	free (src);
-	free (dst);
 	return ret;
 }
 
 static int esil_rol(RAnalEsil *esil) {
 	int regsize, ret = 0;
 	ut64 num, num2;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (dst && r_anal_esil_get_parm_size (esil, dst, &num, &regsize)) {
-		if (src && r_anal_esil_get_parm (esil, src, &num2)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (dst.type && esil_item_get_parm_size (esil, &dst, &num, &regsize)) {
+		if (src.type && esil_item_get_parm (esil, &src, &num2)) {
 			ut64 mask = (regsize - 1);
 			num2 &= mask;
 			ut64 res = (num << num2) | (num >> ((-(st64)num2) & mask));
@@ -1288,18 +1458,16 @@ static int esil_rol(RAnalEsil *esil) {
 			ERR ("esil_rol: empty stack");
 		}
 	}
-	free (src);
-	free (dst);
 	return ret;
 }
 
 static int esil_and(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 num, num2;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (dst && r_anal_esil_get_parm (esil, dst, &num)) {
-		if (src && r_anal_esil_get_parm (esil, src, &num2)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (dst.type && esil_item_get_parm (esil, &dst, &num)) {
+		if (src.type && esil_item_get_parm (esil, &src, &num2)) {
 			num &= num2;
 			r_anal_esil_pushnum (esil, num);
 			ret = 1;
@@ -1307,18 +1475,16 @@ static int esil_and(RAnalEsil *esil) {
 			ERR ("esil_and: empty stack");
 		}
 	}
-	free (src);
-	free (dst);
 	return ret;
 }
 
 static int esil_xor(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 num, num2;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (dst && r_anal_esil_get_parm (esil, dst, &num)) {
-		if (src && r_anal_esil_get_parm (esil, src, &num2)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (dst.type && esil_item_get_parm (esil, &dst, &num)) {
+		if (src.type && esil_item_get_parm (esil, &src, &num2)) {
 			num ^= num2;
 			r_anal_esil_pushnum (esil, num);
 			ret = 1;
@@ -1326,18 +1492,16 @@ static int esil_xor(RAnalEsil *esil) {
 			ERR ("esil_xor: empty stack");
 		}
 	}
-	free (src);
-	free (dst);
 	return ret;
 }
 
 static int esil_or(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 num, num2;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (dst && r_anal_esil_get_parm (esil, dst, &num)) {
-		if (src && r_anal_esil_get_parm (esil, src, &num2)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (dst.type && esil_item_get_parm (esil, &dst, &num)) {
+		if (src.type && esil_item_get_parm (esil, &src, &num2)) {
 			num |= num2;
 			r_anal_esil_pushnum (esil, num);
 			ret = 1;
@@ -1345,8 +1509,6 @@ static int esil_or(RAnalEsil *esil) {
 			ERR ("esil_xor: empty stack");
 		}
 	}
-	free (src);
-	free (dst);
 	return ret;
 }
 
@@ -1387,7 +1549,8 @@ R_API int r_anal_esil_dumpstack(RAnalEsil *esil) {
 		return 0;
 	}
 	for (i = esil->stackptr - 1; i >= 0; i--) {
-		esil->anal->cb_printf ("%s\n", esil->stack[i]);
+		char buf[ESIL_NUMSTR_SIZE];
+		esil->anal->cb_printf ("%s\n", esil_item_str (&esil->stack[i], buf));
 	}
 	return 1;
 }
@@ -1398,10 +1561,7 @@ static int esil_break(RAnalEsil *esil) {
 }
 
 static int esil_clear(RAnalEsil *esil) {
-	char *r;
-	while ((r = r_anal_esil_pop (esil))) {
-		free (r);
-	}
+	esil->stackptr = 0;
 	return 1;
 }
 
@@ -1412,42 +1572,38 @@ static int esil_todo(RAnalEsil *esil) {
 
 static int esil_goto(RAnalEsil *esil) {
 	ut64 num = 0;
-	char *src = r_anal_esil_pop (esil);
-	if (src && *src && r_anal_esil_get_parm (esil, src, &num)) {
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (src.type && esil_item_get_parm (esil, &src, &num)) {
 		esil->parse_goto = num;
 	}
-	free (src);
 	return 1;
 }
 
 static int esil_repeat(RAnalEsil *esil) {
-	char *dst = r_anal_esil_pop (esil); // destaintion of the goto
-	char *src = r_anal_esil_pop (esil); // value of the counter
+	RAnalEsilItem dst = esil_pop_item (esil); // destaintion of the goto
+	RAnalEsilItem src = esil_pop_item (esil); // value of the counter
 	ut64 n, num = 0;
-	if (r_anal_esil_get_parm (esil, src, &n) && r_anal_esil_get_parm (esil, dst, &num)) {
+	if (esil_item_get_parm (esil, &src, &n) && esil_item_get_parm (esil, &dst, &num)) {
 		if (n > 1) {
 			esil->parse_goto = num;
 			r_anal_esil_pushnum (esil, n - 1);
 		}
 	}
-	free (dst);
-	free (src);
 	return 1;
 }
 
 static int esil_pop(RAnalEsil *esil) {
-	char *dst = r_anal_esil_pop (esil);
-	free (dst);
+	(void)esil_pop_item (esil);
 	return 1;
 }
 
 static int esil_mod(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 s, d;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (src && r_anal_esil_get_parm (esil, src, &s)) {
-		if (dst && r_anal_esil_get_parm (esil, dst, &d)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (src.type && esil_item_get_parm (esil, &src, &s)) {
+		if (dst.type && esil_item_get_parm (esil, &dst, &d)) {
 			if (s == 0) {
 				if (esil->verbose > 0) {
 					eprintf ("0x%08"PFMT64x" esil_mod: Division by zero!\n", esil->address);
@@ -1462,25 +1618,23 @@ static int esil_mod(RAnalEsil *esil) {
 	} else {
 		ERR ("esil_mod: invalid parameters");
 	}
-	free (dst);
-	free (src);
 	return ret;
 }
 
 static int esil_modeq(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 s, d;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (src && r_anal_esil_get_parm (esil, src, &s)) {
-		if (dst && r_anal_esil_reg_read (esil, dst, &d, NULL)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (src.type && esil_item_get_parm (esil, &src, &s)) {
+		if (dst.type && esil_item_reg_read (esil, &dst, &d, NULL)) {
 			if (s) {
-				if (r_anal_esil_get_parm_type (esil, src) != R_ANAL_ESIL_PARM_INTERNAL) {
+				if (esil_item_get_parm_type (esil, &src) != R_ANAL_ESIL_PARM_INTERNAL) {
 					esil->old = d;
 					esil->cur = d % s;
-					esil->lastsz = esil_internal_sizeof_reg (esil, dst);
+					esil->lastsz = esil_internal_sizeof_reg (esil, dst.str);
 				}
-				r_anal_esil_reg_write (esil, dst, d % s);
+				esil_item_reg_write (esil, &dst, d % s);
 			} else {
 				ERR ("esil_modeq: Division by zero!");
 				esil->trap = R_ANAL_TRAP_DIVBYZERO;
@@ -1493,18 +1647,16 @@ static int esil_modeq(RAnalEsil *esil) {
 	} else {
 		ERR ("esil_modeq: invalid parameters");
 	}
-	free (src);
-	free (dst);
 	return ret;
 }
 
 static int esil_div(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 s, d;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (src && r_anal_esil_get_parm (esil, src, &s)) {
-		if (dst && r_anal_esil_get_parm (esil, dst, &d)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (src.type && esil_item_get_parm (esil, &src, &s)) {
+		if (dst.type && esil_item_get_parm (esil, &dst, &d)) {
 			if (s == 0) {
 				ERR ("esil_div: Division by zero!");
 				esil->trap = R_ANAL_TRAP_DIVBYZERO;
@@ -1517,25 +1669,23 @@ static int esil_div(RAnalEsil *esil) {
 	} else {
 		ERR ("esil_div: invalid parameters");
 	}
-	free (src);
-	free (dst);
 	return ret;
 }
 
 static int esil_diveq(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 s, d;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (src && r_anal_esil_get_parm (esil, src, &s)) {
-		if (dst && r_anal_esil_reg_read (esil, dst, &d, NULL)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (src.type && esil_item_get_parm (esil, &src, &s)) {
+		if (dst.type && esil_item_reg_read (esil, &dst, &d, NULL)) {
 			if (s) {
-				if (r_anal_esil_get_parm_type (esil, src) != R_ANAL_ESIL_PARM_INTERNAL) {
+				if (esil_item_get_parm_type (esil, &src) != R_ANAL_ESIL_PARM_INTERNAL) {
 					esil->old = d;
 					esil->cur = d / s;
-					esil->lastsz = esil_internal_sizeof_reg (esil, dst);
+					esil->lastsz = esil_internal_sizeof_reg (esil, dst.str);
 				}
-				r_anal_esil_reg_write (esil, dst, d / s);
+				esil_item_reg_write (esil, &dst, d / s);
 			} else {
 				// eprintf ("0x%08"PFMT64x" esil_diveq: Division by zero!\n", esil->address);
 				esil->trap = R_ANAL_TRAP_DIVBYZERO;
@@ -1548,18 +1698,16 @@ static int esil_diveq(RAnalEsil *esil) {
 	} else {
 		ERR ("esil_diveq: invalid parameters");
 	}
-	free (src);
-	free (dst);
 	return ret;
 }
 
 static int esil_mul(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 s, d;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (src && r_anal_esil_get_parm (esil, src, &s)) {
-		if (dst && r_anal_esil_get_parm (esil, dst, &d)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (src.type && esil_item_get_parm (esil, &src, &s)) {
+		if (dst.type && esil_item_get_parm (esil, &dst, &d)) {
 			r_anal_esil_pushnum (esil, d * s);
 			ret = 1;
 		} else {
@@ -1568,24 +1716,22 @@ static int esil_mul(RAnalEsil *esil) {
 	} else {
 		ERR ("esil_mul: invalid parameters");
 	}
-	free (src);
-	free (dst);
 	return ret;
 }
 
 static int esil_muleq(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 s, d;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (src && r_anal_esil_get_parm (esil, src, &s)) {
-		if (dst && r_anal_esil_reg_read (esil, dst, &d, NULL)) {
-			if (r_anal_esil_get_parm_type (esil, src) != R_ANAL_ESIL_PARM_INTERNAL) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (src.type && esil_item_get_parm (esil, &src, &s)) {
+		if (dst.type && esil_item_reg_read (esil, &dst, &d, NULL)) {
+			if (esil_item_get_parm_type (esil, &src) != R_ANAL_ESIL_PARM_INTERNAL) {
 				esil->old = d;
 				esil->cur = d * s;
-				esil->lastsz = esil_internal_sizeof_reg (esil, dst);
+				esil->lastsz = esil_internal_sizeof_reg (esil, dst.str);
 			}
-			r_anal_esil_reg_write (esil, dst, s * d);
+			esil_item_reg_write (esil, &dst, s * d);
 			ret = true;
 		} else {
 			ERR ("esil_muleq: empty stack");
@@ -1593,101 +1739,91 @@ static int esil_muleq(RAnalEsil *esil) {
 	} else {
 		ERR ("esil_muleq: invalid parameters");
 	}
-	free (dst);
-	free (src);
 	return ret;
 }
 
 static int esil_add(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 s, d;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (src && r_anal_esil_get_parm (esil, src, &s)) {
-		if (dst && r_anal_esil_get_parm (esil, dst, &d)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (src.type && esil_item_get_parm (esil, &src, &s)) {
+		if (dst.type && esil_item_get_parm (esil, &dst, &d)) {
 			r_anal_esil_pushnum (esil, s + d);
 			ret = true;
 		}
 	} else {
 		ERR ("esil_add: invalid parameters");
 	}
-	free (src);
-	free (dst);
 	return ret;
 }
 
 static int esil_addeq(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 s, d;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (src && r_anal_esil_get_parm (esil, src, &s)) {
-		if (dst && r_anal_esil_reg_read (esil, dst, &d, NULL)) {
-			if (r_anal_esil_get_parm_type (esil, src) != R_ANAL_ESIL_PARM_INTERNAL) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (src.type && esil_item_get_parm (esil, &src, &s)) {
+		if (dst.type && esil_item_reg_read (esil, &dst, &d, NULL)) {
+			if (esil_item_get_parm_type (esil, &src) != R_ANAL_ESIL_PARM_INTERNAL) {
 				esil->old = d;
 				esil->cur = d + s;
-				esil->lastsz = esil_internal_sizeof_reg (esil, dst);
+				esil->lastsz = esil_internal_sizeof_reg (esil, dst.str);
 			}
-			r_anal_esil_reg_write (esil, dst, s + d);
+			esil_item_reg_write (esil, &dst, s + d);
 			ret = true;
 		}
 	} else {
 		ERR ("esil_addeq: invalid parameters");
 	}
-	free (src);
-	free (dst);
 	return ret;
 }
 
 static int esil_inc(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 s;
-	char *src = r_anal_esil_pop (esil);
-	if (src && r_anal_esil_get_parm (esil, src, &s)) {
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (src.type && esil_item_get_parm (esil, &src, &s)) {
 		s++;
 		r_anal_esil_pushnum (esil, s);
 		ret = true;
 	} else {
 		ERR ("esil_inc: invalid parameters");
 	}
-	free (src);
 	return ret;
 }
 
 static int esil_inceq(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 sd;
-	char *src_dst = r_anal_esil_pop (esil);
-	if (src_dst && (r_anal_esil_get_parm_type (esil, src_dst) == R_ANAL_ESIL_PARM_REG) && r_anal_esil_get_parm (esil, src_dst, &sd)) {
+	RAnalEsilItem src_dst = esil_pop_item (esil);
+	if (src_dst.type && (esil_item_get_parm_type (esil, &src_dst) == R_ANAL_ESIL_PARM_REG) && esil_item_get_parm (esil, &src_dst, &sd)) {
 		// inc rax
 		esil->old = sd++;
 		esil->cur = sd;
-		r_anal_esil_reg_write (esil, src_dst, sd);
-		esil->lastsz = esil_internal_sizeof_reg (esil, src_dst);
+		esil_item_reg_write (esil, &src_dst, sd);
+		esil->lastsz = esil_internal_sizeof_reg (esil, src_dst.str);
 		ret = true;
 	} else {
 		ERR ("esil_inceq: invalid parameters");
 	}
-	free (src_dst);
 	return ret;
 }
 
 static int esil_sub(RAnalEsil *esil) {
 	ut64 s = 0, d = 0;
-	char * dst = r_anal_esil_pop (esil);
-	if (!dst) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	if (!dst.type) {
 		goto dst_broken;
 	}
-	if (r_anal_esil_reg_read (esil, dst, &d, NULL)) {
-		esil->lastsz = esil_internal_sizeof_reg (esil, dst);
+	if (esil_item_reg_read (esil, &dst, &d, NULL)) {
+		esil->lastsz = esil_internal_sizeof_reg (esil, dst.str);
 	} else {
-		if (!isnum (esil, dst, &d)) {
-			free (dst);
+		if (!esil_item_isnum (esil, &dst, &d)) {
 			goto dst_broken;
 		}
 		esil->lastsz = 64;
 	}
-	free (dst);
 
 	if (!popRN (esil, &s)) {
 		ERR ("esil_sub: src is broken");
@@ -1706,56 +1842,52 @@ dst_broken:
 static int esil_subeq(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 s, d;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (src && r_anal_esil_get_parm (esil, src, &s)) {
-		if (dst && r_anal_esil_reg_read (esil, dst, &d, NULL)) {
-			if (r_anal_esil_get_parm_type (esil, src) != R_ANAL_ESIL_PARM_INTERNAL) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (src.type && esil_item_get_parm (esil, &src, &s)) {
+		if (dst.type && esil_item_reg_read (esil, &dst, &d, NULL)) {
+			if (esil_item_get_parm_type (esil, &src) != R_ANAL_ESIL_PARM_INTERNAL) {
 				esil->old = d;
 				esil->cur = d - s;
-				esil->lastsz = esil_internal_sizeof_reg (esil, dst);
+				esil->lastsz = esil_internal_sizeof_reg (esil, dst.str);
 			}
-			r_anal_esil_reg_write (esil, dst, d - s);
+			esil_item_reg_write (esil, &dst, d - s);
 			ret = true;
 		}
 	} else {
 		ERR ("esil_subeq: invalid parameters");
 	}
-	free (src);
-	free (dst);
 	return ret;
 }
 
 static int esil_dec(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 s;
-	char *src = r_anal_esil_pop (esil);
-	if (src && r_anal_esil_get_parm (esil, src, &s)) {
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (src.type && esil_item_get_parm (esil, &src, &s)) {
 		s--;
 		r_anal_esil_pushnum (esil, s);
 		ret = true;
 	} else {
 		ERR ("esil_dec: invalid parameters");
 	}
-	free (src);
 	return ret;
 }
 
 static int esil_deceq(RAnalEsil *esil) {
 	int ret = 0;
 	ut64 sd;
-	char *src_dst = r_anal_esil_pop (esil);
-	if (src_dst && (r_anal_esil_get_parm_type (esil, src_dst) == R_ANAL_ESIL_PARM_REG) && r_anal_esil_get_parm (esil, src_dst, &sd)) {
+	RAnalEsilItem src_dst = esil_pop_item (esil);
+	if (src_dst.type && (esil_item_get_parm_type (esil, &src_dst) == R_ANAL_ESIL_PARM_REG) && esil_item_get_parm (esil, &src_dst, &sd)) {
 		esil->old = sd;
 		sd--;
 		esil->cur = sd;
-		r_anal_esil_reg_write (esil, src_dst, sd);
-		esil->lastsz = esil_internal_sizeof_reg (esil, src_dst);
+		esil_item_reg_write (esil, &src_dst, sd);
+		esil->lastsz = esil_internal_sizeof_reg (esil, src_dst.str);
 		ret = true;
 	} else {
 		ERR ("esil_deceq: invalid parameters");
 	}
-	free (src_dst);
 	return ret;
 }
 
@@ -1765,21 +1897,19 @@ static int esil_poke_n(RAnalEsil *esil, int bits) {
 	ut64 num, num2, addr;
 	ut8 b[8] = {0};
 	ut64 n;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
 	int bytes = R_MIN (sizeof (b), bits / 8), ret = 0;
 	if (bits % 8) {
-		free (src);
-		free (dst);
 		return 0;
 	}
 	//eprintf ("GONA POKE %d src:%s dst:%s\n", bits, src, dst);
-	char *src2 = NULL;
-	if (src && r_anal_esil_get_parm (esil, src, &num)) {
-		if (dst && r_anal_esil_get_parm (esil, dst, &addr)) {
+	RAnalEsilItem src2 = {0};
+	if (src.type && esil_item_get_parm (esil, &src, &num)) {
+		if (dst.type && esil_item_get_parm (esil, &dst, &addr)) {
 			if (bits == 128) {
-				src2 = r_anal_esil_pop (esil);
-				if (src2 && r_anal_esil_get_parm (esil, src2, &num2)) {
+				src2 = esil_pop_item (esil);
+				if (src2.type && esil_item_get_parm (esil, &src2, &num2)) {
 					r_write_ble (b, num, esil->anal->big_endian, 64);
 					ret = r_anal_esil_mem_write (esil, addr, b, bytes);
 					if (ret == 0) {
@@ -1791,7 +1921,7 @@ static int esil_poke_n(RAnalEsil *esil, int bits) {
 				ret = -1;
 				goto out;
 			}
-			int type = r_anal_esil_get_parm_type (esil, src);
+			int type = esil_item_get_parm_type (esil, &src);
 			if (type != R_ANAL_ESIL_PARM_INTERNAL) {
 				// this is a internal peek performed before a poke
 				// we disable hooks to avoid run hooks on internal peeks
@@ -1810,9 +1940,6 @@ static int esil_poke_n(RAnalEsil *esil, int bits) {
 		}
 	}
 out:
-	free (src2);
-	free (src);
-	free (dst);
 	return ret;
 }
 
@@ -1848,26 +1975,24 @@ static int esil_poke_some(RAnalEsil *esil) {
 	int i, ret = 0;
 	int regsize;
 	ut64 ptr, regs = 0, tmp;
-	char *count, *dst = r_anal_esil_pop (esil);
+	RAnalEsilItem count, dst = esil_pop_item (esil);
 #define BYTES_SIZE 64
-	if (dst && r_anal_esil_get_parm_size (esil, dst, &tmp, &regsize)) {
+	if (dst.type && esil_item_get_parm_size (esil, &dst, &tmp, &regsize)) {
 		// reg
-		isregornum (esil, dst, &ptr);
-		count = r_anal_esil_pop (esil);
-		if (count) {
-			isregornum (esil, count, &regs);
+		esil_item_regornum (esil, &dst, &ptr);
+		count = esil_pop_item (esil);
+		if (count.type) {
+			esil_item_regornum (esil, &count, &regs);
 			if (regs > 0) {
-				ut8 b[BYTES_SIZE];
-				ut64 num64;
+				ut8 b[BYTES_SIZE] = {0};
+				ut64 num64 = 0;
 				for (i = 0; i < regs; i++) {
-					char *foo = r_anal_esil_pop (esil);
-					if (!foo) {
+					RAnalEsilItem foo = esil_pop_item (esil);
+					if (!foo.type) {
 						// avoid looping out of stack
-						free (dst);
-						free (count);
 						return 1;
 					}
-					isregornum (esil, foo, &num64);
+					esil_item_regornum (esil, &foo, &num64);
 					/* TODO: implement peek here */
 					// read from $dst
 					r_write_ble (b, num64, esil->anal->big_endian, regsize);
@@ -1877,14 +2002,10 @@ static int esil_poke_some(RAnalEsil *esil) {
 						esil->trap = 1;
 					}
 					ptr += BYTES_SIZE;
-					free (foo);
 				}
 			}
-			free (dst);
-			free (count);
 			return 1;
 		}
-		free (dst);
 	}
 	return 0;
 }
@@ -1895,26 +2016,22 @@ static int esil_peek_n(RAnalEsil *esil, int bits) {
 	if (bits & 7) {
 		return 0;
 	}
-	char res[32];
 	ut64 addr;
 	int ret = 0, bytes = bits / 8;
-	char *dst = r_anal_esil_pop (esil);
-	if (!dst) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	if (!dst.type) {
 		eprintf ("ESIL-ERROR at 0x%08"PFMT64x": Cannot peek memory without specifying an address\n", esil->address);
 		return 0;
 	}
 	//eprintf ("GONA PEEK %d dst:%s\n", bits, dst);
-	if (dst && isregornum (esil, dst, &addr)) {
+	if (dst.type && esil_item_regornum (esil, &dst, &addr)) {
 		if (bits == 128) {
 			ut8 a[sizeof(ut64) * 2] = {0};
 			ret = r_anal_esil_mem_read (esil, addr, a, bytes);
 			ut64 b = r_read_ble64 (&a, 0); //esil->anal->big_endian);
 			ut64 c = r_read_ble64 (&a[8], 0); //esil->anal->big_endian);
-			snprintf (res, sizeof (res), "0x%" PFMT64x, b);
-			r_anal_esil_push (esil, res);
-			snprintf (res, sizeof (res), "0x%" PFMT64x, c);
-			r_anal_esil_push (esil, res);
-			free (dst);
+			r_anal_esil_pushnum (esil, b);
+			r_anal_esil_pushnum (esil, c);
 			return ret;
 		}
 		ut64 bitmask = genmask (bits - 1);
@@ -1924,11 +2041,9 @@ static int esil_peek_n(RAnalEsil *esil, int bits) {
 		if (esil->anal->big_endian) {
 			r_mem_swapendian ((ut8*)&b, (const ut8*)&b, bytes);
 		}
-		snprintf (res, sizeof (res), "0x%" PFMT64x, b & bitmask);
-		r_anal_esil_push (esil, res);
+		r_anal_esil_pushnum (esil, b & bitmask);
 		esil->lastsz = bits;
 	}
-	free (dst);
 	return ret;
 }
 
@@ -1965,40 +2080,36 @@ static int esil_peek_some(RAnalEsil *esil) {
 	int i, ret = 0;
 	ut64 ptr, regs;
 	// pop ptr
-	char *count, *dst = r_anal_esil_pop (esil);
-	if (dst) {
+	RAnalEsilItem count, dst = esil_pop_item (esil);
+	if (dst.type) {
 		// reg
-		isregornum (esil, dst, &ptr);
-		count = r_anal_esil_pop (esil);
-		if (count) {
-			isregornum (esil, count, &regs);
+		esil_item_regornum (esil, &dst, &ptr);
+		count = esil_pop_item (esil);
+		if (count.type) {
+			esil_item_regornum (esil, &count, &regs);
 			if (regs > 0) {
 				ut32 num32;
 				ut8 a[sizeof (ut32)];
 				for (i = 0; i < regs; i++) {
-					char *foo = r_anal_esil_pop (esil);
-					if (!foo) {
+					RAnalEsilItem foo = esil_pop_item (esil);
+					if (!foo.type) {
 						ERR ("Cannot pop in peek");
 						return 0;
 					}
 					ret = r_anal_esil_mem_read (esil, ptr, a, 4);
 					if (ret == sizeof (ut32)) {
 						num32 = r_read_ble32 (a, esil->anal->big_endian);
-						r_anal_esil_reg_write (esil, foo, num32);
+						esil_item_reg_write (esil, &foo, num32);
 					} else {
 						if (esil->verbose) {
 							eprintf ("Cannot peek from 0x%08" PFMT64x "\n", ptr);
 						}
 					}
 					ptr += sizeof (ut32);
-					free (foo);
 				}
 			}
-			free (dst);
-			free (count);
 			return 1;
 		}
-		free (dst);
 	}
 	return 0;
 }
@@ -2008,17 +2119,17 @@ static int esil_peek_some(RAnalEsil *esil) {
 static int esil_mem_oreq_n(RAnalEsil *esil, int bits) {
 	int ret = 0;
 	ut64 s, d;
-	char *dst = r_anal_esil_pop (esil);  //save the dst-addr
-	char *src0 = r_anal_esil_pop (esil); //get the src
-	char *src1 = NULL;
-	if (src0 && r_anal_esil_get_parm (esil, src0, &s)) { 	//get the src
-		r_anal_esil_push (esil, dst);			//push the dst-addr
+	RAnalEsilItem dst = esil_pop_item (esil);  //save the dst-addr
+	RAnalEsilItem src0 = esil_pop_item (esil); //get the src
+	RAnalEsilItem src1 = {0};
+	if (src0.type && esil_item_get_parm (esil, &src0, &s)) { 	//get the src
+		esil_push_item (esil, &dst);			//push the dst-addr
 		ret = (!!esil_peek_n (esil, bits));		//read
-		src1 = r_anal_esil_pop (esil);			//get the old dst-value
-		if (src1 && r_anal_esil_get_parm (esil, src1, &d)) { //get the old dst-value
+		src1 = esil_pop_item (esil);			//get the old dst-value
+		if (src1.type && esil_item_get_parm (esil, &src1, &d)) { //get the old dst-value
 			d |= s;					//calculate the new dst-value
 			r_anal_esil_pushnum (esil, d);		//push the new dst-value
-			r_anal_esil_push (esil, dst);		//push the dst-addr
+			esil_push_item (esil, &dst);		//push the dst-addr
 			ret &= (!!esil_poke_n (esil, bits));	//write
 		} else {
 			ret = 0;
@@ -2027,9 +2138,6 @@ static int esil_mem_oreq_n(RAnalEsil *esil, int bits) {
 	if (!ret) {
 		ERR ("esil_mem_oreq_n: invalid parameters");
 	}
-	free (dst);
-	free (src0);
-	free (src1);
 	return ret;
 }
 
@@ -2054,17 +2162,17 @@ static int esil_mem_oreq(RAnalEsil *esil) {
 static int esil_mem_xoreq_n(RAnalEsil *esil, int bits) {
 	int ret = 0;
 	ut64 s, d;
-	char *dst = r_anal_esil_pop (esil);
-	char *src0 = r_anal_esil_pop (esil);
-	char *src1 = NULL;
-	if (src0 && r_anal_esil_get_parm (esil, src0, &s)) {
-		r_anal_esil_push (esil, dst);
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src0 = esil_pop_item (esil);
+	RAnalEsilItem src1 = {0};
+	if (src0.type && esil_item_get_parm (esil, &src0, &s)) {
+		esil_push_item (esil, &dst);
 		ret = (!!esil_peek_n (esil, bits));
-		src1 = r_anal_esil_pop (esil);
-		if (src1 && r_anal_esil_get_parm (esil, src1, &d)) {
+		src1 = esil_pop_item (esil);
+		if (src1.type && esil_item_get_parm (esil, &src1, &d)) {
 			d ^= s;
 			r_anal_esil_pushnum (esil, d);
-			r_anal_esil_push (esil, dst);
+			esil_push_item (esil, &dst);
 			ret &= (!!esil_poke_n (esil, bits));
 		} else {
 			ret = 0;
@@ -2073,9 +2181,6 @@ static int esil_mem_xoreq_n(RAnalEsil *esil, int bits) {
 	if (!ret) {
 		ERR ("esil_mem_xoreq_n: invalid parameters");
 	}
-	free (dst);
-	free (src0);
-	free (src1);
 	return ret;
 }
 
@@ -2100,17 +2205,17 @@ static int esil_mem_xoreq(RAnalEsil *esil) {
 static int esil_mem_andeq_n(RAnalEsil *esil, int bits) {
 	int ret = 0;
 	ut64 s, d;
-	char *dst = r_anal_esil_pop (esil);
-	char *src0 = r_anal_esil_pop (esil);
-	char *src1 = NULL;
-	if (src0 && r_anal_esil_get_parm (esil, src0, &s)) {
-		r_anal_esil_push (esil, dst);
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src0 = esil_pop_item (esil);
+	RAnalEsilItem src1 = {0};
+	if (src0.type && esil_item_get_parm (esil, &src0, &s)) {
+		esil_push_item (esil, &dst);
 		ret = (!!esil_peek_n (esil, bits));
-		src1 = r_anal_esil_pop (esil);
-		if (src1 && r_anal_esil_get_parm (esil, src1, &d)) {
+		src1 = esil_pop_item (esil);
+		if (src1.type && esil_item_get_parm (esil, &src1, &d)) {
 			d &= s;
 			r_anal_esil_pushnum (esil, d);
-			r_anal_esil_push (esil, dst);
+			esil_push_item (esil, &dst);
 			ret &= (!!esil_poke_n (esil, bits));
 		} else {
 			ret = 0;
@@ -2119,9 +2224,6 @@ static int esil_mem_andeq_n(RAnalEsil *esil, int bits) {
 	if (!ret) {
 		ERR ("esil_mem_andeq_n: invalid parameters");
 	}
-	free (dst);
-	free (src0);
-	free (src1);
 	return ret;
 }
 
@@ -2146,17 +2248,17 @@ static int esil_mem_andeq(RAnalEsil *esil) {
 static int esil_mem_addeq_n(RAnalEsil *esil, int bits) {
 	int ret = 0;
 	ut64 s, d;
-	char *dst = r_anal_esil_pop (esil);
-	char *src0 = r_anal_esil_pop (esil);
-	char *src1 = NULL;
-	if (src0 && r_anal_esil_get_parm (esil, src0, &s)) {
-		r_anal_esil_push (esil, dst);
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src0 = esil_pop_item (esil);
+	RAnalEsilItem src1 = {0};
+	if (src0.type && esil_item_get_parm (esil, &src0, &s)) {
+		esil_push_item (esil, &dst);
 		ret = (!!esil_peek_n (esil, bits));
-		src1 = r_anal_esil_pop (esil);
-		if (src1 && r_anal_esil_get_parm (esil, src1, &d)) {
+		src1 = esil_pop_item (esil);
+		if (src1.type && esil_item_get_parm (esil, &src1, &d)) {
 			d += s;
 			r_anal_esil_pushnum (esil, d);
-			r_anal_esil_push (esil, dst);
+			esil_push_item (esil, &dst);
 			ret &= (!!esil_poke_n (esil, bits));
 		} else {
 			ret = 0;
@@ -2165,9 +2267,6 @@ static int esil_mem_addeq_n(RAnalEsil *esil, int bits) {
 	if (!ret) {
 		ERR ("esil_mem_addeq_n: invalid parameters");
 	}
-	free (dst);
-	free (src0);
-	free (src1);
 	return ret;
 }
 
@@ -2192,17 +2291,17 @@ static int esil_mem_addeq(RAnalEsil *esil) {
 static int esil_mem_subeq_n(RAnalEsil *esil, int bits) {
 	int ret = 0;
 	ut64 s, d;
-	char *dst = r_anal_esil_pop (esil);
-	char *src0 = r_anal_esil_pop (esil);
-	char *src1 = NULL;
-	if (src0 && r_anal_esil_get_parm (esil, src0, &s)) {
-		r_anal_esil_push (esil, dst);
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src0 = esil_pop_item (esil);
+	RAnalEsilItem src1 = {0};
+	if (src0.type && esil_item_get_parm (esil, &src0, &s)) {
+		esil_push_item (esil, &dst);
 		ret = (!!esil_peek_n (esil, bits));
-		src1 = r_anal_esil_pop (esil);
-		if (src1 && r_anal_esil_get_parm (esil, src1, &d)) {
+		src1 = esil_pop_item (esil);
+		if (src1.type && esil_item_get_parm (esil, &src1, &d)) {
 			d -= s;
 			r_anal_esil_pushnum (esil, d);
-			r_anal_esil_push (esil, dst);
+			esil_push_item (esil, &dst);
 			ret &= (!!esil_poke_n (esil, bits));
 		} else {
 			ret = 0;
@@ -2211,9 +2310,6 @@ static int esil_mem_subeq_n(RAnalEsil *esil, int bits) {
 	if (!ret) {
 		ERR ("esil_mem_subeq_n: invalid parameters");
 	}
-	free (dst);
-	free (src0);
-	free (src1);
 	return ret;
 }
 
@@ -2238,23 +2334,23 @@ static int esil_mem_subeq(RAnalEsil *esil) {
 static int esil_mem_modeq_n(RAnalEsil *esil, int bits) {
 	int ret = 0;
 	ut64 s, d;
-	char *dst = r_anal_esil_pop (esil);
-	char *src0 = r_anal_esil_pop (esil);
-	char *src1 = NULL;
-	if (src0 && r_anal_esil_get_parm (esil, src0, &s)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src0 = esil_pop_item (esil);
+	RAnalEsilItem src1 = {0};
+	if (src0.type && esil_item_get_parm (esil, &src0, &s)) {
 		if (s == 0) {
 			ERR ("esil_mem_modeq4: Division by zero!");
 			esil->trap = R_ANAL_TRAP_DIVBYZERO;
 			esil->trap_code = 0;
 		} else {
-			r_anal_esil_push (esil, dst);
+			esil_push_item (esil, &dst);
 			ret = (!!esil_peek_n (esil, bits));
-			src1 = r_anal_esil_pop (esil);
-			if (src1 && r_anal_esil_get_parm (esil, src1, &d) && s >= 1) {
+			src1 = esil_pop_item (esil);
+			if (src1.type && esil_item_get_parm (esil, &src1, &d) && s >= 1) {
 				r_anal_esil_pushnum (esil, d % s);
 				d = d % s;
 				r_anal_esil_pushnum (esil, d);
-				r_anal_esil_push (esil, dst);
+				esil_push_item (esil, &dst);
 				ret &= (!!esil_poke_n (esil, bits));
 			} else {
 				ret = 0;
@@ -2264,9 +2360,6 @@ static int esil_mem_modeq_n(RAnalEsil *esil, int bits) {
 	if (!ret) {
 		ERR ("esil_mem_modeq_n: invalid parameters");
 	}
-	free (dst);
-	free (src0);
-	free (src1);
 	return ret;
 }
 
@@ -2291,22 +2384,22 @@ static int esil_mem_modeq(RAnalEsil *esil) {
 static int esil_mem_diveq_n(RAnalEsil *esil, int bits) {
 	int ret = 0;
 	ut64 s, d;
-	char *dst = r_anal_esil_pop (esil);
-	char *src0 = r_anal_esil_pop (esil);
-	char *src1 = NULL;
-	if (src0 && r_anal_esil_get_parm (esil, src0, &s)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src0 = esil_pop_item (esil);
+	RAnalEsilItem src1 = {0};
+	if (src0.type && esil_item_get_parm (esil, &src0, &s)) {
 		if (s == 0) {
 			ERR ("esil_mem_diveq8: Division by zero!");
 			esil->trap = R_ANAL_TRAP_DIVBYZERO;
 			esil->trap_code = 0;
 		} else {
-			r_anal_esil_push (esil, dst);
+			esil_push_item (esil, &dst);
 			ret = (!!esil_peek_n (esil, bits));
-			src1 = r_anal_esil_pop (esil);
-			if (src1 && r_anal_esil_get_parm (esil, src1, &d)) {
+			src1 = esil_pop_item (esil);
+			if (src1.type && esil_item_get_parm (esil, &src1, &d)) {
 				d = d / s;
 				r_anal_esil_pushnum (esil, d);
-				r_anal_esil_push (esil, dst);
+				esil_push_item (esil, &dst);
 				ret &= (!!esil_poke_n (esil, bits));
 			} else {
 				ret = 0;
@@ -2316,9 +2409,6 @@ static int esil_mem_diveq_n(RAnalEsil *esil, int bits) {
 	if (!ret) {
 		ERR ("esil_mem_diveq_n: invalid parameters");
 	}
-	free (dst);
-	free (src0);
-	free (src1);
 	return ret;
 }
 
@@ -2343,17 +2433,17 @@ static int esil_mem_diveq(RAnalEsil *esil) {
 static int esil_mem_muleq_n(RAnalEsil *esil, int bits, ut64 bitmask) {
 	int ret = 0;
 	ut64 s, d;
-	char *dst = r_anal_esil_pop (esil);
-	char *src0 = r_anal_esil_pop (esil);
-	char *src1 = NULL;
-	if (src0 && r_anal_esil_get_parm (esil, src0, &s)) {
-		r_anal_esil_push (esil, dst);
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src0 = esil_pop_item (esil);
+	RAnalEsilItem src1 = {0};
+	if (src0.type && esil_item_get_parm (esil, &src0, &s)) {
+		esil_push_item (esil, &dst);
 		ret = (!!esil_peek_n (esil, bits));
-		src1 = r_anal_esil_pop (esil);
-		if (src1 && r_anal_esil_get_parm (esil, src1, &d)) {
+		src1 = esil_pop_item (esil);
+		if (src1.type && esil_item_get_parm (esil, &src1, &d)) {
 			d *= s;
 			r_anal_esil_pushnum (esil, d);
-			r_anal_esil_push (esil, dst);
+			esil_push_item (esil, &dst);
 			ret &= (!!esil_poke_n (esil, bits));
 		} else {
 			ret = 0;
@@ -2362,9 +2452,6 @@ static int esil_mem_muleq_n(RAnalEsil *esil, int bits, ut64 bitmask) {
 	if (!ret) {
 		ERR ("esil_mem_muleq_n: invalid parameters");
 	}
-	free (dst);
-	free (src0);
-	free (src1);
 	return ret;
 }
 
@@ -2396,16 +2483,16 @@ static int esil_mem_muleq(RAnalEsil *esil) {
 static int esil_mem_inceq_n(RAnalEsil *esil, int bits) {
 	int ret = 0;
 	ut64 s;
-	char *off = r_anal_esil_pop (esil);
-	char *src = NULL;
-	if (off) {
-		r_anal_esil_push (esil, off);
+	RAnalEsilItem off = esil_pop_item (esil);
+	RAnalEsilItem src = {0};
+	if (off.type) {
+		esil_push_item (esil, &off);
 		ret = (!!esil_peek_n (esil, bits));
-		src = r_anal_esil_pop (esil);
-		if (src && r_anal_esil_get_parm (esil, src, &s)) {
+		src = esil_pop_item (esil);
+		if (src.type && esil_item_get_parm (esil, &src, &s)) {
 			s++;
 			r_anal_esil_pushnum (esil, s);
-			r_anal_esil_push (esil, off);
+			esil_push_item (esil, &off);
 			ret &= (!!esil_poke_n (esil, bits));
 		} else {
 			ret = 0;
@@ -2414,8 +2501,6 @@ static int esil_mem_inceq_n(RAnalEsil *esil, int bits) {
 	if (!ret) {
 		ERR ("esil_mem_inceq_n: invalid parameters");
 	}
-	free (src);
-	free (off);
 	return ret;
 }
 
@@ -2440,16 +2525,16 @@ static int esil_mem_inceq(RAnalEsil *esil) {
 static int esil_mem_deceq_n(RAnalEsil *esil, int bits) {
 	int ret = 0;
 	ut64 s;
-	char *off = r_anal_esil_pop (esil);
-	char *src = NULL;
-	if (off) {
-		r_anal_esil_push (esil, off);
+	RAnalEsilItem off = esil_pop_item (esil);
+	RAnalEsilItem src = {0};
+	if (off.type) {
+		esil_push_item (esil, &off);
 		ret = (!!esil_peek_n (esil, bits));
-		src = r_anal_esil_pop (esil);
-		if (src && r_anal_esil_get_parm (esil, src, &s)) {
+		src = esil_pop_item (esil);
+		if (src.type && esil_item_get_parm (esil, &src, &s)) {
 			s--;
 			r_anal_esil_pushnum (esil, s);
-			r_anal_esil_push (esil, off);
+			esil_push_item (esil, &off);
 			ret &= (!!esil_poke_n (esil, bits));
 		} else {
 			ret = 0;
@@ -2458,8 +2543,6 @@ static int esil_mem_deceq_n(RAnalEsil *esil, int bits) {
 	if (!ret) {
 		ERR ("esil_mem_deceq_n: invalid parameters");
 	}
-	free (src);
-	free (off);
 	return ret;
 }
 
@@ -2484,24 +2567,24 @@ static int esil_mem_deceq(RAnalEsil *esil) {
 static int esil_mem_lsleq_n(RAnalEsil *esil, int bits) {
 	int ret = 0;
 	ut64 s, d;
-	char *dst = r_anal_esil_pop (esil);
-	char *src0 = r_anal_esil_pop (esil);
-	char *src1 = NULL;
-	if (src0 && r_anal_esil_get_parm (esil, src0, &s)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src0 = esil_pop_item (esil);
+	RAnalEsilItem src1 = {0};
+	if (src0.type && esil_item_get_parm (esil, &src0, &s)) {
 		if (s > sizeof (ut64) * 8) {
 			ERR ("esil_mem_lsleq_n: shift is too big");
 		} else {
-			r_anal_esil_push (esil, dst);
+			esil_push_item (esil, &dst);
 			ret = (!!esil_peek_n (esil, bits));
-			src1 = r_anal_esil_pop (esil);
-			if (src1 && r_anal_esil_get_parm (esil, src1, &d)) {
+			src1 = esil_pop_item (esil);
+			if (src1.type && esil_item_get_parm (esil, &src1, &d)) {
 				if (s > 63) {
 					d = 0;
 				} else {
 					d <<= s;
 				}
 				r_anal_esil_pushnum (esil, d);
-				r_anal_esil_push (esil, dst);
+				esil_push_item (esil, &dst);
 				ret &= (!!esil_poke_n (esil, bits));
 			} else {
 				ret = 0;
@@ -2511,9 +2594,6 @@ static int esil_mem_lsleq_n(RAnalEsil *esil, int bits) {
 	if (!ret) {
 		ERR ("esil_mem_lsleq_n: invalid parameters");
 	}
-	free (dst);
-	free (src0);
-	free (src1);
 	return ret;
 }
 
@@ -2538,17 +2618,17 @@ static int esil_mem_lsleq(RAnalEsil *esil) {
 static int esil_mem_lsreq_n(RAnalEsil *esil, int bits) {
 	int ret = 0;
 	ut64 s, d;
-	char *dst = r_anal_esil_pop (esil);
-	char *src0 = r_anal_esil_pop (esil);
-	char *src1 = NULL;
-	if (src0 && r_anal_esil_get_parm (esil, src0, &s)) {
-		r_anal_esil_push (esil, dst);
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src0 = esil_pop_item (esil);
+	RAnalEsilItem src1 = {0};
+	if (src0.type && esil_item_get_parm (esil, &src0, &s)) {
+		esil_push_item (esil, &dst);
 		ret = (!!esil_peek_n (esil, bits));
-		src1 = r_anal_esil_pop (esil);
-		if (src1 && r_anal_esil_get_parm (esil, src1, &d)) {
+		src1 = esil_pop_item (esil);
+		if (src1.type && esil_item_get_parm (esil, &src1, &d)) {
 			d >>= s;
 			r_anal_esil_pushnum (esil, d);
-			r_anal_esil_push (esil, dst);
+			esil_push_item (esil, &dst);
 			ret &= (!!esil_poke_n (esil, bits));
 		} else {
 			ret = 0;
@@ -2557,9 +2637,6 @@ static int esil_mem_lsreq_n(RAnalEsil *esil, int bits) {
 	if (!ret) {
 		ERR ("esil_mem_lsreq_n: invalid parameters");
 	}
-	free (dst);
-	free (src0);
-	free (src1);
 	return ret;
 }
 
@@ -2581,19 +2658,18 @@ static int esil_mem_lsreq(RAnalEsil *esil) {
 
 /* get value of register or memory reference and push the value */
 static int esil_num(RAnalEsil *esil) {
-	char *dup_me;
+	RAnalEsilItem dup_me;
 	ut64 dup;
 	if (!esil) {
 		return false;
 	}
-	if (!(dup_me = r_anal_esil_pop (esil))) {
+	dup_me = esil_pop_item (esil);
+	if (!dup_me.type) {
 		return false;
 	}
-	if (!r_anal_esil_get_parm (esil, dup_me, &dup)) {
-		free (dup_me);
+	if (!esil_item_get_parm (esil, &dup_me, &dup)) {
 		return false;
 	}
-	free (dup_me);
 	return r_anal_esil_pushnum (esil, dup);
 }
 
@@ -2602,17 +2678,14 @@ static int esil_dup(RAnalEsil *esil) {
 	if (!esil || !esil->stack || esil->stackptr < 1 || esil->stackptr > (esil->stacksize - 1)) {
 		return false;
 	}
-	return r_anal_esil_push (esil, esil->stack[esil->stackptr-1]);
+	return esil_push_item (esil, &esil->stack[esil->stackptr-1]);
 }
 
 static int esil_swap(RAnalEsil *esil) {
-	char *tmp;
+	RAnalEsilItem tmp;
 	if (!esil || !esil->stack || esil->stackptr < 2) {
 		return false;
 	}
-	if (!esil->stack[esil->stackptr-1] || !esil->stack[esil->stackptr-2]) {
-		return false;
-	}
 	tmp = esil->stack[esil->stackptr-1];
 	esil->stack[esil->stackptr-1] = esil->stack[esil->stackptr-2];
 	esil->stack[esil->stackptr-2] = tmp;
@@ -2620,10 +2693,10 @@ static int esil_swap(RAnalEsil *esil) {
 }
 
 static int __esil_generic_pick(RAnalEsil *esil, int rev) {
-	char *idx = r_anal_esil_pop (esil);
+	RAnalEsilItem idx = esil_pop_item (esil);
 	ut64 i;
 	int ret = false;
-	if (!idx || !r_anal_esil_get_parm (esil, idx, &i)) {
+	if (!idx.type || !esil_item_get_parm (esil, &idx, &i)) {
 		ERR ("esil_pick: invalid index number");
 		goto end;
 	}
@@ -2638,11 +2711,11 @@ static int __esil_generic_pick(RAnalEsil *esil, int rev) {
 		ERR ("esil_pick: index out of stack bounds");
 		goto end;
 	}
-	if (!esil->stack[esil->stackptr-i]) {
+	if (!esil->stack[esil->stackptr-i].type) {
 		ERR ("esil_pick: undefined element");
 		goto end;
 	}
-	if (!r_anal_esil_push (esil, esil->stack[esil->stackptr-i])) {
+	if (!esil_push_item (esil, &esil->stack[esil->stackptr-i])) {
 		ERR ("ESIL stack is full");
 		esil->trap = 1;
 		esil->trap_code = 1;
@@ -2650,7 +2723,6 @@ static int __esil_generic_pick(RAnalEsil *esil, int rev) {
 	}
 	ret = true;
 end:
-	free (idx);
 	return ret;
 }
 
@@ -2690,17 +2762,17 @@ static int signed_compare_gt(ut64 a, ut64 b, ut64 size) {
 static int esil_smaller(RAnalEsil *esil) { // 'dst < src' => 'src,dst,<'
 	ut64 num, num2;
 	int ret = 0;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (dst && r_anal_esil_get_parm (esil, dst, &num)) {
-		if (src && r_anal_esil_get_parm (esil, src, &num2)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (dst.type && esil_item_get_parm (esil, &dst, &num)) {
+		if (src.type && esil_item_get_parm (esil, &src, &num2)) {
 			esil->old = num;
 			esil->cur = num - num2;
 			ret = 1;
-			if (r_reg_get (esil->anal->reg, dst, -1)) {
-				esil->lastsz = esil_internal_sizeof_reg (esil, dst);
-			} else if (r_reg_get (esil->anal->reg, src, -1)) {
-				esil->lastsz = esil_internal_sizeof_reg (esil, src);
+			if (r_reg_get (esil->anal->reg, dst.str, -1)) {
+				esil->lastsz = esil_internal_sizeof_reg (esil, dst.str);
+			} else if (r_reg_get (esil->anal->reg, src.str, -1)) {
+				esil->lastsz = esil_internal_sizeof_reg (esil, src.str);
 			} else {
 				// default size is set to 64 as internally operands are ut64
 				esil->lastsz = 64;
@@ -2709,25 +2781,23 @@ static int esil_smaller(RAnalEsil *esil) { // 'dst < src' => 'src,dst,<'
 			                           !signed_compare_gt (num, num2, esil->lastsz));
 		}
 	}
-	free (dst);
-	free (src);
 	return ret;
 }
 
 static int esil_bigger(RAnalEsil *esil) { // 'dst > src' => 'src,dst,>'
 	ut64 num, num2;
 	int ret = 0;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (dst && r_anal_esil_get_parm (esil, dst, &num)) {
-		if (src && r_anal_esil_get_parm (esil, src, &num2)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (dst.type && esil_item_get_parm (esil, &dst, &num)) {
+		if (src.type && esil_item_get_parm (esil, &src, &num2)) {
 			esil->old = num;
 			esil->cur = num - num2;
 			ret = 1;
-			if (r_reg_get (esil->anal->reg, dst, -1)) {
-				esil->lastsz = esil_internal_sizeof_reg (esil, dst);
-			} else if (r_reg_get (esil->anal->reg, src, -1)) {
-				esil->lastsz = esil_internal_sizeof_reg (esil, src);
+			if (r_reg_get (esil->anal->reg, dst.str, -1)) {
+				esil->lastsz = esil_internal_sizeof_reg (esil, dst.str);
+			} else if (r_reg_get (esil->anal->reg, src.str, -1)) {
+				esil->lastsz = esil_internal_sizeof_reg (esil, src.str);
 			} else {
 				// default size is set to 64 as internally operands are ut64
 				esil->lastsz = 64;
@@ -2735,25 +2805,23 @@ static int esil_bigger(RAnalEsil *esil) { // 'dst > src' => 'src,dst,>'
 			r_anal_esil_pushnum (esil, signed_compare_gt (num, num2, esil->lastsz));
 		}
 	}
-	free (dst);
-	free (src);
 	return ret;
 }
 
 static int esil_smaller_equal(RAnalEsil *esil) { // 'dst <= src' => 'src,dst,<='
 	ut64 num, num2;
 	int ret = 0;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (dst && r_anal_esil_get_parm (esil, dst, &num)) {
-		if (src && r_anal_esil_get_parm (esil, src, &num2)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (dst.type && esil_item_get_parm (esil, &dst, &num)) {
+		if (src.type && esil_item_get_parm (esil, &src, &num2)) {
 			esil->old = num;
 			esil->cur = num - num2;
 			ret = 1;
-			if (r_reg_get (esil->anal->reg, dst, -1)) {
-				esil->lastsz = esil_internal_sizeof_reg (esil, dst);
-			} else if (r_reg_get (esil->anal->reg, src, -1)) {
-				esil->lastsz = esil_internal_sizeof_reg (esil, src);
+			if (r_reg_get (esil->anal->reg, dst.str, -1)) {
+				esil->lastsz = esil_internal_sizeof_reg (esil, dst.str);
+			} else if (r_reg_get (esil->anal->reg, src.str, -1)) {
+				esil->lastsz = esil_internal_sizeof_reg (esil, src.str);
 			} else {
 				// default size is set to 64 as internally operands are ut64
 				esil->lastsz = 64;
@@ -2761,25 +2829,23 @@ static int esil_smaller_equal(RAnalEsil *esil) { // 'dst <= src' => 'src,dst,<='
 			r_anal_esil_pushnum (esil, !signed_compare_gt (num, num2, esil->lastsz));
 		}
 	}
-	free (dst);
-	free (src);
 	return ret;
 }
 
 static int esil_bigger_equal(RAnalEsil *esil) { // 'dst >= src' => 'src,dst,>='
 	ut64 num, num2;
 	int ret = 0;
-	char *dst = r_anal_esil_pop (esil);
-	char *src = r_anal_esil_pop (esil);
-	if (dst && r_anal_esil_get_parm (esil, dst, &num)) {
-		if (src && r_anal_esil_get_parm (esil, src, &num2)) {
+	RAnalEsilItem dst = esil_pop_item (esil);
+	RAnalEsilItem src = esil_pop_item (esil);
+	if (dst.type && esil_item_get_parm (esil, &dst, &num)) {
+		if (src.type && esil_item_get_parm (esil, &src, &num2)) {
 			esil->old = num;
 			esil->cur = num - num2;
 			ret = 1;
-			if (r_reg_get (esil->anal->reg, dst, -1)) {
-				esil->lastsz = esil_internal_sizeof_reg (esil, dst);
-			} else if (r_reg_get (esil->anal->reg, src, -1)) {
-				esil->lastsz = esil_internal_sizeof_reg (esil, src);
+			if (r_reg_get (esil->anal->reg, dst.str, -1)) {
+				esil->lastsz = esil_internal_sizeof_reg (esil, dst.str);
+			} else if (r_reg_get (esil->anal->reg, src.str, -1)) {
+				esil->lastsz = esil_internal_sizeof_reg (esil, src.str);
 			} else {
 				// default size is set to 64 as internally operands are ut64
 				esil->lastsz = 64;
@@ -2788,8 +2854,6 @@ static int esil_bigger_equal(RAnalEsil *esil) { // 'dst >= src' => 'src,dst,>='
 			                           signed_compare_gt (num, num2, esil->lastsz));
 		}
 	}
-	free (dst);
-	free (src);
 	return ret;
 }
 
@@ -2937,21 +3001,183 @@ static int evalWord(RAnalEsil *esil, const char *ostr, const char **str) {
 	return 3;
 }
 
-R_API int r_anal_esil_parse(RAnalEsil *esil, const char *str) {
+/* compiled expressions: the words of an esil string are split and its
+ * operations are resolved once, then cached in esil->code by string. Strings
+ * using ';', '#!' or empty words keep going through the interpreter below. */
+static EsilCode *esil_code_compile(RAnalEsil *esil, const char *str) {
+	int i, count = 1;
+	if (*str == ',' || strchr (str, ';') || strstr (str, ",,") || strstr (str, "#!")) {
+		return NULL;
+	}
+	for (i = 0; str[i]; i++) {
+		if (str[i] == ',') {
+			count++;
+		}
+	}
+	if (!i || str[i - 1] == ',') {
+		return NULL;
+	}
+	EsilCode *code = calloc (1, sizeof (EsilCode) + count * sizeof (EsilCodeWord));
+	if (!code) {
+		return NULL;
+	}
+	code->refs = 1;
+	code->count = count;
+	code->size = i;
+	if (!(code->text = strdup (str))) {
+		free (code);
+		return NULL;
+	}
+	char *word = code->text;
+	for (i = 0; i < count; i++) {
+		EsilCodeWord *w = &code->words[i];
+		char *next = strchr (word, ',');
+		if (next) {
+			*next = 0;
+		}
+		if (strlen (word) > ESIL_WORD_MAX) {
+			esil_code_unref (code);
+			return NULL;
+		}
+		w->str = word;
+		w->off = word - code->text;
+		if (!strcmp (word, "}{")) {
+			w->type = ESIL_WORD_ELSE;
+		} else if (!strcmp (word, "}")) {
+			w->type = ESIL_WORD_ENDIF;
+		} else {
+			if (!iscommand (esil, word, &w->op)) {
+				w->op = NULL;
+			}
+			if (!strcmp (word, "?{")) {
+				w->type = ESIL_WORD_IF;
+			} else {
+				w->type = w->op? ESIL_WORD_OP: ESIL_WORD_PUSH;
+			}
+			if (!w->op) {
+				esil_item_set (&w->item, word);
+			}
+		}
+		word = next + 1;
+	}
+	return code;
+}
+
+static EsilCode *esil_code_get(RAnalEsil *esil, const char *str) {
+	bool found = false;
+	EsilCode *code;
+	if (!esil->code) {
+		return NULL;
+	}
+	code = ht_pp_find (esil->code, str, &found);
+	if (found) {
+		return code;
+	}
+	if (esil->code->count >= ESIL_CODE_MAX) {
+		esil_code_flush (esil);
+	}
+	// uncompilable strings are cached too, to avoid trying again
+	code = esil_code_compile (esil, str);
+	ht_pp_insert (esil->code, str, code);
+	return code;
+}
+
+/* same as runword() for a compiled word */
+static int esil_code_runword(RAnalEsil *esil, EsilCodeWord *w) {
+	esil->parse_goto_count--;
+	if (esil->parse_goto_count < 1) {
+		ERR ("ESIL infinite loop detected\n");
+		esil->trap = 1;       // INTERNAL ERROR
+		esil->parse_stop = 1; // INTERNAL ERROR
+		return 0;
+	}
+	switch (w->type) {
+	case ESIL_WORD_ELSE:
+		if (esil->skip == 1) {
+			esil->skip = 0;
+		} else if (esil->skip == 0) {
+			esil->skip = 1;
+		}
+		return 1;
+	case ESIL_WORD_ENDIF:
+		if (esil->skip) {
+			esil->skip--;
+		}
+		return 1;
+	}
+	if (esil->skip && w->type != ESIL_WORD_IF) {
+		return 1;
+	}
+	if (w->op) {
+		if (esil->cb.hook_command) {
+			if (esil->cb.hook_command (esil, w->str)) {
+				return 1; // XXX cannot return != 1
+			}
+		}
+		return w->op (esil);
+	}
+	if (!esil_push_item (esil, &w->item)) {
+		ERR ("ESIL stack is full");
+		esil->trap = 1;
+		esil->trap_code = 1;
+	}
+	return 1;
+}
+
+static int esil_code_run(RAnalEsil *esil, EsilCode *code, const char *str) {
+	int pc;
+loop:
+	esil->repeat = 0;
+	esil->skip = 0;
+	esil->parse_goto = -1;
+	esil->parse_stop = 0;
+	esil->parse_goto_count = esil->anal? esil->anal->esil_goto_limit: R_ANAL_ESIL_GOTO_LIMIT;
+	for (pc = 0; pc < code->count; pc++) {
+		if (!esil_code_runword (esil, &code->words[pc])) {
+			return 0;
+		}
+		if (esil->repeat) {
+			goto loop;
+		}
+		if (esil->parse_goto != -1) {
+			if (esil->parse_goto < 0 || esil->parse_goto >= code->count) {
+				if (esil->verbose) {
+					eprintf ("Cannot find word %d\n", esil->parse_goto);
+				}
+				return 0;
+			}
+			pc = esil->parse_goto - 1;
+			esil->parse_goto = -1;
+			continue;
+		}
+		if (esil->parse_stop) {
+			if (esil->parse_stop == 2) {
+				eprintf ("ESIL TODO: %s\n", pc + 1 < code->count
+					? str + code->words[pc + 1].off: "");
+			}
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* words of the code left in the stack must survive the code */
+static void esil_code_leave(RAnalEsil *esil, EsilCode *code) {
+	int i;
+	for (i = 0; i < esil->stackptr; i++) {
+		RAnalEsilItem *it = &esil->stack[i];
+		if (it->str >= code->text && it->str < code->text + code->size) {
+			it->str = esil_word_intern (esil, it->str);
+		}
+	}
+}
+
+static int esil_interpret(RAnalEsil *esil, const char *str) {
 	int wordi = 0;
 	int dorunword;
 	char word[64];
 	const char *ostr = str;
-	if (!esil || !str || !*str) {
-		return 0;
-	}
 	const char *hashbang = strstr (str, "#!");
-	esil->trap = 0;
-	if (esil->cmd && esil->cmd_todo) {
-		if (!strncmp (str, "TODO", 4)) {
-			esil->cmd (esil, esil->cmd_todo, esil->address, 0);
-		}
-	}
 loop:
 	esil->repeat = 0;
 	esil->skip = 0;
@@ -3022,6 +3248,34 @@ repeat:
 	return 1;
 }
 
+R_API int r_anal_esil_parse(RAnalEsil *esil, const char *str) {
+	int ret;
+	if (!esil || !str || !*str) {
+		return 0;
+	}
+	esil->trap = 0;
+	if (esil->cmd && esil->cmd_todo) {
+		if (!strncmp (str, "TODO", 4)) {
+			esil->cmd (esil, esil->cmd_todo, esil->address, 0);
+		}
+	}
+	esil->parse_depth++;
+	EsilCode *code = (esil->Reil || esil->nocompile)? NULL: esil_code_get (esil, str);
+	if (code) {
+		// keep it alive, nested parses may flush the cache
+		code->refs++;
+		ret = esil_code_run (esil, code, str);
+		esil_code_leave (esil, code);
+		esil_code_unref (code);
+	} else {
+		ret = esil_interpret (esil, str);
+	}
+	if (!--esil->parse_depth && !esil->stackptr && esil->words->count > ESIL_WORDS_MAX) {
+		esil_words_flush (esil);
+	}
+	return ret;
+}
+
 R_API int r_anal_esil_runword(RAnalEsil *esil, const char *word) {
 	const char *str = NULL;
 	runword (esil, word);
@@ -3039,17 +3293,17 @@ R_API int r_anal_esil_runword(RAnalEsil *esil, const char *word) {
 //frees all elements from the stack, not the stack itself
 //rename to stack_empty() ?
 R_API void r_anal_esil_stack_free(RAnalEsil *esil) {
-	int i;
 	if (esil) {
-		for (i = 0; i < esil->stackptr; i++) {
-			R_FREE (esil->stack[i]);
-		}
 		esil->stackptr = 0;
+		if (!esil->parse_depth) {
+			// nothing references the interned words anymore
+			esil_words_flush (esil);
+		}
 	}
 }
 
 R_API int r_anal_esil_condition(RAnalEsil *esil, const char *str) {
-	char *popped;
+	RAnalEsilItem popped;
 	int ret;
 	if (!esil) {
 		return false;
@@ -3058,15 +3312,14 @@ R_API int r_anal_esil_condition(RAnalEsil *esil, const char *str) {
 		str++; // use proper string chop?
 	}
 	(void) r_anal_esil_parse (esil, str);
-	popped = r_anal_esil_pop (esil);
-	if (popped) {
+	popped = esil_pop_item (esil);
+	if (popped.type) {
 		ut64 num;
-		if (isregornum (esil, popped, &num)) {
+		if (esil_item_regornum (esil, &popped, &num)) {
 			ret = !!num;
 		} else {
 			ret = 0;
 		}
-		free (popped);
 	} else {
 		ERR ("ESIL stack is empty");
 		return -1;
@@ -1,15 +1,353 @@
-/* radare - LGPL - Copyright 2015-2018 - pancake */
+/* radare - LGPL - Copyright 2015-2019 - pancake */
 
 #include <r_anal.h>
 
-#define DB esil->db_trace
-#define KEY(x) sdb_fmt ("%d."x, esil->trace_idx)
-#define KEYAT(x,y) sdb_fmt ("%d."x".0x%"PFMT64x, esil->trace_idx, y)
-#define KEYREG(x,y) sdb_fmt ("%d."x".%s", esil->trace_idx, y)
+// The trace is kept as fixed size records in two rings, one with a step
+// per traced instruction and another one with the register and memory
+// accesses of all the steps. They grow up to the given amount of accesses
+// and then the oldest steps are dropped. Memory data takes a record per 8
+// bytes. Register names are stored once, the records keep their id.
+
+typedef struct {
+	ut8 *a;
+	size_t elem;
+	ut64 head; // slot of the oldest element
+	ut64 len;
+	ut64 cap; // power of two
+} TraceRing;
+
+struct r_anal_esil_trace_t {
+	TraceRing steps;
+	TraceRing accesses;
+	int first; // index of the oldest step
+	ut64 seq; // sequence number of the oldest access
+	ut64 max;
+	HtPP *regs; // register name -> id + 1
+	RPVector names;
+};
 
 static int ocbs_set = false;
 static RAnalEsilCallbacks ocbs = {0};
 
+static inline void *ring_at(TraceRing *r, ut64 i) {
+	return r->a + ((r->head + i) & (r->cap - 1)) * r->elem;
+}
+
+static bool ring_grow(TraceRing *r) {
+	ut64 cap = r->cap? r->cap * 2: 64;
+	ut8 *a = malloc (cap * r->elem);
+	if (!a) {
+		return false;
+	}
+	if (r->len) {
+		ut64 n = R_MIN (r->len, r->cap - r->head);
+		memcpy (a, r->a + r->head * r->elem, n * r->elem);
+		memcpy (a + n * r->elem, r->a, (r->len - n) * r->elem);
+	}
+	free (r->a);
+	r->a = a;
+	r->head = 0;
+	r->cap = cap;
+	return true;
+}
+
+static void ring_drop(TraceRing *r, ut64 n) {
+	r->head = (r->head + n) & (r->cap - 1);
+	r->len -= n;
+}
+
+R_API RAnalEsilTrace *r_anal_esil_trace_new(ut64 max) {
+	RAnalEsilTrace *trace = R_NEW0 (RAnalEsilTrace);
+	if (!trace) {
+		return NULL;
+	}
+	trace->regs = ht_pp_new0 ();
+	if (!trace->regs) {
+		free (trace);
+		return NULL;
+	}
+	trace->steps.elem = sizeof (RAnalEsilTraceStep);
+	trace->accesses.elem = sizeof (RAnalEsilTraceAccess);
+	trace->max = 64;
+	while (trace->max < max) {
+		trace->max *= 2;
+	}
+	r_pvector_init (&trace->names, free);
+	return trace;
+}
+
+R_API void r_anal_esil_trace_free(RAnalEsilTrace *trace) {
+	if (trace) {
+		free (trace->steps.a);
+		free (trace->accesses.a);
+		ht_pp_free (trace->regs);
+		r_pvector_clear (&trace->names);
+		free (trace);
+	}
+}
+
+// forget the steps, the register names are kept
+R_API void r_anal_esil_trace_reset(RAnalEsilTrace *trace) {
+	r_return_if_fail (trace);
+	trace->steps.head = trace->steps.len = 0;
+	trace->accesses.head = trace->accesses.len = 0;
+	trace->seq = 0;
+}
+
+static void trace_drop_step(RAnalEsilTrace *trace) {
+	RAnalEsilTraceStep *step = ring_at (&trace->steps, 0);
+	ring_drop (&trace->accesses, step->count);
+	trace->seq += step->count;
+	ring_drop (&trace->steps, 1);
+	trace->first++;
+}
+
+static RAnalEsilTraceStep *trace_add_step(RAnalEsilTrace *trace, int idx, ut64 addr) {
+	if (trace->steps.len && idx != trace->first + trace->steps.len) {
+		r_anal_esil_trace_reset (trace);
+	}
+	if (!trace->steps.len) {
+		trace->first = idx;
+	}
+	if (trace->steps.len == trace->steps.cap) {
+		if (trace->steps.cap < trace->max) {
+			if (!ring_grow (&trace->steps)) {
+				return NULL;
+			}
+		} else {
+			trace_drop_step (trace);
+		}
+	}
+	RAnalEsilTraceStep *step = ring_at (&trace->steps, trace->steps.len++);
+	step->addr = addr;
+	step->start = trace->seq + trace->accesses.len;
+	step->count = 0;
+	return step;
+}
+
+static RAnalEsilTraceAccess *trace_add(RAnalEsilTrace *trace, ut32 type, ut64 addr, ut64 value, ut32 size) {
+	if (!trace->steps.len) {
+		return NULL;
+	}
+	while (trace->accesses.len == trace->accesses.cap) {
+		// a single step can outgrow the limit
+		if (trace->accesses.cap < trace->max || trace->steps.len == 1) {
+			if (!ring_grow (&trace->accesses)) {
+				return NULL;
+			}
+		} else {
+			trace_drop_step (trace);
+		}
+	}
+	RAnalEsilTraceStep *step = ring_at (&trace->steps, trace->steps.len - 1);
+	RAnalEsilTraceAccess *a = ring_at (&trace->accesses, trace->accesses.len++);
+	a->addr = addr;
+	a->value = value;
+	a->size = size;
+	a->type = type;
+	step->count++;
+	return a;
+}
+
+static ut64 trace_regid(RAnalEsilTrace *trace, const char *name, bool add) {
+	bool found = false;
+	ut64 id = (ut64)(size_t)ht_pp_find (trace->regs, name, &found);
+	if (found) {
+		return id - 1;
+	}
+	if (!add) {
+		return UT64_MAX;
+	}
+	char *s = strdup (name);
+	if (!s || !r_pvector_push (&trace->names, s)) {
+		free (s);
+		return UT64_MAX;
+	}
+	id = r_pvector_len (&trace->names);
+	ht_pp_insert (trace->regs, name, (void *)(size_t)id);
+	return id - 1;
+}
+
+static void trace_add_reg(RAnalEsilTrace *trace, ut32 type, const char *name, ut64 val) {
+	ut64 id = trace_regid (trace, name, true);
+	if (id != UT64_MAX) {
+		trace_add (trace, type, id, val, 0);
+	}
+}
+
+static void trace_add_mem(RAnalEsilTrace *trace, ut32 type, ut64 addr, const ut8 *buf, int len) {
+	ut64 value = 0;
+	int i;
+	if (len < 0) {
+		return;
+	}
+	for (i = 0; i < len || !i; i += 8) {
+		value = 0;
+		memcpy (&value, buf + i, R_MIN (8, len - i));
+		if (!trace_add (trace, i? R_ANAL_ESIL_TRACE_DATA: type, addr, value, len)) {
+			break;
+		}
+	}
+}
+
+R_API const RAnalEsilTraceStep *r_anal_esil_trace_step(RAnalEsilTrace *trace, int idx) {
+	r_return_val_if_fail (trace, NULL);
+	if (idx < trace->first || idx - trace->first >= trace->steps.len) {
+		return NULL;
+	}
+	return ring_at (&trace->steps, idx - trace->first);
+}
+
+R_API const RAnalEsilTraceAccess *r_anal_esil_trace_access(RAnalEsilTrace *trace, const RAnalEsilTraceStep *step, ut32 n) {
+	r_return_val_if_fail (trace && step, NULL);
+	return n < step->count? ring_at (&trace->accesses, step->start - trace->seq + n): NULL;
+}
+
+R_API const char *r_anal_esil_trace_regname(RAnalEsilTrace *trace, const RAnalEsilTraceAccess *a) {
+	r_return_val_if_fail (trace && a, NULL);
+	if (a->type != R_ANAL_ESIL_TRACE_REG_READ && a->type != R_ANAL_ESIL_TRACE_REG_WRITE) {
+		return NULL;
+	}
+	return a->addr < r_pvector_len (&trace->names)? r_pvector_at (&trace->names, a->addr): NULL;
+}
+
+// copy the data of the memory access n of the step
+R_API int r_anal_esil_trace_data(RAnalEsilTrace *trace, const RAnalEsilTraceStep *step, ut32 n, ut8 *buf, int len) {
+	const RAnalEsilTraceAccess *a = r_anal_esil_trace_access (trace, step, n);
+	int i;
+	if (!a || (a->type != R_ANAL_ESIL_TRACE_MEM_READ && a->type != R_ANAL_ESIL_TRACE_MEM_WRITE)) {
+		return -1;
+	}
+	len = R_MIN (len, a->size);
+	for (i = 0; i < len; i += 8) {
+		const RAnalEsilTraceAccess *d = i? r_anal_esil_trace_access (trace, step, n + i / 8): a;
+		if (!d || (i && d->type != R_ANAL_ESIL_TRACE_DATA)) {
+			return i;
+		}
+		memcpy (buf + i, &d->value, R_MIN (8, len - i));
+	}
+	return len;
+}
+
+// last value of the register read or written by the step
+R_API bool r_anal_esil_trace_reg(RAnalEsilTrace *trace, int idx, int type, const char *name, ut64 *value) {
+	r_return_val_if_fail (trace && name, false);
+	const RAnalEsilTraceStep *step = r_anal_esil_trace_step (trace, idx);
+	ut64 id = trace_regid (trace, name, false);
+	bool found = false;
+	ut32 n;
+	if (!step || id == UT64_MAX) {
+		return false;
+	}
+	for (n = 0; n < step->count; n++) {
+		const RAnalEsilTraceAccess *a = r_anal_esil_trace_access (trace, step, n);
+		if (a->type == type && a->addr == id) {
+			if (value) {
+				*value = a->value;
+			}
+			found = true;
+		}
+	}
+	return found;
+}
+
+// names of the registers read or written by the step, in order of access
+R_API int r_anal_esil_trace_regs(RAnalEsilTrace *trace, int idx, int type, const char **names, int max) {
+	r_return_val_if_fail (trace && names, 0);
+	const RAnalEsilTraceStep *step = r_anal_esil_trace_step (trace, idx);
+	int count = 0, i;
+	ut32 n;
+	if (!step) {
+		return 0;
+	}
+	for (n = 0; n < step->count && count < max; n++) {
+		const RAnalEsilTraceAccess *a = r_anal_esil_trace_access (trace, step, n);
+		if (a->type != type) {
+			continue;
+		}
+		const char *name = r_anal_esil_trace_regname (trace, a);
+		for (i = 0; i < count && names[i] != name; i++) {
+			;
+		}
+		if (name && i == count) {
+			names[count++] = name;
+		}
+	}
+	return count;
+}
+
+// address of the first memory read or write of the step
+R_API bool r_anal_esil_trace_mem(RAnalEsilTrace *trace, int idx, int type, ut64 *addr) {
+	r_return_val_if_fail (trace, false);
+	const RAnalEsilTraceStep *step = r_anal_esil_trace_step (trace, idx);
+	ut32 n;
+	if (!step) {
+		return false;
+	}
+	for (n = 0; n < step->count; n++) {
+		const RAnalEsilTraceAccess *a = r_anal_esil_trace_access (trace, step, n);
+		if (a->type == type) {
+			if (addr) {
+				*addr = a->addr;
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+static char *trace_hex(RAnalEsilTrace *trace, const RAnalEsilTraceStep *step, ut32 n) {
+	const RAnalEsilTraceAccess *a = r_anal_esil_trace_access (trace, step, n);
+	ut8 *buf = malloc (a->size + 1);
+	char *hex = malloc (a->size * 2 + 1);
+	if (buf && hex) {
+		int len = r_anal_esil_trace_data (trace, step, n, buf, a->size);
+		r_hex_bin2str (buf, R_MAX (len, 0), hex);
+	} else {
+		R_FREE (hex);
+	}
+	free (buf);
+	return hex;
+}
+
+// the trace in the layout of the old sdb based one, for listing it
+R_API Sdb *r_anal_esil_trace_sdb(RAnalEsilTrace *trace) {
+	r_return_val_if_fail (trace, NULL);
+	static const char *kinds[] = { "reg.read", "reg.write", "mem.read", "mem.write" };
+	Sdb *db = sdb_new0 ();
+	ut64 i;
+	ut32 n;
+	if (!db) {
+		return NULL;
+	}
+	if (trace->steps.len) {
+		sdb_num_set (db, "idx", trace->first + trace->steps.len - 1, 0);
+	}
+	for (i = 0; i < trace->steps.len; i++) {
+		const RAnalEsilTraceStep *step = ring_at (&trace->steps, i);
+		int idx = trace->first + i;
+		sdb_num_set (db, sdb_fmt ("%d.addr", idx), step->addr, 0);
+		for (n = 0; n < step->count; n++) {
+			const RAnalEsilTraceAccess *a = r_anal_esil_trace_access (trace, step, n);
+			if (a->type == R_ANAL_ESIL_TRACE_DATA) {
+				continue;
+			}
+			const char *kind = kinds[a->type];
+			const char *name = r_anal_esil_trace_regname (trace, a);
+			if (name) {
+				sdb_array_add (db, sdb_fmt ("%d.%s", idx, kind), name, 0);
+				sdb_num_set (db, sdb_fmt ("%d.%s.%s", idx, kind, name), a->value, 0);
+			} else {
+				char *hex = trace_hex (trace, step, n);
+				sdb_array_add_num (db, sdb_fmt ("%d.%s", idx, kind), a->addr, 0);
+				sdb_set (db, sdb_fmt ("%d.%s.data.0x%"PFMT64x, idx, kind, a->addr), hex, 0);
+				free (hex);
+			}
+		}
+	}
+	return db;
+}
+
 static int trace_hook_reg_read(RAnalEsil *esil, const char *name, ut64 *res, int *size) {
 	int ret = 0;
 	if (*name=='0') {
@@ -26,21 +364,14 @@ static int trace_hook_reg_read(RAnalEsil *esil, const char *name, ut64 *res, int
 		ret = esil->cb.reg_read (esil, name, res, size);
 	}
 	if (ret) {
-		ut64 val = *res;
-		//eprintf ("[ESIL] REG READ %s 0x%08"PFMT64x"\n", name, val);
-		sdb_array_add (DB, KEY ("reg.read"), name, 0);
-		sdb_num_set (DB, KEYREG ("reg.read", name), val, 0);
-	} //else {
-		//eprintf ("[ESIL] REG READ %s FAILED\n", name);
-	//}
+		trace_add_reg (esil->trace, R_ANAL_ESIL_TRACE_REG_READ, name, *res);
+	}
 	return ret;
 }
 
 static int trace_hook_reg_write(RAnalEsil *esil, const char *name, ut64 *val) {
 	int ret = 0;
-	//eprintf ("[ESIL] REG WRITE %s 0x%08"PFMT64x"\n", name, *val);
-	sdb_array_add (DB, KEY ("reg.write"), name, 0);
-	sdb_num_set (DB, KEYREG ("reg.write", name), *val, 0);
+	trace_add_reg (esil->trace, R_ANAL_ESIL_TRACE_REG_WRITE, name, *val);
 	if (ocbs.hook_reg_write) {
 		RAnalEsilCallbacks cbs = esil->cb;
 		esil->cb = ocbs;
@@ -51,17 +382,11 @@ static int trace_hook_reg_write(RAnalEsil *esil, const char *name, ut64 *val) {
 }
 
 static int trace_hook_mem_read(RAnalEsil *esil, ut64 addr, ut8 *buf, int len) {
-	char *hexbuf = calloc ((1 + len), 4);
 	int ret = 0;
 	if (esil->cb.mem_read) {
 		ret = esil->cb.mem_read (esil, addr, buf, len);
 	}
-	sdb_array_add_num (DB, KEY ("mem.read"), addr, 0);
-	r_hex_bin2str (buf, len, hexbuf);
-	sdb_set (DB, KEYAT ("mem.read.data", addr), hexbuf, 0);
-	//eprintf ("[ESIL] MEM READ 0x%08"PFMT64x" %s\n", addr, hexbuf);
-	free (hexbuf);
-
+	trace_add_mem (esil->trace, R_ANAL_ESIL_TRACE_MEM_READ, addr, buf, len);
 	if (ocbs.hook_mem_read) {
 		RAnalEsilCallbacks cbs = esil->cb;
 		esil->cb = ocbs;
@@ -73,13 +398,7 @@ static int trace_hook_mem_read(RAnalEsil *esil, ut64 addr, ut8 *buf, int len) {
 
 static int trace_hook_mem_write(RAnalEsil *esil, ut64 addr, const ut8 *buf, int len) {
 	int ret = 0;
-	char *hexbuf = malloc ((1+len)*3);
-	sdb_array_add_num (DB, KEY ("mem.write"), addr, 0);
-	r_hex_bin2str (buf, len, hexbuf);
-	sdb_set (DB, KEYAT ("mem.write.data", addr), hexbuf, 0);
-	//eprintf ("[ESIL] MEM WRITE 0x%08"PFMT64x" %s\n", addr, hexbuf);
-	free (hexbuf);
-
+	trace_add_mem (esil->trace, R_ANAL_ESIL_TRACE_MEM_WRITE, addr, buf, len);
 	if (ocbs.hook_mem_write) {
 		RAnalEsilCallbacks cbs = esil->cb;
 		esil->cb = ocbs;
@@ -95,19 +414,17 @@ R_API void r_anal_esil_trace (RAnalEsil *esil, RAnalOp *op) {
 	if (ocbs_set) {
 		eprintf ("cannot call recursively\n");
 	}
+	if (!esil->trace) {
+		esil->trace = r_anal_esil_trace_new (R_ANAL_ESIL_TRACE_MAX);
+		if (!esil->trace) {
+			return;
+		}
+	}
+	if (!trace_add_step (esil->trace, esil->trace_idx, op->addr)) {
+		return;
+	}
 	ocbs = esil->cb;
 	ocbs_set = true;
-	if (!DB) {
-		DB = sdb_new0 ();
-	}
-	sdb_num_set (DB, "idx", esil->trace_idx, 0);
-	sdb_num_set (DB, KEY ("addr"), op->addr, 0);
-//	sdb_set (DB, KEY ("opcode"), op->mnemonic, 0);
-//	sdb_set (DB, KEY ("addr"), expr, 0);
-
-	//eprintf ("[ESIL] ADDR 0x%08"PFMT64x"\n", op->addr);
-	//eprintf ("[ESIL] OPCODE %s\n", op->mnemonic);
-	//eprintf ("[ESIL] EXPR = %s\n", expr);
 	/* set hooks */
 	esil->verbose = 0;
 	esil->cb.hook_reg_read = trace_hook_reg_read;
@@ -127,68 +444,52 @@ R_API void r_anal_esil_trace (RAnalEsil *esil, RAnalOp *op) {
 R_API void r_anal_esil_trace_list (RAnalEsil *esil) {
 	SdbKv *kv;
 	SdbListIter *iter;
-	SdbList *list = sdb_foreach_list (esil->db_trace, true);
+	if (!esil->trace) {
+		return;
+	}
+	Sdb *db = r_anal_esil_trace_sdb (esil->trace);
+	SdbList *list = sdb_foreach_list (db, true);
 	ls_foreach (list, iter, kv) {
 		eprintf ("%s=%s\n", sdbkv_key (kv), sdbkv_value (kv));
 	}
 	ls_free (list);
+	sdb_free (db);
 }
 
 R_API void r_anal_esil_trace_show(RAnalEsil *esil, int idx) {
 	PrintfCallback p = esil->anal->cb_printf;
-	const char *str2;
-	const char *str;
-	int trace_idx = esil->trace_idx;
-	esil->trace_idx = idx;
-
-	str2 = sdb_const_get (DB, KEY ("addr"), 0);
-	if (!str2) {
+	RAnalEsilTrace *trace = esil->trace;
+	const RAnalEsilTraceStep *step = trace? r_anal_esil_trace_step (trace, idx): NULL;
+	const char *names[64];
+	int i, count;
+	ut32 n, m;
+	if (!step) {
 		return;
 	}
-	p ("dr pc = %s\n", str2);
+	p ("dr pc = 0x%"PFMT64x"\n", step->addr);
 	/* registers */
-	str = sdb_const_get (DB, KEY ("reg.read"), 0);
-	if (str) {
-		char regname[32];
-		const char *next, *ptr = str;
-		if (ptr && *ptr) {
-			do {
-				next = sdb_const_anext (ptr);
-				int len = next? (int)(size_t)(next-ptr)-1 : strlen (ptr);
-				if (len <sizeof(regname)) {
-					memcpy (regname, ptr, len);
-					regname[len] = 0;
-					str2 = sdb_const_get (DB, KEYREG ("reg.read", regname), 0);
-					p ("dr %s = %s\n", regname, str2);
-				} else {
-					eprintf ("Invalid entry in reg.read\n");
-				}
-				ptr = next;
-			} while (next);
-		}
+	count = r_anal_esil_trace_regs (trace, idx, R_ANAL_ESIL_TRACE_REG_READ, names, 64);
+	for (i = 0; i < count; i++) {
+		ut64 val = 0;
+		r_anal_esil_trace_reg (trace, idx, R_ANAL_ESIL_TRACE_REG_READ, names[i], &val);
+		p ("dr %s = 0x%"PFMT64x"\n", names[i], val);
 	}
 	/* memory */
-	str = sdb_const_get (DB, KEY ("mem.read"), 0);
-	if (str) {
-		char addr[64];
-		const char *next, *ptr = str;
-		if (ptr && *ptr) {
-			do {
-				next = sdb_const_anext (ptr);
-				int len = next? (int)(size_t)(next-ptr)-1 : strlen (ptr);
-				if (len <sizeof(addr)) {
-					memcpy (addr, ptr, len);
-					addr[len] = 0;
-					str2 = sdb_const_get (DB, KEYAT ("mem.read.data",
-						r_num_get (NULL, addr)), 0);
-					p ("wx %s @ %s\n", str2, addr);
-				} else {
-					eprintf ("Invalid entry in reg.read\n");
-				}
-				ptr = next;
-			} while (next);
+	for (n = 0; n < step->count; n++) {
+		const RAnalEsilTraceAccess *a = r_anal_esil_trace_access (trace, step, n);
+		if (a->type != R_ANAL_ESIL_TRACE_MEM_READ) {
+			continue;
+		}
+		for (m = 0; m < n; m++) {
+			const RAnalEsilTraceAccess *b = r_anal_esil_trace_access (trace, step, m);
+			if (b->type == a->type && b->addr == a->addr) {
+				break;
+			}
+		}
+		if (m == n) {
+			char *hex = trace_hex (trace, step, n);
+			p ("wx %s @ 0x%"PFMT64x"\n", hex? hex: "", a->addr);
+			free (hex);
 		}
 	}
-
-	esil->trace_idx = trace_idx;
 }
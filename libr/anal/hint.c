@@ -2,120 +2,233 @@
 
 #include <r_anal.h>
 
-#define DB a->sdb_hints
-#define setf(x,...) snprintf(x,sizeof(x)-1,##__VA_ARGS__)
+// hints are kept decoded in a tree sorted by address, every node tracks
+// which of the RAnalHint fields have been set so unset can drop it again
+enum {
+	HINT_IMMBASE = 1 << 0,
+	HINT_JUMP = 1 << 1,
+	HINT_FAIL = 1 << 2,
+	HINT_PTR = 1 << 3,
+	HINT_NWORD = 1 << 4,
+	HINT_RET = 1 << 5,
+	HINT_BITS = 1 << 6,
+	HINT_NEW_BITS = 1 << 7,
+	HINT_SIZE = 1 << 8,
+	HINT_SYNTAX = 1 << 9,
+	HINT_TYPE = 1 << 10,
+	HINT_OPCODE = 1 << 11,
+	HINT_OFFSET = 1 << 12,
+	HINT_ESIL = 1 << 13,
+	HINT_ARCH = 1 << 14,
+	HINT_HIGH = 1 << 15,
+};
+
+typedef struct {
+	RAnalHint hint;
+	ut32 fields;
+	RBNode rb;
+} HintNode;
+
+static int hint_cmp(const void *incoming, const RBNode *in_tree) {
+	ut64 addr = *(const ut64 *)incoming;
+	ut64 at = container_of (in_tree, const HintNode, rb)->hint.addr;
+	return addr < at? -1: addr > at? 1: 0;
+}
+
+static void hint_fini(RAnalHint *h) {
+	free (h->arch);
+	free (h->esil);
+	free (h->opcode);
+	free (h->syntax);
+	free (h->offset);
+}
+
+static void hint_node_free(RBNode *n) {
+	HintNode *node = container_of (n, HintNode, rb);
+	hint_fini (&node->hint);
+	free (node);
+}
+
+static HintNode *hint_node_get(RAnal *a, ut64 addr) {
+	RBNode *n = r_rbtree_find (a->hints, &addr, hint_cmp);
+	return n? container_of (n, HintNode, rb): NULL;
+}
+
+static RAnalHint *set_hint(RAnal *a, ut64 addr, ut32 field) {
+	HintNode *node = hint_node_get (a, addr);
+	if (!node) {
+		node = R_NEW0 (HintNode);
+		if (!node) {
+			return NULL;
+		}
+		node->hint.addr = addr;
+		node->hint.jump = UT64_MAX;
+		node->hint.fail = UT64_MAX;
+		node->hint.ret = UT64_MAX;
+		r_rbtree_insert (&a->hints, &addr, &node->rb, hint_cmp);
+	}
+	node->fields |= field;
+	return &node->hint;
+}
 
-R_API void r_anal_hint_clear(RAnal *a) {
-	sdb_reset (a->sdb_hints);
+static void set_str(char **dst, const char *s) {
+	free (*dst);
+	*dst = s? strdup (s): NULL;
 }
 
-R_API void r_anal_hint_del(RAnal *a, ut64 addr, int size) {
-	char key[128];
-	if (size > 1) {
-		eprintf ("TODO: r_anal_hint_del: in range\n");
-	} else {
-		setf (key, "hint.0x%08"PFMT64x, addr);
-		sdb_unset (a->sdb_hints, key, 0);
+static void unset_hint(RAnal *a, ut64 addr, ut32 field) {
+	HintNode *node = hint_node_get (a, addr);
+	if (!node || !(node->fields & field)) {
+		return;
+	}
+	node->fields &= ~field;
+	if (!node->fields) {
+		r_rbtree_delete (&a->hints, &addr, hint_cmp, hint_node_free);
+		return;
+	}
+	RAnalHint *h = &node->hint;
+	switch (field) {
+	case HINT_IMMBASE: h->immbase = 0; break;
+	case HINT_JUMP: h->jump = UT64_MAX; break;
+	case HINT_FAIL: h->fail = UT64_MAX; break;
+	case HINT_PTR: h->ptr = 0; break;
+	case HINT_NWORD: h->nword = 0; break;
+	case HINT_RET: h->ret = UT64_MAX; break;
+	case HINT_BITS: h->bits = 0; break;
+	case HINT_NEW_BITS: h->new_bits = 0; break;
+	case HINT_SIZE: h->size = 0; break;
+	case HINT_SYNTAX: R_FREE (h->syntax); break;
+	case HINT_TYPE: h->type = 0; break;
+	case HINT_OPCODE: R_FREE (h->opcode); break;
+	case HINT_OFFSET: R_FREE (h->offset); break;
+	case HINT_ESIL: R_FREE (h->esil); break;
+	case HINT_ARCH: R_FREE (h->arch); break;
+	case HINT_HIGH: h->high = false; break;
 	}
 }
 
-static void unsetHint(RAnal *a, const char *type, ut64 addr) {
-	char key[128];
-	setf (key, "hint.0x%08"PFMT64x, addr);
-	int idx = sdb_array_indexof (DB, key, type, 0);
-	if (idx != -1) {
-		sdb_array_delete (DB, key, idx, 0);
-		sdb_array_delete (DB, key, idx, 0);
-	}
+R_API void r_anal_hint_clear(RAnal *a) {
+	r_rbtree_free (a->hints, hint_node_free);
+	a->hints = NULL;
 }
 
-static void setHint(RAnal *a, const char *type, ut64 addr, const char *s, ut64 ptr) {
-	char key[128], val[128], *nval = NULL;
-	setf (key, "hint.0x%08"PFMT64x, addr);
-	int idx = sdb_array_indexof (DB, key, type, 0);
-	if (s) {
-		nval = sdb_encode ((const ut8*)s, -1);
-	} else {
-		nval = sdb_itoa (ptr, val, 16);
-	}
-	if (idx != -1) {
-		if (!s) {
-			nval = sdb_itoa (ptr, val, 16);
-		}
-		sdb_array_set (DB, key, idx + 1, nval, 0);
+R_API void r_anal_hint_del(RAnal *a, ut64 addr, int size) {
+	if (size > 1) {
+		eprintf ("TODO: r_anal_hint_del: in range\n");
 	} else {
-		sdb_array_push (DB, key, nval, 0);
-		sdb_array_push (DB, key, type, 0);
-	}
-	if (s) {
-		free (nval);
+		r_rbtree_delete (&a->hints, &addr, hint_cmp, hint_node_free);
 	}
 }
 
 R_API void r_anal_hint_set_offset(RAnal *a, ut64 addr, const char* typeoff) {
-	setHint (a, "Offset:", addr, r_str_trim_ro (typeoff), 0);
+	RAnalHint *h = set_hint (a, addr, HINT_OFFSET);
+	if (h) {
+		set_str (&h->offset, r_str_trim_ro (typeoff));
+	}
 }
 
 R_API void r_anal_hint_set_nword(RAnal *a, ut64 addr, int nword) {
-	setHint (a, "nword:", addr, NULL, nword);
+	RAnalHint *h = set_hint (a, addr, HINT_NWORD);
+	if (h) {
+		h->nword = nword;
+	}
 }
 
 R_API void r_anal_hint_set_jump(RAnal *a, ut64 addr, ut64 ptr) {
-	setHint (a, "jump:", addr, NULL, ptr);
+	RAnalHint *h = set_hint (a, addr, HINT_JUMP);
+	if (h) {
+		h->jump = ptr;
+	}
 }
 
 R_API void r_anal_hint_set_newbits(RAnal *a, ut64 addr, int bits) {
-	setHint (a, "Bits:", addr, NULL, bits);
+	RAnalHint *h = set_hint (a, addr, HINT_NEW_BITS);
+	if (h) {
+		h->new_bits = bits;
+	}
 }
 
 // TOOD: add helpers for newendian and newbank
 
 R_API void r_anal_hint_set_fail(RAnal *a, ut64 addr, ut64 ptr) {
-	setHint (a, "fail:", addr, NULL, ptr);
+	RAnalHint *h = set_hint (a, addr, HINT_FAIL);
+	if (h) {
+		h->fail = ptr;
+	}
 }
 
 R_API void r_anal_hint_set_high(RAnal *a, ut64 addr) {
-	setHint (a, "high:", addr, NULL, 1);
+	RAnalHint *h = set_hint (a, addr, HINT_HIGH);
+	if (h) {
+		h->high = true;
+	}
 }
 
 R_API void r_anal_hint_set_immbase(RAnal *a, ut64 addr, int base) {
 	if (base) {
-		setHint (a, "immbase:", addr, NULL, (ut64)base);
+		RAnalHint *h = set_hint (a, addr, HINT_IMMBASE);
+		if (h) {
+			h->immbase = base;
+		}
 	} else {
-		unsetHint (a, "immbase:", addr);
+		unset_hint (a, addr, HINT_IMMBASE);
 	}
 }
 
 R_API void r_anal_hint_set_pointer(RAnal *a, ut64 addr, ut64 ptr) {
-	setHint (a, "ptr:", addr, NULL, ptr);
+	RAnalHint *h = set_hint (a, addr, HINT_PTR);
+	if (h) {
+		h->ptr = ptr;
+	}
 }
 
 R_API void r_anal_hint_set_ret(RAnal *a, ut64 addr, ut64 val) {
-	setHint (a, "ret:", addr, NULL, val);
+	RAnalHint *h = set_hint (a, addr, HINT_RET);
+	if (h) {
+		h->ret = val;
+	}
 }
 
 R_API void r_anal_hint_set_arch(RAnal *a, ut64 addr, const char *arch) {
-	setHint (a, "arch:", addr, r_str_trim_ro (arch), 0);
+	RAnalHint *h = set_hint (a, addr, HINT_ARCH);
+	if (h) {
+		set_str (&h->arch, r_str_trim_ro (arch));
+	}
 }
 
 R_API void r_anal_hint_set_syntax(RAnal *a, ut64 addr, const char *syn) {
-	setHint (a, "Syntax:", addr, syn, 0);
+	RAnalHint *h = set_hint (a, addr, HINT_SYNTAX);
+	if (h) {
+		set_str (&h->syntax, syn);
+	}
 }
 
 R_API void r_anal_hint_set_opcode(RAnal *a, ut64 addr, const char *opcode) {
-	setHint (a, "opcode:", addr, r_str_trim_ro (opcode), 0);
+	RAnalHint *h = set_hint (a, addr, HINT_OPCODE);
+	if (h) {
+		set_str (&h->opcode, r_str_trim_ro (opcode));
+	}
 }
 
 R_API void r_anal_hint_set_esil(RAnal *a, ut64 addr, const char *esil) {
-	setHint (a, "esil:", addr, r_str_trim_ro (esil), 0);
+	RAnalHint *h = set_hint (a, addr, HINT_ESIL);
+	if (h) {
+		set_str (&h->esil, r_str_trim_ro (esil));
+	}
 }
 
 R_API void r_anal_hint_set_type (RAnal *a, ut64 addr, int type) {
-	setHint (a, "type:", addr, NULL, (ut64)type);
+	RAnalHint *h = set_hint (a, addr, HINT_TYPE);
+	if (h) {
+		h->type = type;
+	}
 }
 
 R_API void r_anal_hint_set_bits(RAnal *a, ut64 addr, int bits) {
-	setHint (a, "bits:", addr, NULL, bits);
+	RAnalHint *h = set_hint (a, addr, HINT_BITS);
+	if (h) {
+		h->bits = bits;
+	}
 	if (a && a->hint_cbs.on_bits) {
 		a->hint_cbs.on_bits (a, addr, bits, true);
 	}
@@ -123,15 +236,18 @@ R_API void r_anal_hint_set_bits(RAnal *a, ut64 addr, int bits) {
 }
 
 R_API void r_anal_hint_set_size(RAnal *a, ut64 addr, int size) {
-	setHint (a, "size:", addr, NULL, size);
+	RAnalHint *h = set_hint (a, addr, HINT_SIZE);
+	if (h) {
+		h->size = size;
+	}
 }
 
 R_API void r_anal_hint_unset_size(RAnal *a, ut64 addr) {
-	unsetHint(a, "size:", addr);
+	unset_hint (a, addr, HINT_SIZE);
 }
 
 R_API void r_anal_hint_unset_bits(RAnal *a, ut64 addr) {
-	unsetHint(a, "bits:", addr);
+	unset_hint (a, addr, HINT_BITS);
 	if (a && a->hint_cbs.on_bits) {
 		a->hint_cbs.on_bits (a, addr, 0, false);
 	}
@@ -139,60 +255,56 @@ R_API void r_anal_hint_unset_bits(RAnal *a, ut64 addr) {
 }
 
 R_API void r_anal_hint_unset_esil(RAnal *a, ut64 addr) {
-	unsetHint(a, "esil:", addr);
+	unset_hint (a, addr, HINT_ESIL);
 }
 
 R_API void r_anal_hint_unset_opcode(RAnal *a, ut64 addr) {
-	unsetHint(a, "opcode:", addr);
+	unset_hint (a, addr, HINT_OPCODE);
 }
 
 R_API void r_anal_hint_unset_high(RAnal *a, ut64 addr) {
-	unsetHint(a, "high:", addr);
+	unset_hint (a, addr, HINT_HIGH);
 }
 
 R_API void r_anal_hint_unset_arch(RAnal *a, ut64 addr) {
-	unsetHint(a, "arch:", addr);
+	unset_hint (a, addr, HINT_ARCH);
 }
 
 R_API void r_anal_hint_unset_nword(RAnal *a, ut64 addr) {
-	unsetHint(a, "nword:", addr);
+	unset_hint (a, addr, HINT_NWORD);
 }
 
 R_API void r_anal_hint_unset_syntax(RAnal *a, ut64 addr) {
-	unsetHint(a, "Syntax:", addr);
+	unset_hint (a, addr, HINT_SYNTAX);
 }
 
 R_API void r_anal_hint_unset_pointer(RAnal *a, ut64 addr) {
-	unsetHint(a, "ptr:", addr);
+	unset_hint (a, addr, HINT_PTR);
 }
 
 R_API void r_anal_hint_unset_ret(RAnal *a, ut64 addr) {
-	unsetHint(a, "ret:", addr);
+	unset_hint (a, addr, HINT_RET);
 }
 
 R_API void r_anal_hint_unset_offset(RAnal *a, ut64 addr) {
-	unsetHint (a, "Offset:", addr);
+	unset_hint (a, addr, HINT_OFFSET);
 }
 
 R_API void r_anal_hint_unset_jump(RAnal *a, ut64 addr) {
-	unsetHint (a, "jump:", addr);
+	unset_hint (a, addr, HINT_JUMP);
 }
 
 R_API void r_anal_hint_unset_fail(RAnal *a, ut64 addr) {
-	unsetHint (a, "fail:", addr);
+	unset_hint (a, addr, HINT_FAIL);
 }
 
 R_API void r_anal_hint_unset_type (RAnal *a, ut64 addr) {
-	unsetHint (a, "type:", addr);
+	unset_hint (a, addr, HINT_TYPE);
 }
 
 R_API void r_anal_hint_free(RAnalHint *h) {
 	if (h) {
-		free (h->arch);
-		free (h->esil);
-		free (h->opcode);
-		free (h->syntax);
-		free (h->offset);
+		hint_fini (h);
 		free (h);
 	}
 }
@@ -227,7 +339,63 @@ R_API int r_anal_hint_get_bits_at(RAnal *a, ut64 addr, const char *str) {
 	return bits;
 }
 
-// TODO: missing to_string ()
+// serialized as the sdb array of "type:,value" pairs used by older versions
+R_API char *r_anal_hint_to_string(const RAnalHint *hint) {
+	char num[SDB_NUM_BUFSZ];
+	RStrBuf *sb = r_strbuf_new ("");
+	if (!sb) {
+		return NULL;
+	}
+#define HINT_NUM(tok, x) r_strbuf_appendf (sb, "%s" tok ",%s", \
+		r_strbuf_length (sb)? ",": "", sdb_itoa ((ut64)(x), num, 16))
+#define HINT_STR(tok, x) if (x) { \
+		char *e = sdb_encode ((const ut8 *)(x), -1); \
+		r_strbuf_appendf (sb, "%s" tok ",%s", r_strbuf_length (sb)? ",": "", e? e: ""); \
+		free (e); \
+	}
+	if (hint->immbase) {
+		HINT_NUM ("immbase:", hint->immbase);
+	}
+	if (hint->jump != UT64_MAX) {
+		HINT_NUM ("jump:", hint->jump);
+	}
+	if (hint->fail != UT64_MAX) {
+		HINT_NUM ("fail:", hint->fail);
+	}
+	if (hint->ptr) {
+		HINT_NUM ("ptr:", hint->ptr);
+	}
+	if (hint->nword) {
+		HINT_NUM ("nword:", hint->nword);
+	}
+	if (hint->ret != UT64_MAX) {
+		HINT_NUM ("ret:", hint->ret);
+	}
+	if (hint->bits) {
+		HINT_NUM ("bits:", hint->bits);
+	}
+	if (hint->new_bits) {
+		HINT_NUM ("Bits:", hint->new_bits);
+	}
+	if (hint->size) {
+		HINT_NUM ("size:", hint->size);
+	}
+	if (hint->type) {
+		HINT_NUM ("type:", hint->type);
+	}
+	if (hint->high) {
+		HINT_NUM ("high:", 1);
+	}
+	HINT_STR ("Syntax:", hint->syntax);
+	HINT_STR ("opcode:", hint->opcode);
+	HINT_STR ("Offset:", hint->offset);
+	HINT_STR ("esil:", hint->esil);
+	HINT_STR ("arch:", hint->arch);
+#undef HINT_NUM
+#undef HINT_STR
+	return r_strbuf_drain (sb);
+}
+
 R_API RAnalHint *r_anal_hint_from_string(RAnal *a, ut64 addr, const char *str) {
 	char *r, *nxt, *nxt2;
 	int token = 0;
@@ -280,9 +448,36 @@ R_API RAnalHint *r_anal_hint_from_string(RAnal *a, ut64 addr, const char *str) {
 	return hint;
 }
 
+// borrowed reference owned by the anal, valid until the hint is modified
+R_API RAnalHint *r_anal_hint_at(RAnal *a, ut64 from) {
+	HintNode *node = hint_node_get (a, from);
+	return node? &node->hint: NULL;
+}
+
 R_API RAnalHint *r_anal_hint_get(RAnal *a, ut64 addr) {
-	char key[64];
-	setf (key, "hint.0x%08"PFMT64x, addr);
-	const char *s = sdb_const_get (DB, key, 0);
-	return s? r_anal_hint_from_string (a, addr, s): NULL;
+	RAnalHint *h = r_anal_hint_at (a, addr);
+	if (!h) {
+		return NULL;
+	}
+	RAnalHint *hint = R_NEW (RAnalHint);
+	if (!hint) {
+		return NULL;
+	}
+	*hint = *h;
+	hint->arch = h->arch? strdup (h->arch): NULL;
+	hint->opcode = h->opcode? strdup (h->opcode): NULL;
+	hint->syntax = h->syntax? strdup (h->syntax): NULL;
+	hint->esil = h->esil? strdup (h->esil): NULL;
+	hint->offset = h->offset? strdup (h->offset): NULL;
+	return hint;
+}
+
+R_API void r_anal_hint_foreach(RAnal *a, RAnalHintCb cb, void *user) {
+	RBIter it;
+	HintNode *node;
+	r_rbtree_foreach (a->hints, it, node, HintNode, rb) {
+		if (!cb (user, &node->hint)) {
+			break;
+		}
+	}
 }
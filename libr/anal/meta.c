@@ -19,71 +19,129 @@ Keys:
   'meta.<type>.count=<int>'     number of added metas where 'type' is a single char
   'meta.<type>.<last>=<array>'  splitted array, each block contains K elements
   'meta.<type>.<addr>=<string>' string representing extra information of the meta type at given address
-  'range.<baddr>=<array>'       store valid addresses in a base range array
 #endif
 
 #include <r_anal.h>
 #include <r_core.h>
 #include <r_util.h>
 
-#define META_RANGE_BASE(x) ((x)>>5)
 #undef DB
 #define DB a->sdb_meta
 
-static char *meta_inrange_get (RAnal *a, ut64 addr, int size) {
-	if (size <= 0) {
-		return NULL;
+// every meta item is also indexed by its [from, to) interval in an
+// augmented rbtree keyed by (from, type), max_to is the largest end
+// address in the subtree so range queries can skip whole branches
+typedef struct {
+	ut64 from;
+	ut64 to;
+	ut64 max_to;
+	int type;
+	RBNode rb;
+} MetaRange;
+
+typedef bool (*MetaRangeCb)(MetaRange *r, void *user);
+
+static int meta_range_cmp(const void *incoming, const RBNode *in_tree) {
+	const MetaRange *a = incoming;
+	const MetaRange *b = container_of (in_tree, const MetaRange, rb);
+	if (a->from != b->from) {
+		return a->from < b->from? -1: 1;
 	}
-	ut64 base = META_RANGE_BASE (addr);
-	ut64 base2 = META_RANGE_BASE (addr + size - 1);
-	char *res = NULL;
-	// return string array of all the offsets where there are stuff
-	for (; base <= base2; base++) {
-		const char *key = sdb_fmt ("range.0x%"PFMT64x, base);
-		// char *r = sdb_array_get (DB, key, 0, 0);
-		char *r = sdb_get (DB, key, 0);
-		if (r) {
-			if (res) {
-				res = r_str_append (res, ",");
+	return a->type - b->type;
+}
+
+static void meta_range_sum(RBNode *node) {
+	MetaRange *r = container_of (node, MetaRange, rb);
+	int i;
+	r->max_to = r->to;
+	for (i = 0; i < 2; i++) {
+		if (node->child[i]) {
+			MetaRange *c = container_of (node->child[i], MetaRange, rb);
+			if (c->max_to > r->max_to) {
+				r->max_to = c->max_to;
 			}
-			res = r_str_append (res, r);
-			free (r);
 		}
 	}
-	return res;
 }
 
-static bool meta_inrange_add (RAnal *a, ut64 addr, int size) {
-	if (size <= 0) {
-		return false;
+static void meta_range_free(RBNode *node) {
+	free (container_of (node, MetaRange, rb));
+}
+
+static void meta_range_set(RAnal *a, int type, ut64 from, ut64 size) {
+	if (!size) {
+		return;
 	}
-	bool set = false;
-	ut64 base, base2;
-	base = META_RANGE_BASE (addr);
-	base2 = META_RANGE_BASE (addr + size - 1);
-	for (; base <= base2; base++) {
-		const char *key = sdb_fmt ("range.0x%"PFMT64x, base);
-		if (sdb_array_add_num (DB, key, addr, 0)) {
-			set = true;
+	MetaRange k = { .from = from, .type = type };
+	ut64 to = from + size < from? UT64_MAX: from + size;
+	RBNode *node = r_rbtree_find (a->meta_ranges, &k, meta_range_cmp);
+	if (node) {
+		MetaRange *r = container_of (node, MetaRange, rb);
+		if (r->to != to) {
+			r->to = to;
+			r_rbtree_aug_update_sum (a->meta_ranges, &k, node, meta_range_cmp, meta_range_sum);
 		}
+		return;
+	}
+	MetaRange *r = R_NEW0 (MetaRange);
+	if (r) {
+		r->from = from;
+		r->to = to;
+		r->max_to = to;
+		r->type = type;
+		r_rbtree_aug_insert (&a->meta_ranges, r, &r->rb, meta_range_cmp, meta_range_sum);
 	}
-	return set;
 }
 
-static bool meta_inrange_del (RAnal *a, ut64 addr, int size) {
-	if (size <= 0) {
-		return false;
+static void meta_range_del(RAnal *a, int type, ut64 from) {
+	MetaRange k = { .from = from, .type = type };
+	r_rbtree_aug_delete (&a->meta_ranges, &k, meta_range_cmp, meta_range_free, meta_range_sum);
+}
+
+// visit the ranges intersecting [from, to), the ones starting last come first
+static bool meta_range_foreach(RBNode *node, ut64 from, ut64 to, MetaRangeCb cb, void *user) {
+	if (!node) {
+		return true;
 	}
-	bool set = false;
-	ut64 base = META_RANGE_BASE (addr);
-	ut64 base2 = META_RANGE_BASE (addr + size - 1);
-	for (; base <= base2; base++) {
-		const char *key = sdb_fmt ("range.0x%"PFMT64x, base);
-		if (sdb_array_remove_num (DB, key, addr, 0)) {
-			set = true;
+	MetaRange *r = container_of (node, MetaRange, rb);
+	if (r->max_to <= from) {
+		return true;
+	}
+	if (r->from < to) {
+		if (!meta_range_foreach (node->child[1], from, to, cb, user)) {
+			return false;
+		}
+		if (r->to > from && !cb (r, user)) {
+			return false;
+		}
+	}
+	return meta_range_foreach (node->child[0], from, to, cb, user);
+}
+
+static bool collect_range(MetaRange *r, void *user) {
+	MetaRange k = { .from = r->from, .type = r->type };
+	r_vector_push (user, &k);
+	return true;
+}
+
+static void meta_range_del_at(RAnal *a, ut64 from) {
+	RVector *v = r_vector_new (sizeof (MetaRange), NULL, NULL);
+	MetaRange *r;
+	if (!v) {
+		return;
+	}
+	meta_range_foreach (a->meta_ranges, from, from + 1, collect_range, v);
+	r_vector_foreach (v, r) {
+		if (r->from == from) {
+			meta_range_del (a, r->type, r->from);
 		}
 	}
-	return set;
+	r_vector_free (v);
+}
+
+R_API void r_meta_free(RAnal *a) {
+	r_rbtree_free (a->meta_ranges, meta_range_free);
+	a->meta_ranges = NULL;
 }
 
 // 512 = 1.5s
@@ -118,7 +176,7 @@ R_API int r_meta_set_string(RAnal *a, int type, ut64 addr, const char *s) {
 	size = sdb_array_get_num (DB, key, 0, 0);
 	if (!size) {
 		size = strlen (s);
-		meta_inrange_add (a, addr, size);
+		meta_range_set (a, type, addr, size);
 		ret = true;
 	} else {
 		ret = false;
@@ -155,7 +213,7 @@ R_API int r_meta_set_var_comment(RAnal *a, int type, ut64 idx, ut64 addr, const
 	size = sdb_array_get_num (DB, key, 0, 0);
 	if (!size) {
 		size = strlen (s);
-		meta_inrange_add (a, addr, size);
+		meta_range_set (a, type, addr, size);
 		ret = true;
 	} else {
 		ret = false;
@@ -230,6 +288,7 @@ R_API int r_meta_del(RAnal *a, int type, ut64 addr, ut64 size) {
 		// XXX: this thing ignores the type
 		if (type == R_META_TYPE_ANY) {
 			sdb_reset (DB);
+			r_meta_free (a);
 		} else {
 			snprintf (key, sizeof (key)-1, "meta.%c.count", type);
 			int last = (ut64)sdb_num_get (DB, key, NULL)/K;
@@ -238,10 +297,11 @@ R_API int r_meta_del(RAnal *a, int type, ut64 addr, ut64 size) {
 				dtr = sdb_get (DB, key, 0);
 				for (p = dtr; p; p = next) {
 					s = sdb_anext (p, &next);
+					ut64 at = sdb_atoi (s);
 					snprintf (key, sizeof (key)-1,
-						"meta.%c.0x%"PFMT64x,
-						type, sdb_atoi (s));
+						"meta.%c.0x%"PFMT64x, type, at);
 					sdb_unset (DB, key, 0);
+					meta_range_del (a, type, at);
 					if (!next) {
 						break;
 					}
@@ -261,7 +321,11 @@ R_API int r_meta_del(RAnal *a, int type, ut64 addr, ut64 size) {
 	} else {
 		snprintf (key, sizeof (key)-1, "meta.0x%"PFMT64x, addr);
 	}
-	meta_inrange_del (a, addr, size);
+	if (type == R_META_TYPE_ANY) {
+		meta_range_del_at (a, addr);
+	} else {
+		meta_range_del (a, type, addr);
+	}
 	val = sdb_const_get (DB, key, 0);
 	if (val) {
 		if (type == R_META_TYPE_ANY) {
@@ -308,6 +372,56 @@ R_API int r_meta_cleanup(RAnal *a, ut64 from, ut64 to) {
 	return r_meta_del (a, R_META_TYPE_ANY, from, (to-from));
 }
 
+typedef struct {
+	int type;
+	RVector items; // MetaRange copies, the tree changes while deleting
+} MetaDel;
+
+static bool collect_del(MetaRange *r, void *user) {
+	MetaDel *md = user;
+	if (md->type == R_META_TYPE_ANY || md->type == r->type) {
+		r_vector_push (&md->items, r);
+	}
+	return true;
+}
+
+// delete the items of the given type overlapping [from, to)
+R_API int r_meta_del_range(RAnal *a, int type, ut64 from, ut64 to) {
+	MetaDel md = { type };
+	MetaRange *r;
+	int n;
+	if (from >= to) {
+		return 0;
+	}
+	r_vector_init (&md.items, sizeof (MetaRange), NULL, NULL);
+	meta_range_foreach (a->meta_ranges, from, to, collect_del, &md);
+	n = md.items.len;
+	r_vector_foreach (&md.items, r) {
+		r_meta_del (a, r->type, r->from, 1);
+	}
+	r_vector_clear (&md.items);
+	return n;
+}
+
+typedef struct {
+	int type;
+	int count;
+} MetaCount;
+
+static bool count_range(MetaRange *r, void *user) {
+	MetaCount *mc = user;
+	if (mc->type == R_META_TYPE_ANY || mc->type == r->type) {
+		mc->count++;
+	}
+	return true;
+}
+
+R_API int r_meta_count(RAnal *a, int type, ut64 from, ut64 to) {
+	MetaCount mc = { type, 0 };
+	meta_range_foreach (a->meta_ranges, from, to, count_range, &mc);
+	return mc.count;
+}
+
 static void r_meta_item_fini(RAnalMetaItem *item) {
 	free (item->str);
 }
@@ -418,7 +532,7 @@ static int meta_add(RAnal *a, int type, int subtype, ut64 from, ut64 to, const c
 	val[0] = type;
 	val[1] = '\0';
 	sdb_array_add (DB, key, val, 0);
-	meta_inrange_add (a, from, to - from);
+	meta_range_set (a, type, from, to - from);
 	return true;
 }
 
@@ -477,25 +591,36 @@ R_API RAnalMetaItem *r_meta_find_any_except(RAnal *a, ut64 at, int type, int whe
 	return r_meta_find_ (a, at, R_META_TYPE_ANY, where, type);
 }
 
-R_API RAnalMetaItem *r_meta_find_in(RAnal *a, ut64 at, int type, int where) {
-	char *res = meta_inrange_get (a, at, 1);
-	if (!res) {
-		return NULL;
-	}
-	RList *list = r_str_split_list (res, ",");
-	RListIter *iter;
-	const char *meta;
-	r_list_foreach (list, iter, meta) {
-		ut64 mia = r_num_math (NULL, meta);
-		RAnalMetaItem *mi = r_meta_find (a, mia, type, where);
-		if (mi && (at >= mi->from && at < mi->to)) {
-			free (res);
-			return mi;
-		}
+typedef struct {
+	RAnal *anal;
+	ut64 at;
+	int type;
+	int where;
+	RAnalMetaItem *mi;
+} MetaFindIn;
+
+static bool find_in_cb(MetaRange *r, void *user) {
+	MetaFindIn *fi = user;
+	if (fi->type != R_META_TYPE_ANY && fi->type != r->type) {
+		return true;
+	}
+	// prefer whatever r_meta_find returns for that address, but do not
+	// miss an item of another type covering it
+	RAnalMetaItem *mi = r_meta_find (fi->anal, r->from, fi->type, fi->where);
+	if (!mi || fi->at < mi->from || fi->at >= mi->to) {
+		mi = r_meta_find (fi->anal, r->from, r->type, fi->where);
+	}
+	if (mi && (fi->at >= mi->from && fi->at < mi->to)) {
+		fi->mi = mi;
+		return false;
 	}
-	r_list_free (list);
-	free (res);
-	return NULL;
+	return true;
+}
+
+R_API RAnalMetaItem *r_meta_find_in(RAnal *a, ut64 at, int type, int where) {
+	MetaFindIn fi = { a, at, type, where, NULL };
+	meta_range_foreach (a->meta_ranges, at, at + 1, find_in_cb, &fi);
+	return fi.mi;
 }
 
 R_API const char *r_meta_type_to_string(int type) {
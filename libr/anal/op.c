@@ -171,10 +171,9 @@ R_API int r_anal_op(RAnal *anal, RAnalOp *op, ut64 addr, const ut8 *data, int le
 		}
 	}
 	if (mask & R_ANAL_OP_MASK_HINT) {
-		RAnalHint *hint = r_anal_hint_get (anal, addr);
+		RAnalHint *hint = r_anal_hint_at (anal, addr);
 		if (hint) {
 			r_anal_op_hint (op, hint);
-			r_anal_hint_free (hint);
 		}
 	}
 	return ret;
@@ -24,6 +24,36 @@ xrefs
 // XXX: is it possible to have multiple type for the same (from, to) pair?
 //      if it is, things need to be adjusted
 
+/* Every address keeps its references in a flat array of edges. The
+ * first 'sorted' edges are ordered by address, the rest are recent
+ * insertions that get merged in once there are too many of them or
+ * when the array is read. The addresses are spread over shards, each
+ * one with its own table and lock, so writers on different shards do
+ * not contend. */
+#define XREFS_SHARDS 16
+#define XREFS_TAIL_MIN 16
+
+typedef struct {
+	ut64 addr;
+	RAnalRefType type;
+} XrefsEdge;
+
+typedef struct {
+	XrefsEdge *edges;
+	ut32 count;
+	ut32 sorted;
+	ut32 size;
+} XrefsAdj;
+
+typedef struct {
+	HtUP *ht; // addr -> XrefsAdj
+	RThreadLock *lock;
+} XrefsShard;
+
+struct r_anal_xrefs_t {
+	XrefsShard shards[XREFS_SHARDS];
+};
+
 static RAnalRef *r_anal_ref_new(ut64 addr, ut64 at, ut64 type) {
 	RAnalRef *ref = R_NEW (RAnalRef);
 	if (ref) {
@@ -42,17 +72,181 @@ R_API RList *r_anal_ref_list_new() {
 	return r_list_newf (r_anal_ref_free);
 }
 
-static void xrefs_ht_free(HtUPKv *kv) {
-	ht_up_free (kv->value);
+static void xrefs_adj_free(HtUPKv *kv) {
+	XrefsAdj *adj = kv->value;
+	free (adj->edges);
+	free (adj);
+}
+
+static XrefsShard *xrefs_shard(RAnalXrefs *x, ut64 addr) {
+	return &x->shards[(addr * 0x9e3779b97f4a7c15ULL) >> 60];
+}
+
+static RAnalXrefs *xrefs_new(void) {
+	int i;
+	RAnalXrefs *x = R_NEW0 (RAnalXrefs);
+	if (!x) {
+		return NULL;
+	}
+	for (i = 0; i < XREFS_SHARDS; i++) {
+		x->shards[i].ht = ht_up_new (NULL, xrefs_adj_free, NULL);
+		x->shards[i].lock = r_th_lock_new (true);
+		if (!x->shards[i].ht || !x->shards[i].lock) {
+			break;
+		}
+	}
+	if (i < XREFS_SHARDS) {
+		for (; i >= 0; i--) {
+			ht_up_free (x->shards[i].ht);
+			r_th_lock_free (x->shards[i].lock);
+		}
+		free (x);
+		return NULL;
+	}
+	return x;
+}
+
+static void xrefs_free(RAnalXrefs *x) {
+	int i;
+	if (!x) {
+		return;
+	}
+	for (i = 0; i < XREFS_SHARDS; i++) {
+		ht_up_free (x->shards[i].ht);
+		r_th_lock_free (x->shards[i].lock);
+	}
+	free (x);
+}
+
+static int edge_cmp(const void *a, const void *b) {
+	const XrefsEdge *ea = a, *eb = b;
+	return (ea->addr > eb->addr) - (ea->addr < eb->addr);
+}
+
+static XrefsEdge *adj_find(XrefsAdj *adj, ut64 addr) {
+	ut32 lo = 0, hi = adj->sorted, i;
+	while (lo < hi) {
+		ut32 mid = lo + (hi - lo) / 2;
+		if (adj->edges[mid].addr < addr) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	if (lo < adj->sorted && adj->edges[lo].addr == addr) {
+		return &adj->edges[lo];
+	}
+	for (i = adj->sorted; i < adj->count; i++) {
+		if (adj->edges[i].addr == addr) {
+			return &adj->edges[i];
+		}
+	}
+	return NULL;
+}
+
+// merge the unsorted tail into the sorted part, there are no duplicates
+static void adj_merge(XrefsAdj *adj) {
+	ut32 n = adj->count - adj->sorted;
+	if (!n) {
+		return;
+	}
+	XrefsEdge *tail = adj->edges + adj->sorted;
+	qsort (tail, n, sizeof (XrefsEdge), edge_cmp);
+	if (adj->sorted && tail[0].addr < tail[-1].addr) {
+		XrefsEdge *tmp = malloc (n * sizeof (XrefsEdge));
+		if (!tmp) {
+			qsort (adj->edges, adj->count, sizeof (XrefsEdge), edge_cmp);
+			adj->sorted = adj->count;
+			return;
+		}
+		memcpy (tmp, tail, n * sizeof (XrefsEdge));
+		st64 i = (st64)adj->sorted - 1, j = (st64)n - 1, k = (st64)adj->count - 1;
+		while (j >= 0) {
+			if (i >= 0 && adj->edges[i].addr > tmp[j].addr) {
+				adj->edges[k--] = adj->edges[i--];
+			} else {
+				adj->edges[k--] = tmp[j--];
+			}
+		}
+		free (tmp);
+	}
+	adj->sorted = adj->count;
+}
+
+static void setxref(RAnalXrefs *x, ut64 from, ut64 to, int type) {
+	XrefsShard *shard = xrefs_shard (x, from);
+	bool found;
+	if (type == -1) {
+		type = R_ANAL_REF_TYPE_CODE;
+	}
+	r_th_lock_enter (shard->lock);
+	XrefsAdj *adj = ht_up_find (shard->ht, from, &found);
+	if (!found) {
+		adj = R_NEW0 (XrefsAdj);
+		if (!adj || !ht_up_insert (shard->ht, from, adj)) {
+			free (adj);
+			r_th_lock_leave (shard->lock);
+			return;
+		}
+	}
+	XrefsEdge *e = adj_find (adj, to);
+	if (e) {
+		e->type = type;
+	} else {
+		if (adj->count == adj->size) {
+			ut32 size = adj->size? adj->size * 2: 1;
+			XrefsEdge *edges = realloc (adj->edges, size * sizeof (XrefsEdge));
+			if (!edges) {
+				r_th_lock_leave (shard->lock);
+				return;
+			}
+			adj->edges = edges;
+			adj->size = size;
+		}
+		e = &adj->edges[adj->count++];
+		e->addr = to;
+		e->type = type;
+		// keep the linear part of the lookups short
+		if (adj->count - adj->sorted > R_MAX (XREFS_TAIL_MIN, adj->sorted >> 6)) {
+			adj_merge (adj);
+		}
+	}
+	r_th_lock_leave (shard->lock);
 }
 
-static void xrefs_ref_free(HtUPKv *kv) {
-	r_anal_ref_free (kv->value);
+static void delxrefs(RAnalXrefs *x, ut64 addr) {
+	XrefsShard *shard = xrefs_shard (x, addr);
+	r_th_lock_enter (shard->lock);
+	ht_up_delete (shard->ht, addr);
+	r_th_lock_leave (shard->lock);
 }
 
-static bool appendRef(void *u, const ut64 k, const void *v) {
+/* visit the references of addr sorted by address without copying them,
+ * the callback must not add or remove references */
+static bool foreachref(RAnalXrefs *x, ut64 addr, RAnalRefCb cb, void *user) {
+	XrefsShard *shard = xrefs_shard (x, addr);
+	RAnalRef ref;
+	ut32 i;
+	bool found;
+	r_th_lock_enter (shard->lock);
+	XrefsAdj *adj = ht_up_find (shard->ht, addr, &found);
+	if (found) {
+		adj_merge (adj);
+		ref.at = addr;
+		for (i = 0; i < adj->count; i++) {
+			ref.addr = adj->edges[i].addr;
+			ref.type = adj->edges[i].type;
+			if (!cb (user, &ref)) {
+				break;
+			}
+		}
+	}
+	r_th_lock_leave (shard->lock);
+	return found;
+}
+
+static bool appendRef(void *u, const RAnalRef *ref) {
 	RList *list = (RList *)u;
-	RAnalRef *ref = (RAnalRef *)v;
 	RAnalRef *cloned = r_anal_ref_new (ref->addr, ref->at, ref->type);
 	if (cloned) {
 		r_list_append (list, cloned);
@@ -61,12 +255,38 @@ static bool appendRef(void *u, const ut64 k, const void *v) {
 	return false;
 }
 
-static bool mylistrefs_cb(void *list, const ut64 k, const void *v) {
-	HtUP *ht = (HtUP *)v;
-	ht_up_foreach (ht, appendRef, list);
+static bool appendKey(void *u, const ut64 k, const void *v) {
+	r_vector_push ((RVector *)u, (void *)&k);
 	return true;
 }
 
+static int key_cmp(const void *a, const void *b) {
+	ut64 ka = *(const ut64 *)a, kb = *(const ut64 *)b;
+	return (ka > kb) - (ka < kb);
+}
+
+// visit all the references sorted by (at, addr)
+static void foreachrefs(RAnalXrefs *x, RAnalRefCb cb, void *user) {
+	RVector *keys = r_vector_new (sizeof (ut64), NULL, NULL);
+	ut64 *k;
+	int i;
+	if (!keys) {
+		return;
+	}
+	for (i = 0; i < XREFS_SHARDS; i++) {
+		r_th_lock_enter (x->shards[i].lock);
+		ht_up_foreach (x->shards[i].ht, appendKey, keys);
+		r_th_lock_leave (x->shards[i].lock);
+	}
+	if (keys->len) {
+		qsort (keys->a, keys->len, sizeof (ut64), key_cmp);
+	}
+	r_vector_foreach (keys, k) {
+		foreachref (x, *k, cb, user);
+	}
+	r_vector_free (keys);
+}
+
 static int ref_cmp(const RAnalRef *a, const RAnalRef *b) {
 	if (a->at < b->at) {
 		return -1;
@@ -83,34 +303,16 @@ static int ref_cmp(const RAnalRef *a, const RAnalRef *b) {
 	return 0;
 }
 
-static void listxrefs(HtUP *m, ut64 addr, RList *list) {
+static void listxrefs(RAnalXrefs *x, ut64 addr, RList *list) {
+	// the references come out sorted, only mixing them needs a sort
+	bool sort = !r_list_empty (list);
 	if (addr == UT64_MAX) {
-		ht_up_foreach (m, mylistrefs_cb, list);
+		foreachrefs (x, appendRef, list);
 	} else {
-		bool found;
-		HtUP *d = ht_up_find (m, addr, &found);
-		if (!found) {
-			return;
-		}
-
-		ht_up_foreach (d, appendRef, list);
-	}
-	r_list_sort (list, (RListComparator)ref_cmp);
-}
-
-static void setxref(HtUP *m, ut64 from, ut64 to, int type) {
-	bool found;
-	HtUP *ht = ht_up_find (m, from, &found);
-	if (!found) {
-		ht = ht_up_new (NULL, xrefs_ref_free, NULL);
-		if (!ht) {
-			return;
-		}
-		ht_up_insert (m, from, ht);
+		foreachref (x, addr, appendRef, list);
 	}
-	RAnalRef *ref = r_anal_ref_new (to, from, type);
-	if (ref) {
-		ht_up_update (ht, to, ref);
+	if (sort) {
+		r_list_sort (list, (RListComparator)ref_cmp);
 	}
 }
 
@@ -134,8 +336,8 @@ R_API int r_anal_xrefs_deln(RAnal *anal, ut64 from, ut64 to, const RAnalRefType
 	if (!anal) {
 		return false;
 	}
-	ht_up_delete (anal->dict_refs, from);
-	ht_up_delete (anal->dict_xrefs, to);
+	delxrefs (anal->dict_refs, from);
+	delxrefs (anal->dict_xrefs, to);
 	return true;
 }
 
@@ -154,6 +356,26 @@ R_API int r_anal_xrefs_from(RAnal *anal, RList *list, const char *kind, const RA
 	return true;
 }
 
+// visit the references to TO without allocating them, UT64_MAX visits all of them
+R_API bool r_anal_xrefs_foreach(RAnal *anal, ut64 to, RAnalRefCb cb, void *user) {
+	r_return_val_if_fail (anal && cb, false);
+	if (to == UT64_MAX) {
+		foreachrefs (anal->dict_xrefs, cb, user);
+		return true;
+	}
+	return foreachref (anal->dict_xrefs, to, cb, user);
+}
+
+// visit the references from FROM without allocating them, UT64_MAX visits all of them
+R_API bool r_anal_refs_foreach(RAnal *anal, ut64 from, RAnalRefCb cb, void *user) {
+	r_return_val_if_fail (anal && cb, false);
+	if (from == UT64_MAX) {
+		foreachrefs (anal->dict_refs, cb, user);
+		return true;
+	}
+	return foreachref (anal->dict_refs, from, cb, user);
+}
+
 R_API RList *r_anal_xrefs_get(RAnal *anal, ut64 to) {
 	RList *list = r_anal_ref_list_new ();
 	if (!list) {
@@ -193,78 +415,84 @@ R_API RList *r_anal_xrefs_get_from(RAnal *anal, ut64 to) {
 	return list;
 }
 
-R_API void r_anal_xrefs_list(RAnal *anal, int rad) {
-	bool is_first = true;
-	RListIter *iter;
-	RAnalRef *ref;
-	RList *list = r_anal_ref_list_new();
-	listxrefs (anal->dict_refs, UT64_MAX, list);
-	if (rad == 'j') {
-		anal->cb_printf ("[");
-	}
-	r_list_foreach (list, iter, ref) {
-		int t = ref->type ? ref->type: ' ';
-		switch (rad) {
-		case '*':
-			anal->cb_printf ("ax%c 0x%"PFMT64x" 0x%"PFMT64x"\n", t, ref->addr, ref->at);
-			break;
-		case '\0':
-			{
-				char *name = anal->coreb.getNameDelta (anal->coreb.core, ref->at);
-				if (name) {
-					r_str_replace_ch (name, ' ', 0, true);
-					anal->cb_printf ("%40s", name);
-					free (name);
-				} else {
-					anal->cb_printf ("%40s", "?");
-				}
-				anal->cb_printf (" 0x%"PFMT64x" -> %9s -> 0x%"PFMT64x, ref->at, r_anal_xrefs_type_tostring (t), ref->addr);
-				name = anal->coreb.getNameDelta (anal->coreb.core, ref->addr);
-				if (name) {
-					r_str_replace_ch (name, ' ', 0, true);
-					anal->cb_printf (" %s\n", name);
-					free (name);
-				} else {
-					anal->cb_printf ("\n");
-				}
+typedef struct {
+	RAnal *anal;
+	int rad;
+	bool is_first;
+} XrefsListCtx;
+
+static bool printref(void *user, const RAnalRef *ref) {
+	XrefsListCtx *ctx = user;
+	RAnal *anal = ctx->anal;
+	int t = ref->type ? ref->type: ' ';
+	switch (ctx->rad) {
+	case '*':
+		anal->cb_printf ("ax%c 0x%"PFMT64x" 0x%"PFMT64x"\n", t, ref->addr, ref->at);
+		break;
+	case '\0':
+		{
+			char *name = anal->coreb.getNameDelta (anal->coreb.core, ref->at);
+			if (name) {
+				r_str_replace_ch (name, ' ', 0, true);
+				anal->cb_printf ("%40s", name);
+				free (name);
+			} else {
+				anal->cb_printf ("%40s", "?");
 			}
-			break;
-		case 'q':
-			anal->cb_printf ("0x%08"PFMT64x" -> 0x%08"PFMT64x"  %s\n", ref->at, ref->addr, r_anal_xrefs_type_tostring (t));
-			break;
-		case 'j':
-			{
-				if (is_first) {
-					is_first = false;
-				} else {
-					anal->cb_printf (",");
-				}
-				anal->cb_printf ("{");
-				char *name = anal->coreb.getNameDelta (anal->coreb.core, ref->at);
-				if (name) {
-					r_str_replace_ch (name, ' ', 0, true);
-					anal->cb_printf ("\"name\":\"%s\",", name);
-					free (name);
-				}
-				anal->cb_printf ("\"from\":%"PFMT64u",\"type\":\"%s\",\"addr\":%"PFMT64u,
-					ref->at, r_anal_xrefs_type_tostring (t), ref->addr);
-				name = anal->coreb.getNameDelta (anal->coreb.core, ref->addr);
-				if (name) {
-					r_str_replace_ch (name, ' ', 0, true);
-					anal->cb_printf (",\"refname\":\"%s\"", name);
-					free (name);
-				}
-				anal->cb_printf ("}");
+			anal->cb_printf (" 0x%"PFMT64x" -> %9s -> 0x%"PFMT64x, ref->at, r_anal_xrefs_type_tostring (t), ref->addr);
+			name = anal->coreb.getNameDelta (anal->coreb.core, ref->addr);
+			if (name) {
+				r_str_replace_ch (name, ' ', 0, true);
+				anal->cb_printf (" %s\n", name);
+				free (name);
+			} else {
+				anal->cb_printf ("\n");
 			}
-			break;
-		default:
-			break;
 		}
+		break;
+	case 'q':
+		anal->cb_printf ("0x%08"PFMT64x" -> 0x%08"PFMT64x"  %s\n", ref->at, ref->addr, r_anal_xrefs_type_tostring (t));
+		break;
+	case 'j':
+		{
+			if (ctx->is_first) {
+				ctx->is_first = false;
+			} else {
+				anal->cb_printf (",");
+			}
+			anal->cb_printf ("{");
+			char *name = anal->coreb.getNameDelta (anal->coreb.core, ref->at);
+			if (name) {
+				r_str_replace_ch (name, ' ', 0, true);
+				anal->cb_printf ("\"name\":\"%s\",", name);
+				free (name);
+			}
+			anal->cb_printf ("\"from\":%"PFMT64u",\"type\":\"%s\",\"addr\":%"PFMT64u,
+				ref->at, r_anal_xrefs_type_tostring (t), ref->addr);
+			name = anal->coreb.getNameDelta (anal->coreb.core, ref->addr);
+			if (name) {
+				r_str_replace_ch (name, ' ', 0, true);
+				anal->cb_printf (",\"refname\":\"%s\"", name);
+				free (name);
+			}
+			anal->cb_printf ("}");
+		}
+		break;
+	default:
+		break;
+	}
+	return true;
+}
+
+R_API void r_anal_xrefs_list(RAnal *anal, int rad) {
+	XrefsListCtx ctx = { anal, rad, true };
+	if (rad == 'j') {
+		anal->cb_printf ("[");
 	}
+	r_anal_refs_foreach (anal, UT64_MAX, printref, &ctx);
 	if (rad == 'j') {
 		anal->cb_printf ("]\n");
 	}
-	r_list_free (list);
 }
 
 R_API const char *r_anal_xrefs_type_tostring(RAnalRefType type) {
@@ -297,32 +525,32 @@ R_API RAnalRefType r_anal_xrefs_type(char ch) {
 }
 
 R_API bool r_anal_xrefs_init(RAnal *anal) {
-	ht_up_free (anal->dict_refs);
-	anal->dict_refs = NULL;
-	ht_up_free (anal->dict_xrefs);
-	anal->dict_xrefs = NULL;
-
-	HtUP *tmp = ht_up_new (NULL, xrefs_ht_free, NULL);
-	if (!tmp) {
+	r_anal_xrefs_fini (anal);
+	anal->dict_refs = xrefs_new ();
+	anal->dict_xrefs = xrefs_new ();
+	if (!anal->dict_refs || !anal->dict_xrefs) {
+		r_anal_xrefs_fini (anal);
 		return false;
 	}
-	anal->dict_refs = tmp;
-
-	tmp = ht_up_new (NULL, xrefs_ht_free, NULL);
-	if (!tmp) {
-		ht_up_free (anal->dict_refs);
-		anal->dict_refs = NULL;
-		return false;
-	}
-	anal->dict_xrefs = tmp;
 	return true;
 }
 
+R_API void r_anal_xrefs_fini(RAnal *anal) {
+	xrefs_free (anal->dict_refs);
+	anal->dict_refs = NULL;
+	xrefs_free (anal->dict_xrefs);
+	anal->dict_xrefs = NULL;
+}
+
 R_API int r_anal_xrefs_count(RAnal *anal) {
-	return anal->dict_xrefs->count;
+	int i, count = 0;
+	for (i = 0; i < XREFS_SHARDS; i++) {
+		count += anal->dict_xrefs->shards[i].ht->count;
+	}
+	return count;
 }
 
-static RList *fcn_get_refs(RAnalFunction *fcn, HtUP *ht) {
+static RList *fcn_get_refs(RAnalFunction *fcn, RAnalXrefs *x) {
 	RListIter *iter;
 	RAnalBlock *bb;
 	RList *list = r_anal_ref_list_new ();
@@ -335,12 +563,61 @@ static RList *fcn_get_refs(RAnalFunction *fcn, HtUP *ht) {
 
 		for (i = 0; i < bb->ninstr; ++i) {
 			ut64 at = bb->addr + r_anal_bb_offset_inst (bb, i);
-			listxrefs (ht, at, list);
+			foreachref (x, at, appendRef, list);
 		}
 	}
+	r_list_sort (list, (RListComparator)ref_cmp);
 	return list;
 }
 
+typedef struct {
+	RAnalRefCb cb;
+	void *user;
+	bool stop;
+} FcnRefsCtx;
+
+static bool fcn_ref_cb(void *u, const RAnalRef *ref) {
+	FcnRefsCtx *ctx = (FcnRefsCtx *)u;
+	return !(ctx->stop = !ctx->cb (ctx->user, ref));
+}
+
+// visit the references from the instructions of FCN sorted by (at, addr),
+// an instruction shared by several blocks is visited once
+R_API bool r_anal_fcn_refs_foreach(RAnal *anal, RAnalFunction *fcn, RAnalRefCb cb, void *user) {
+	r_return_val_if_fail (anal && fcn && cb, false);
+	FcnRefsCtx ctx = { cb, user, false };
+	RListIter *iter;
+	RAnalBlock *bb;
+	RVector ats;
+	ut64 *at, last = UT64_MAX;
+	size_t j;
+	r_vector_init (&ats, sizeof (ut64), NULL, NULL);
+	r_list_foreach (fcn->bbs, iter, bb) {
+		int i;
+		for (i = 0; i < bb->ninstr; i++) {
+			ut64 a = bb->addr + r_anal_bb_offset_inst (bb, i);
+			if (!r_vector_push (&ats, &a)) {
+				r_vector_clear (&ats);
+				return false;
+			}
+		}
+	}
+	if (ats.len) {
+		qsort (ats.a, ats.len, sizeof (ut64), key_cmp);
+	}
+	for (j = 0, at = ats.a; j < ats.len; j++, at++) {
+		if (*at != last) {
+			foreachref (anal->dict_refs, *at, fcn_ref_cb, &ctx);
+			if (ctx.stop) {
+				break;
+			}
+			last = *at;
+		}
+	}
+	r_vector_clear (&ats);
+	return true;
+}
+
 R_API RList *r_anal_fcn_get_refs(RAnal *anal, RAnalFunction *fcn) {
 	r_return_val_if_fail (anal && fcn, NULL);
 	return fcn_get_refs (fcn, anal->dict_refs);
@@ -7,6 +7,10 @@
 // maybe too big sometimes? 2KB of stack eaten here..
 #define R_STRING_SCAN_BUFFER_SIZE 2048
 #define R_STRING_MAX_UNI_BLOCKS 4
+// strings are scanned in windows of this size, any string starting inside
+// one ends before this many bytes past its end
+#define R_STRING_SCAN_WINDOW (8 * 1024 * 1024)
+#define R_STRING_SCAN_OVERLAP (8 * R_STRING_SCAN_BUFFER_SIZE)
 
 static RBinString *find_string_at(RBinFile *bf, RList *ret, ut64 addr) {
 	if (addr != 0 && addr != UT64_MAX) {
@@ -79,46 +83,70 @@ static void print_string(RBinFile *bf, RBinString *string, int raw) {
 	}
 }
 
-static int string_scan_range(RList *list, RBinFile *bf, int min,
-			      const ut64 from, const ut64 to, int type, int raw) {
-	ut8 tmp[R_STRING_SCAN_BUFFER_SIZE];
-	ut64 str_start, needle = from;
-	int count = 0, i, rc, runes;
-	int str_type = R_STRING_TYPE_DETECT;
-
-	// if list is null it means its gonna dump
-	r_return_val_if_fail (bf, -1);
-
-	if (type == -1) {
-		type = R_STRING_TYPE_DETECT;
+typedef struct {
+	ut64 from; // the scan starts here and stops at the first string head past 'to'
+	ut64 to;
+	ut64 lim; // end of the readable bytes, the strings crossing 'to' end before it
+	ut64 base; // address of buf[0], a few bytes before 'from' for the BOM check
+	const ut8 *buf;
+	ut8 *data; // private copy of the window when bf->buf can't be read in place
+	const ut8 *ascii; // ascii bytes that make a rune, NULL if the type is fixed
+	int min;
+	int type;
+	ut64 needle;
+	RList *strings;
+	ut8 heads[R_STRING_SCAN_OVERLAP / 8]; // string heads visited near 'from'
+} StringScan;
+
+// true when the type detection takes the ascii byte at p as the head of
+// a plain ascii string
+static inline bool is_ascii_head(const ut8 *p) {
+	if (p[0] >= 0x80) {
+		return false;
 	}
-	if (from >= to) {
-		eprintf ("Invalid range to find strings 0x%"PFMT64x" .. 0x%"PFMT64x"\n", from, to);
-		return -1;
+	if (p[1]) {
+		return true;
 	}
-	int len = to - from;
-	ut8 *buf = calloc (len, 1);
-	if (!buf || !min) {
-		free (buf);
-		return -1;
+	if (p[2]) {
+		return p[3] != 0; // utf16
 	}
-	st64 vdelta = 0;
-	if (bf->o) {
-		RBinSection *s = r_bin_get_section_at (bf->o, from, false);
-		if (s) {
-			vdelta = s->vaddr - from;
+	return p[3] || !p[4] || p[5]; // utf32
+}
+
+static void string_scan_window(StringScan *ss, ut64 needle) {
+	ut8 tmp[R_STRING_SCAN_BUFFER_SIZE];
+	const ut8 *buf = ss->buf - ss->base;
+	const ut64 to = ss->lim;
+	int i, rc, runes;
+	int type = ss->type;
+	int str_type = R_STRING_TYPE_DETECT;
+	ut64 str_start;
+
+	memset (ss->heads, 0, sizeof (ss->heads));
+	while (needle < ss->to) {
+		if (needle - ss->from < R_STRING_SCAN_OVERLAP) {
+			ut64 h = needle - ss->from;
+			ss->heads[h / 8] |= 1 << (h % 8);
 		}
-	}
-	r_buf_read_at (bf->buf, from, buf, len);
-	// may oobread
-	while (needle < to) {
-		rc = r_utf8_decode (buf + needle - from, to - needle, NULL);
+		// ascii runs too short to be kept are skipped without decoding
+		if (ss->ascii && needle + ss->min + 6 < to && is_ascii_head (buf + needle)) {
+			const ut8 *p = buf + needle;
+			int k = 0;
+			while (k < ss->min && ss->ascii[p[k]]) {
+				k++;
+			}
+			if (k < ss->min && (p[k] < 0x80 || !r_utf8_decode (p + k, to - needle - k, NULL))) {
+				needle += k + 1;
+				continue;
+			}
+		}
+		rc = r_utf8_decode (buf + needle, to - needle, NULL);
 		if (!rc) {
 			needle++;
 			continue;
 		}
 		if (type == R_STRING_TYPE_DETECT) {
-			char *w = (char *)buf + needle + rc - from;
+			char *w = (char *)buf + needle + rc;
 			if ((to - needle) > 5 + rc) {
 				bool is_wide32 = (needle + rc + 2 < to) && (!w[0] && !w[1] && !w[2] && w[3] && !w[4]);
 				if (is_wide32) {
@@ -141,17 +169,17 @@ static int string_scan_range(RList *list, RBinFile *bf, int min,
 			RRune r = {0};
 
 			if (str_type == R_STRING_TYPE_WIDE32) {
-				rc = r_utf32le_decode (buf + needle - from, to - needle, &r);
+				rc = r_utf32le_decode (buf + needle, to - needle, &r);
 				if (rc) {
 					rc = 4;
 				}
 			} else if (str_type == R_STRING_TYPE_WIDE) {
-				rc = r_utf16le_decode (buf + needle - from, to - needle, &r);
+				rc = r_utf16le_decode (buf + needle, to - needle, &r);
 				if (rc == 1) {
 					rc = 2;
 				}
 			} else {
-				rc = r_utf8_decode (buf + needle - from, to - needle, &r);
+				rc = r_utf8_decode (buf + needle, to - needle, &r);
 				if (rc > 1) {
 					str_type = R_STRING_TYPE_UTF8;
 				}
@@ -195,7 +223,7 @@ static int string_scan_range(RList *list, RBinFile *bf, int min,
 
 		tmp[i++] = '\0';
 
-		if (runes >= min) {
+		if (runes >= ss->min) {
 			// reduce false positives
 			int j, num_blocks, *block_list;
 			if (str_type == R_STRING_TYPE_ASCII) {
@@ -231,41 +259,173 @@ static int string_scan_range(RList *list, RBinFile *bf, int min,
 			bs->type = str_type;
 			bs->length = runes;
 			bs->size = needle - str_start;
-			bs->ordinal = count++;
-			// TODO: move into adjust_offset
-			switch (str_type) {
-			case R_STRING_TYPE_WIDE:
-				if (str_start - from > 1) {
-					const ut8 *p = buf + str_start - 2 - from;
-					if (p[0] == 0xff && p[1] == 0xfe) {
-						str_start -= 2; // \xff\xfe
-					}
-				}
-				break;
-			case R_STRING_TYPE_WIDE32:
-				if (str_start - from > 3) {
-					const ut8 *p = buf + str_start - 4 - from;
-					if (p[0] == 0xff && p[1] == 0xfe) {
-						str_start -= 4; // \xff\xfe\x00\x00
-					}
-				}
-				break;
-			}
+			// the merge moves it back over the BOM once it knows the string is kept
 			bs->paddr = str_start;
-			bs->vaddr = str_start + vdelta;
 			bs->string = r_str_ndup ((const char *)tmp, i);
-			if (list) {
-				r_list_append (list, bs);
-				if (bf->o) {
-					ht_up_insert (bf->o->strings_db, bs->vaddr, bs);
+			r_list_append (ss->strings, bs);
+		}
+	}
+	ss->needle = needle;
+}
+
+static RThreadFunctionRet string_scan_th(RThread *th) {
+	StringScan *ss = th->user;
+	string_scan_window (ss, ss->from);
+	return R_TH_STOP;
+}
+
+static bool string_scan_head(StringScan *ss, ut64 needle) {
+	ut64 h = needle - ss->from;
+	return h < R_STRING_SCAN_OVERLAP && (ss->heads[h / 8] & (1 << (h % 8)));
+}
+
+// append the strings of a window found after 'needle', where the previous
+// window stopped, in the order the whole range would have produced them
+static int string_scan_merge(StringScan *ss, RList *list, RBinFile *bf, int raw, ut64 needle, ut64 from, st64 vdelta, int count) {
+	RListIter *iter;
+	RBinString *bs;
+
+	if (needle > ss->from && !string_scan_head (ss, needle)) {
+		// the window started inside a string and never fell in step with
+		// the previous one, scan it again from where that one ended
+		r_list_purge (ss->strings);
+		string_scan_window (ss, needle);
+	}
+	r_list_foreach (ss->strings, iter, bs) {
+		if (bs->paddr < needle) {
+			continue;
+		}
+		ut64 str_start = bs->paddr;
+		switch (bs->type) {
+		case R_STRING_TYPE_WIDE:
+			if (str_start - from > 1) {
+				const ut8 *p = ss->buf + str_start - 2 - ss->base;
+				if (p[0] == 0xff && p[1] == 0xfe) {
+					str_start -= 2; // \xff\xfe
 				}
+			}
+			break;
+		case R_STRING_TYPE_WIDE32:
+			if (str_start - from > 3) {
+				const ut8 *p = ss->buf + str_start - 4 - ss->base;
+				if (p[0] == 0xff && p[1] == 0xfe) {
+					str_start -= 4; // \xff\xfe\x00\x00
+				}
+			}
+			break;
+		}
+		bs->paddr = str_start;
+		bs->vaddr = str_start + vdelta;
+		bs->ordinal = count++;
+		iter->data = NULL;
+		if (list) {
+			r_list_append (list, bs);
+			if (bf->o) {
+				ht_up_insert (bf->o->strings_db, bs->vaddr, bs);
+			}
+		} else {
+			print_string (bf, bs, raw);
+			r_bin_string_free (bs);
+		}
+	}
+	return count;
+}
+
+// scan the range in bounded windows, one thread per window and cpu, the
+// windows are read in place when the whole file is already in memory
+static int string_scan_range(RList *list, RBinFile *bf, int min,
+			      const ut64 from, const ut64 to, int type, int raw) {
+	ut8 ascii[256] = {0};
+	int count = 0, i, n;
+
+	// if list is null it means its gonna dump
+	r_return_val_if_fail (bf, -1);
+
+	if (type == -1) {
+		type = R_STRING_TYPE_DETECT;
+	}
+	if (from >= to) {
+		eprintf ("Invalid range to find strings 0x%"PFMT64x" .. 0x%"PFMT64x"\n", from, to);
+		return -1;
+	}
+	if (!min) {
+		return -1;
+	}
+	st64 vdelta = 0;
+	if (bf->o) {
+		RBinSection *s = r_bin_get_section_at (bf->o, from, false);
+		if (s) {
+			vdelta = s->vaddr - from;
+		}
+	}
+	RBuffer *b = bf->buf;
+	const ut8 *mem = NULL;
+	if (!b->iob && b->fd == -1 && !b->empty && !b->base && r_buf_buffer (b) && to <= r_buf_size (b)) {
+		mem = r_buf_buffer (b) + b->offset;
+	}
+	for (i = 1; i < 0x80; i++) {
+		ascii[i] = (r_isprint (i) && i != '\\') || strchr ("\b\v\f\n\r\t\a\033\\", i);
+	}
+	int ntasks = R_MAX (1, r_th_ncpus ());
+	StringScan *ss = calloc (ntasks, sizeof (StringScan));
+	RThread **th = calloc (ntasks, sizeof (RThread *));
+	if (!ss || !th) {
+		free (ss);
+		free (th);
+		return -1;
+	}
+	ut64 at = from, needle = from;
+	while (at < to && count >= 0) {
+		// read the next batch of windows before any thread touches them
+		for (n = 0; n < ntasks && at < to; n++) {
+			StringScan *s = &ss[n];
+			s->from = at;
+			s->to = R_MIN (to, at + R_STRING_SCAN_WINDOW);
+			s->lim = R_MIN (to, s->to + R_STRING_SCAN_OVERLAP);
+			s->base = R_MAX (from, at - R_MIN (at, 4));
+			s->ascii = type == R_STRING_TYPE_DETECT? ascii: NULL;
+			s->min = min;
+			s->type = type;
+			s->strings = r_list_newf ((RListFree)r_bin_string_free);
+			if (mem) {
+				s->buf = mem + s->base;
+			} else if ((s->data = calloc (s->lim - s->base, 1))) {
+				r_buf_read_at (b, s->base, s->data, s->lim - s->base);
+				s->buf = s->data;
+			}
+			if (!s->strings || !s->buf) {
+				count = -1;
+			}
+			at = s->to;
+		}
+		if (count >= 0) {
+			if (n == 1) {
+				string_scan_window (&ss[0], ss[0].from);
 			} else {
-				print_string (bf, bs, raw);
-				r_bin_string_free (bs);
+				for (i = 0; i < n; i++) {
+					th[i] = r_th_new (string_scan_th, &ss[i], 0);
+					if (!th[i]) {
+						string_scan_window (&ss[i], ss[i].from);
+					}
+				}
+				for (i = 0; i < n; i++) {
+					r_th_wait (th[i]);
+					r_th_free (th[i]);
+				}
 			}
+			for (i = 0; i < n; i++) {
+				count = string_scan_merge (&ss[i], list, bf, raw, needle, from, vdelta, count);
+				needle = ss[i].needle;
+			}
+		}
+		for (i = 0; i < n; i++) {
+			r_list_free (ss[i].strings);
+			R_FREE (ss[i].data);
+			ss[i].buf = NULL;
 		}
 	}
-	free (buf);
+	free (ss);
+	free (th);
 	return count;
 }
 
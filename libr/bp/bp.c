@@ -5,6 +5,8 @@
 
 R_LIB_VERSION (r_bp);
 
+#define BP_CONTAINER(x) container_of ((RBNode*)(x), RBreakpointItem, rb)
+
 static struct r_bp_plugin_t *bp_static_plugins[] =
 	{ R_BP_STATIC_PLUGINS };
 
@@ -31,6 +33,7 @@ R_API RBreakpoint *r_bp_new() {
 	bp->traces = r_bp_traptrace_new ();
 	bp->cb_printf = (PrintfCallback)printf;
 	bp->bps = r_list_newf ((RListFree)r_bp_item_free);
+	bp->bps_at = ht_up_new0 ();
 	bp->plugins = r_list_newf ((RListFree)free);
 	bp->nhwbps = 0;
 	for (i = 0; bp_static_plugins[i]; i++) {
@@ -45,6 +48,7 @@ R_API RBreakpoint *r_bp_new() {
 
 R_API RBreakpoint *r_bp_free(RBreakpoint *bp) {
 	r_list_free (bp->bps);
+	ht_up_free (bp->bps_at);
 	r_list_free (bp->plugins);
 	r_list_free (bp->traces);
 	free (bp->bps_idx);
@@ -88,17 +92,6 @@ repeat:
 	return 0;
 }
 
-R_API RBreakpointItem *r_bp_get_at(RBreakpoint *bp, ut64 addr) {
-	RListIter *iter;
-	RBreakpointItem *b;
-	r_list_foreach(bp->bps, iter, b) {
-		if (b->addr == addr) {
-			return b;
-		}
-	}
-	return NULL;
-}
-
 static inline bool inRange(RBreakpointItem *b, ut64 addr) {
 	return (addr >= b->addr && addr < (b->addr + b->size));
 }
@@ -107,17 +100,89 @@ static inline bool matchProt(RBreakpointItem *b, int perm) {
 	return (!perm || (perm && b->perm));
 }
 
-R_API RBreakpointItem *r_bp_get_in(RBreakpoint *bp, ut64 addr, int perm) {
-	RBreakpointItem *b;
-	RListIter *iter;
-	r_list_foreach (bp->bps, iter, b) {
-		// eprintf ("---ataddr--- 0x%08"PFMT64x" %d %d %x\n", b->addr, b->size, b->recoil, b->perm);
-		// Check addr within range and provided perm matches (or null)
-		if (inRange (b, addr) && matchProt (b, perm)) {
-			return b;
+// _bp_tree_{cmp_addr,calc_max_addr} are used by the interval tree, the bps
+// starting at the same address are ordered by when they were linked
+static int _bp_tree_cmp_addr(const void *a_, const RBNode *b_) {
+	const RBreakpointItem *a = (const RBreakpointItem *)a_;
+	const RBreakpointItem *b = BP_CONTAINER (b_);
+	if (a->addr != b->addr) {
+		return a->addr < b->addr ? -1 : 1;
+	}
+	if (a->seq != b->seq) {
+		return a->seq < b->seq ? -1 : 1;
+	}
+	return 0;
+}
+
+static void _bp_tree_calc_max_addr(RBNode *node) {
+	int i;
+	RBreakpointItem *b = BP_CONTAINER (node);
+	b->rb_max_addr = b->addr + (b->size < 1 ? 0 : b->size - 1);
+	for (i = 0; i < 2; i++) {
+		if (node->child[i]) {
+			RBreakpointItem *b1 = BP_CONTAINER (node->child[i]);
+			if (b1->rb_max_addr > b->rb_max_addr) {
+				b->rb_max_addr = b1->rb_max_addr;
+			}
 		}
 	}
-	return NULL;
+}
+
+// the bp containing addr with a matching perm that was linked first
+static void _bp_tree_first_in(RBNode *n, ut64 addr, int perm, RBreakpointItem **found) {
+	while (n) {
+		RBreakpointItem *b = BP_CONTAINER (n);
+		if (b->rb_max_addr < addr) {
+			break;
+		}
+		_bp_tree_first_in (n->child[0], addr, perm, found);
+		if (b->addr > addr) {
+			break;
+		}
+		if (inRange (b, addr) && matchProt (b, perm) && (!*found || b->seq < (*found)->seq)) {
+			*found = b;
+		}
+		n = n->child[1];
+	}
+}
+
+// first bp linked at addr in the tree, the seq 0 key sorts before all of them
+static RBreakpointItem *first_at(RBreakpoint *bp, ut64 addr) {
+	RBreakpointItem key = { .addr = addr };
+	RBNode *n = r_rbtree_lower_bound (bp->bps_tree, &key, _bp_tree_cmp_addr);
+	return n && BP_CONTAINER (n)->addr == addr? BP_CONTAINER (n): NULL;
+}
+
+static void indexBreakpoint(RBreakpoint *bp, RBreakpointItem *b) {
+	r_rbtree_aug_insert (&bp->bps_tree, b, &b->rb, _bp_tree_cmp_addr, _bp_tree_calc_max_addr);
+	// keeps the bp already there, it was added before
+	ht_up_insert (bp->bps_at, b->addr, b);
+}
+
+static void unindexBreakpoint(RBreakpoint *bp, RBreakpointItem *b) {
+	if (!r_rbtree_aug_delete (&bp->bps_tree, b, _bp_tree_cmp_addr, NULL, _bp_tree_calc_max_addr)) {
+		return;
+	}
+	if (ht_up_find (bp->bps_at, b->addr, NULL) == b) {
+		RBreakpointItem *next = first_at (bp, b->addr);
+		if (next) {
+			ht_up_update (bp->bps_at, b->addr, next);
+		} else {
+			ht_up_delete (bp->bps_at, b->addr);
+		}
+	}
+}
+
+R_API RBreakpointItem *r_bp_get_at(RBreakpoint *bp, ut64 addr) {
+	return ht_up_find (bp->bps_at, addr, NULL);
+}
+
+R_API RBreakpointItem *r_bp_get_in(RBreakpoint *bp, ut64 addr, int perm) {
+	RBreakpointItem *found = NULL;
+	// Check addr within range and provided perm matches (or null),
+	// with overlapping bps the first one that was added wins
+	_bp_tree_first_in (bp->bps_tree, addr, perm, &found);
+	return found;
 }
 
 R_API RBreakpointItem *r_bp_enable(RBreakpoint *bp, ut64 addr, int set, int count) {
@@ -145,15 +210,37 @@ R_API int r_bp_stepy_continuation(RBreakpoint *bp) {
 }
 
 static void unlinkBreakpoint(RBreakpoint *bp, RBreakpointItem *b) {
-	int i;
-	for (i = 0; i < bp->bps_idx_count; i++) {
-		if (bp->bps_idx[i] == b) {
-			bp->bps_idx[i] = NULL;
+	int i = b->idx;
+	if (i >= 0 && i < bp->bps_idx_count && bp->bps_idx[i] == b) {
+		bp->bps_idx[i] = NULL;
+		if (i < bp->bps_idx_free) {
+			bp->bps_idx_free = i;
 		}
 	}
+	unindexBreakpoint (bp, b);
 	r_list_delete_data (bp->bps, b);
 }
 
+/* add an item returned by r_bp_item_new to the list, once its address and
+ * size are set */
+R_API void r_bp_item_link(RBreakpoint *bp, RBreakpointItem *b) {
+	bp->nbps++;
+	b->seq = ++bp->bps_seq;
+	r_list_append (bp->bps, b);
+	indexBreakpoint (bp, b);
+}
+
+/* change the address of a breakpoint keeping it indexed */
+R_API void r_bp_move(RBreakpoint *bp, RBreakpointItem *b, ut64 addr) {
+	if (b->addr == addr) {
+		return;
+	}
+	unindexBreakpoint (bp, b);
+	b->addr = addr;
+	indexBreakpoint (bp, b);
+	ht_up_update (bp->bps_at, addr, first_at (bp, addr));
+}
+
 /* TODO: detect overlapping of breakpoints */
 static RBreakpointItem *r_bp_add(RBreakpoint *bp, const ut8 *obytes, ut64 addr, int size, int hw, int perm) {
 	int ret;
@@ -166,6 +253,9 @@ static RBreakpointItem *r_bp_add(RBreakpoint *bp, const ut8 *obytes, ut64 addr,
 		return NULL;
 	}
 	b = r_bp_item_new (bp);
+	if (!b) {
+		return NULL;
+	}
 	b->addr = addr + bp->delta;
 	b->size = size;
 	b->enabled = true;
@@ -196,8 +286,7 @@ static RBreakpointItem *r_bp_add(RBreakpoint *bp, const ut8 *obytes, ut64 addr,
 		}
 		b->recoil = ret;
 	}
-	bp->nbps++;
-	r_list_append (bp->bps, b);
+	r_bp_item_link (bp, b);
 	return b;
 }
 
@@ -231,21 +320,21 @@ R_API RBreakpointItem* r_bp_add_hw(RBreakpoint *bp, ut64 addr, int size, int per
 R_API int r_bp_del_all(RBreakpoint *bp) {
 	if (!r_list_empty (bp->bps)) {
 		r_list_purge (bp->bps);
+		bp->bps_tree = NULL;
+		ht_up_free (bp->bps_at);
+		bp->bps_at = ht_up_new0 ();
+		memset (bp->bps_idx, 0, bp->bps_idx_count * sizeof (RBreakpointItem*));
+		bp->bps_idx_free = 0;
 		return true;
 	}
 	return false;
 }
 
 R_API int r_bp_del(RBreakpoint *bp, ut64 addr) {
-	RListIter *iter;
-	RBreakpointItem *b;
-	/* No _safe loop necessary because we return immediately after the delete. */
-	r_list_foreach (bp->bps, iter, b) {
-		if (b->addr == addr) {
-			unlinkBreakpoint (bp, b);
-			// r_list_delete (bp->bps, iter);
-			return true;
-		}
+	RBreakpointItem *b = r_bp_get_at (bp, addr);
+	if (b) {
+		unlinkBreakpoint (bp, b);
+		return true;
 	}
 	return false;
 }
@@ -336,27 +425,33 @@ R_API int r_bp_list(RBreakpoint *bp, int rad) {
 }
 
 R_API RBreakpointItem *r_bp_item_new (RBreakpoint *bp) {
+	RBreakpointItem *b;
 	int i, j;
 	/* find empty slot */
-	for (i = 0; i < bp->bps_idx_count; i++) {
+	for (i = bp->bps_idx_free; i < bp->bps_idx_count; i++) {
 		if (!bp->bps_idx[i]) {
 			goto return_slot;
 		}
 	}
 	/* allocate new slot */
-	bp->bps_idx_count += 16; // alocate space for 16 more bps
-	RBreakpointItem **newbps = realloc (bp->bps_idx, bp->bps_idx_count * sizeof (RBreakpointItem*));
-	if (newbps) {
-		bp->bps_idx = newbps;
-	} else {
-		bp->bps_idx_count -= 16; // alocate space for 16 more bps
+	int grow = R_MAX (16, bp->bps_idx_count / 2); // at least 16 more bps
+	RBreakpointItem **newbps = realloc (bp->bps_idx, (bp->bps_idx_count + grow) * sizeof (RBreakpointItem*));
+	if (!newbps) {
+		return NULL;
 	}
+	bp->bps_idx = newbps;
+	bp->bps_idx_count += grow;
 	for (j = i; j < bp->bps_idx_count; j++) {
 		bp->bps_idx[j] = NULL;
 	}
 return_slot:
 	/* empty slot */
-	return (bp->bps_idx[i] = R_NEW0 (RBreakpointItem));
+	if (!(b = R_NEW0 (RBreakpointItem))) {
+		return NULL;
+	}
+	b->idx = i;
+	bp->bps_idx_free = i + 1;
+	return (bp->bps_idx[i] = b);
 }
 
 R_API RBreakpointItem *r_bp_get_index(RBreakpoint *bp, int idx) {
@@ -377,9 +472,8 @@ R_API int r_bp_get_index_at (RBreakpoint *bp, ut64 addr) {
 }
 
 R_API int r_bp_del_index(RBreakpoint *bp, int idx) {
-	if (idx >= 0 && idx < bp->bps_idx_count) {
-		r_list_delete_data (bp->bps, bp->bps_idx[idx]);
-		R_FREE (bp->bps_idx[idx]);
+	if (idx >= 0 && idx < bp->bps_idx_count && bp->bps_idx[idx]) {
+		unlinkBreakpoint (bp, bp->bps_idx[idx]);
 		return true;
 	}
 	return false;
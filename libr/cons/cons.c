@@ -162,6 +162,69 @@ static inline void r_cons_write(const char *obuf, int olen) {
 	}
 }
 
+static void cons_tee(const char *buf, int len) {
+	FILE *d = r_sandbox_fopen (I.teefile, "a+");
+	if (d) {
+		if (len != fwrite (buf, 1, len, d)) {
+			eprintf ("r_cons_flush: fwrite: error (%s)\n", I.teefile);
+		}
+		fclose (d);
+	} else {
+		eprintf ("Cannot write on '%s'\n", I.teefile);
+	}
+}
+
+static void cons_output(const char *buf, int len) {
+	if (I.cb_stream) {
+		if (len > 0) {
+			I.cb_stream (I.stream_user, buf, len);
+		}
+	} else {
+		r_cons_write (buf, len);
+	}
+}
+
+// the grep, html and highlight filters, the pager and the captured
+// command output need the whole buffer
+static bool cons_can_stream(void) {
+	RConsGrep *grep = &I.context->grep;
+	return !I.null && !I.noflush && !I.is_interactive && !I.filter && !I.is_html
+		&& !(I.highlight && *I.highlight)
+		&& !grep->str && !grep->nstrings && !grep->tokens_used && !grep->less && !grep->json
+		&& (!I.context->cons_stack || r_stack_is_empty (I.context->cons_stack));
+}
+
+// only whole lines are written, the current one and a trailing run of
+// newlines stay in the buffer for the disasm alignment and r_cons_chop
+static inline void cons_stream(void) {
+	if (I.stream > 0 && I.context->buffer_len >= I.stream && cons_can_stream ()) {
+		char *buf = I.context->buffer;
+		int len = I.context->buffer_len;
+		while (len > 0 && (buf[len - 1] == '\n' || IS_WHITESPACE (buf[len - 1]))) {
+			len--;
+		}
+		while (len > 0 && buf[len - 1] != '\n') {
+			len--;
+		}
+		if (len < 1) {
+			return;
+		}
+		if (I.teefile && *I.teefile) {
+			cons_tee (buf, len);
+		}
+		cons_output (buf, len);
+		I.context->buffer_len -= len;
+		memmove (buf, buf + len, I.context->buffer_len + 1);
+		I.lastline = buf;
+		CTX (streamed) += len;
+	}
+}
+
+R_API void r_cons_set_stream(RConsStreamCallback cb, void *user) {
+	I.cb_stream = cb;
+	I.stream_user = user;
+}
+
 R_API RColor r_cons_color_random(ut8 alpha) {
 	RColor rcolor = {0};
 	if (I.context->color > COLOR_MODE_16) {
@@ -637,6 +700,7 @@ R_API void r_cons_reset() {
 	I.lastline = I.context->buffer;
 	cons_grep_reset (&I.context->grep);
 	CTX (pageable) = true;
+	CTX (streamed) = 0;
 }
 
 R_API const char *r_cons_get_buffer() {
@@ -648,6 +712,11 @@ R_API int r_cons_get_buffer_len() {
 	return I.context->buffer_len;
 }
 
+// bytes of the current output already streamed out of the buffer
+R_API ut64 r_cons_get_streamed(void) {
+	return CTX (streamed);
+}
+
 R_API void r_cons_filter() {
 	/* grep */
 	if (I.filter || I.context->grep.nstrings > 0 || I.context->grep.tokens_used || I.context->grep.less || I.context->grep.json) {
@@ -781,7 +850,11 @@ R_API void r_cons_flush(void) {
 		r_cons_reset ();
 		return;
 	}
-	if (lastMatters () && !CTX (lastMode)) {
+	if (CTX (streamed)) {
+		// only the tail is left, it is not worth keeping
+		CTX (lastLength) = 0;
+		CTX (lastMode) = false;
+	} else if (lastMatters () && !CTX (lastMode)) {
 		// snapshot of the output
 		if (CTX (buffer_len) > CTX (lastLength)) {
 			free (CTX (lastOutput));
@@ -833,15 +906,7 @@ R_API void r_cons_flush(void) {
 		}
 	}
 	if (tee && *tee) {
-		FILE *d = r_sandbox_fopen (tee, "a+");
-		if (d) {
-			if (I.context->buffer_len != fwrite (I.context->buffer, 1, I.context->buffer_len, d)) {
-				eprintf ("r_cons_flush: fwrite: error (%s)\n", tee);
-			}
-			fclose (d);
-		} else {
-			eprintf ("Cannot write on '%s'\n", tee);
-		}
+		cons_tee (I.context->buffer, I.context->buffer_len);
 	}
 	r_cons_highlight (I.highlight);
 
@@ -867,10 +932,10 @@ R_API void r_cons_flush(void) {
 			r_cons_write (ptr, I.context->buffer + len - ptr);
 			r_cons_break_pop ();
 		} else {
-			r_cons_write (I.context->buffer, I.context->buffer_len);
+			cons_output (I.context->buffer, I.context->buffer_len);
 		}
 	} else {
-		r_cons_write (I.context->buffer, I.context->buffer_len);
+		cons_output (I.context->buffer, I.context->buffer_len);
 	}
 
 	r_cons_reset ();
@@ -1025,6 +1090,7 @@ club:
 		}
 		I.context->buffer_len += written;
 		I.context->buffer[I.context->buffer_len] = 0;
+		cons_stream ();
 	} else {
 		r_cons_strcat (format);
 	}
@@ -1070,6 +1136,7 @@ R_API int r_cons_memcat(const char *str, int len) {
 			memcpy (I.context->buffer + I.context->buffer_len, str, len);
 			I.context->buffer_len += len;
 			I.context->buffer[I.context->buffer_len] = 0;
+			cons_stream ();
 		}
 	}
 	if (I.flush) {
@@ -38,16 +38,41 @@ static void r_anal_emul_restore(RCore *core, RConfigHold *hc) {
 	r_config_hold_free (hc);
 }
 
-#define SDB_CONTAINS(i,s) sdb_array_contains (trace, sdb_fmt ("%d.reg.write", i), s, 0)
+#define TRACE_WRITES(i,s) r_anal_esil_trace_reg (trace, i, R_ANAL_ESIL_TRACE_REG_WRITE, s, NULL)
 
-static bool type_pos_hit(RAnal *anal, Sdb *trace, bool in_stack, int idx, int size, const char *place) {
+static bool type_pos_hit(RAnal *anal, RAnalEsilTrace *trace, bool in_stack, int idx, int size, const char *place) {
 	if (in_stack) {
 		const char *sp_name = r_reg_get_name (anal->reg, R_REG_NAME_SP);
 		ut64 sp = r_reg_getv (anal->reg, sp_name);
-		ut64 write_addr = sdb_num_get (trace, sdb_fmt ("%d.mem.write", idx), 0);
+		ut64 write_addr = 0;
+		r_anal_esil_trace_mem (trace, idx, R_ANAL_ESIL_TRACE_MEM_WRITE, &write_addr);
 		return (write_addr == sp + size);
 	}
-	return SDB_CONTAINS (idx, place);
+	return TRACE_WRITES (idx, place);
+}
+
+// comma separated names of the registers written by the step
+static const char *trace_dest(RAnalEsilTrace *trace, int idx, char *buf, int size) {
+	const char *names[32];
+	int i, len = 0, count = r_anal_esil_trace_regs (trace, idx, R_ANAL_ESIL_TRACE_REG_WRITE, names, 32);
+	if (!count) {
+		return NULL;
+	}
+	*buf = 0;
+	for (i = 0; i < count; i++) {
+		int n = strlen (names[i]) + (i? 1: 0);
+		if (len + n >= size) {
+			break;
+		}
+		snprintf (buf + len, size - len, "%s%s", i? ",": "", names[i]);
+		len += n;
+	}
+	return buf;
+}
+
+static ut64 trace_addr(RAnalEsilTrace *trace, int idx) {
+	const RAnalEsilTraceStep *step = r_anal_esil_trace_step (trace, idx);
+	return step? step->addr: 0;
 }
 
 static void var_rename(RAnal *anal, RAnalVar *v, const char *name, ut64 addr) {
@@ -164,12 +189,13 @@ static void get_src_regname(RCore *core, ut64 addr, char *regname, int size) {
 	r_anal_op_free (op);
 }
 
-static ut64 get_addr(Sdb *trace, const char *regname, int idx) {
+static ut64 get_addr(RAnalEsilTrace *trace, const char *regname, int idx) {
 	if (!regname || !*regname) {
 		return UT64_MAX;
 	}
-	const char *query = sdb_fmt ("%d.reg.read.%s", idx, regname);
-	return r_num_math (NULL, sdb_const_get (trace, query, 0));
+	ut64 val = 0;
+	r_anal_esil_trace_reg (trace, idx, R_ANAL_ESIL_TRACE_REG_READ, regname, &val);
+	return val;
 }
 
 static int cond_invert (int cond) {
@@ -288,15 +314,15 @@ static RList *parse_format(RCore *core, char *fmt) {
 
 static void type_match(RCore *core, ut64 addr, char *fcn_name, ut64 baddr, const char* cc,
 		int prev_idx, bool userfnc, ut64 caddr) {
-	Sdb *trace = core->anal->esil->db_trace;
+	RAnalEsilTrace *trace = core->anal->esil->trace;
 	Sdb *TDB = core->anal->sdb_types;
 	RAnal *anal = core->anal;
 	RList *types = NULL;
-	int idx = sdb_num_get (trace, "idx", 0);
+	int idx = core->anal->esil->trace_idx - 1;
 	bool verbose = r_config_get_i (core->config, "anal.types.verbose");
 	bool stack_rev = false, in_stack = false, format = false;
 
-	if (!fcn_name || !cc) {
+	if (!fcn_name || !cc || !trace) {
 		return;
 	}
 	int i, j, pos = 0, size = 0, max = r_type_func_args_count (TDB, fcn_name);
@@ -346,7 +372,7 @@ static void type_match(RCore *core, ut64 addr, char *fcn_name, ut64 baddr, const
 		bool res = false;
 		// Backtrace instruction from source sink to prev source sink
 		for (j = idx; j >= prev_idx; j--) {
-			ut64 instr_addr = sdb_num_get (trace, sdb_fmt ("%d.addr", j), 0);
+			ut64 instr_addr = trace_addr (trace, j);
 			if (instr_addr < baddr) {
 				break;
 			}
@@ -369,8 +395,7 @@ static void type_match(RCore *core, ut64 addr, char *fcn_name, ut64 baddr, const
 			} else {
 				key = sdb_fmt ("fcn.0x%08"PFMT64x".arg.%d", caddr, size);
 			}
-			const char *query = sdb_fmt ("%d.mem.read", j);
-			if (op->type == R_ANAL_OP_TYPE_MOV && sdb_const_get (trace, query, 0)) {
+			if (op->type == R_ANAL_OP_TYPE_MOV && r_anal_esil_trace_mem (trace, j, R_ANAL_ESIL_TRACE_MEM_READ, NULL)) {
 				memref = (!memref && var && (var->kind != R_ANAL_VAR_KIND_REG))? false: true;
 			}
 			// Match type from function param to instr
@@ -404,7 +429,7 @@ static void type_match(RCore *core, ut64 addr, char *fcn_name, ut64 baddr, const
 				}
 			}
 			// Type propagate by following source reg
-			if (!res && *regname && SDB_CONTAINS (j, regname)) {
+			if (!res && *regname && TRACE_WRITES (j, regname)) {
 				if (var) {
 					if (!userfnc) {
 						var_retype (anal, var, name, type, addr, memref, false);
@@ -471,9 +496,15 @@ R_API void r_core_anal_type_match(RCore *core, RAnalFunction *fcn) {
 		r_anal_emul_restore (core, hc);
 		return;
 	}
+	if (!anal->esil->trace) {
+		anal->esil->trace = r_anal_esil_trace_new (R_ANAL_ESIL_TRACE_MAX);
+	}
+	RAnalEsilTrace *trace = anal->esil->trace;
+	HtUP *loop_counts = ht_up_new0 ();
 	ut8 *buf = malloc (bsize);
-	if (!buf) {
+	if (!buf || !trace || !loop_counts) {
 		free (buf);
+		ht_up_free (loop_counts);
 		r_anal_emul_restore (core, hc);
 		return;
 	}
@@ -485,6 +516,7 @@ R_API void r_core_anal_type_match(RCore *core, RAnalFunction *fcn) {
 	char prev_type[256] = {0};
 	const char *prev_dest = NULL;
 	const char *ret_reg = NULL;
+	char prev_dest_buf[128], cur_dest_buf[128], ret_reg_buf[128];
 	const char *pc = r_reg_get_name (core->dbg->reg, R_REG_NAME_PC);
 	RRegItem *r = r_reg_get (core->dbg->reg, pc, -1);
 	r_cons_break_push (NULL, NULL);
@@ -513,20 +545,19 @@ R_API void r_core_anal_type_match(RCore *core, RAnalFunction *fcn) {
 				r_anal_op_fini (&aop);
 				continue;
 			}
-			int loop_count = sdb_num_get (anal->esil->db_trace, sdb_fmt ("0x%"PFMT64x".count", addr), 0);
+			int loop_count = (int)(size_t)ht_up_find (loop_counts, addr, NULL);
 			if (loop_count > LOOP_MAX || aop.type == R_ANAL_OP_TYPE_RET) {
 				r_anal_op_fini (&aop);
 				break;
 			}
-			sdb_num_set (anal->esil->db_trace, sdb_fmt ("0x%"PFMT64x".count", addr), loop_count + 1, 0);
+			ht_up_update (loop_counts, addr, (void *)(size_t)(loop_count + 1));
 			if (r_anal_op_nonlinear (aop.type)) {   // skip the instr
 				r_reg_set_value (core->dbg->reg, r, addr + ret);
 			} else {
 				r_core_esil_step (core, UT64_MAX, NULL, NULL);
 			}
 			bool userfnc = false;
-			Sdb *trace = anal->esil->db_trace;
-			cur_idx = sdb_num_get (trace, "idx", 0);
+			cur_idx = anal->esil->trace_idx - 1;
 			RAnalVar *var = aop.var;
 			RAnalOp *next_op = r_core_anal_op (core, addr + ret, R_ANAL_OP_MASK_BASIC);
 			ut32 type = aop.type & R_ANAL_OP_TYPE_MASK;
@@ -552,8 +583,7 @@ R_API void r_core_anal_type_match(RCore *core, RAnalFunction *fcn) {
 						resolved = false;
 					}
 					if (!strcmp (fcn_name, "__stack_chk_fail")) {
-						const char *query = sdb_fmt ("%d.addr", cur_idx - 1);
-						ut64 mov_addr = sdb_num_get (trace, query, 0);
+						ut64 mov_addr = trace_addr (trace, cur_idx - 1);
 						RAnalOp *mop = r_core_anal_op (core, mov_addr, R_ANAL_OP_MASK_BASIC);
 						if (mop && mop->var) {
 							ut32 type = mop->type & R_ANAL_OP_TYPE_MASK;
@@ -568,15 +598,14 @@ R_API void r_core_anal_type_match(RCore *core, RAnalFunction *fcn) {
 			} else if (!resolved && ret_type && ret_reg) {
 				// Forward propgation of function return type
 				char src[REG_SZ] = {0};
-				const char *query = sdb_fmt ("%d.reg.write", cur_idx);
-				const char *cur_dest = sdb_const_get (trace, query, 0);
+				const char *cur_dest = trace_dest (trace, cur_idx, cur_dest_buf, sizeof (cur_dest_buf));
 				get_src_regname (core, aop.addr, src, sizeof (src));
 				if (ret_reg && *src && strstr (ret_reg, src)) {
 					if (var && aop.direction == R_ANAL_OP_DIR_WRITE) {
 						var_retype (anal, var, NULL, ret_type, addr, false, false);
 						resolved = true;
 					} else if (type == R_ANAL_OP_TYPE_MOV) {
-						ret_reg = cur_dest;
+						ret_reg = cur_dest? strcpy (ret_reg_buf, cur_dest): NULL;
 					}
 				} else if (cur_dest) {
 					char *foo = r_str_new (cur_dest);
@@ -679,8 +708,7 @@ R_API void r_core_anal_type_match(RCore *core, RAnalFunction *fcn) {
 				if (var && str_flag) {
 					var_retype (anal, var, NULL, "const char *", addr, false, false);
 				}
-				const char *query = sdb_fmt ("%d.reg.write", cur_idx);
-				prev_dest = sdb_const_get (trace, query, 0);
+				prev_dest = trace_dest (trace, cur_idx, prev_dest_buf, sizeof (prev_dest_buf));
 				if (var) {
 					strncpy (prev_type, var->type, sizeof (prev_type) - 1);
 					prop = true;
@@ -754,5 +782,6 @@ out_function:
 	free (buf);
 	r_cons_break_pop();
 	r_anal_emul_restore (core, hc);
-	sdb_reset (anal->esil->db_trace);
+	ht_up_free (loop_counts);
+	r_anal_esil_trace_reset (trace);
 }
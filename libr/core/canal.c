@@ -657,7 +657,6 @@ static int core_anal_fcn(RCore *core, ut64 at, ut64 from, int reftype, int depth
 		return false;
 	}
 	int has_next = r_config_get_i (core->config, "anal.hasnext");
-	RAnalHint *hint = NULL;
 	ut8 *buf = NULL;
 	int i, nexti = 0;
 	ut64 *next = NULL;
@@ -672,7 +671,7 @@ static int core_anal_fcn(RCore *core, ut64 at, ut64 from, int reftype, int depth
 		return false;
 	}
 	fcn->cc = r_str_const (r_anal_cc_default (core->anal));
-	hint = r_anal_hint_get (core->anal, at);
+	RAnalHint *hint = r_anal_hint_at (core->anal, at);
 	if (hint && hint->bits == 16) {
 		// expand 16bit for function
 		fcn->bits = 16;
@@ -842,7 +841,6 @@ static int core_anal_fcn(RCore *core, ut64 at, ut64 from, int reftype, int depth
 		}
 		free (next);
 	}
-	r_anal_hint_free (hint);
 	return true;
 
 error:
@@ -882,7 +880,6 @@ error:
 			}
 		}
 	}
-	r_anal_hint_free (hint);
 	return false;
 }
 
@@ -932,7 +929,7 @@ err_op:
 	return NULL;
 }
 
-static void print_hint_h_format(RAnalHint* hint) {
+static void print_hint_h_format(const RAnalHint *hint) {
 	r_cons_printf (" 0x%08"PFMT64x" - 0x%08"PFMT64x" =>", hint->addr, hint->addr + hint->size);
 	HINTCMD (hint, arch, " arch='%s'", false);
 	HINTCMD (hint, bits, " bits=%d", false);
@@ -952,12 +949,14 @@ static void print_hint_h_format(RAnalHint* hint) {
 }
 
 // TODO: move this into anal/hint.c ?
-static int cb(void *p, const char *k, const char *v) {
+static bool cb(void *p, const RAnalHint *hint) {
 	HintListState *hls = p;
-	RAnalHint *hint = r_anal_hint_from_string (hls->a, sdb_atoi (k + 5), v);
+	char *s;
 	switch (hls->mode) {
 	case 's':
-		r_cons_printf ("%s=%s\n", k, v);
+		s = r_anal_hint_to_string (hint);
+		r_cons_printf ("hint.0x%08"PFMT64x"=%s\n", hint->addr, r_str_get (s));
+		free (s);
 		break;
 	case '*':
 		HINTCMD_ADDR (hint, arch, "aha %s");
@@ -992,8 +991,7 @@ static int cb(void *p, const char *k, const char *v) {
 		print_hint_h_format (hint);
 		break;
 	}
-	free (hint);
-	return 1;
+	return true;
 }
 
 R_API void r_core_anal_hint_print(RAnal* a, ut64 addr, int mode) {
@@ -1027,13 +1025,7 @@ R_API void r_core_anal_hint_list(RAnal *a, int mode) {
 	if (mode == 'j') {
 		r_cons_strcat ("[");
 	}
-	SdbList *ls = sdb_foreach_list (a->sdb_hints, true);
-	SdbListIter *lsi;
-	SdbKv *kv;
-	ls_foreach (ls, lsi, kv) {
-		cb (&hls, sdbkv_key (kv), sdbkv_value (kv));
-	}
-	ls_free (ls);
+	r_anal_hint_foreach (a, cb, &hls);
 	if (mode == 'j') {
 		r_cons_strcat ("]\n");
 	}
@@ -1912,18 +1904,38 @@ static int RAnalRef_cmp(const RAnalRef* ref1, const RAnalRef* ref2) {
 	return ref1->addr != ref2->addr;
 }
 
+// collect the calls to each callee once, in the order of the first one
+static bool push_call(void *user, const RAnalRef *ref) {
+	RVector *calls = (RVector *)user;
+	RAnalRef *c;
+	//  TODO: tail calll jumps are also calls
+	if (ref->type != R_ANAL_REF_TYPE_CALL) {
+		return true;
+	}
+	r_vector_foreach (calls, c) {
+		if (c->addr == ref->addr) {
+			return true;
+		}
+	}
+	return r_vector_push (calls, (void *)ref) != NULL;
+}
+
 R_API void r_core_anal_callgraph(RCore *core, ut64 addr, int fmt) {
 	const char *font = r_config_get (core->config, "graph.font");
 	int is_html = r_cons_singleton ()->is_html;
 	bool refgraph = r_config_get_i (core->config, "graph.refs");
 	int first, first2;
-	RListIter *iter, *iter2;
+	RListIter *iter;
 	int usenames = r_config_get_i (core->config, "graph.json.usenames");;
 	RAnalFunction *fcni;
 	RAnalRef *fcnr;
+	RVector *calls = r_vector_new (sizeof (RAnalRef), NULL, NULL);
 
 	ut64 from = r_config_get_i (core->config, "graph.from");
 	ut64 to = r_config_get_i (core->config, "graph.to");
+	if (!calls) {
+		return;
+	}
 
 	switch (fmt)
 	{
@@ -1983,18 +1995,10 @@ repeat:
 		if (addr != UT64_MAX && addr != fcni->addr) {
 			continue;
 		}
-		RList *refs = r_anal_fcn_get_refs (core->anal, fcni);
-		RList *calls = r_list_new ();
 		// TODO: maybe fcni->calls instead ?
-		r_list_foreach (refs, iter2, fcnr) {
-			//  TODO: tail calll jumps are also calls
-			if (fcnr->type == 'C' && r_list_find(calls, fcnr, (RListComparator)RAnalRef_cmp) == NULL) {
-				r_list_append (calls, fcnr);
-			}
-		}
-		if (r_list_empty(calls)) {
-			r_list_free (refs);
-			r_list_free (calls);
+		r_vector_clear (calls);
+		r_anal_fcn_refs_foreach (core->anal, fcni, push_call, calls);
+		if (!calls->len) {
 			continue;
 		}
 		switch (fmt) {
@@ -2036,7 +2040,7 @@ repeat:
 					fcni->name, fcni->addr);
 		}
 		first2 = 0;
-		r_list_foreach (calls, iter2, fcnr) {
+		r_vector_foreach (calls, fcnr) {
 			// TODO: display only code or data refs?
 			RFlagItem *flag = r_flag_get_i (core->flags, fcnr->addr);
 			char *fcnr_name = (flag && flag->name) ? flag->name : r_str_newf ("unk.0x%"PFMT64x, fcnr->addr);
@@ -2097,8 +2101,6 @@ repeat:
 			}
 			first2 = 1;
 		}
-		r_list_free (refs);
-		r_list_free (calls);
 		if (fmt == R_GRAPH_FORMAT_JSON) {
 			r_cons_printf ("]}");
 		}
@@ -2121,6 +2123,7 @@ repeat:
 		r_cons_printf ("}\n");
 		break;
 	}
+	r_vector_free (calls);
 }
 
 static void fcn_list_bbs(RAnalFunction *fcn) {
@@ -1921,6 +1921,9 @@ static int bin_symbols(RCore *r, int mode, ut64 laddr, int va, ut64 at, const ch
 	if (IS_MODE_NORMAL (mode)) {
 		r_cons_printf ("Num Paddr      Vaddr      Bind     Type Size Name\n");
 	}
+	// plain symbols are flagged at once after the loop
+	RFlagBulk *bulk = IS_MODE_SET (mode)? r_flag_bulk_new (r->flags): NULL;
+	int queued = 0;
 
 	r_list_foreach (symbols, iter, symbol) {
 		if (!symbol->name) {
@@ -1982,6 +1985,12 @@ static int bin_symbols(RCore *r, int mode, ut64 laddr, int va, ut64 at, const ch
 			}
 			/* If that's a Classed symbol (method or so) */
 			if (sn.classname) {
+				// the method may be linked to a plain symbol still queued
+				if (queued) {
+					r_flag_bulk_commit (bulk);
+					bulk = r_flag_bulk_new (r->flags);
+					queued = 0;
+				}
 				RFlagItem *fi = r_flag_get (r->flags, sn.methflag);
 				if (r->bin->prefix) {
 					char *prname = r_str_newf ("%s.%s", r->bin->prefix, sn.methflag);
@@ -2009,11 +2018,13 @@ static int bin_symbols(RCore *r, int mode, ut64 laddr, int va, ut64 at, const ch
 				char *fnp = (r->bin->prefix) ?
 					r_str_newf ("%s.%s", r->bin->prefix, fn):
 					strdup (fn);
-				RFlagItem *fi = r_flag_set (r->flags, fnp, addr, symbol->size);
-				if (fi) {
-					r_flag_item_set_realname (fi, n);
+				if (bulk && r_flag_bulk_add (bulk, fnp, n, addr, symbol->size)) {
+					queued++;
 				} else {
-					if (fn) {
+					RFlagItem *fi = r_flag_set (r->flags, fnp, addr, symbol->size);
+					if (fi) {
+						r_flag_item_set_realname (fi, n);
+					} else if (fn) {
 						eprintf ("[Warning] Can't find flag (%s)\n", fn);
 					}
 				}
@@ -2134,6 +2145,9 @@ static int bin_symbols(RCore *r, int mode, ut64 laddr, int va, ut64 at, const ch
 			break;
 		}
 	}
+	if (bulk) {
+		r_flag_bulk_commit (bulk);
+	}
 
 	//handle thumb and arm for entry point since they are not present in symbols
 	if (is_arm) {
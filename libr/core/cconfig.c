@@ -1751,6 +1751,13 @@ static int cb_ioautofd(void *user, void *data) {
 	return true;
 }
 
+static int cb_io_gzip_index(void *user, void *data) {
+	RCore *core = (RCore *) user;
+	RConfigNode *node = (RConfigNode *) data;
+	core->io->gzip_index = node->i_value;
+	return true;
+}
+
 static int cb_scr_color_grep(void *user, void *data) {
 	RCore *core = (RCore *) user;
 	RConfigNode *node = (RConfigNode *) data;
@@ -1871,6 +1878,12 @@ static int cb_scrflush(void *user, void *data) {
 	return true;
 }
 
+static int cb_scrstream(void *user, void *data) {
+	RConfigNode *node = (RConfigNode *) data;
+	r_cons_singleton ()->stream = R_MAX (node->i_value, 0);
+	return true;
+}
+
 static int cb_scrstrconv(void *user, void *data) {
 	RCore *core = (RCore*) user;
 	RConfigNode *node = (RConfigNode*) data;
@@ -2006,6 +2019,13 @@ static int cb_swstep(void *user, void *data) {
 	return true;
 }
 
+static int cb_dbg_softdirty(void *user, void *data) {
+	RCore *core = (RCore *) user;
+	RConfigNode *node = (RConfigNode *) data;
+	core->dbg->softdirty = node->i_value;
+	return true;
+}
+
 static int cb_consbreak(void *user, void *data) {
 	RCore *core = (RCore *) user;
 	RConfigNode *node = (RConfigNode *) data;
@@ -2976,6 +2996,7 @@ R_API int r_core_config_init(RCore *core) {
 	SETICB ("dbg.gdb.page_size", 4096, &cb_dbg_gdb_page_size, "Page size on gdb target (useful for QEMU)");
 	SETICB ("dbg.gdb.retries", 10, &cb_dbg_gdb_retries, "Number of retries before gdb packet read times out");
 	SETCB ("dbg.consbreak", "false", &cb_consbreak, "SIGINT handle for attached processes");
+	SETCB ("dbg.softdirty", "false", &cb_dbg_softdirty, "Snapshot diffs only read the pages with the soft-dirty bit (linux, experimental)");
 
 	r_config_set_getter (cfg, "dbg.swstep", (RConfigCallback)__dbg_swstep_getter);
 
@@ -3109,6 +3130,7 @@ R_API int r_core_config_init(RCore *core) {
 	SETPREF ("graph.json.usenames", "true", "Use names instead of addresses in Global Call Graph (agCj)");
 	SETI ("graph.edges", 2, "0=no edges, 1=simple edges, 2=avoid collisions");
 	SETI ("graph.layout", 0, "Graph layout (0=vertical, 1=horizontal)");
+	SETI ("graph.sweeps", 4096, "Max number of sweeps done to reduce the edge crossings of the graph layout");
 	SETI ("graph.linemode", 1, "Graph edges (0=diagonal, 1=square)");
 	SETPREF ("graph.font", "Courier", "Font for dot graphs");
 	SETPREF ("graph.offset", "false", "Show offsets in graphs");
@@ -3149,6 +3171,7 @@ R_API int r_core_config_init(RCore *core) {
 	SETICB ("scr.linesleep", 0, &cb_scrlinesleep, "Flush sleeping some ms in every line");
 	SETICB ("scr.pagesize", 1, &cb_scrpagesize, "Flush in pages when scr.linesleep is != 0");
 	SETCB ("scr.flush", "false", &cb_scrflush, "Force flush to console in realtime (breaks scripting)");
+	SETICB ("scr.stream", 0, &cb_scrstream, "Write the output of non interactive commands in chunks of this many bytes, unless grepped or filtered (0 = whole)");
 	/* TODO: rename to asm.color.ops ? */
 	SETPREF ("scr.zoneflags", "true", "Show zoneflags in visual mode before the title (see fz?)");
 	SETPREF ("scr.slow", "true", "Do slow stuff on visual mode like RFlag.get_at(true)");
@@ -3260,6 +3283,7 @@ R_API int r_core_config_init(RCore *core) {
 	SETCB ("io.va", "true", &cb_iova, "Use virtual address layout");
 	SETCB ("io.pava", "false", &cb_io_pava, "Use EXPERIMENTAL paddr -> vaddr address mode");
 	SETCB ("io.autofd", "true", &cb_ioautofd, "Change fd when opening a new file");
+	SETCB ("io.gzip.index", "false", &cb_io_gzip_index, "Save the index of gzip:// files next to them to reopen them faster");
 
 	/* file */
 	SETPREF ("file.desc", "", "User defined file description (used by projects)");
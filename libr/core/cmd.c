@@ -215,6 +215,7 @@ static const char *help_msg_k[] = {
 	"k", " anal/**", "list namespaces under anal",
 	"k", " anal/meta/meta.0x80404", "get value for meta.0x80404 key",
 	"kj", "", "List all namespaces and sdb databases in JSON format",
+	"kB", " [n]", "time n address keys in HtUP and show its bucket chains, truncating and folding the keys",
 	//"kl", " ha.sdb", "load keyvalue from ha.sdb",
 	//"ks", " ha.sdb", "save keyvalue to ha.sdb",
 	NULL,
@@ -1013,6 +1014,69 @@ R_API int sdbshell_history_down(RLine *line) {
 	return true;
 }
 
+static ut32 ht_hash_trunc(const ut64 k) {
+	return (ut32)k;
+}
+
+// address distributions of the tables keyed by address
+static ut64 kuery_bench_key(int dist, ut64 i, ut64 *seed) {
+	*seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+	switch (dist) {
+	case 0: // code
+		return 0x400000 + i * 16;
+	case 1: // pages of a mapping
+		return 0x7f0000000000ULL + i * 0x1000;
+	case 2: // kernel text
+		return 0xffffffff81000000ULL + i * 0x40;
+	case 3: // mapping bases sharing the lower 32 bits
+		return 0x7f0000000000ULL + (i << 32) + 0x1000;
+	default: // pointers into the heap, the stacks and the libraries
+		return ((*seed >> 33) & 1? 0x7ffc00000000ULL: 0x55d000000000ULL) + ((*seed >> 16) & 0xfffffff8);
+	}
+}
+
+/* insert n keys of each address distribution in a HtUP hashing them as
+ * they were (truncated to 32 bits) and as they are (folded), and show the
+ * lookup time and the histogram of the bucket chains */
+static void cmd_kuery_bench(RCore *core, const char *input) {
+	static const char *dists[] = { "code", "pages", "kernel", "low32", "mixed" };
+	HtUPOptions opt = { .hashfn = ht_hash_trunc, .elem_size = sizeof (HtUPKv) };
+	int n = *input? R_MAX (1, (int)r_num_math (core->num, input)): 100000;
+	int d, h, i, j;
+	for (d = 0; d < R_ARRAY_SIZE (dists); d++) {
+		for (h = 0; h < 2; h++) {
+			HtUP *ht = h? ht_up_new0 (): ht_up_new_opt (&opt);
+			ut32 hist[6] = {0}, used = 0, max = 0;
+			ut64 seed = 1, t;
+			if (!ht) {
+				return;
+			}
+			for (i = 0; i < n; i++) {
+				ht_up_insert (ht, kuery_bench_key (d, i, &seed), core);
+			}
+			seed = 1;
+			t = r_sys_now ();
+			for (i = 0; i < n; i++) {
+				ht_up_find (ht, kuery_bench_key (d, i, &seed), NULL);
+			}
+			t = r_sys_now () - t;
+			for (j = 0; j < ht->size; j++) {
+				ut32 c = ht->table[j].count;
+				if (c) {
+					used++;
+					max = R_MAX (max, c);
+					hist[c < 4? c - 1: c < 8? 3: c < 64? 4: 5]++;
+				}
+			}
+			r_cons_printf ("%-6s %-5s buckets %-6u chain %-6u 1:%u 2:%u 3:%u 4-7:%u 8-63:%u 64+:%u find %.3fus\n",
+				dists[d], h? "fold": "trunc", used, max,
+				hist[0], hist[1], hist[2], hist[3], hist[4], hist[5],
+				(double)t / n);
+			ht_up_free (ht);
+		}
+	}
+}
+
 static int cmd_kuery(void *data, const char *input) {
 	char buf[1024], *out;
 	RCore *core = (RCore*)data;
@@ -1025,6 +1089,9 @@ static int cmd_kuery(void *data, const char *input) {
 
 	switch (input[0]) {
 
+	case 'B': // "kB"
+		cmd_kuery_bench (core, r_str_trim_ro (input + 1));
+		break;
 	case 'j':
 		out = sdb_querys (s, NULL, 0, "anal/**");
 		if (!out) {
@@ -118,6 +118,7 @@ static const char *help_msg_ae[] = {
 	"ae?", "", "show this help",
 	"ae??", "", "show ESIL help",
 	"ae[aA]", "[f] [count]", "analyse esil accesses (regs, mem..)",
+	"aeB", " [n] [expr]", "time n runs (default 1000) of the esil of the function or block here, or of expr, compiled and interpreted",
 	"aeC", "[arg0 arg1..] @ addr", "appcall in esil",
 	"aec", "[?]", "continue until ^C",
 	"aecs", "", "continue until syscall",
@@ -459,6 +460,7 @@ static const char *help_msg_ag[] = {
 	"Output formats:", "", "",
 	"<blank>", "", "Ascii art",
 	"*", "", "r2 commands",
+	"b", "", "Benchmark the layout (agf, agg, agc and agC only)",
 	"d", "", "Graphviz dot",
 	"g", "", "Graph Modelling Language (gml)",
 	"j", "", "json ('J' for formatted disassembly)",
@@ -4589,6 +4591,139 @@ static void __core_anal_appcall(RCore *core, const char *input) {
 //	r_reg_arena_pop (core->dbg->reg);
 }
 
+typedef struct {
+	ut64 addr;
+	char *expr;
+} EsilBenchOp;
+
+static void esil_bench_op_free(void *e, void *user) {
+	free (((EsilBenchOp *)e)->expr);
+}
+
+// the memory writes of the replayed instructions are dropped
+static int esil_bench_mem_write(RAnalEsil *esil, ut64 addr, const ut8 *buf, int len) {
+	return 1;
+}
+
+static int esil_bench_words(const char *expr) {
+	int words = 1;
+	for (; *expr; expr++) {
+		words += *expr == ',';
+	}
+	return words;
+}
+
+// decodes the instructions in [addr, addr + len) and keeps their esil
+static int esil_bench_decode(RCore *core, RVector *ops, ut64 addr, ut64 len) {
+	RAnalOp op;
+	ut64 i;
+	int size, words = 0;
+	ut8 *buf = len? malloc (len): NULL;
+	if (!buf) {
+		return 0;
+	}
+	(void)r_io_read_at (core->io, addr, buf, len);
+	for (i = 0; i < len; i += size) {
+		size = r_anal_op (core->anal, &op, addr + i, buf + i, len - i, R_ANAL_OP_MASK_ESIL);
+		if (size < 1) {
+			size = 1;
+		} else if (*R_STRBUF_SAFEGET (&op.esil)) {
+			EsilBenchOp e = { addr + i, strdup (r_strbuf_get (&op.esil)) };
+			if (e.expr && r_vector_push (ops, &e)) {
+				words += esil_bench_words (e.expr);
+			} else {
+				free (e.expr);
+			}
+		}
+		r_anal_op_fini (&op);
+	}
+	free (buf);
+	return words;
+}
+
+/* replay n times the esil of the instructions of the function at the current
+ * offset (or of the current block) or expr, through the compiled expressions
+ * and through the interpreter, and report how long each path took */
+static void cmd_esil_bench(RCore *core, const char *input) {
+	RAnalEsil *esil = core->anal->esil;
+	char *args = strdup (r_str_trim_ro (input));
+	char *sp = args? strchr (args, ' '): NULL;
+	RVector *ops;
+	EsilBenchOp *e;
+	ut64 t[2];
+	int i, j, n, words = 0;
+	if (!args) {
+		return;
+	}
+	if (sp) {
+		*sp++ = 0;
+	}
+	n = *args? R_MAX (1, (int)r_num_math (core->num, args)): 1000;
+	if (!esil) {
+		r_core_cmd0 (core, "aei");
+		if (!(esil = core->anal->esil)) {
+			free (args);
+			return;
+		}
+	}
+	if (!(ops = r_vector_new (sizeof (EsilBenchOp), esil_bench_op_free, NULL))) {
+		free (args);
+		return;
+	}
+	if (sp && *r_str_trim_ro (sp)) {
+		EsilBenchOp op = { core->offset, strdup (r_str_trim_ro (sp)) };
+		if (op.expr && r_vector_push (ops, &op)) {
+			words = esil_bench_words (op.expr);
+		}
+	} else {
+		RAnalFunction *fcn = r_anal_get_fcn_in (core->anal, core->offset, 0);
+		if (fcn) {
+			RAnalBlock *bb;
+			RListIter *iter;
+			r_list_foreach (fcn->bbs, iter, bb) {
+				words += esil_bench_decode (core, ops, bb->addr, bb->size);
+			}
+		} else {
+			words = esil_bench_decode (core, ops, core->offset, core->blocksize);
+		}
+	}
+	if (!ops->len) {
+		eprintf ("No esil to replay at 0x%08"PFMT64x"\n", core->offset);
+		r_vector_free (ops);
+		free (args);
+		return;
+	}
+	// the registers are restored and the memory left untouched afterwards
+	int (*hook_mem_write)(RAnalEsil *esil, ut64 addr, const ut8 *buf, int len) = esil->cb.hook_mem_write;
+	bool nocompile = esil->nocompile;
+	ut64 address = esil->address;
+	r_reg_arena_push (core->anal->reg);
+	esil->cb.hook_mem_write = esil_bench_mem_write;
+	for (j = 0; j < 2; j++) {
+		esil->nocompile = j;
+		t[j] = r_sys_now ();
+		for (i = 0; i < n; i++) {
+			r_vector_foreach (ops, e) {
+				esil->address = e->addr;
+				r_anal_esil_parse (esil, e->expr);
+				if (esil->stackptr) {
+					r_anal_esil_stack_free (esil);
+				}
+			}
+		}
+		t[j] = r_sys_now () - t[j];
+	}
+	esil->cb.hook_mem_write = hook_mem_write;
+	esil->nocompile = nocompile;
+	esil->address = address;
+	r_reg_arena_pop (core->anal->reg);
+	r_cons_printf ("runs %d ops %d words %d compiled %.3fs (%.1fM words/s) interpreted %.3fs (%.1fM words/s)\n",
+		n, (int)ops->len, words, t[0] / 1000000.0, (double)n * words / R_MAX (t[0], 1),
+		t[1] / 1000000.0, (double)n * words / R_MAX (t[1], 1));
+	r_vector_free (ops);
+	free (args);
+}
+
 static void cmd_anal_esil(RCore *core, const char *input) {
 	RAnalEsil *esil = core->anal->esil;
 	ut64 addr = core->offset;
@@ -4860,6 +4995,9 @@ static void cmd_anal_esil(RCore *core, const char *input) {
 			break;
 		}
 		break;
+	case 'B': // "aeB"
+		cmd_esil_bench (core, input + 1);
+		break;
 	case 'k': // "aek"
 		switch (input[1]) {
 		case '\0':
@@ -5855,6 +5993,74 @@ static char *get_buf_asm(RCore *core, ut64 from, ut64 addr, RAnalFunction *fcn,
 #define var_ref_list(a,d,t) sdb_fmt ("var.0x%"PFMT64x".%d.%d.%s",\
 		a, 1, d, (t == 'R')?"reads":"writes");
 
+static bool print_xref_addr(void *user, const RAnalRef *ref) {
+	r_cons_printf ("0x%" PFMT64x "\n", ref->addr);
+	return true;
+}
+
+typedef struct {
+	RCore *core;
+	RAnalFunction *fcn;
+	PJ *pj;
+	int mode;
+	int count;
+} AxfCtx;
+
+static bool print_ref_from(void *user, const RAnalRef *ref) {
+	AxfCtx *ctx = (AxfCtx *)user;
+	RCore *core = ctx->core;
+	RAsmOp asmop;
+	ut8 buf[12];
+	ctx->count++;
+	switch (ctx->mode) {
+	case 'q': // "axfq"
+		r_cons_printf ("0x%" PFMT64x "\n", ref->at);
+		break;
+	case 'j': // "axfj"
+		r_io_read_at (core->io, ref->at, buf, sizeof (buf));
+		r_asm_set_pc (core->assembler, ref->at);
+		r_asm_disassemble (core->assembler, &asmop, buf, sizeof (buf));
+		pj_o (ctx->pj);
+		pj_kn (ctx->pj, "from", ref->at);
+		pj_kn (ctx->pj, "to", ref->addr);
+		pj_ks (ctx->pj, "type", r_anal_xrefs_type_tostring (ref->type));
+		pj_ks (ctx->pj, "opcode", r_asm_op_get_asm (&asmop));
+		pj_end (ctx->pj);
+		break;
+	case '*': // "axf*"
+		// TODO: implement multi-line comments
+		r_cons_printf ("CCa 0x%" PFMT64x " \"XREF from 0x%" PFMT64x "\n", ref->at, (ut64)ref->type);
+		break;
+	default: { // "axf"
+		char str[512], *buf_asm;
+		RAnalFunction *fcn = ctx->fcn;
+		r_io_read_at (core->io, ref->at, buf, sizeof (buf));
+		r_asm_set_pc (core->assembler, ref->at);
+		r_asm_disassemble (core->assembler, &asmop, buf, sizeof (buf));
+		r_parse_filter (core->parser, ref->at, core->flags, r_asm_op_get_asm (&asmop),
+				str, sizeof (str), core->print->big_endian);
+		if (core->print->flags & R_PRINT_FLAGS_COLOR) {
+			buf_asm = r_print_colorize_opcode (core->print, str,
+					core->cons->context->pal.reg, core->cons->context->pal.num, false, fcn ? fcn->addr : 0);
+		} else {
+			buf_asm = r_str_new (str);
+		}
+		r_cons_printf ("%c 0x%" PFMT64x " %s", ref->type, ref->at, buf_asm);
+		if (ref->type == R_ANAL_REF_TYPE_CALL) {
+			RAnalOp aop;
+			r_anal_op (core->anal, &aop, ref->at, buf, sizeof (buf), R_ANAL_OP_MASK_BASIC);
+			if (aop.type == R_ANAL_OP_TYPE_UCALL) {
+				cmd_anal_ucall_ref (core, ref->addr);
+			}
+		}
+		r_cons_newline ();
+		free (buf_asm);
+		break;
+		}
+	}
+	return true;
+}
+
 static bool cmd_anal_refs(RCore *core, const char *input) {
 	ut64 addr = core->offset;
 	switch (input[0]) {
@@ -5961,13 +6167,14 @@ static bool cmd_anal_refs(RCore *core, const char *input) {
 		} else {
 			addr = core->offset;
 		}
+		if (input[1] == 'q') { // "axtq"
+			r_anal_xrefs_foreach (core->anal, addr, print_xref_addr, NULL);
+			free (name);
+			break;
+		}
 		list = r_anal_xrefs_get (core->anal, addr);
 		if (list) {
-			if (input[1] == 'q') { // "axtq"
-				r_list_foreach (list, iter, ref) {
-					r_cons_printf ("0x%" PFMT64x "\n", ref->addr);
-				}
-			} else if (input[1] == 'j') { // "axtj"
+			if (input[1] == 'j') { // "axtj"
 				PJ *pj = pj_new ();
 				if (!pj) {
 					return false;
@@ -6113,95 +6320,24 @@ static bool cmd_anal_refs(RCore *core, const char *input) {
 				eprintf ("Cannot find any function\n");
 			}
 		} else { // "axf"
-			ut8 buf[12];
-			RAsmOp asmop;
-			char *buf_asm = NULL;
-			RList *list, *list_ = NULL;
-			RAnalRef *ref;
-			RListIter *iter;
 			char *space = strchr (input, ' ');
-			RAnalFunction * fcn = r_anal_get_fcn_in (core->anal, addr, 0);
-
-			if (space) {
-				addr = r_num_math (core->num, space + 1);
-			} else {
-				addr = core->offset;
-			}
-			if (input[1] == '.') { // "axf."
-				list = list_ = r_anal_xrefs_get_from (core->anal, addr);
-				if (!list) {
-					list = r_anal_fcn_get_refs (core->anal, fcn);
+			AxfCtx ctx = { core, r_anal_get_fcn_in (core->anal, addr, 0), NULL, input[1] == '.'? 0: input[1], 0 };
+			addr = space? r_num_math (core->num, space + 1): core->offset;
+			if (ctx.mode == 'j') {
+				if (!(ctx.pj = pj_new ())) {
+					return false;
 				}
-			} else {
-				list = r_anal_refs_get (core->anal, addr);
+				pj_a (ctx.pj);
 			}
-
-			if (list) {
-				if (input[1] == 'q') { // "axfq"
-					r_list_foreach (list, iter, ref) {
-						r_cons_printf ("0x%" PFMT64x "\n", ref->at);
-					}
-				} else if (input[1] == 'j') { // "axfj"
-					PJ *pj = pj_new ();
-					if (!pj) {
-						return false;
-					}
-					pj_a (pj);
-					r_list_foreach (list, iter, ref) {
-						r_io_read_at (core->io, ref->at, buf, 12);
-						r_asm_set_pc (core->assembler, ref->at);
-						r_asm_disassemble (core->assembler, &asmop, buf, 12);
-						pj_o (pj);
-						pj_kn (pj, "from", ref->at);
-						pj_kn (pj, "to", ref->addr);
-						pj_ks (pj, "type", r_anal_xrefs_type_tostring (ref->type));
-						pj_ks (pj, "opcode", r_asm_op_get_asm (&asmop));
-						pj_end (pj);
-					}
-					pj_end (pj);
-					r_cons_println (pj_string (pj));
-					pj_free (pj);
-				} else if (input[1] == '*') { // "axf*"
-					// TODO: implement multi-line comments
-					r_list_foreach (list, iter, ref) {
-						r_cons_printf ("CCa 0x%" PFMT64x " \"XREF from 0x%" PFMT64x "\n",
-								ref->at, ref->type, r_asm_op_get_asm (&asmop), iter->n? ",": "");
-					}
-				} else { // "axf"
-					char str[512];
-					int has_color = core->print->flags & R_PRINT_FLAGS_COLOR;
-					r_list_foreach (list, iter, ref) {
-						r_io_read_at (core->io, ref->at, buf, 12);
-						r_asm_set_pc (core->assembler, ref->at);
-						r_asm_disassemble (core->assembler, &asmop, buf, 12);
-						r_parse_filter (core->parser, ref->at, core->flags, r_asm_op_get_asm (&asmop),
-								str, sizeof (str), core->print->big_endian);
-						if (has_color) {
-							buf_asm = r_print_colorize_opcode (core->print, str,
-									core->cons->context->pal.reg, core->cons->context->pal.num, false, fcn ? fcn->addr : 0);
-						} else {
-							buf_asm = r_str_new (str);
-						}
-						r_cons_printf ("%c 0x%" PFMT64x " %s",
-								ref->type, ref->at, buf_asm);
-
-						if (ref->type == R_ANAL_REF_TYPE_CALL) {
-							RAnalOp aop;
-							r_anal_op (core->anal, &aop, ref->at, buf, 12, R_ANAL_OP_MASK_BASIC);
-							if (aop.type == R_ANAL_OP_TYPE_UCALL) {
-								cmd_anal_ucall_ref (core, ref->addr);
-							}
-						}
-						r_cons_newline ();
-						free (buf_asm);
-					}
-				}
-			} else {
-				if (input[1] == 'j') { // "axfj"
-					r_cons_print ("[]\n");
-				}
+			r_anal_refs_foreach (core->anal, addr, print_ref_from, &ctx);
+			if (input[1] == '.' && !ctx.count && ctx.fcn) { // "axf."
+				r_anal_fcn_refs_foreach (core->anal, ctx.fcn, print_ref_from, &ctx);
+			}
+			if (ctx.pj) {
+				pj_end (ctx.pj);
+				r_cons_println (pj_string (ctx.pj));
+				pj_free (ctx.pj);
 			}
-			r_list_free (list);
 		}
 		break;
 	case 'F': // "axF"
@@ -6672,6 +6808,9 @@ static void cmd_agraph_print(RCore *core, const char *input) {
 		core->graph->is_tiny = false;
 		break;
 		}
+	case 'b': // "aggb"
+		r_core_agraph_bench (core, core->graph, NULL);
+		break;
 	case 'k': // "aggk"
 	{
 		Sdb *db = r_agraph_get_sdb (core->graph);
@@ -6808,6 +6947,15 @@ static void cmd_anal_graph(RCore *core, const char *input) {
 			r_core_print_bb_gml (core, fcn);
 			break;
 			}
+		case 'b':{ // "agfb"
+			RAnalFunction *fcn = r_anal_get_fcn_in (core->anal, core->offset, 0);
+			if (fcn) {
+				r_core_agraph_bench (core, NULL, fcn);
+			} else {
+				eprintf ("No function in current seek\n");
+			}
+			break;
+			}
 		case 'k':{ // "agfk"
 			r_core_cmdf (core, "ag-; .agf* @ %"PFMT64u"; aggk", core->offset);
 			break;
@@ -6856,6 +7004,7 @@ static void cmd_anal_graph(RCore *core, const char *input) {
 		break;
 	case 'C': // "agC"
 		switch (input[1]) {
+		case 'b':
 		case 'v':
 		case 't':
 		case 'k':
@@ -6997,6 +7146,7 @@ static void cmd_anal_graph(RCore *core, const char *input) {
 		break;
 	case 'c': // "agc"
 		switch (input[1]) {
+		case 'b':
 		case 'v':
 		case 't':
 		case 'k':
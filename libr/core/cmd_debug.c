@@ -47,6 +47,7 @@ static const char *help_msg_db[] = {
 	"db-", " <addr>", "Remove breakpoint",
 	"db-*", "", "Remove all the breakpoints",
 	"db.", "", "Show breakpoint info in current offset",
+	"dbB", " [n] [step]", "Time adding, hitting and removing n bps from the current offset",
 	"dbj", "", "List breakpoints in JSON format",
 	// "dbi", " 0x848 ecx=3", "stop execution when condition matches",
 	"dbc", " <addr> <cmd>", "Run command when breakpoint is hit",
@@ -268,6 +269,7 @@ static const char *help_msg_dms[] = {
 	"dmsa", "", "Full snapshot of all `dm` maps",
 	"dmsf", " [file] @ addr", "Read snapshot from disk",
 	"dmst", " [file] @ addr", "Dump snapshot to disk",
+	"dmsB", " [pct] @ addr", "Time a snapshot of the map and a diff after writing to pct% of its pages",
 	// TODO: dmsj - for json
 	NULL
 };
@@ -1182,6 +1184,71 @@ static int __r_debug_snap_diff(RCore *core, int idx) {
 	return 0;
 }
 
+// one byte of the written pages, spread evenly, is flipped and put back
+// from the base after the diff, whether the diff picked the page up or not
+static void cmd_debug_snap_bench(RCore *core, const char *input) {
+	RDebug *dbg = core->dbg;
+	RIO *io = dbg->iob.io;
+	RDebugMap *map = r_debug_map_get (dbg, core->offset);
+	RDebugSnap *snap;
+	RDebugSnapDiff *diff;
+	int pct = *input? R_MAX (0, R_MIN (100, (int)r_num_math (core->num, input))): 10;
+	ut32 i, pages, written = 0, changed = 0, lost = 0;
+	int cached;
+	bool tracked;
+	ut64 t[2];
+	if (!map) {
+		eprintf ("Cannot find map at 0x%08"PFMT64x"\n", core->offset);
+		return;
+	}
+	if (r_debug_snap_get (dbg, core->offset)) {
+		eprintf ("Delete the snapshot of this map first\n");
+		return;
+	}
+	t[0] = r_sys_now ();
+	r_debug_snap_map (dbg, map);
+	t[0] = r_sys_now () - t[0];
+	if (!(snap = r_debug_snap_get (dbg, core->offset))) {
+		return;
+	}
+	tracked = snap->dirty != NULL;
+	pages = snap->page_num;
+	// the bytes must reach the debuggee, not the io cache
+	cached = io->cached;
+	io->cached = 0;
+	for (i = 0; i < pages; i++) {
+		if ((ut64)i * pct % 100 < pct) {
+			ut8 b = snap->data[(ut64)i * SNAP_PAGE_SIZE] ^ 1;
+			if (dbg->iob.write_at (io, snap->addr + (ut64)i * SNAP_PAGE_SIZE, &b, 1)) {
+				written++;
+			}
+		}
+	}
+	t[1] = r_sys_now ();
+	diff = r_debug_snap_map (dbg, map);
+	t[1] = r_sys_now () - t[1];
+	if (diff) {
+		changed = r_list_length (diff->pages);
+	}
+	for (i = 0; i < pages; i++) {
+		if ((ut64)i * pct % 100 < pct) {
+			ut64 off = (ut64)i * SNAP_PAGE_SIZE;
+			ut8 b = 0;
+			dbg->iob.write_at (io, snap->addr + off, snap->data + off, 1);
+			if (!dbg->iob.read_at (io, snap->addr + off, &b, 1) || b != snap->data[off]) {
+				lost++;
+			}
+		}
+	}
+	io->cached = cached;
+	r_list_delete_data (dbg->snaps, snap);
+	r_cons_printf ("pages %u written %u changed %u tracked %s snap %.3fs diff %.3fs\n",
+		pages, written, changed, r_str_bool (tracked), t[0] / 1000000.0, t[1] / 1000000.0);
+	if (lost) {
+		eprintf ("Cannot restore %u byte(s) of the map\n", lost);
+	}
+}
+
 static int cmd_debug_map_snapshot(RCore *core, const char *input) {
 	switch (*input) {
 	case 'f':
@@ -1254,6 +1321,9 @@ static int cmd_debug_map_snapshot(RCore *core, const char *input) {
 	case 'C':
 		r_debug_snap_comment (core->dbg, atoi (input + 1), strchr (input, ' '));
 		break;
+	case 'B': // "dmsB"
+		cmd_debug_snap_bench (core, r_str_trim_ro (input + 1));
+		break;
 	case 'd':
 		__r_debug_snap_diff (core, atoi (input + 1));
 		break;
@@ -2961,6 +3031,62 @@ static void core_cmd_dbi (RCore *core, const char *input, ut64 addr) {
 	}
 }
 
+/* add n breakpoints step bytes apart from the current offset, look each one
+ * up as r_debug_bp_hit does on a trap and remove them, reporting the times */
+static void cmd_bp_bench(RCore *core, const char *input) {
+	RBreakpoint *bp = core->dbg->bp;
+	int i, n = 10000, added, hits = 0, bpsize = R_MAX (1, core->dbg->bpsize);
+	ut32 j, used = 0, chain = 0;
+	char *args = strdup (r_str_trim_ro (input));
+	char *sp = args? strchr (args, ' '): NULL;
+	ut64 t[3], step = 16;
+	if (!args) {
+		return;
+	}
+	if (sp) {
+		*sp++ = 0;
+		step = R_MAX (1, r_num_math (core->num, sp));
+	}
+	if (*args) {
+		n = R_MAX (1, (int)r_num_math (core->num, args));
+	}
+	free (args);
+	t[0] = r_sys_now ();
+	for (added = 0; added < n; added++) {
+		if (!r_bp_add_hw (bp, core->offset + added * step, 1, R_BP_PROT_EXEC)) {
+			break;
+		}
+	}
+	t[0] = r_sys_now () - t[0];
+	// longest bucket chain of the address table the trap handlers hit
+	for (j = 0; j < bp->bps_at->size; j++) {
+		ut32 count = bp->bps_at->table[j].count;
+		used += count > 0;
+		chain = R_MAX (chain, count);
+	}
+	t[1] = r_sys_now ();
+	for (i = 0; i < added; i++) {
+		ut64 pc = core->offset + i * step + bpsize;
+		RBreakpointItem *b = r_bp_get_at (bp, pc);
+		if (!b) {
+			b = r_bp_get_at (bp, pc - bpsize);
+		}
+		if (!b) {
+			b = r_bp_get_in (bp, pc - bpsize, R_BP_PROT_EXEC);
+		}
+		hits += b != NULL;
+	}
+	t[1] = r_sys_now () - t[1];
+	t[2] = r_sys_now ();
+	for (i = 0; i < added; i++) {
+		r_bp_del (bp, core->offset + i * step);
+	}
+	t[2] = r_sys_now () - t[2];
+	r_cons_printf ("bps %d hits %d add %.3fs hit %.3fus del %.3fs buckets %u chain %u\n",
+		added, hits, t[0] / 1000000.0, added? (double)t[1] / added: 0.0,
+		t[2] / 1000000.0, used, chain);
+}
+
 static void r_core_cmd_bp(RCore *core, const char *input) {
 	RBreakpointItem *bpi;
 	int i, hwbp = r_config_get_i (core->config, "dbg.hwbp");
@@ -3020,6 +3146,9 @@ static void r_core_cmd_bp(RCore *core, const char *input) {
 		}
 		}
 		break;
+	case 'B': // "dbB"
+		cmd_bp_bench (core, input + 2);
+		break;
 	case 'x': // "dbx"
 		if (input[2] == ' ') {
 			if (addr == UT64_MAX) {
@@ -4442,9 +4571,8 @@ static int cmd_debug(void *data, const char *input) {
 			} break;
 			case '-': // "dte-"
 				if (!strcmp (input + 3, "*")) {
-					if (core->anal->esil) {
-						sdb_free (core->anal->esil->db_trace);
-						core->anal->esil->db_trace = sdb_new0 ();
+					if (core->anal->esil && core->anal->esil->trace) {
+						r_anal_esil_trace_reset (core->anal->esil->trace);
 					}
 				} else {
 					eprintf ("TODO: dte- cannot delete specific logs. Use dte-*\n");
@@ -4457,10 +4585,13 @@ static int cmd_debug(void *data, const char *input) {
 			} break;
 			case 'k': // "dtek"
 				if (input[3] == ' ') {
-					char *s = sdb_querys (core->anal->esil->db_trace,
-							NULL, 0, input + 4);
-					r_cons_println (s);
-					free (s);
+					if (core->anal->esil->trace) {
+						Sdb *db = r_anal_esil_trace_sdb (core->anal->esil->trace);
+						char *s = sdb_querys (db, NULL, 0, input + 4);
+						r_cons_println (s);
+						free (s);
+						sdb_free (db);
+					}
 				} else {
 					eprintf ("Usage: dtek [query]\n");
 				}
@@ -103,6 +103,7 @@ static const char *help_msg_om[] = {
 	"omfg", "[+-]rwx", "change flags/perms for all maps (global)",
 	"omb", " mapid addr", "relocate map with corresponding id",
 	"omb.", " addr", "relocate current map",
+	"omB", " [n]", "benchmark adding, moving, resizing, reading and removing n maps at the current offset",
 	"omr", " mapid newsize", "resize map with corresponding id",
 	"omo", " fd", "map the given fd with lowest priority",
 	"omp", " mapid", "prioritize map with corresponding id",
@@ -536,6 +537,51 @@ static void cmd_omf(RCore *core, const char *input) {
 	free (arg);
 }
 
+/* time the map updates on n overlapping maps of the current fd, each map
+ * shadows half of the previous one. The maps are removed afterwards */
+static void cmd_open_map_bench(RCore *core, int n) {
+	RIO *io = core->io;
+	int i, fd = r_io_fd_get_current (io);
+	ut32 *ids = calloc (n, sizeof (ut32));
+	ut64 t[5], seed = 1;
+	ut8 b;
+	if (!ids || fd < 0) {
+		free (ids);
+		return;
+	}
+	t[0] = r_sys_now ();
+	for (i = 0; i < n; i++) {
+		RIOMap *map = r_io_map_new (io, fd, R_PERM_R, 0, core->offset + (ut64)i * 0x800, 0x1000);
+		ids[i] = map? map->id: 0;
+	}
+	t[0] = r_sys_now () - t[0];
+	t[1] = r_sys_now ();
+	for (i = 0; i < n; i++) {
+		r_io_map_remap (io, ids[i], core->offset + (ut64)(n - i - 1) * 0x800);
+	}
+	t[1] = r_sys_now () - t[1];
+	t[2] = r_sys_now ();
+	for (i = 0; i < n; i++) {
+		r_io_map_resize (io, ids[i], 0x1800);
+	}
+	t[2] = r_sys_now () - t[2];
+	// single byte reads spread over the maps go through a skyline lookup each
+	t[4] = r_sys_now ();
+	for (i = 0; i < n; i++) {
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		r_io_read_at (io, core->offset + (seed >> 33) % ((ut64)n * 0x800), &b, 1);
+	}
+	t[4] = r_sys_now () - t[4];
+	t[3] = r_sys_now ();
+	for (i = 0; i < n; i++) {
+		r_io_map_del (io, ids[i]);
+	}
+	t[3] = r_sys_now () - t[3];
+	r_cons_printf ("maps %d add %.3fs remap %.3fs resize %.3fs read %.3fus del %.3fs\n", n,
+		t[0] / 1000000.0, t[1] / 1000000.0, t[2] / 1000000.0, (double)t[4] / n, t[3] / 1000000.0);
+	free (ids);
+}
+
 static void cmd_open_map(RCore *core, const char *input) {
 	ut64 fd = 0LL;
 	ut32 id = 0;
@@ -585,6 +631,9 @@ static void cmd_open_map(RCore *core, const char *input) {
 			}
 		}
 		break;
+	case 'B': // "omB"
+		cmd_open_map_bench (core, input[2]? R_MAX (1, (int)r_num_math (core->num, input + 2)): 10000);
+		break;
 	case 'o': // "omo"
 		if (input[2] == ' ') {
 			r_core_cmdf (core, "om %s 0x%08" PFMT64x " $s r omo", input + 2);
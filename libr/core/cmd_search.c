@@ -143,9 +143,73 @@ static const char *help_msg_slash_x[] = {
 	"Usage:", "/x [hexpairs]:[binmask]", "Search in memory",
 	"/x ", "9090cd80", "search for those bytes",
 	"/x ", "9090cd80:ffff7ff0", "search with binary mask",
+	"/xB", " [n] [size]", "time n random keywords over size bytes, with and without the automaton (noac)",
 	NULL
 };
 
+static int search_bench_hit(RSearchKeyword *kw, void *user, ut64 addr) {
+	(*(int *)user)++;
+	return 1;
+}
+
+// half of the keywords are taken from the data so both passes have hits to compare
+static void cmd_search_bench(RCore *core, const char *input) {
+	int i, pass, n = 100, size = 1024 * 1024, hits[2] = {0};
+	const int bsize = 0x10000;
+	char *args = strdup (r_str_trim_ro (input));
+	char *sp = args? strchr (args, ' '): NULL;
+	ut64 t[2];
+	if (!args) {
+		return;
+	}
+	if (sp) {
+		*sp++ = 0;
+		size = R_MAX (16, (int)r_num_math (core->num, sp));
+	}
+	if (*args) {
+		n = R_MAX (1, (int)r_num_math (core->num, args));
+	}
+	free (args);
+	ut8 *buf = malloc (size);
+	RSearch *s = r_search_new (R_SEARCH_KEYWORD);
+	if (!buf || !s) {
+		eprintf ("Cannot allocate %d bytes\n", size);
+		free (buf);
+		r_search_free (s);
+		return;
+	}
+	r_io_read_at (core->io, core->offset, buf, size);
+	s->contiguous = true;
+	for (i = 0; i < n; i++) {
+		ut8 kw[12];
+		int j, len = 4 + r_num_rand (9);
+		if (i % 2) {
+			memcpy (kw, buf + r_num_rand (size - len), len);
+		} else {
+			for (j = 0; j < len; j++) {
+				kw[j] = r_num_rand (256);
+			}
+		}
+		r_search_kw_add (s, r_search_keyword_new (kw, len, NULL, 0, NULL));
+	}
+	for (pass = 0; pass < 2; pass++) {
+		int at;
+		s->noac = pass;
+		r_search_set_callback (s, search_bench_hit, &hits[pass]);
+		r_search_begin (s);
+		t[pass] = r_sys_now ();
+		for (at = 0; at < size; at += bsize) {
+			r_search_update (s, core->offset + at, buf + at, R_MIN (bsize, size - at));
+		}
+		t[pass] = R_MAX (1, r_sys_now () - t[pass]);
+	}
+	r_cons_printf ("kws %d size %d auto %.3fs %.1fMB/s hits %d noac %.3fs %.1fMB/s hits %d\n",
+		n, size, t[0] / 1000000.0, (double)size / t[0], hits[0],
+		t[1] / 1000000.0, (double)size / t[1], hits[1]);
+	free (buf);
+	r_search_free (s);
+}
+
 static int preludecnt = 0;
 static int searchflags = 0;
 static int searchshow = 0;
@@ -179,10 +243,131 @@ static void cmd_search_init(RCore *core) {
 	DEFINE_CMD_DESCRIPTOR_SPECIAL (core, /x, slash_x);
 }
 
+// offsets hashed by each carving thread at least
+#define HASH_CARVE_CHUNK 0x10000
+
+typedef struct {
+	ut64 algo;
+	const char *hashname;
+	const char *hashstr; // entropy has no digest bytes, compare the strings
+	const ut8 *digest;
+	int dsize;
+	const ut8 *buf;
+	ut32 len;
+	int from; // first and last offsets of buf where a block may start
+	int to;
+	int id;
+	int hit;
+	int *first; // lowest task with a hit, the others can stop
+	RThreadLock *lock;
+} HashCarve;
+
+static void hash_carve(HashCarve *hc) {
+	RHashRoll *roll = hc->dsize? r_hash_roll_new (hc->algo, hc->len): NULL;
+	RHash *ctx = roll? NULL: r_hash_new (true, hc->algo);
+	int i;
+
+	hc->hit = -1;
+	if (!roll && !ctx) {
+		return;
+	}
+	for (i = hc->from; i <= hc->to; i++) {
+		bool match;
+		if (!((i - hc->from) & 0xffff) && (r_cons_is_breaked () || *hc->first < hc->id)) {
+			break;
+		}
+		if (roll) {
+			// checksums slide over a whole chunk instead of hashing every block
+			int n = R_MIN (HASH_CARVE_CHUNK, hc->to - i + 1);
+			int at = r_hash_roll_find (roll, hc->buf + i, n + hc->len - 1, hc->digest);
+			match = at >= 0;
+			i += match? at: n - 1;
+		} else if (hc->dsize) {
+			r_hash_do_begin (ctx, hc->algo);
+			r_hash_calculate (ctx, hc->algo, hc->buf + i, hc->len);
+			r_hash_do_end (ctx, hc->algo);
+			match = !memcmp (ctx->digest, hc->digest, hc->dsize);
+		} else {
+			char *s = r_hash_to_string (ctx, hc->hashname, hc->buf + i, hc->len);
+			match = s && !strcmp (s, hc->hashstr);
+			free (s);
+		}
+		if (match) {
+			hc->hit = i;
+			r_th_lock_enter (hc->lock);
+			if (hc->id < *hc->first) {
+				*hc->first = hc->id;
+			}
+			r_th_lock_leave (hc->lock);
+			break;
+		}
+	}
+	r_hash_roll_free (roll);
+	r_hash_free (ctx);
+}
+
+static RThreadFunctionRet hash_carve_th(RThread *th) {
+	hash_carve (th->user);
+	return R_TH_STOP;
+}
+
+// split the blocks of buf across the cpus, returns the first match or -1
+static int hash_carve_buf(HashCarve *hc, const ut8 *buf, int bufsz) {
+	int blocks = bufsz - hc->len + 1;
+	int i, ntasks = R_MIN (r_th_ncpus (), blocks / HASH_CARVE_CHUNK + 1);
+	HashCarve *tasks = calloc (ntasks, sizeof (HashCarve));
+	RThread **th = calloc (ntasks, sizeof (RThread *));
+	int first = ntasks, hit = -1;
+
+	if (!tasks || !th) {
+		free (tasks);
+		free (th);
+		return -1;
+	}
+	for (i = 0; i < ntasks; i++) {
+		tasks[i] = *hc;
+		tasks[i].buf = buf;
+		tasks[i].from = (int)(((st64)blocks * i) / ntasks);
+		tasks[i].to = (int)(((st64)blocks * (i + 1)) / ntasks) - 1;
+		tasks[i].id = i;
+		tasks[i].first = &first;
+	}
+	if (ntasks == 1) {
+		hash_carve (&tasks[0]);
+	} else {
+		for (i = 0; i < ntasks; i++) {
+			th[i] = r_th_new (hash_carve_th, &tasks[i], 0);
+			if (!th[i]) {
+				hash_carve (&tasks[i]);
+			}
+		}
+		for (i = 0; i < ntasks; i++) {
+			r_th_wait (th[i]);
+			r_th_free (th[i]);
+		}
+	}
+	if (first < ntasks) {
+		hit = tasks[first].hit;
+	}
+	free (tasks);
+	free (th);
+	return hit;
+}
+
+static int hash_range_cmp(const void *a, const void *b) {
+	const RInterval *ra = a, *rb = b;
+	if (ra->addr != rb->addr) {
+		return ra->addr < rb->addr? -1: 1;
+	}
+	return 0;
+}
+
 static int search_hash(RCore *core, const char *hashname, const char *hashstr, ut32 minlen, ut32 maxlen, struct search_parameters *param) {
+	HashCarve hc = {0};
+	RInterval *ranges = NULL, bufitv = {0};
 	RIOMap *map;
-	ut8 *buf;
-	int i, j;
+	ut8 *buf = NULL, *digest = NULL;
+	int i, j, nranges = 0, ret = 0;
 	RListIter *iter;
 
 	if (!minlen || minlen == UT32_MAX) {
@@ -191,62 +376,97 @@ static int search_hash(RCore *core, const char *hashname, const char *hashstr, u
 	if (!maxlen || maxlen == UT32_MAX) {
 		maxlen = minlen;
 	}
+	hc.algo = r_hash_name_to_bits (hashname);
+	if (!hc.algo) {
+		eprintf ("Unknown hash algorithm '%s'\n", hashname);
+		return -1;
+	}
+	// compare binary digests instead of formatting every block
+	hc.dsize = r_hash_size (hc.algo);
+	if (hc.dsize) {
+		digest = malloc (strlen (hashstr) / 2 + 1);
+		if (!digest || r_hex_str2bin (hashstr, digest) != hc.dsize) {
+			eprintf ("Invalid %s hash '%s'\n", hashname, hashstr);
+			free (digest);
+			return -1;
+		}
+	}
+	hc.hashname = hashname;
+	hc.hashstr = hashstr;
+	hc.digest = digest;
+	hc.lock = r_th_lock_new (false);
+	// adjacent maps are merged so the blocks crossing them are carved too
+	ranges = calloc (r_list_length (param->boundaries) + 1, sizeof (RInterval));
+	if (!hc.lock || !ranges) {
+		r_th_lock_free (hc.lock);
+		free (ranges);
+		free (digest);
+		return -1;
+	}
+	r_list_foreach (param->boundaries, iter, map) {
+		ranges[nranges++] = map->itv;
+	}
+	qsort (ranges, nranges, sizeof (RInterval), hash_range_cmp);
+	for (i = j = 0; i < nranges; i++) {
+		if (j && ranges[i].addr <= r_itv_end (ranges[j - 1])) {
+			ut64 end = R_MAX (r_itv_end (ranges[j - 1]), r_itv_end (ranges[i]));
+			ranges[j - 1].size = end - ranges[j - 1].addr;
+		} else {
+			ranges[j++] = ranges[i];
+		}
+	}
+	nranges = j;
 
 	r_cons_break_push (NULL, NULL);
-	for (j = minlen; j <= maxlen; j++) {
-		ut32 len = j;
+	for (j = minlen; j <= maxlen && !ret; j++) {
 		eprintf ("Searching %s for %d byte length.\n", hashname, j);
-		r_list_foreach (param->boundaries, iter, map) {
+		for (i = 0; i < nranges; i++) {
+			ut64 from = ranges[i].addr, to = r_itv_end (ranges[i]);
+			st64 bufsz = to - from;
 			if (r_cons_is_breaked ()) {
 				break;
 			}
-			ut64 from = map->itv.addr, to = r_itv_end (map->itv);
-			st64 bufsz;
-			bufsz = to - from;
-			if (len > bufsz) {
+			if (j > bufsz) {
 				eprintf ("Hash length is bigger than range 0x%"PFMT64x "\n", from);
 				continue;
 			}
-			buf = malloc (bufsz);
-			if (!buf) {
-				eprintf ("Cannot allocate %"PFMT64d " bytes\n", bufsz);
-				goto hell;
-			}
-			eprintf ("Search in range 0x%08"PFMT64x " and 0x%08"PFMT64x "\n", from, to);
-			int blocks = (int) (to - from - len);
-			eprintf ("Carving %d blocks...\n", blocks);
-			(void) r_io_read_at (core->io, from, buf, bufsz);
-			for (i = 0; (from + i + len) < to; i++) {
-				if (r_cons_is_breaked ()) {
-					break;
-				}
-				char *s = r_hash_to_string (NULL, hashname, buf + i, len);
-				if (!(i % 5)) {
-					eprintf ("%d\r", i);
-				}
-				if (!s) {
-					eprintf ("Hash fail\n");
+			// a single range is read once for all the lengths
+			if (!buf || bufitv.addr != from || bufitv.size != ranges[i].size) {
+				free (buf);
+				buf = malloc (bufsz);
+				if (!buf) {
+					eprintf ("Cannot allocate %"PFMT64d " bytes\n", bufsz);
+					ret = -1;
 					break;
 				}
-				// eprintf ("0x%08"PFMT64x" %s\n", from+i, s);
-				if (!strcmp (s, hashstr)) {
-					eprintf ("Found at 0x%"PFMT64x "\n", from + i);
-					r_cons_printf ("f hash.%s.%s = 0x%"PFMT64x "\n",
-						hashname, hashstr, from + i);
-					free (s);
-					free (buf);
-					return 1;
-				}
-				free (s);
+				bufitv = ranges[i];
+				(void) r_io_read_at (core->io, from, buf, bufsz);
 			}
-			free (buf);
+			eprintf ("Search in range 0x%08"PFMT64x " and 0x%08"PFMT64x "\n", from, to);
+			eprintf ("Carving %d blocks...\n", (int) (bufsz - j + 1));
+			hc.len = j;
+			int at = hash_carve_buf (&hc, buf, bufsz);
+			if (at >= 0) {
+				eprintf ("Found at 0x%"PFMT64x "\n", from + at);
+				r_cons_printf ("f hash.%s.%s = 0x%"PFMT64x "\n",
+					hashname, hashstr, from + at);
+				ret = 1;
+				break;
+			}
+		}
+		if (r_cons_is_breaked ()) {
+			break;
 		}
 	}
 	r_cons_break_pop ();
-	eprintf ("No hashes found\n");
-	return 0;
-hell:
-	return -1;
+	if (!ret) {
+		eprintf ("No hashes found\n");
+	}
+	r_th_lock_free (hc.lock);
+	free (ranges);
+	free (digest);
+	free (buf);
+	return ret;
 }
 
 static void cmd_search_bin(RCore *core, RInterval itv) {
@@ -660,10 +880,9 @@ R_API RList *r_core_get_boundaries_prot(RCore *core, int perm, const char *mode,
 		ut64 end = UT64_MAX;
 #define USE_SKYLINE 0
 #if USE_SKYLINE
-		const RPVector *skyline = &core->io->map_skyline;
-		size_t i;
-		for (i = 0; i < r_pvector_len (skyline); i++) {
-			const RIOMapSkyline *part = r_pvector_at (skyline, i);
+		RIOMapSkyline *part;
+		RBIter it;
+		r_io_skyline_foreach (core->io, it, part) {
 		//  	int perm = part->map->perm;
 			ut64 from = r_itv_begin (part->itv);
 			ut64 to = r_itv_end (part->itv);
@@ -716,12 +935,11 @@ R_API RList *r_core_get_boundaries_prot(RCore *core, int perm, const char *mode,
 				append_bound (list, core->io, search_itv, addr, size, s->perm);
 			}
 		}
-		const RPVector *skyline = &core->io->map_skyline;
+		RIOMapSkyline *part;
+		RBIter it;
 		ut64 begin = UT64_MAX;
 		ut64 end = UT64_MAX;
-		size_t i;
-		for (i = 0; i < r_pvector_len (skyline); i++) {
-			const RIOMapSkyline *part = r_pvector_at (skyline, i);
+		r_io_skyline_foreach (core->io, it, part) {
 			ut64 from = part->itv.addr;
 			ut64 to = part->itv.addr + part->itv.size;
 			int perm = part->map->perm;
@@ -3586,6 +3804,8 @@ reread:
 	case 'x': // "/x" search hex
 		if (input[1] == '?') {
 			r_core_cmd_help (core, help_msg_slash_x);
+		} else if (input[1] == 'B') { // "/xB"
+			cmd_search_bench (core, input + 2);
 		} else {
 			RSearchKeyword *kw;
 			char *s, *p = strdup (input + param_offset);
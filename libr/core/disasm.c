@@ -273,7 +273,7 @@ typedef struct {
 
 	bool use_json;
 	bool first_line;
-	int buf_line_begin;
+	ut64 buf_line_begin; // output position, counting what scr.stream wrote
 	const char *strip;
 	int maxflags;
 } RDisasmState;
@@ -1101,7 +1101,7 @@ static void ds_begin_line(RDisasmState *ds) {
 		ds->first_line = false;
 		r_cons_printf ("{\"offset\":%"PFMT64d",\"text\":\"", ds->vat);
 	}
-	ds->buf_line_begin = r_cons_get_buffer_len ();
+	ds->buf_line_begin = r_cons_get_streamed () + r_cons_get_buffer_len ();
 }
 
 static void ds_newline(RDisasmState *ds) {
@@ -3234,12 +3234,11 @@ static int ds_print_shortcut(RDisasmState *ds, ut64 addr, int pos) {
 static bool ds_print_core_vmode_jump_hit(RDisasmState *ds, int pos) {
 	RCore *core = ds->core;
 	RAnal *a = core->anal;
-	RAnalHint *hint = r_anal_hint_get (a, ds->at);
+	RAnalHint *hint = r_anal_hint_at (a, ds->at);
 	if (hint) {
 		if (hint->jump != UT64_MAX) {
 			ds_print_shortcut (ds, hint->jump, pos);
 		}
-		r_anal_hint_free (hint);
 		return true;
 	}
 	return false;
@@ -3349,17 +3348,27 @@ static void ds_print_core_vmode(RDisasmState *ds, int pos) {
 	ds->hinted_line = gotShortcut;
 }
 
+// start of the current line in the cons buffer, streaming only writes
+// whole lines so it is still there unless a newline was printed since
+static const char *ds_line_begin(RDisasmState *ds) {
+	const char *ll = r_cons_get_buffer ();
+	ut64 streamed = r_cons_get_streamed ();
+	if (!ll || ds->buf_line_begin < streamed) {
+		return ll;
+	}
+	return ll + (ds->buf_line_begin - streamed);
+}
+
 // align for comment
 static void ds_align_comment(RDisasmState *ds) {
 	if (!ds->show_comment_right_default) {
 		return;
 	}
 	const int cmtcol = ds->cmtcol - 1;
-	const char *ll = r_cons_get_buffer ();
+	const char *ll = ds_line_begin (ds);
 	if (!ll) {
 		return;
 	}
-	ll += ds->buf_line_begin;
 	int cells = r_str_len_utf8_ansi (ll);
 	int cols = ds->interactive ? ds->core->cons->columns : 1024;
 	if (cells < cmtcol) {
@@ -4226,12 +4235,7 @@ static void delete_last_comment(RDisasmState *ds) {
 	if (!ds->show_comment_right_default) {
 		return;
 	}
-	const char *ll = r_cons_get_buffer ();
-	if (!ll) {
-		return;
-	}
-	ll += ds->buf_line_begin;
-	const char *begin = ll;
+	const char *begin = ds_line_begin (ds);
 	if (begin) {
 		ds_newline (ds);
 		ds_begin_line (ds);
@@ -38,6 +38,9 @@ static const char *mousemodes[] = {
 #define MINIGRAPH_NODE_CENTER_X 3
 #define MININODE_MIN_WIDTH 16
 
+#define SWEEPS_DEFAULT 4096
+#define SWEEPS_STALL 16
+
 #define ZOOM_STEP 10
 #define ZOOM_DEFAULT 100
 
@@ -46,11 +49,6 @@ static const char *mousemodes[] = {
 
 #define NORMALIZE_MOV(x) ((x) < 0 ? -1 : ((x) > 0 ? 1 : 0))
 
-#define hash_set(sdb, k, v) (sdb_num_set (sdb, sdb_fmt ("%"PFMT64u, (ut64) (size_t) (k)), (ut64) (size_t) (v), 0))
-#define hash_get(sdb, k) (sdb_num_get (sdb, sdb_fmt ("%"PFMT64u, (ut64) (size_t) (k)), NULL))
-#define hash_get_rnode(sdb, k) ((RGraphNode *) (size_t) hash_get (sdb, k))
-#define hash_get_rlist(sdb, k) ((RList *) (size_t) hash_get (sdb, k))
-#define hash_get_int(sdb, k) ((int) hash_get (sdb, k))
 /* dont use macros for this */
 #define get_anode(gn) ((gn)? (RANode *) (gn)->data: NULL)
 
@@ -62,11 +60,7 @@ struct len_pos_t {
 	int pos;
 };
 
-struct dist_t {
-	const RGraphNode *from;
-	const RGraphNode *to;
-	int dist;
-};
+#define dist_key(from, to) (((ut64) (ut32) (from)->idx << 32) | (ut32) (to)->idx)
 
 struct g_cb {
 	RAGraph *graph;
@@ -397,159 +391,6 @@ static void normal_RANode_print(const RAGraph *g, const RANode *n, int cur) {
 	}
 }
 
-static int **get_crossing_matrix(const RGraph *g,
-                                 const struct layer_t layers[],
-                                 int maxlayer, int i, int from_up,
-                                 int *n_rows) {
-	int j, **m, len = layers[i].n_nodes;
-
-	m = R_NEWS0 (int *, len);
-	if (!m) {
-		return NULL;
-	}
-	for (j = 0; j < len; j++) {
-		m[j] = R_NEWS0 (int, len);
-		if (!m[j]) {
-			goto err_row;
-		}
-	}
-	/* calculate crossings between layer i and layer i-1 */
-	/* consider the crossings generated by each pair of edges */
-	if (i > 0 && from_up) {
-		for (j = 0; j < layers[i - 1].n_nodes; j++) {
-			const RGraphNode *gj = layers[i - 1].nodes[j];
-			const RList *neigh = r_graph_get_neighbours (g, gj);
-			RGraphNode *gk;
-			RListIter *itk;
-
-			r_list_foreach (neigh, itk, gk) {
-				int s;
-				// skip self-loop
-				if (gj == gk) {
-					continue;
-				}
-				for (s = 0; s < j; ++s) {
-					const RGraphNode *gs = layers[i - 1].nodes[s];
-					const RList *neigh_s = r_graph_get_neighbours (g, gs);
-					RGraphNode *gt;
-					RListIter *itt;
-
-					r_list_foreach (neigh_s, itt, gt) {
-						const RANode *ak, *at; /* k and t should be "indexes" on layer i */
-						if (gt == gk || gt == gs) {
-							continue;
-						}
-						ak = get_anode (gk);
-						at = get_anode (gt);
-						if (ak->layer != i || at->layer != i) {
-							// this should never happen
-							// but it happens if we do graph.dummy = false, so better hide it for now
-#if 0
-							eprintf ("(WARNING) \"%s\" (%d) or \"%s\" (%d) are not on the right layer (%d)\n",
-								ak->title, ak->layer,
-								at->title, at->layer,
-								i);
-#endif
-							continue;
-						}
-						m[ak->pos_in_layer][at->pos_in_layer]++;
-					}
-				}
-			}
-		}
-	}
-
-	/* calculate crossings between layer i and layer i+1 */
-	if (i < maxlayer - 1 && !from_up) {
-		for (j = 0; j < layers[i].n_nodes; ++j) {
-			const RGraphNode *gj = layers[i].nodes[j];
-			const RList *neigh = r_graph_get_neighbours (g, gj);
-			const RANode *ak, *aj = get_anode (gj);
-			RGraphNode *gk;
-			RListIter *itk;
-
-			graph_foreach_anode (neigh, itk, gk, ak) {
-				int s;
-				for (s = 0; s < layers[i].n_nodes; ++s) {
-					const RGraphNode *gs = layers[i].nodes[s];
-					const RList *neigh_s;
-					RGraphNode *gt;
-					RListIter *itt;
-					const RANode *at, *as = get_anode (gs);
-
-					if (gs == gj) {
-						continue;
-					}
-					neigh_s = r_graph_get_neighbours (g, gs);
-					graph_foreach_anode (neigh_s, itt, gt, at) {
-						if (at->pos_in_layer < ak->pos_in_layer) {
-							m[aj->pos_in_layer][as->pos_in_layer]++;
-						}
-					}
-				}
-			}
-		}
-	}
-
-	if (n_rows) {
-		*n_rows = len;
-	}
-	return m;
-
-err_row:
-	for (i = 0; i < len; i++) {
-		free (m[i]);
-	}
-	free (m);
-	return NULL;
-}
-
-static int layer_sweep(const RGraph *g, const struct layer_t layers[],
-                       int maxlayer, int i, int from_up) {
-	int **cross_matrix;
-	RGraphNode *u, *v;
-	const RANode *au, *av;
-	int n_rows, j, changed = false;
-	int len = layers[i].n_nodes;
-
-	cross_matrix = get_crossing_matrix (g, layers, maxlayer, i, from_up, &n_rows);
-	if (!cross_matrix) {
-		return false;
-	}
-
-	for (j = 0; j < len - 1; ++j) {
-		int auidx, avidx;
-
-		u = layers[i].nodes[j];
-		v = layers[i].nodes[j + 1];
-		au = get_anode (u);
-		av = get_anode (v);
-		auidx = au->pos_in_layer;
-		avidx = av->pos_in_layer;
-
-		if (cross_matrix[auidx][avidx] > cross_matrix[avidx][auidx]) {
-			/* swap elements */
-			layers[i].nodes[j] = v;
-			layers[i].nodes[j + 1] = u;
-			changed = true;
-		}
-	}
-
-	/* update position in the layer of each node. During the swap of some
-	 * elements we didn't swap also the pos_in_layer because the cross_matrix
-	 * is indexed by it, so do it now! */
-	for (j = 0; j < layers[i].n_nodes; ++j) {
-		RANode *n = get_anode (layers[i].nodes[j]);
-		n->pos_in_layer = j;
-	}
-
-	for (j = 0; j < n_rows; ++j) {
-		free (cross_matrix[j]);
-	}
-	free (cross_matrix);
-	return changed;
-}
-
 static void view_cyclic_edge(const RGraphEdge *e, const RGraphVisitor *vis) {
 	const RAGraph *g = (RAGraph *) vis->data;
 	RGraphEdge *new_e = R_NEW0 (RGraphEdge);
@@ -654,6 +495,25 @@ static int is_reversed(const RAGraph *g, const RGraphEdge *e) {
 	return r_list_find (g->back_edges, e, (RListComparator) find_edge)? true: false;
 }
 
+/* dummies only exist during the layout, so unlike r_agraph_add_node they
+ * are not registered in the sdb of the graph */
+static RANode *add_dummy_node(const RAGraph *g, int layer, int reversed) {
+	RANode *res = R_NEW0 (RANode);
+	if (!res) {
+		return NULL;
+	}
+	res->title = strdup ("");
+	res->body = strdup ("");
+	res->layer = layer;
+	res->pos_in_layer = -1;
+	res->is_dummy = true;
+	res->is_reversed = reversed;
+	res->klass = -1;
+	res->w = 1;
+	res->gnode = r_graph_add_node (g->graph, res);
+	return res;
+}
+
 /* add dummy nodes when there are edges that span multiple layers */
 static void create_dummy_nodes(RAGraph *g) {
 	RGraphVisitor dummy_vis = {
@@ -674,18 +534,19 @@ static void create_dummy_nodes(RAGraph *g) {
 		int diff_layer = R_ABS (from->layer - to->layer);
 		RANode *prev = get_anode (e->from);
 		int i, nth = e->nth;
+		int reversed = diff_layer > 1 && is_reversed (g, e);
 
 		r_agraph_del_edge (g, from, to);
 		for (i = 1; i < diff_layer; ++i) {
-			RANode *dummy = r_agraph_add_node (g, NULL, NULL);
+			RANode *dummy = add_dummy_node (g, from->layer + i, reversed);
 			if (!dummy) {
 				return;
 			}
-			dummy->is_dummy = true;
-			dummy->layer = from->layer + i;
-			dummy->is_reversed = is_reversed (g, e);
-			dummy->w = 1;
-			r_agraph_add_edge_at (g, prev, dummy, nth);
+			if (prev->is_dummy) {
+				r_graph_add_edge_at (g->graph, prev->gnode, dummy->gnode, nth);
+			} else {
+				r_agraph_add_edge_at (g, prev, dummy, nth);
+			}
 
 			prev = dummy;
 			nth = -1;
@@ -735,53 +596,318 @@ static void create_layers(RAGraph *g) {
 	}
 }
 
-/* layer-by-layer sweep */
-/* it permutes each layer, trying to find the best ordering for each layer
- * to minimize the number of crossing edges */
-static void minimize_crossings(const RAGraph *g) {
-	int i, cross_changed, max_changes = 4096;
+/* the sweeps work on a copy of the layered graph made of arrays indexed by
+ * the idx of the nodes, which is much faster to walk than the RGraph lists */
+struct sweep_t {
+	int *layer;
+	int *pos; /* position in the layer, kept in sync with pos_in_layer */
+	int *off; /* out-neighbours of n are adj[off[n]] .. adj[off[n + 1] - 1] */
+	int *adj;
+	int *eoff; /* edges of the nodes of a layer, see get_layer_edges */
+	int *epos;
+	int *tree; /* accumulator tree of layer_crossings */
+	RGraphNode **best; /* best ordering found so far */
+};
 
-	do {
-		cross_changed = false;
-		max_changes--;
+static void sweep_fini(struct sweep_t *s) {
+	free (s->layer);
+	free (s->pos);
+	free (s->off);
+	free (s->adj);
+	free (s->eoff);
+	free (s->epos);
+	free (s->tree);
+	free (s->best);
+}
 
-		for (i = 0; i < g->n_layers; ++i) {
-			cross_changed |= layer_sweep (g->graph, g->layers, g->n_layers, i, true);
+static bool sweep_init(const RAGraph *g, struct sweep_t *s) {
+	int i, n = R_MAX (g->graph->last_index, 1), n_nodes = 0, max_len = 1;
+	const RList *nodes = r_graph_get_nodes (g->graph);
+	const RGraphNode *gn, *gk;
+	const RListIter *it, *itk;
+	const RANode *an, *ak;
+
+	memset (s, 0, sizeof (*s));
+	for (i = 0; i < g->n_layers; i++) {
+		n_nodes += g->layers[i].n_nodes;
+		max_len = R_MAX (max_len, g->layers[i].n_nodes);
+	}
+	s->layer = R_NEWS0 (int, n);
+	s->pos = R_NEWS0 (int, n);
+	s->off = R_NEWS0 (int, n + 1);
+	s->eoff = R_NEWS0 (int, max_len + 1);
+	/* the tree has twice the power of two following the layer size */
+	s->tree = R_NEWS0 (int, 4 * max_len);
+	s->best = R_NEWS0 (RGraphNode *, R_MAX (n_nodes, 1));
+	if (!s->layer || !s->pos || !s->off || !s->eoff || !s->tree || !s->best) {
+		goto fail;
+	}
+	graph_foreach_anode (nodes, it, gn, an) {
+		s->layer[gn->idx] = an->layer;
+		s->pos[gn->idx] = an->pos_in_layer;
+		graph_foreach_anode (r_graph_get_neighbours (g->graph, gn), itk, gk, ak) {
+			s->off[gn->idx + 1]++;
+		}
+	}
+	for (i = 0; i < n; i++) {
+		s->off[i + 1] += s->off[i];
+	}
+	s->adj = R_NEWS0 (int, R_MAX (s->off[n], 1));
+	s->epos = R_NEWS0 (int, R_MAX (s->off[n], 1));
+	if (!s->adj || !s->epos) {
+		goto fail;
+	}
+	graph_foreach_anode (nodes, it, gn, an) {
+		int k = s->off[gn->idx];
+		graph_foreach_anode (r_graph_get_neighbours (g->graph, gn), itk, gk, ak) {
+			s->adj[k++] = gk->idx;
 		}
-	} while (cross_changed && max_changes);
+	}
+	return true;
+fail:
+	sweep_fini (s);
+	return false;
+}
+
+static void sort_ints(int *a, int n) {
+	int i, j;
 
-	max_changes = 4096;
+	for (i = 1; i < n; i++) {
+		int v = a[i];
+		for (j = i; j > 0 && a[j - 1] > v; j--) {
+			a[j] = a[j - 1];
+		}
+		a[j] = v;
+	}
+}
 
-	do {
-		cross_changed = false;
-		max_changes--;
+/* collects, for each node of layer i, the sorted positions its edges reach in
+ * the adjacent layer: the in-edges coming from layer i-1 when sweeping from
+ * up, the out-edges otherwise. The positions of the node with pos_in_layer j
+ * are epos[eoff[j]] .. epos[eoff[j + 1] - 1] */
+static void get_layer_edges(const RAGraph *g, struct sweep_t *s, int i, int from_up) {
+	const struct layer_t *l = from_up? &g->layers[i - 1]: &g->layers[i];
+	int j, k, len = g->layers[i].n_nodes;
+	int *o = s->eoff, *p = s->epos;
 
-		for (i = g->n_layers - 1; i >= 0; --i) {
-			cross_changed |= layer_sweep (g->graph, g->layers, g->n_layers, i, false);
+	memset (o, 0, sizeof (int) * (len + 1));
+	for (j = 0; j < l->n_nodes; j++) {
+		int u = l->nodes[j]->idx;
+		for (k = s->off[u]; k < s->off[u + 1]; k++) {
+			int v = s->adj[k];
+			if (!from_up) {
+				o[s->pos[u] + 1]++;
+			} else if (v != u && s->layer[v] == i) {
+				// skip self-loop
+				o[s->pos[v] + 1]++;
+			}
 		}
-	} while (cross_changed && max_changes);
+	}
+	for (j = 0; j < len; j++) {
+		o[j + 1] += o[j];
+	}
+	/* the nodes of layer i-1 are visited in order, so the positions of
+	 * in-edges come out sorted */
+	for (j = 0; j < l->n_nodes; j++) {
+		int u = l->nodes[j]->idx;
+		for (k = s->off[u]; k < s->off[u + 1]; k++) {
+			int v = s->adj[k];
+			if (!from_up) {
+				p[o[s->pos[u]]++] = s->pos[v];
+			} else if (v != u && s->layer[v] == i) {
+				p[o[s->pos[v]]++] = j;
+			}
+		}
+	}
+	for (j = len; j > 0; j--) {
+		o[j] = o[j - 1];
+	}
+	o[0] = 0;
+	if (!from_up) {
+		for (j = 0; j < len; j++) {
+			sort_ints (p + o[j], o[j + 1] - o[j]);
+		}
+	}
 }
 
-static int find_dist(const struct dist_t *a, const struct dist_t *b) {
-	return a->from == b->from && a->to == b->to? 0: 1;
+/* number of crossings between the edges of u and v when u is placed left of
+ * v, given the sorted positions their edges reach: the pairs of edges where
+ * the one of v ends before the one of u */
+static int pair_crossings(const int *u, int nu, const int *v, int nv) {
+	int i, j = 0, res = 0;
+
+	for (i = 0; i < nu; i++) {
+		while (j < nv && v[j] < u[i]) {
+			j++;
+		}
+		res += j;
+	}
+	return res;
+}
+
+static int layer_sweep(const RAGraph *g, struct sweep_t *s, int i, int from_up) {
+	const struct layer_t *l = &g->layers[i];
+	RGraphNode *u, *v;
+	int j, changed = false;
+	const int *o = s->eoff, *p = s->epos;
+
+	/* only the crossings with the layer above (or below) are considered */
+	if ((from_up && i == 0) || (!from_up && i >= g->n_layers - 1)) {
+		return false;
+	}
+	get_layer_edges (g, s, i, from_up);
+
+	for (j = 0; j < l->n_nodes - 1; ++j) {
+		int a, b;
+
+		u = l->nodes[j];
+		v = l->nodes[j + 1];
+		a = s->pos[u->idx];
+		b = s->pos[v->idx];
+		if (pair_crossings (p + o[a], o[a + 1] - o[a], p + o[b], o[b + 1] - o[b]) >
+				pair_crossings (p + o[b], o[b + 1] - o[b], p + o[a], o[a + 1] - o[a])) {
+			/* swap elements */
+			l->nodes[j] = v;
+			l->nodes[j + 1] = u;
+			changed = true;
+		}
+	}
+
+	/* update position in the layer of each node. During the swap of some
+	 * elements we didn't swap also the positions because the edges are
+	 * indexed by them, so do it now! */
+	for (j = 0; j < l->n_nodes; ++j) {
+		get_anode (l->nodes[j])->pos_in_layer = j;
+		s->pos[l->nodes[j]->idx] = j;
+	}
+	return changed;
+}
+
+/* counts the crossings between the edges of layer i-1 and layer i with an
+ * accumulator tree, see "Simple and Efficient Bilayer Cross Counting" by
+ * W. Barth, M. Junger, P. Mutzel. The edges are walked sorted by their end in
+ * layer i and then by their start in layer i-1 */
+static ut64 layer_crossings(const RAGraph *g, struct sweep_t *s, int i) {
+	int j, k, first = 1, len = g->layers[i].n_nodes;
+	const int *o = s->eoff, *p = s->epos;
+	int *tree = s->tree;
+	ut64 res = 0;
+
+	while (first < g->layers[i - 1].n_nodes) {
+		first *= 2;
+	}
+	memset (tree, 0, sizeof (int) * 2 * first);
+	get_layer_edges (g, s, i, true);
+	for (j = 0; j < len; j++) {
+		for (k = o[j]; k < o[j + 1]; k++) {
+			int idx = p[k] + first;
+			tree[idx]++;
+			while (idx > 1) {
+				/* edges already in the right subtree start after this one */
+				if (!(idx % 2)) {
+					res += tree[idx + 1];
+				}
+				idx /= 2;
+				tree[idx]++;
+			}
+		}
+	}
+	return res;
+}
+
+static ut64 count_crossings(const RAGraph *g, struct sweep_t *s) {
+	ut64 res = 0;
+	int i;
+
+	for (i = 1; i < g->n_layers; i++) {
+		res += layer_crossings (g, s, i);
+	}
+	return res;
+}
+
+static void save_order(const RAGraph *g, struct sweep_t *s) {
+	RGraphNode **order = s->best;
+	int i;
+
+	for (i = 0; i < g->n_layers; i++) {
+		memcpy (order, g->layers[i].nodes, sizeof (RGraphNode *) * g->layers[i].n_nodes);
+		order += g->layers[i].n_nodes;
+	}
+}
+
+static void restore_order(const RAGraph *g, struct sweep_t *s) {
+	RGraphNode **order = s->best;
+	int i, j;
+
+	for (i = 0; i < g->n_layers; i++) {
+		for (j = 0; j < g->layers[i].n_nodes; j++) {
+			RGraphNode *gn = *order++;
+			g->layers[i].nodes[j] = gn;
+			get_anode (gn)->pos_in_layer = j;
+			s->pos[gn->idx] = j;
+		}
+	}
+}
+
+/* layer-by-layer sweep */
+/* it permutes each layer, trying to find the best ordering for each layer
+ * to minimize the number of crossing edges. The sweeps stop when nothing
+ * changes, when the budget is over or when the number of crossings does not
+ * get any better for a while, the best ordering found is kept */
+static void minimize_crossings(const RAGraph *g) {
+	struct sweep_t s;
+	int i, dir;
+
+	if (!sweep_init (g, &s)) {
+		return;
+	}
+	for (dir = 0; dir < 2; dir++) {
+		int from_up = !dir, stall = 0;
+		int budget = g->sweeps > 0? g->sweeps: SWEEPS_DEFAULT;
+		ut64 cross, min = count_crossings (g, &s);
+
+		save_order (g, &s);
+		while (budget-- > 0 && stall < SWEEPS_STALL && !r_cons_is_breaked ()) {
+			int cross_changed = false;
+
+			if (from_up) {
+				for (i = 0; i < g->n_layers; ++i) {
+					cross_changed |= layer_sweep (g, &s, i, true);
+				}
+			} else {
+				for (i = g->n_layers - 1; i >= 0; --i) {
+					cross_changed |= layer_sweep (g, &s, i, false);
+				}
+			}
+			if (!cross_changed) {
+				break;
+			}
+			cross = count_crossings (g, &s);
+			if (cross < min) {
+				min = cross;
+				stall = 0;
+				save_order (g, &s);
+			} else {
+				stall++;
+			}
+		}
+		restore_order (g, &s);
+	}
+	sweep_fini (&s);
 }
 
 /* returns the distance between two nodes */
 /* if the distance between two nodes were explicitly set, returns that;
  * otherwise calculate the distance of two nodes on the same layer */
 static int dist_nodes(const RAGraph *g, const RGraphNode *a, const RGraphNode *b) {
-	struct dist_t d;
 	const RANode *aa, *ab;
-	RListIter *it;
+	bool found;
 	int res = 0;
 
 	if (g->dists) {
-		d.from = a;
-		d.to = b;
-		it = r_list_find (g->dists, &d, (RListComparator) find_dist);
-		if (it) {
-			struct dist_t *old = (struct dist_t *) r_list_iter_get_data (it);
-			return old->dist;
+		int dist = (int) (size_t) ht_up_find (g->dists, dist_key (a, b), &found);
+		if (found) {
+			return dist;
 		}
 	}
 
@@ -796,16 +922,12 @@ static int dist_nodes(const RAGraph *g, const RGraphNode *a, const RGraphNode *b
 			const RGraphNode *next = g->layers[aa->layer].nodes[i + 1];
 			const RANode *anext = get_anode (next);
 			const RANode *acur = get_anode (cur);
-			int found = false;
 
+			found = false;
 			if (g->dists) {
-				d.from = cur;
-				d.to = next;
-				it = r_list_find (g->dists, &d, (RListComparator) find_dist);
-				if (it) {
-					struct dist_t *old = (struct dist_t *) r_list_iter_get_data (it);
-					res += old->dist;
-					found = true;
+				int dist = (int) (size_t) ht_up_find (g->dists, dist_key (cur, next), &found);
+				if (found) {
+					res += dist;
 				}
 			}
 
@@ -830,10 +952,9 @@ static int dist_nodes(const RAGraph *g, const RGraphNode *a, const RGraphNode *b
 
 /* explictly set the distance between two nodes on the same layer */
 static void set_dist_nodes(const RAGraph *g, int l, int cur, int next) {
-	struct dist_t *d, find_el;
 	const RGraphNode *vi, *vip;
 	const RANode *avi, *avip;
-	RListIter *it;
+	int dist;
 
 	if (!g->dists) {
 		return;
@@ -843,17 +964,8 @@ static void set_dist_nodes(const RAGraph *g, int l, int cur, int next) {
 	avi = get_anode (vi);
 	avip = get_anode (vip);
 
-	find_el.from = vi;
-	find_el.to = vip;
-	it = r_list_find (g->dists, &find_el, (RListComparator) find_dist);
-	d = it? (struct dist_t *) r_list_iter_get_data (it): R_NEW0 (struct dist_t);
-
-	d->from = vi;
-	d->to = vip;
-	d->dist = (avip && avi)? avip->x - avi->x: 0;
-	if (!it) {
-		r_list_push (g->dists, d);
-	}
+	dist = (avip && avi)? avip->x - avi->x: 0;
+	ht_up_update (g->dists, dist_key (vi, vip), (void *) (size_t) dist);
 }
 
 static int is_valid_pos(const RAGraph *g, int l, int pos) {
@@ -864,19 +976,21 @@ static int is_valid_pos(const RAGraph *g, int l, int pos) {
 /* if v is an original node, L(v) = { v }
  * if v is a dummy node, L(v) is the set of all the dummies node that belongs
  *      to the same long edge */
-static Sdb *compute_vertical_nodes(const RAGraph *g) {
-	Sdb *res = sdb_new0 ();
+static RList **compute_vertical_nodes(const RAGraph *g) {
+	RList **res = R_NEWS0 (RList *, R_MAX (g->graph->last_index, 1));
 	int i, j;
 
+	if (!res) {
+		return NULL;
+	}
 	for (i = 0; i < g->n_layers; ++i) {
 		for (j = 0; j < g->layers[i].n_nodes; ++j) {
 			RGraphNode *gn = g->layers[i].nodes[j];
-			const RList *Ln = hash_get_rlist (res, gn);
 			const RANode *an = get_anode (gn);
 
-			if (!Ln) {
+			if (!res[gn->idx]) {
 				RList *vert = r_list_new ();
-				hash_set (res, gn, vert);
+				res[gn->idx] = vert;
 				if (an->is_dummy) {
 					RGraphNode *next = gn;
 					const RANode *anext = get_anode (next);
@@ -904,7 +1018,7 @@ static Sdb *compute_vertical_nodes(const RAGraph *g) {
  * - v E C
  * - w E C => L(v) is a subset of C
  * - w E C, the s+(w) exists and is not in any class yet => s+(w) E C */
-static RList **compute_classes(const RAGraph *g, Sdb *v_nodes, int is_left, int *n_classes) {
+static RList **compute_classes(const RAGraph *g, RList **v_nodes, int is_left, int *n_classes) {
 	int i, j, c;
 	RList **res = R_NEWS0 (RList *, g->n_layers);
 	RGraphNode *gn;
@@ -925,7 +1039,7 @@ static RList **compute_classes(const RAGraph *g, Sdb *v_nodes, int is_left, int
 			const RANode *aj = get_anode (gj);
 
 			if (aj->klass == -1) {
-				const RList *laj = hash_get_rlist (v_nodes, gj);
+				const RList *laj = v_nodes[gj->idx];
 
 				if (!res[c]) {
 					res[c] = r_list_new ();
@@ -966,16 +1080,16 @@ static RGraphNode *get_sibling(const RAGraph *g, const RANode *n, int is_left, i
 	return res;
 }
 
-static int adjust_class_val(const RAGraph *g, const RGraphNode *gn, const RGraphNode *sibl, Sdb *res, int is_left) {
+static int adjust_class_val(const RAGraph *g, const RGraphNode *gn, const RGraphNode *sibl, int *res, int is_left) {
 	if (is_left) {
-		return hash_get_int (res, sibl) - hash_get_int (res, gn) - dist_nodes (g, gn, sibl);
+		return res[sibl->idx] - res[gn->idx] - dist_nodes (g, gn, sibl);
 	}
-	return hash_get_int (res, gn) - hash_get_int (res, sibl) - dist_nodes (g, sibl, gn);
+	return res[gn->idx] - res[sibl->idx] - dist_nodes (g, sibl, gn);
 }
 
 /* adjusts the position of previously placed left/right classes */
 /* tries to place classes as close as possible */
-static void adjust_class(const RAGraph *g, int is_left, RList **classes, Sdb *res, int c) {
+static void adjust_class(const RAGraph *g, int is_left, RList **classes, int *res, int c) {
 	const RGraphNode *gn;
 	const RListIter *it;
 	const RANode *an;
@@ -1030,17 +1144,15 @@ static void adjust_class(const RAGraph *g, int is_left, RList **classes, Sdb *re
 	}
 
 	graph_foreach_anode (classes[c], it, gn, an) {
-		const int old_val = hash_get_int (res, gn);
-		const int new_val = is_left? old_val + dist: old_val - dist;
-		hash_set (res, gn, new_val);
+		res[gn->idx] = is_left? res[gn->idx] + dist: res[gn->idx] - dist;
 	}
 }
 
-static int place_nodes_val(const RAGraph *g, const RGraphNode *gn, const RGraphNode *sibl, Sdb *res, int is_left) {
+static int place_nodes_val(const RAGraph *g, const RGraphNode *gn, const RGraphNode *sibl, int *res, int is_left) {
 	if (is_left) {
-		return hash_get_int (res, sibl) + dist_nodes (g, sibl, gn);
+		return res[sibl->idx] + dist_nodes (g, sibl, gn);
 	}
-	return hash_get_int (res, sibl) - dist_nodes (g, gn, sibl);
+	return res[sibl->idx] - dist_nodes (g, gn, sibl);
 }
 
 static int place_nodes_sel_p(int newval, int oldval, int is_first, int is_left) {
@@ -1054,8 +1166,8 @@ static int place_nodes_sel_p(int newval, int oldval, int is_first, int is_left)
 }
 
 /* places left/right the nodes of a class */
-static void place_nodes(const RAGraph *g, const RGraphNode *gn, int is_left, Sdb *v_nodes, RList **classes, Sdb *res, Sdb *placed) {
-	const RList *lv = hash_get_rlist (v_nodes, gn);
+static void place_nodes(const RAGraph *g, const RGraphNode *gn, int is_left, RList **v_nodes, RList **classes, int *res, bool *placed) {
+	const RList *lv = v_nodes[gn->idx];
 	int p = 0, v, is_first = true;
 	const RGraphNode *gk;
 	const RListIter *itk;
@@ -1071,7 +1183,7 @@ static void place_nodes(const RAGraph *g, const RGraphNode *gn, int is_left, Sdb
 		}
 		sibl_anode = get_anode (sibling);
 		if (ak->klass == sibl_anode->klass) {
-			if (!hash_get (placed, sibling)) {
+			if (!placed[sibling->idx]) {
 				place_nodes (g, sibling, is_left, v_nodes, classes, res, placed);
 			}
 
@@ -1086,14 +1198,15 @@ static void place_nodes(const RAGraph *g, const RGraphNode *gn, int is_left, Sdb
 	}
 
 	graph_foreach_anode (lv, itk, gk, ak) {
-		hash_set (res, gk, p);
-		hash_set (placed, gk, true);
+		res[gk->idx] = p;
+		placed[gk->idx] = true;
 	}
 }
 
 /* computes the position to the left/right of all the nodes */
-static Sdb *compute_pos(const RAGraph *g, int is_left, Sdb *v_nodes) {
-	Sdb *res, *placed;
+static int *compute_pos(const RAGraph *g, int is_left, RList **v_nodes) {
+	int *res = NULL;
+	bool *placed;
 	RList **classes;
 	int n_classes, i;
 
@@ -1102,14 +1215,16 @@ static Sdb *compute_pos(const RAGraph *g, int is_left, Sdb *v_nodes) {
 		return NULL;
 	}
 
-	res = sdb_new0 ();
-	placed = sdb_new0 ();
-	for (i = 0; i < n_classes; ++i) {
+	placed = R_NEWS0 (bool, R_MAX (g->graph->last_index, 1));
+	if (placed) {
+		res = R_NEWS0 (int, R_MAX (g->graph->last_index, 1));
+	}
+	for (i = 0; res && i < n_classes; ++i) {
 		const RGraphNode *gn;
 		const RListIter *it;
 
 		r_list_foreach (classes[i], it, gn) {
-			if (!hash_get_rnode (placed, gn)) {
+			if (!placed[gn->idx]) {
 				place_nodes (g, gn, is_left, v_nodes, classes, res, placed);
 			}
 		}
@@ -1117,7 +1232,7 @@ static Sdb *compute_pos(const RAGraph *g, int is_left, Sdb *v_nodes) {
 		adjust_class (g, is_left, classes, res, i);
 	}
 
-	sdb_free (placed);
+	free (placed);
 	for (i = 0; i < n_classes; ++i) {
 		if (classes[i]) {
 			r_list_free (classes[i]);
@@ -1127,17 +1242,13 @@ static Sdb *compute_pos(const RAGraph *g, int is_left, Sdb *v_nodes) {
 	return res;
 }
 
-static int free_vertical_nodes_cb(void *user UNUSED, const char *k UNUSED, const char *v) {
-	r_list_free ((RList *) (size_t) sdb_atoi (v));
-	return 1;
-}
-
 /* calculates position of all nodes, but in particular dummies nodes */
 /* computes two different placements (called "left"/"right") and set the final
  * position of each node to the average of the values in the two placements */
 static void place_dummies(const RAGraph *g) {
 	const RList *nodes;
-	Sdb *xminus, *xplus, *vertical_nodes;
+	RList **vertical_nodes;
+	int *xminus, *xplus, i;
 	const RGraphNode *gn;
 	const RListIter *it;
 	RANode *n;
@@ -1157,15 +1268,17 @@ static void place_dummies(const RAGraph *g) {
 
 	nodes = r_graph_get_nodes (g->graph);
 	graph_foreach_anode (nodes, it, gn, n) {
-		n->x = (hash_get_int (xminus, gn) + hash_get_int (xplus, gn)) / 2;
+		n->x = (xminus[gn->idx] + xplus[gn->idx]) / 2;
 	}
 
-	sdb_free (xplus);
+	free (xplus);
 xplus_err:
-	sdb_free (xminus);
+	free (xminus);
 xminus_err:
-	sdb_foreach (vertical_nodes, (SdbForeachCallback)free_vertical_nodes_cb, NULL);
-	sdb_free (vertical_nodes);
+	for (i = 0; i < g->graph->last_index; i++) {
+		r_list_free (vertical_nodes[i]);
+	}
+	free (vertical_nodes);
 }
 
 static RGraphNode *get_right_dummy(const RAGraph *g, const RGraphNode *n) {
@@ -1189,7 +1302,7 @@ static RGraphNode *get_right_dummy(const RAGraph *g, const RGraphNode *n) {
 	return NULL;
 }
 
-static void adjust_directions(const RAGraph *g, int i, int from_up, Sdb *D, Sdb *P) {
+static void adjust_directions(const RAGraph *g, int i, int from_up, int *D, int *P) {
 	const RGraphNode *vm = NULL, *wm = NULL;
 	const RANode *vma = NULL, *wma = NULL;
 	int j, d = from_up? 1: -1;
@@ -1214,23 +1327,23 @@ static void adjust_directions(const RAGraph *g, int i, int from_up, Sdb *D, Sdb
 			continue;
 		}
 		if (vm) {
-			int p = hash_get_int (P, wm);
+			int p = P[wm->idx];
 			int k;
 
 			for (k = wma->pos_in_layer + 1; k < wpa->pos_in_layer; ++k) {
 				const RGraphNode *w = g->layers[wma->layer].nodes[k];
 				const RANode *aw = get_anode (w);
 				if (aw && aw->is_dummy) {
-					p &= hash_get_int (P, w);
+					p &= P[w->idx];
 				}
 			}
 			if (p) {
-				hash_set (D, vm, from_up);
+				D[vm->idx] = from_up;
 				for (k = vma->pos_in_layer + 1; k < vpa->pos_in_layer; ++k) {
 					const RGraphNode *v = g->layers[vma->layer].nodes[k];
 					const RANode *av = get_anode (v);
 					if (av && av->is_dummy) {
-						hash_set (D, v, from_up);
+						D[v->idx] = from_up;
 					}
 				}
 			}
@@ -1451,7 +1564,7 @@ static void place_sequence(const RAGraph *g, int l, const RGraphNode *bm, const
 /* finds the placements of nodes while traversing the graph in the given
  * direction */
 /* places all the sequences of consecutive original nodes in each layer. */
-static void original_traverse_l(const RAGraph *g, Sdb *D, Sdb *P, int from_up) {
+static void original_traverse_l(const RAGraph *g, int *D, int *P, int from_up) {
 	int i, k, va, vr;
 
 	for (i = from_up? 0: g->n_layers - 1;
@@ -1500,12 +1613,12 @@ static void original_traverse_l(const RAGraph *g, Sdb *D, Sdb *P, int from_up) {
 				if (is_valid_pos (g, i, va)) {
 					set_dist_nodes (g, i, bma->pos_in_layer, va);
 				}
-			} else if (hash_get_int (D, bm) == from_up) {
+			} else if (D[bm->idx] == from_up) {
 				bpa = get_anode (bp);
 				va = bma->pos_in_layer + 1;
 				vr = bpa->pos_in_layer;
 				place_sequence (g, i, bm, bp, from_up, va, vr);
-				hash_set (P, bm, true);
+				P[bm->idx] = true;
 			}
 			bm = bp;
 		}
@@ -1518,24 +1631,24 @@ static void original_traverse_l(const RAGraph *g, Sdb *D, Sdb *P, int from_up) {
 /* set the node placements traversing the graph downward and then upward */
 static void place_original(RAGraph *g) {
 	const RList *nodes = r_graph_get_nodes (g->graph);
-	Sdb *D, *P;
+	int *D, *P;
 	const RGraphNode *gn;
 	const RListIter *itn;
 	const RANode *an;
 
-	D = sdb_new0 ();
+	D = R_NEWS0 (int, R_MAX (g->graph->last_index, 1));
 	if (!D) {
 		return;
 	}
-	P = sdb_new0 ();
+	P = R_NEWS0 (int, R_MAX (g->graph->last_index, 1));
 	if (!P) {
-		sdb_free (D);
+		free (D);
 		return;
 	}
-	g->dists = r_list_newf ((RListFree) free);
+	g->dists = ht_up_new0 ();
 	if (!g->dists) {
-		sdb_free (D);
-		sdb_free (P);
+		free (D);
+		free (P);
 		return;
 	}
 
@@ -1546,19 +1659,18 @@ static void place_original(RAGraph *g) {
 		const RGraphNode *right_v = get_right_dummy (g, gn);
 		const RANode *right = get_anode (right_v);
 		if (right_v && right) {
-			hash_set (D, gn, 0);
-			int dt_eq = right->x - an->x == dist_nodes (g, gn, right_v);
-			hash_set (P, gn, dt_eq);
+			D[gn->idx] = 0;
+			P[gn->idx] = right->x - an->x == dist_nodes (g, gn, right_v);
 		}
 	}
 
 	original_traverse_l (g, D, P, true);
 	original_traverse_l (g, D, P, false);
 
-	r_list_free (g->dists);
+	ht_up_free (g->dists);
 	g->dists = NULL;
-	sdb_free (P);
-	sdb_free (D);
+	free (P);
+	free (D);
 }
 
 #if 0
@@ -3862,6 +3974,54 @@ static void rotateColor(RCore *core) {
 	r_config_set_i (core->config, "scr.color", color);
 }
 
+/* lays out the basic blocks of fcn, or g when given, without drawing them
+ * and reports how long it took */
+R_API bool r_core_agraph_bench(RCore *core, RAGraph *g, RAnalFunction *fcn) {
+	RListIter *it;
+	RGraphNode *gn;
+	RANode *an;
+	int n_nodes, n_edges, n_dummies = 0;
+	bool graph_allocated = false;
+	ut64 t;
+
+	r_return_val_if_fail (core && (g || fcn), false);
+	if (!g) {
+		RConsCanvas *can = r_cons_canvas_new (1, 1);
+		if (!can) {
+			return false;
+		}
+		g = r_agraph_new (can);
+		if (!g) {
+			r_cons_canvas_free (can);
+			return false;
+		}
+		graph_allocated = true;
+		if (!get_bbnodes (g, core, fcn)) {
+			r_agraph_free (g);
+			return false;
+		}
+	}
+	g->layout = r_config_get_i (core->config, "graph.layout");
+	g->sweeps = r_config_get_i (core->config, "graph.sweeps");
+	n_nodes = g->graph->n_nodes;
+	n_edges = g->graph->n_edges;
+	update_node_dimension (g->graph, is_mini (g), g->zoom, g->edgemode, g->is_callgraph, g->layout);
+
+	t = r_sys_now ();
+	agraph_set_layout (g);
+	t = r_sys_now () - t;
+
+	graph_foreach_anode (r_graph_get_nodes (g->graph), it, gn, an) {
+		n_dummies += an->is_dummy;
+	}
+	r_cons_printf ("nodes %d edges %d dummies %d layers %d layout %.3fs\n",
+		n_nodes, n_edges, n_dummies, g->n_layers, t / 1000000.0);
+	if (graph_allocated) {
+		r_agraph_free (g);
+	}
+	return true;
+}
+
 R_API int r_core_visual_graph(RCore *core, RAGraph *g, RAnalFunction *_fcn, int is_interactive) {
 	int o_asmqjmps_letter = core->is_asmqjmps_letter;
 	int o_scrinteractive = r_config_get_i (core->config, "scr.interactive");
@@ -3922,6 +4082,7 @@ R_API int r_core_visual_graph(RCore *core, RAGraph *g, RAnalFunction *_fcn, int
 	r_config_set_i (core->config, "scr.interactive", false);
 	g->can = can;
 	g->movspeed = r_config_get_i (core->config, "graph.scroll");
+	g->sweeps = r_config_get_i (core->config, "graph.sweeps");
 	g->on_curnode_change = (RANodeCallback) seek_to_node;
 	g->on_curnode_change_data = core;
 	g->edgemode = r_config_get_i (core->config, "graph.edges");
@@ -409,6 +409,10 @@ static void activateDieTime (RCore *core) {
 	}
 }
 
+static void rtr_http_chunk(void *user, const char *buf, int len) {
+	r_socket_http_chunk ((RSocketHTTPRequest *)user, buf, len);
+}
+
 // return 1 on error
 static int r_core_rtr_http_run(RCore *core, int launch, int browse, const char *path) {
 	RConfig *newcfg = NULL, *origcfg = NULL;
@@ -734,6 +738,7 @@ static int r_core_rtr_http_run(RCore *core, int launch, int browse, const char *
 							free (bar);
 						} else {
 							char *out, *cmd = rs->path + 5;
+							bool sent = false;
 							r_str_uri_decode (cmd);
 							r_config_set (core->config, "scr.interactive", "false");
 
@@ -745,11 +750,27 @@ static int r_core_rtr_http_run(RCore *core, int launch, int browse, const char *
 								/* commands in /cmd/: starting with : do not show any output */
 								r_core_cmd0 (core, cmd + 1);
 								out = NULL;
+							} else if (r_config_get_i (core->config, "scr.stream") > 0 && !strchr (cmd, '|')) {
+								/* send the output in chunks while the command runs */
+								char *newheaders = r_str_newf (
+										"Content-Type: text/plain\n%s", headers);
+								r_socket_http_response_chunked (rs, 200, newheaders);
+								free (newheaders);
+								r_cons_reset ();
+								r_cons_set_stream (rtr_http_chunk, rs);
+								r_core_cmd0 (core, cmd);
+								r_cons_flush ();
+								r_cons_set_stream (NULL, NULL);
+								r_socket_http_chunk (rs, NULL, 0);
+								out = NULL;
+								sent = true;
 							} else {
 								out = r_core_cmd_str_pipe (core, cmd);
 							}
 
-							if (out) {
+							if (sent) {
+								// the response is complete
+							} else if (out) {
 								char *res = r_str_uri_encode (out);
 								char *newheaders = r_str_newf (
 										"Content-Type: text/plain\n%s", headers);
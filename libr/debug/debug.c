@@ -40,7 +40,7 @@ R_API void r_debug_bp_update(RDebug *dbg) {
 	RListIter *iter;
 	r_list_foreach (dbg->bp->bps, iter, bp) {
 		if (bp->expr) {
-			bp->addr = dbg->corebind.numGet (dbg->corebind.core, bp->expr);
+			r_bp_move (dbg->bp, bp, dbg->corebind.numGet (dbg->corebind.core, bp->expr));
 		}
 	}
 }
@@ -275,9 +275,11 @@ R_API void r_debug_session_save(RDebug *dbg, const char *file) {
 		snapentry.perm = base->perm;
 		r_file_dump (base_file, (const ut8 *) &snapentry, sizeof (RSnapEntry), 1);
 		r_file_dump (base_file, (const ut8 *) base->data, base->size, 1);
-		/* dump all hases */
+		/* dump all hashes, the file keeps 128 byte slots for them */
 		for (i = 0; i < base->page_num; i++) {
-			r_file_dump (base_file, (const ut8 *) base->hashes[i], 128, 1);
+			ut8 slot[128] = {0};
+			r_write_le64 (slot, base->hashes[i]);
+			r_file_dump (base_file, slot, sizeof (slot), 1);
 		}
 	}
 
@@ -312,9 +314,11 @@ R_API void r_debug_session_save(RDebug *dbg, const char *file) {
 
 			/* Dump page entries */
 			r_list_foreach (snapdiff->pages, iter3, page) {
+				ut8 slot[128] = {0};
+				r_write_le64 (slot, page->hash);
 				r_file_dump (diff_file, (const ut8 *) &page->page_off, sizeof (ut32), 1);
 				r_file_dump (diff_file, (const ut8 *) page->data, SNAP_PAGE_SIZE, 1);
-				r_file_dump (diff_file, (const ut8 *) page->hash, 128, 1);
+				r_file_dump (diff_file, slot, sizeof (slot), 1);
 			}
 		}
 	}
@@ -380,13 +384,14 @@ R_API void r_debug_session_restore(RDebug *dbg, const char *file) {
 			R_FREE (base);
 			break;
 		}
-		/* restore all hases */
-		base->hashes = R_NEWS0 (ut8 *, base->page_num);
+		/* restore all hashes, sessions saved with sha256 ones just look changed */
+		base->hashes = R_NEWS0 (ut64, base->page_num);
 		for (i = 0; i < base->page_num; i++) {
-			base->hashes[i] = calloc (1, 128);
-			if (fread (base->hashes[i], 128, 1, fd) != 1) {
+			ut8 slot[128];
+			if (fread (slot, sizeof (slot), 1, fd) != 1) {
 				break;
 			}
+			base->hashes[i] = r_read_le64 (slot);
 		}
 		r_list_append (dbg->snaps, base);
 	}
@@ -481,7 +486,9 @@ R_API void r_debug_session_restore(RDebug *dbg, const char *file) {
 				page->data = calloc (1, clust_page);
 				(void) fread (&page->page_off, sizeof (ut32), 1, fd);
 				(void) fread (page->data, SNAP_PAGE_SIZE, 1, fd);
-				(void) fread (page->hash, 128, 1, fd);
+				ut8 slot[128] = {0};
+				(void) fread (slot, sizeof (slot), 1, fd);
+				page->hash = r_read_le64 (slot);
 				snapdiff->last_changes[page->page_off] = page;
 				r_list_append (snapdiff->pages, page);
 			}
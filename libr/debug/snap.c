@@ -1,15 +1,178 @@
-/* radare - LGPL - Copyright 2015-2017 - pancake, rkx1209 */
+/* radare - LGPL - Copyright 2015-2019 - pancake, rkx1209 */
 
 #include <r_debug.h>
 
+#define SNAP_CHUNK 256 // pages read at once when diffing
+
+// the pages are told apart with an xxh64 like fingerprint, it is not
+// meant to resist collisions crafted by the debuggee
+#define SNAP_P1 0x9E3779B185EBCA87ULL
+#define SNAP_P2 0xC2B2AE3D27D4EB4FULL
+#define SNAP_ROTL(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static ut64 snap_page_hash(const ut8 *buf, int len) {
+	ut64 acc[4] = { SNAP_P1 + SNAP_P2, SNAP_P2, 0, -SNAP_P1 };
+	ut64 h, w;
+	int i, j;
+	for (i = 0; i + 32 <= len; i += 32) {
+		for (j = 0; j < 4; j++) {
+			memcpy (&w, buf + i + j * 8, sizeof (w));
+			acc[j] = SNAP_ROTL (acc[j] + w * SNAP_P2, 31) * SNAP_P1;
+		}
+	}
+	h = SNAP_ROTL (acc[0], 1) + SNAP_ROTL (acc[1], 7) + SNAP_ROTL (acc[2], 12) + SNAP_ROTL (acc[3], 18) + len;
+	for (; i < len; i++) {
+		h = SNAP_ROTL (h ^ (buf[i] * SNAP_P1), 11) * SNAP_P2;
+	}
+	h ^= h >> 33;
+	h *= SNAP_P2;
+	h ^= h >> 29;
+	h *= SNAP_P1;
+	h ^= h >> 32;
+	return h;
+}
+
+// fingerprint of the page as of the last diff
+static ut64 snap_page_last_hash(RDebugSnap *snap, ut32 page_off) {
+	RDebugSnapDiff *last = r_list_last (snap->history);
+	RPageData *page = last? last->last_changes[page_off]: NULL;
+	return page? page->hash: snap->hashes[page_off];
+}
+
+static void snap_untrack(RDebug *dbg) {
+	RListIter *iter;
+	RDebugSnap *snap;
+	r_list_foreach (dbg->snaps, iter, snap) {
+		if (snap->dirty) {
+			r_bitmap_free (snap->dirty);
+			snap->dirty = NULL;
+		}
+	}
+}
+
+#if __linux__
+/* Linux keeps a soft-dirty bit in the page tables of the processes, set on
+ * every write since the last "4" written to /proc/pid/clear_refs and shown
+ * in /proc/pid/pagemap, so the diffs only have to read the written pages. */
+#define PM_PRESENT (1ULL << 63)
+#define PM_SWAP (1ULL << 62)
+#define PM_EXCLUSIVE (1ULL << 56)
+#define PM_SOFT_DIRTY (1ULL << 55)
+
+static ut64 snap_zero_hash(void) {
+	static ut64 zero_hash = 0;
+	static bool done = false;
+	if (!done) {
+		ut8 zero[SNAP_PAGE_SIZE] = {0};
+		zero_hash = snap_page_hash (zero, sizeof (zero));
+		done = true;
+	}
+	return zero_hash;
+}
+
+static bool soft_dirty_clear(int pid) {
+	char path[64];
+	snprintf (path, sizeof (path), "/proc/%d/clear_refs", pid);
+	int fd = open (path, O_WRONLY);
+	if (fd == -1) {
+		return false;
+	}
+	bool ret = write (fd, "4", 1) == 1;
+	close (fd);
+	return ret;
+}
+
+static bool pagemap_read(int fd, ut64 page, ut64 *pme, int n) {
+	ssize_t len = n * sizeof (ut64);
+	return pread (fd, pme, len, page * sizeof (ut64)) == len;
+}
+
+// kernels without CONFIG_MEM_SOFT_DIRTY accept the clear but never set the bit
+static bool soft_dirty_supported(void) {
+	static int supported = -1;
+	if (supported == -1) {
+		supported = 0;
+		ut8 *buf = malloc (SNAP_PAGE_SIZE * 2);
+		int fd = open ("/proc/self/pagemap", O_RDONLY);
+		if (buf && fd != -1 && sysconf (_SC_PAGESIZE) == SNAP_PAGE_SIZE && soft_dirty_clear (getpid ())) {
+			volatile ut8 *page = (ut8 *)(((size_t)buf + SNAP_PAGE_SIZE - 1) & ~(size_t)(SNAP_PAGE_SIZE - 1));
+			ut64 pme = 0;
+			*page = 1;
+			if (pagemap_read (fd, (size_t)page / SNAP_PAGE_SIZE, &pme, 1) && (pme & PM_SOFT_DIRTY)) {
+				supported = 1;
+			}
+		}
+		if (fd != -1) {
+			close (fd);
+		}
+		free (buf);
+	}
+	return supported == 1;
+}
+
+// opt-in with dbg.softdirty, it was only tried with simulated bits
+static bool snap_tracking(RDebug *dbg) {
+	return dbg->softdirty && dbg->pid > 0 && dbg->h && !strcmp (dbg->h->name, "native") && soft_dirty_supported ();
+}
+
+/* Fold the soft-dirty bits of every tracked snap into its bitmap before
+ * clearing them, clear_refs works on the whole process. Pages that are not
+ * mapped or shared may have been dropped and read back as zeroes or file
+ * contents without a write, so they count as dirty unless they were zero. */
+static bool snap_dirty_sync(RDebug *dbg) {
+	ut64 pme[SNAP_CHUNK];
+	char path[64];
+	RListIter *iter;
+	RDebugSnap *snap;
+	ut32 i, j;
+	if (!snap_tracking (dbg)) {
+		return false;
+	}
+	snprintf (path, sizeof (path), "/proc/%d/pagemap", dbg->pid);
+	int fd = open (path, O_RDONLY);
+	if (fd == -1) {
+		return false;
+	}
+	ut64 zero = snap_zero_hash ();
+	bool ret = true;
+	r_list_foreach (dbg->snaps, iter, snap) {
+		if (!snap->dirty) {
+			continue;
+		}
+		for (i = 0; ret && i < snap->page_num; i += SNAP_CHUNK) {
+			ut32 n = R_MIN (SNAP_CHUNK, snap->page_num - i);
+			if (!pagemap_read (fd, snap->addr / SNAP_PAGE_SIZE + i, pme, n)) {
+				ret = false;
+				break;
+			}
+			for (j = 0; j < n; j++) {
+				bool mapped = (pme[j] & (PM_PRESENT | PM_EXCLUSIVE)) == (PM_PRESENT | PM_EXCLUSIVE)
+					|| (pme[j] & PM_SWAP);
+				if ((pme[j] & PM_SOFT_DIRTY) || (!mapped && snap_page_last_hash (snap, i + j) != zero)) {
+					r_bitmap_set (snap->dirty, i + j);
+				}
+			}
+		}
+	}
+	close (fd);
+	return ret && soft_dirty_clear (dbg->pid);
+}
+#else
+static bool snap_tracking(RDebug *dbg) {
+	return false;
+}
+
+static bool snap_dirty_sync(RDebug *dbg) {
+	return false;
+}
+#endif
+
 R_API RDebugSnap *r_debug_snap_new() {
 	RDebugSnap *snap = R_NEW0 (RDebugSnap);
-	ut64 algobit = r_hash_name_to_bits ("sha256");
 	if (!snap) {
 		return NULL;
 	}
 	snap->history = r_list_newf (r_debug_diff_free);
-	snap->hash_ctx = r_hash_new (true, algobit);
 	return snap;
 }
 
@@ -19,6 +182,9 @@ R_API void r_debug_snap_free(void *p) {
 	free (snap->data);
 	free (snap->comment);
 	free (snap->hashes);
+	if (snap->dirty) {
+		r_bitmap_free (snap->dirty);
+	}
 	free (snap);
 }
 
@@ -101,8 +267,11 @@ R_API RDebugSnap *r_debug_snap_get(RDebug *dbg, ut64 addr) {
 
 static void r_page_data_set(RDebug *dbg, RPageData *page) {
 	RDebugSnapDiff *diff = page->diff;
-	ut64 addr = diff->base->addr + page->page_off * SNAP_PAGE_SIZE;
+	ut64 addr = diff->base->addr + (ut64)page->page_off * SNAP_PAGE_SIZE;
 	dbg->iob.write_at (dbg->iob.io, addr, page->data, SNAP_PAGE_SIZE);
+	if (diff->base->dirty) {
+		r_bitmap_set (diff->base->dirty, page->page_off);
+	}
 }
 
 /* snap->history must have at least one entry */
@@ -131,6 +300,9 @@ R_API void r_debug_diff_set(RDebug *dbg, RDebugSnapDiff *diff) {
 			ut64 off = (ut64) last_page->page_off * SNAP_PAGE_SIZE;
 			/* Copy a page data of base snap to current addr. (i.e. roll back) */
 			dbg->iob.write_at (dbg->iob.io, addr, snap->data + off, SNAP_PAGE_SIZE);
+			if (snap->dirty) {
+				r_bitmap_set (snap->dirty, page_off);
+			}
 			//eprintf ("Roll back 0x%08"PFMT64x "(page: %d)\n", addr, page_off);
 		}
 	}
@@ -169,6 +341,9 @@ R_API void r_debug_diff_set_base(RDebug *dbg, RDebugSnap *base) {
 			ut64 off = (ut64) last_page->page_off * SNAP_PAGE_SIZE;
 			/* Copy a page data of base snap to current addr. (i.e. roll back) */
 			dbg->iob.write_at (dbg->iob.io, addr, base->data + off, SNAP_PAGE_SIZE);
+			if (base->dirty) {
+				r_bitmap_set (base->dirty, page_off);
+			}
 			//eprintf ("Roll back 0x%08"PFMT64x "(page: %d)\n", addr, page_off);
 		}
 	}
@@ -199,75 +374,51 @@ R_API int r_debug_snap_set_idx(RDebug *dbg, int idx) {
 	return 1;
 }
 
-/* XXX: Just for debugging. Duplicate soon */
-#if 0
-static void print_hash(ut8 *hash, int digest_size) {
-	int i = 0;
-	for (i = 0; i < digest_size; i++) {
-		eprintf ("%02"PFMT32x, hash[i]);
-	}
-	eprintf ("\n");
-}
-#endif
-
 R_API RDebugSnapDiff *r_debug_snap_map(RDebug *dbg, RDebugMap *map) {
 	if (!dbg || !map || map->size < 1) {
 		eprintf ("Invalid map size\n");
 		return NULL;
 	}
-	ut8 *hash;
-	ut64 addr;
-	ut64 algobit = r_hash_name_to_bits ("sha256");
-	ut32 page_num = map->size / SNAP_PAGE_SIZE;
-	ut32 digest_size;
+	ut32 page_off, page_num = map->size / SNAP_PAGE_SIZE;
 	/* Get an existing snapshot entry */
 	RDebugSnap *snap = r_debug_snap_get_map (dbg, map);
-	if (!snap) {
-		/* Create a new one */
-		if (!(snap = r_debug_snap_new ())) {
-			return NULL;
-		}
-		snap->timestamp = sdb_now ();
-		snap->addr = map->addr;
-		snap->addr_end = map->addr_end;
-		snap->size = map->size;
-		snap->page_num = page_num;
-		snap->data = malloc (map->size);
-		snap->perm = map->perm;
-		if (!snap->data) {
-			goto error;
-		}
-		snap->hashes = R_NEWS0 (ut8 *, page_num);
-		if (!snap->hashes) {
-			free (snap->data);
-			goto error;
-		}
-		eprintf ("Reading %d byte(s) from 0x%08"PFMT64x "...\n", snap->size, snap->addr);
-		dbg->iob.read_at (dbg->iob.io, snap->addr, snap->data, snap->size);
-
-		ut32 clust_page = R_MIN (SNAP_PAGE_SIZE, snap->size);
-
-		/* Calculate all hashes of pages */
-		for (addr = snap->addr; addr < snap->addr_end; addr += SNAP_PAGE_SIZE) {
-			ut32 page_off = (addr - snap->addr) / SNAP_PAGE_SIZE;
-			digest_size = r_hash_calculate (snap->hash_ctx, algobit, &snap->data[addr - snap->addr], clust_page);
-			hash = calloc (128, 1);	// Fix hash size to 128 byte
-			memcpy (hash, snap->hash_ctx->digest, digest_size);
-			snap->hashes[page_off] = hash;
-			// eprintf ("0x%08"PFMT64x"(page: %d)...\n",addr, page_off);
-			// print_hash (hash, digest_size);
-		}
-
-		r_list_append (dbg->snaps, snap);
-		goto okay;
-	} else {
+	if (snap) {
 		/* A base snapshot have already been saved. *
 		        So we only need to save different parts. */
 		return r_debug_diff_add (dbg, snap);
 	}
-error:
-	free (snap);
-okay:
+	/* Create a new one */
+	if (!(snap = r_debug_snap_new ())) {
+		return NULL;
+	}
+	snap->timestamp = sdb_now ();
+	snap->addr = map->addr;
+	snap->addr_end = map->addr_end;
+	snap->size = map->size;
+	snap->page_num = page_num;
+	snap->perm = map->perm;
+	snap->data = malloc (map->size);
+	snap->hashes = R_NEWS0 (ut64, page_num);
+	if (!snap->data || !snap->hashes) {
+		r_debug_snap_free (snap);
+		return NULL;
+	}
+	eprintf ("Reading %d byte(s) from 0x%08"PFMT64x "...\n", snap->size, snap->addr);
+	dbg->iob.read_at (dbg->iob.io, snap->addr, snap->data, snap->size);
+
+	/* Calculate all hashes of pages */
+	for (page_off = 0; page_off < page_num; page_off++) {
+		snap->hashes[page_off] = snap_page_hash (snap->data + (ut64)page_off * SNAP_PAGE_SIZE, SNAP_PAGE_SIZE);
+	}
+	/* Writes are tracked from now on, after saving the bits of the other snaps */
+	if (snap_tracking (dbg)) {
+		if (snap_dirty_sync (dbg)) {
+			snap->dirty = r_bitmap_new (page_num);
+		} else {
+			snap_untrack (dbg);
+		}
+	}
+	r_list_append (dbg->snaps, snap);
 	return NULL;
 }
 
@@ -328,77 +479,78 @@ R_API void r_debug_diff_free(void *p) {
 
 R_API RDebugSnapDiff *r_debug_diff_add(RDebug *dbg, RDebugSnap *base) {
 	RDebugSnapDiff *prev_diff = NULL, *new_diff;
-	RPageData *new_page, *last_page;
-	ut64 addr;
-	int digest_size;
-	ut32 page_off;
-	ut64 algobit = r_hash_name_to_bits ("sha256");
-	ut32 clust_page = R_MIN (SNAP_PAGE_SIZE, base->size);
+	RPageData *new_page;
+	ut32 page_off, i, n;
+	ut8 *buf;
 
 	new_diff = R_NEW0 (RDebugSnapDiff);
 	if (!new_diff) {
-		goto error;
+		return NULL;
 	}
 	new_diff->base = base;
 	new_diff->pages = r_list_newf (r_page_data_free);
 	new_diff->last_changes = R_NEWS0 (RPageData *, base->page_num);
+	buf = malloc (SNAP_CHUNK * SNAP_PAGE_SIZE);
+	if (!new_diff->pages || !new_diff->last_changes || !buf) {
+		free (buf);
+		r_debug_diff_free (new_diff);
+		return NULL;
+	}
 	if (r_list_length (base->history)) {
 		/* Inherit last changes from previous SnapDiff */
 		prev_diff = (RDebugSnapDiff *) r_list_tail (base->history)->data;
 		memcpy (new_diff->last_changes, prev_diff->last_changes, sizeof (RPageData *) * base->page_num);
 	}
+	/* Without the written pages at hand every page is read */
+	bool tracked = false;
+	if (base->dirty) {
+		tracked = snap_dirty_sync (dbg);
+		if (!tracked) {
+			snap_untrack (dbg);
+		}
+	}
 
-	/* Compare hash of pages. */
-	for (addr = base->addr; addr < base->addr_end; addr += SNAP_PAGE_SIZE) {
-		ut8 *prev_hash, *cur_hash;
-		ut8 *buf = malloc (clust_page);
-		/* Copy current memory value to buf and calculate cur_hash from it. */
-		dbg->iob.read_at (dbg->iob.io, addr, buf, clust_page);
-		digest_size = r_hash_calculate (base->hash_ctx, algobit, buf, clust_page);
-		cur_hash = base->hash_ctx->digest;
-
-		page_off = (addr - base->addr) / SNAP_PAGE_SIZE;
-		/* Check If there is any last change for this page. */
-		if (prev_diff && (last_page = prev_diff->last_changes[page_off])) {
-			/* Use hash of last SnapDiff */
-			// eprintf ("use hash of diff\n");
-			prev_hash = last_page->hash;
-		} else {
-			/* Use hash of base snapshot */
-			// eprintf ("use hash of base\n");
-			prev_hash = base->hashes[page_off];
+	/* Compare hash of the pages, reading runs of them at once */
+	for (page_off = 0; page_off < base->page_num; page_off += n) {
+		if (tracked && !r_bitmap_test (base->dirty, page_off)) {
+			n = 1;
+			continue;
 		}
-		/* Memory has been changed. So add new diff entry for this addr */
-		if (memcmp (cur_hash, prev_hash, digest_size) != 0) {
-			// print_hash (cur_hash, digest_size);
-			// print_hash (prev_hash, digest_size);
-			/* Create new page diff entry, save one page and calculate hash. */
+		for (n = 1; n < SNAP_CHUNK && page_off + n < base->page_num; n++) {
+			if (tracked && !r_bitmap_test (base->dirty, page_off + n)) {
+				break;
+			}
+		}
+		ut64 addr = base->addr + (ut64)page_off * SNAP_PAGE_SIZE;
+		dbg->iob.read_at (dbg->iob.io, addr, buf, n * SNAP_PAGE_SIZE);
+		for (i = 0; i < n; i++) {
+			ut8 *data = buf + i * SNAP_PAGE_SIZE;
+			ut64 hash = snap_page_hash (data, SNAP_PAGE_SIZE);
+			if (tracked) {
+				r_bitmap_unset (base->dirty, page_off + i);
+			}
+			if (hash == snap_page_last_hash (base, page_off + i)) {
+				continue;
+			}
+			/* Memory has been changed. So add new diff entry for this page */
 			new_page = R_NEW0 (RPageData);
+			if (!new_page || !(new_page->data = malloc (SNAP_PAGE_SIZE))) {
+				free (new_page);
+				continue;
+			}
+			memcpy (new_page->data, data, SNAP_PAGE_SIZE);
 			new_page->diff = new_diff;
-			new_page->page_off = page_off;
-			new_page->data = buf;
-			memcpy (new_page->hash, cur_hash, digest_size);
-			new_diff->last_changes[page_off] = new_page;	// Update last change to new page
+			new_page->page_off = page_off + i;
+			new_page->hash = hash;
+			new_diff->last_changes[page_off + i] = new_page;	// Update last change to new page
 			r_list_append (new_diff->pages, new_page);
 		}
 	}
+	free (buf);
 	if (r_list_length (new_diff->pages)) {
-#if 0
-		RPageData *page;
-		RListIter *iter;
-		eprintf ("saved: 0x%08"PFMT64x "(page: ", base->addr);
-		r_list_foreach (new_diff->pages, iter, page) {
-			eprintf ("%d ", page->page_off);
-		}
-		eprintf (")\n");
-#endif
 		r_list_append (base->history, new_diff);
 		return new_diff;
-	} else {
-		r_debug_diff_free (new_diff);
-		return NULL;
 	}
-error:
-	free (new_diff);
+	r_debug_diff_free (new_diff);
 	return NULL;
 }
@@ -31,7 +31,7 @@ static const char *str_callback(RNum *user, ut64 off, int *ok) {
 
 static void flag_skiplist_free(void *data) {
 	RFlagsAtOffset *item = (RFlagsAtOffset *)data;
-	r_list_free (item->flags);
+	r_list_purge (item->flags);
 	free (data);
 }
 
@@ -63,13 +63,26 @@ static ut64 num_callback(RNum *user, const char *name, int *ok) {
 	return 0LL;
 }
 
+// names set in bulk point into a pool, they are copied before any of them
+// is replaced
+static void unpool_item(RFlagItem *item) {
+	if (item->pooled) {
+		char *name = strdup (item->name);
+		item->realname = item->realname == item->name? name: STRDUP_OR_NULL (item->realname);
+		item->name = name;
+		item->pooled = false;
+	}
+}
+
 static void free_item_realname(RFlagItem *item) {
+	unpool_item (item);
 	if (item->name != item->realname) {
 		free (item->realname);
 	}
 }
 
 static void free_item_name(RFlagItem *item) {
+	unpool_item (item);
 	if (item->name != item->realname) {
 		free (item->name);
 	}
@@ -104,18 +117,14 @@ static RFlagsAtOffset *flags_at_offset(RFlag *f, ut64 off) {
 		return res;
 	}
 
-	// there is no existing flagsAtOffset, we create one now
-	res = R_NEW (RFlagsAtOffset);
+	// there is no existing flagsAtOffset, we create one now, the list
+	// lives in the same allocation
+	res = malloc (sizeof (RFlagsAtOffset) + sizeof (RList));
 	if (!res) {
 		return NULL;
 	}
-
-	res->flags = r_list_new ();
-	if (!res->flags) {
-		free (res);
-		return NULL;
-	}
-
+	res->flags = (RList *)(res + 1);
+	r_list_init (res->flags);
 	res->off = off;
 	r_skiplist_insert (f->by_off, res);
 	return res;
@@ -141,7 +150,10 @@ static void set_name(RFlagItem *item, char *name) {
 
 static bool update_flag_item_offset(RFlag *f, RFlagItem *item, ut64 newoff, bool force) {
 	if (item->offset != newoff || force) {
-		remove_offsetmap (f, item);
+		// unnamed items are still being created and not indexed yet
+		if (item->name) {
+			remove_offsetmap (f, item);
+		}
 		item->offset = newoff;
 
 		RFlagsAtOffset *flagsAtOffset = flags_at_offset (f, newoff);
@@ -185,11 +197,34 @@ static bool update_flag_item_name(RFlag *f, RFlagItem *item, const char *newname
 	return res;
 }
 
+// the keys are the names of the items, freed with them
 static void ht_free_flag(HtPPKv *kv) {
-	free (kv->key);
 	r_flag_item_free (kv->value);
 }
 
+static int ht_name_cmp(const void *a, const void *b) {
+	return strcmp (a, b);
+}
+
+static ut32 ht_name_hash(const void *k) {
+	return sdb_hash (k);
+}
+
+static ut32 ht_name_size(const void *k) {
+	return strlen (k);
+}
+
+static HtPP *ht_name_new(void) {
+	HtPPOptions opt = {
+		.cmp = ht_name_cmp,
+		.hashfn = ht_name_hash,
+		.calcsizeK = ht_name_size,
+		.freefn = ht_free_flag,
+		.elem_size = sizeof (HtPPKv),
+	};
+	return ht_pp_new_opt (&opt);
+}
+
 static bool count_flags(RFlagItem *fi, void *user) {
 	int *count = (int *)user;
 	(*count)++;
@@ -239,7 +274,8 @@ R_API RFlag *r_flag_new() {
 	f->zones = NULL;
 #endif
 	f->tags = sdb_new0 ();
-	f->ht_name = ht_pp_new (NULL, ht_free_flag, NULL);
+	f->ht_name = ht_name_new ();
+	f->pools = r_list_newf ((RListFree)r_strpool_free);
 	f->by_off = r_skiplist_new (flag_skiplist_free, flag_skiplist_cmp);
 #if R_FLAG_ZONE_USE_SDB
 	sdb_free (f->zones);
@@ -275,9 +311,11 @@ R_API void r_flag_item_free(RFlagItem *item) {
 	free (item->color);
 	free (item->comment);
 	free (item->alias);
-	/* release only one of the two pointers if they are the same */
-	free_item_name (item);
-	free (item->realname);
+	if (!item->pooled) {
+		/* release only one of the two pointers if they are the same */
+		free_item_name (item);
+		free (item->realname);
+	}
 	free (item);
 }
 
@@ -285,6 +323,7 @@ R_API RFlag *r_flag_free(RFlag *f) {
 	r_return_val_if_fail (f, NULL);
 	r_skiplist_free (f->by_off);
 	ht_pp_free (f->ht_name);
+	r_list_free (f->pools);
 	sdb_free (f->tags);
 	r_spaces_fini (&f->spaces);
 	r_num_free (f->num);
@@ -702,6 +741,159 @@ err:
 	return NULL;
 }
 
+struct r_flag_bulk_t {
+	RFlag *f;
+	RStrpool *pool; // names are kept as offsets until the pool stops growing
+	RVector items;
+};
+
+typedef struct {
+	int name;
+	int realname; // -1 if it is the name
+	ut64 off;
+	ut32 size;
+	RSpace *space;
+} RFlagBulkItem;
+
+typedef struct {
+	RFlagItem *item;
+	int seq; // position of the last bulk item moving it
+} RFlagBulkMove;
+
+/* start a set of flags to be added at once, for the loaders defining
+ * millions of symbols. Names are interned in a string pool owned by the flag
+ * and the offset index is updated once per offset on commit */
+R_API RFlagBulk *r_flag_bulk_new(RFlag *f) {
+	r_return_val_if_fail (f, NULL);
+	RFlagBulk *b = R_NEW0 (RFlagBulk);
+	if (!b) {
+		return NULL;
+	}
+	b->f = f;
+	b->pool = r_strpool_new (0);
+	if (!b->pool) {
+		free (b);
+		return NULL;
+	}
+	r_vector_init (&b->items, sizeof (RFlagBulkItem), NULL, NULL);
+	return b;
+}
+
+/* queue a flag as r_flag_set followed by r_flag_item_set_realname would
+ * define it, realname can be NULL. The current flag space is used */
+R_API bool r_flag_bulk_add(RFlagBulk *b, const char *name, const char *realname, ut64 addr, ut32 size) {
+	r_return_val_if_fail (b && name && *name, false);
+	char *itemname = filter_item_name (name);
+	if (!itemname) {
+		return false;
+	}
+	RFlagBulkItem bi = {
+		.name = r_strpool_append (b->pool, itemname),
+		.realname = R_STR_ISEMPTY (realname)? -1: r_strpool_append (b->pool, realname),
+		.off = addr,
+		.size = size,
+		.space = r_flag_space_cur (b->f)
+	};
+	free (itemname);
+	if (bi.name < 0 || (!R_STR_ISEMPTY (realname) && bi.realname < 0)) {
+		return false;
+	}
+	return r_vector_push (&b->items, &bi) != NULL;
+}
+
+static int bulk_item_cmp(const void *a, const void *b) {
+	const RFlagBulkMove *ma = a, *mb = b;
+	if (ma->item != mb->item) {
+		return ma->item < mb->item? -1: 1;
+	}
+	return ma->seq - mb->seq;
+}
+
+static int bulk_offset_cmp(const void *a, const void *b) {
+	const RFlagBulkMove *ma = a, *mb = b;
+	if (ma->item->offset != mb->item->offset) {
+		return ma->item->offset < mb->item->offset? -1: 1;
+	}
+	return ma->seq - mb->seq;
+}
+
+/* define all the queued flags and free the bulk. Later items win over the
+ * earlier ones with the same name. Returns the number of flags set */
+R_API int r_flag_bulk_commit(RFlagBulk *b) {
+	r_return_val_if_fail (b, -1);
+	RFlag *f = b->f;
+	RFlagBulkItem *bi;
+	RFlagBulkMove *moves = calloc (b->items.len + 1, sizeof (RFlagBulkMove));
+	bool pooled = false;
+	int i, j, n = 0, nmoves = 0;
+
+	if (!moves || (b->pool->len && !r_strpool_fit (b->pool))) {
+		goto beach;
+	}
+	const char *str = b->pool->str;
+	r_vector_foreach (&b->items, bi) {
+		const char *name = str + bi->name;
+		const char *realname = bi->realname < 0? NULL: str + bi->realname;
+		RFlagItem *item = ht_pp_find (f->ht_name, name, NULL);
+		if (item && item->offset == bi->off) {
+			item->size = bi->size;
+		} else {
+			if (!item) {
+				item = R_NEW0 (RFlagItem);
+				if (!item) {
+					break;
+				}
+				item->name = (char *)name;
+				item->realname = (char *)(realname? realname: name);
+				item->pooled = pooled = true;
+				ht_pp_insert (f->ht_name, item->name, item);
+				realname = NULL;
+			} else {
+				// no-op for the items moved earlier in this bulk
+				remove_offsetmap (f, item);
+			}
+			item->space = bi->space;
+			item->size = bi->size;
+			item->offset = bi->off + f->base;
+			moves[nmoves].item = item;
+			moves[nmoves++].seq = n;
+		}
+		if (realname) {
+			r_flag_item_set_realname (item, realname);
+		}
+		n++;
+	}
+	// keep the last move of every item, then index them with one lookup
+	// per offset, appending in the order r_flag_set would
+	qsort (moves, nmoves, sizeof (RFlagBulkMove), bulk_item_cmp);
+	for (i = j = 0; i < nmoves; i++) {
+		if (i + 1 == nmoves || moves[i].item != moves[i + 1].item) {
+			moves[j++] = moves[i];
+		}
+	}
+	nmoves = j;
+	qsort (moves, nmoves, sizeof (RFlagBulkMove), bulk_offset_cmp);
+	RFlagsAtOffset *flags = NULL;
+	for (i = 0; i < nmoves; i++) {
+		if (!i || moves[i].item->offset != moves[i - 1].item->offset) {
+			flags = flags_at_offset (f, moves[i].item->offset);
+		}
+		if (flags) {
+			r_list_append (flags->flags, moves[i].item);
+		}
+	}
+beach:
+	if (pooled) {
+		r_list_append (f->pools, b->pool);
+	} else {
+		r_strpool_free (b->pool);
+	}
+	r_vector_clear (&b->items);
+	free (moves);
+	free (b);
+	return n;
+}
+
 /* add/replace/remove the alias of a flag item */
 R_API void r_flag_item_set_alias(RFlagItem *item, const char *alias) {
 	r_return_if_fail (item);
@@ -790,7 +982,8 @@ R_API bool r_flag_unset_name(RFlag *f, const char *name) {
 R_API void r_flag_unset_all(RFlag *f) {
 	r_return_if_fail (f);
 	ht_pp_free (f->ht_name);
-	f->ht_name = ht_pp_new (NULL, ht_free_flag, NULL);
+	f->ht_name = ht_name_new ();
+	r_list_purge (f->pools);
 	r_skiplist_purge (f->by_off);
 	r_spaces_fini (&f->spaces);
 	new_spaces (f);
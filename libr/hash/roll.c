@@ -0,0 +1,358 @@
+/* radare - LGPL - Copyright 2019 - pancake */
+
+#include <r_hash.h>
+
+// Rolling versions of the checksums that can slide over a buffer one byte
+// at a time, producing the same digest bytes as r_hash_calculate for every
+// window of 'len' bytes. CRCs are linear, so the outgoing byte and the
+// initial value can be cancelled with a couple of precomputed terms.
+
+#define MOD_ADLER 65521
+
+void crc_init_preset (R_CRC_CTX *ctx, enum CRC_PRESETS preset);
+void crc_update (R_CRC_CTX *ctx, const ut8 *data, ut32 sz);
+
+struct r_hash_roll_t {
+	ut64 algo;
+	ut32 len;
+	int size;
+	ut32 a, b; // adler32, xor, mod255 and parity state
+	R_CRC_CTX crc;
+	utcrc init;
+	utcrc mask;
+	utcrc fix; // removes the initial value shifted one byte too far
+	utcrc drop[256]; // contribution of the outgoing byte
+	utcrc push[256]; // byte-wise update of the register
+	ut8 rev[256]; // bit reversed bytes
+};
+
+static const struct {
+	ut64 algo;
+	enum CRC_PRESETS preset;
+} crc_algos[] = {
+	{ R_HASH_CRC8_SMBUS, CRC_PRESET_8_SMBUS },
+#if R_HAVE_CRC8_EXTRA
+	{ R_HASH_CRC8_CDMA2000, CRC_PRESET_CRC8_CDMA2000 },
+	{ R_HASH_CRC8_DARC, CRC_PRESET_CRC8_DARC },
+	{ R_HASH_CRC8_DVB_S2, CRC_PRESET_CRC8_DVB_S2 },
+	{ R_HASH_CRC8_EBU, CRC_PRESET_CRC8_EBU },
+	{ R_HASH_CRC8_ICODE, CRC_PRESET_CRC8_ICODE },
+	{ R_HASH_CRC8_ITU, CRC_PRESET_CRC8_ITU },
+	{ R_HASH_CRC8_MAXIM, CRC_PRESET_CRC8_MAXIM },
+	{ R_HASH_CRC8_ROHC, CRC_PRESET_CRC8_ROHC },
+	{ R_HASH_CRC8_WCDMA, CRC_PRESET_CRC8_WCDMA },
+#endif /* #if R_HAVE_CRC8_EXTRA */
+#if R_HAVE_CRC15_EXTRA
+	{ R_HASH_CRC15_CAN, CRC_PRESET_15_CAN },
+#endif /* #if R_HAVE_CRC15_EXTRA */
+	{ R_HASH_CRC16, CRC_PRESET_16 },
+	{ R_HASH_CRC16_HDLC, CRC_PRESET_16_HDLC },
+	{ R_HASH_CRC16_USB, CRC_PRESET_16_USB },
+	{ R_HASH_CRC16_CITT, CRC_PRESET_16_CITT },
+#if R_HAVE_CRC16_EXTRA
+	{ R_HASH_CRC16_AUG_CCITT, CRC_PRESET_CRC16_AUG_CCITT },
+	{ R_HASH_CRC16_BUYPASS, CRC_PRESET_CRC16_BUYPASS },
+	{ R_HASH_CRC16_CDMA2000, CRC_PRESET_CRC16_CDMA2000 },
+	{ R_HASH_CRC16_DDS110, CRC_PRESET_CRC16_DDS110 },
+	{ R_HASH_CRC16_DECT_R, CRC_PRESET_CRC16_DECT_R },
+	{ R_HASH_CRC16_DECT_X, CRC_PRESET_CRC16_DECT_X },
+	{ R_HASH_CRC16_DNP, CRC_PRESET_CRC16_DNP },
+	{ R_HASH_CRC16_EN13757, CRC_PRESET_CRC16_EN13757 },
+	{ R_HASH_CRC16_GENIBUS, CRC_PRESET_CRC16_GENIBUS },
+	{ R_HASH_CRC16_MAXIM, CRC_PRESET_CRC16_MAXIM },
+	{ R_HASH_CRC16_MCRF4XX, CRC_PRESET_CRC16_MCRF4XX },
+	{ R_HASH_CRC16_RIELLO, CRC_PRESET_CRC16_RIELLO },
+	{ R_HASH_CRC16_T10_DIF, CRC_PRESET_CRC16_T10_DIF },
+	{ R_HASH_CRC16_TELEDISK, CRC_PRESET_CRC16_TELEDISK },
+	{ R_HASH_CRC16_TMS37157, CRC_PRESET_CRC16_TMS37157 },
+	{ R_HASH_CRCA, CRC_PRESET_CRCA },
+	{ R_HASH_CRC16_KERMIT, CRC_PRESET_CRC16_KERMIT },
+	{ R_HASH_CRC16_MODBUS, CRC_PRESET_CRC16_MODBUS },
+	{ R_HASH_CRC16_X25, CRC_PRESET_CRC16_X25 },
+	{ R_HASH_CRC16_XMODEM, CRC_PRESET_CRC16_XMODEM },
+#endif /* #if R_HAVE_CRC16_EXTRA */
+#if R_HAVE_CRC24
+	{ R_HASH_CRC24, CRC_PRESET_24 },
+#endif /* #if R_HAVE_CRC24 */
+	{ R_HASH_CRC32, CRC_PRESET_32 },
+	{ R_HASH_CRC32C, CRC_PRESET_32C },
+	{ R_HASH_CRC32_ECMA_267, CRC_PRESET_32_ECMA_267 },
+#if R_HAVE_CRC32_EXTRA
+	{ R_HASH_CRC32_BZIP2, CRC_PRESET_CRC32_BZIP2 },
+	{ R_HASH_CRC32D, CRC_PRESET_CRC32D },
+	{ R_HASH_CRC32_MPEG2, CRC_PRESET_CRC32_MPEG2 },
+	{ R_HASH_CRC32_POSIX, CRC_PRESET_CRC32_POSIX },
+	{ R_HASH_CRC32Q, CRC_PRESET_CRC32Q },
+	{ R_HASH_CRC32_JAMCRC, CRC_PRESET_CRC32_JAMCRC },
+	{ R_HASH_CRC32_XFER, CRC_PRESET_CRC32_XFER },
+#endif /* #if R_HAVE_CRC32_EXTRA */
+#if R_HAVE_CRC64
+	{ R_HASH_CRC64, CRC_PRESET_CRC64 },
+#endif /* #if R_HAVE_CRC64 */
+#if R_HAVE_CRC64_EXTRA
+	{ R_HASH_CRC64_ECMA182, CRC_PRESET_CRC64_ECMA182 },
+	{ R_HASH_CRC64_WE, CRC_PRESET_CRC64_WE },
+	{ R_HASH_CRC64_XZ, CRC_PRESET_CRC64_XZ },
+	{ R_HASH_CRC64_ISO, CRC_PRESET_CRC64_ISO },
+#endif /* #if R_HAVE_CRC64_EXTRA */
+};
+
+static int crc_preset(ut64 algo) {
+	int i;
+	for (i = 0; i < R_ARRAY_SIZE (crc_algos); i++) {
+		if (crc_algos[i].algo == algo) {
+			return crc_algos[i].preset;
+		}
+	}
+	return -1;
+}
+
+static utcrc crc_shift(R_CRC_CTX *ctx, utcrc crc, ut32 n) {
+	static const ut8 zero[256] = {0};
+	ctx->crc = crc;
+	while (n > 0) {
+		ut32 chunk = R_MIN (n, sizeof (zero));
+		crc_update (ctx, zero, chunk);
+		n -= chunk;
+	}
+	return ctx->crc;
+}
+
+static void roll_crc_init(RHashRoll *roll, int preset) {
+	R_CRC_CTX ctx;
+	utcrc bits[8];
+	int i, j;
+
+	crc_init_preset (&roll->crc, preset);
+	roll->init = roll->crc.crc;
+	roll->mask = roll->crc.size < 64? (UTCRC_C (1) << roll->crc.size) - 1: ~UTCRC_C (0);
+	ctx = roll->crc;
+	// the register is linear on the input bytes, build the table from
+	// the value each single bit leaves after 'len' more bytes
+	for (i = 0; i < 8; i++) {
+		ut8 b = 1 << i;
+		ctx.crc = 0;
+		crc_update (&ctx, &b, 1);
+		bits[i] = crc_shift (&ctx, ctx.crc, roll->len) & roll->mask;
+	}
+	for (i = 0; i < 256; i++) {
+		utcrc v = 0;
+		for (j = 0; j < 8; j++) {
+			if (i & (1 << j)) {
+				v ^= bits[j];
+			}
+		}
+		roll->drop[i] = v;
+	}
+	utcrc shifted = crc_shift (&ctx, roll->init, roll->len);
+	roll->fix = (shifted ^ crc_shift (&ctx, shifted, 1)) & roll->mask;
+	// table driven update, the 8 top bits of the register select the row
+	ctx.reflect = 0;
+	for (i = 0; i < 256; i++) {
+		ut8 b = i;
+		ctx.crc = 0;
+		crc_update (&ctx, &b, 1);
+		roll->push[i] = ctx.crc & roll->mask;
+		for (j = 0, b = 0; j < 8; j++) {
+			if (i & (1 << j)) {
+				b |= 0x80 >> j;
+			}
+		}
+		roll->rev[i] = b;
+	}
+}
+
+static inline utcrc crc_reflect(RHashRoll *roll, utcrc crc) {
+	utcrc r = 0;
+	int i;
+	for (i = 0; i < roll->crc.size; i += 8) {
+		r = (r << 8) | roll->rev[crc & 0xff];
+		crc >>= 8;
+	}
+	return r >> (((roll->crc.size + 7) & ~7) - roll->crc.size);
+}
+
+static inline int parity8(ut8 b) {
+	b ^= b >> 4;
+	b ^= b >> 2;
+	b ^= b >> 1;
+	return b & 1;
+}
+
+static inline utcrc crc_push(RHashRoll *roll, utcrc crc, ut8 in) {
+	ut8 d = roll->crc.reflect? roll->rev[in]: in;
+	return (crc << 8) ^ roll->push[((crc >> (roll->crc.size - 8)) ^ d) & 0xff];
+}
+
+static inline void roll_step(RHashRoll *roll, ut8 out, ut8 in) {
+	switch (roll->algo) {
+	case R_HASH_ADLER32:
+		roll->a = (roll->a + MOD_ADLER - out + in) % MOD_ADLER;
+		roll->b = (roll->b + MOD_ADLER - (ut32)(((ut64)roll->len * out) % MOD_ADLER)
+			+ roll->a + MOD_ADLER - 1) % MOD_ADLER;
+		break;
+	case R_HASH_XOR:
+		roll->a ^= out ^ in;
+		break;
+	case R_HASH_MOD255:
+		roll->a = (roll->a + 255 - out + in) % 255;
+		break;
+	case R_HASH_PARITY:
+		roll->a ^= parity8 (out) ^ parity8 (in);
+		break;
+	default:
+		roll->crc.crc = (crc_push (roll, roll->crc.crc, in) ^ roll->drop[out] ^ roll->fix) & roll->mask;
+		break;
+	}
+}
+
+// the state of the current window in a single number
+static inline ut64 roll_key(RHashRoll *roll) {
+	switch (roll->algo) {
+	case R_HASH_ADLER32:
+		return (roll->b << 16) | roll->a;
+	case R_HASH_XOR:
+	case R_HASH_MOD255:
+	case R_HASH_PARITY:
+		return roll->a;
+	default:
+		return roll->crc.crc;
+	}
+}
+
+// the state a window must have to produce the given digest
+static ut64 digest_key(RHashRoll *roll, const ut8 *digest) {
+	switch (roll->algo) {
+	case R_HASH_ADLER32: {
+		ut32 res;
+		memcpy (&res, digest, R_HASH_SIZE_ADLER32);
+		return res;
+	}
+	case R_HASH_XOR:
+	case R_HASH_MOD255:
+	case R_HASH_PARITY:
+		return *digest;
+	default: {
+		utcrc res = 0;
+		int i;
+		for (i = 0; i < roll->size; i++) {
+			res = (res << 8) | digest[i];
+		}
+		res ^= roll->crc.xout;
+		return (roll->crc.reflect? crc_reflect (roll, res): res) & roll->mask;
+	}
+	}
+}
+
+// returns NULL for the algorithms that need the whole window every time
+R_API RHashRoll *r_hash_roll_new(ut64 algo, ut32 len) {
+	if (!len) {
+		return NULL;
+	}
+	int preset = crc_preset (algo);
+	if (preset < 0 && algo != R_HASH_ADLER32 && algo != R_HASH_XOR
+			&& algo != R_HASH_MOD255 && algo != R_HASH_PARITY) {
+		return NULL;
+	}
+	RHashRoll *roll = R_NEW0 (RHashRoll);
+	if (!roll) {
+		return NULL;
+	}
+	roll->algo = algo;
+	roll->len = len;
+	roll->size = r_hash_size (algo);
+	if (preset >= 0) {
+		roll_crc_init (roll, preset);
+	}
+	return roll;
+}
+
+R_API void r_hash_roll_free(RHashRoll *roll) {
+	free (roll);
+}
+
+// hash the first window, buf must hold at least 'len' bytes
+R_API void r_hash_roll_begin(RHashRoll *roll, const ut8 *buf) {
+	ut32 i;
+	switch (roll->algo) {
+	case R_HASH_ADLER32:
+		roll->a = 1;
+		roll->b = 0;
+		for (i = 0; i < roll->len; i++) {
+			roll->a = (roll->a + buf[i]) % MOD_ADLER;
+			roll->b = (roll->b + roll->a) % MOD_ADLER;
+		}
+		break;
+	case R_HASH_XOR:
+		roll->a = r_hash_xor (buf, roll->len);
+		break;
+	case R_HASH_MOD255:
+		roll->a = r_hash_mod255 (buf, roll->len);
+		break;
+	case R_HASH_PARITY:
+		roll->a = r_hash_parity (buf, roll->len);
+		break;
+	default:
+		roll->crc.crc = roll->init & roll->mask;
+		for (i = 0; i < roll->len; i++) {
+			roll->crc.crc = crc_push (roll, roll->crc.crc, buf[i]) & roll->mask;
+		}
+		break;
+	}
+}
+
+// slide the window one byte: 'out' leaves it from the left and 'in' enters
+R_API void r_hash_roll_next(RHashRoll *roll, ut8 out, ut8 in) {
+	roll_step (roll, out, in);
+}
+
+// first offset of buf where a block of the rolling length has the given
+// digest, or -1. The digest is turned into the checksum state once instead
+// of finalizing every window
+R_API int r_hash_roll_find(RHashRoll *roll, const ut8 *buf, int len, const ut8 *digest) {
+	int i, last = len - (int)roll->len;
+	if (last < 0) {
+		return -1;
+	}
+	ut64 key = digest_key (roll, digest);
+	r_hash_roll_begin (roll, buf);
+	for (i = 0; ; i++) {
+		if (roll_key (roll) == key) {
+			return i;
+		}
+		if (i == last) {
+			break;
+		}
+		roll_step (roll, buf[i], buf[i + roll->len]);
+	}
+	return -1;
+}
+
+// write the digest of the current window as r_hash_calculate would
+R_API int r_hash_roll_digest(RHashRoll *roll, ut8 *digest) {
+	switch (roll->algo) {
+	case R_HASH_ADLER32: {
+		ut32 res = (roll->b << 16) | roll->a;
+		memcpy (digest, &res, R_HASH_SIZE_ADLER32);
+		break;
+	}
+	case R_HASH_XOR:
+	case R_HASH_MOD255:
+	case R_HASH_PARITY:
+		*digest = roll->a;
+		break;
+	default: {
+		utcrc res = roll->crc.crc;
+		int i;
+		if (roll->crc.reflect) {
+			res = crc_reflect (roll, res);
+		}
+		res ^= roll->crc.xout;
+		for (i = 0; i < roll->size; i++) {
+			digest[i] = res >> (8 * (roll->size - 1 - i));
+		}
+		break;
+	}
+	}
+	return roll->size;
+}
@@ -670,8 +670,8 @@ typedef struct r_anal_t {
 	Sdb *sdb_fmts;
 	Sdb *sdb_meta; // TODO: Future r_meta api
 	Sdb *sdb_zigns;
-	HtUP *dict_refs;
-	HtUP *dict_xrefs;
+	struct r_anal_xrefs_t *dict_refs;
+	struct r_anal_xrefs_t *dict_xrefs;
 	bool recursive_noreturn;
 	RSpaces meta_spaces;
 	RSpaces zign_spaces;
@@ -686,7 +686,8 @@ typedef struct r_anal_t {
 	Sdb *sdb_args;  //
 	Sdb *sdb_vars; // globals?
 #endif
-	Sdb *sdb_hints; // OK
+	RBNode *hints; // RAnalHint sorted by address
+	RBNode *meta_ranges; // meta item intervals
 	RHintCb hint_cbs;
 	Sdb *sdb_fcnsign; // OK
 	Sdb *sdb_cc; // calling conventions
@@ -1101,9 +1102,48 @@ typedef struct r_anal_esil_callbacks_t {
 	int (*reg_write)(ESIL *esil, const char *name, ut64 val);
 } RAnalEsilCallbacks;
 
+enum {
+	R_ANAL_ESIL_TRACE_REG_READ = 0,
+	R_ANAL_ESIL_TRACE_REG_WRITE,
+	R_ANAL_ESIL_TRACE_MEM_READ,
+	R_ANAL_ESIL_TRACE_MEM_WRITE,
+	R_ANAL_ESIL_TRACE_DATA, // more bytes of the memory access before it
+};
+
+#define R_ANAL_ESIL_TRACE_MAX (1 << 20) // accesses kept by default
+
+/* register or memory access done by a traced instruction */
+typedef struct r_anal_esil_trace_access_t {
+	ut64 addr; // memory address, or id of the register name
+	ut64 value; // register value, or the first 8 bytes of memory
+	ut32 size; // length of the memory access
+	ut32 type;
+} RAnalEsilTraceAccess;
+
+typedef struct r_anal_esil_trace_step_t {
+	ut64 addr;
+	ut64 start; // sequence number of its first access
+	ut32 count;
+} RAnalEsilTraceStep;
+
+typedef struct r_anal_esil_trace_t RAnalEsilTrace;
+
+enum {
+	R_ANAL_ESIL_ITEM_NONE = 0,
+	R_ANAL_ESIL_ITEM_NUM,
+	R_ANAL_ESIL_ITEM_REG,
+	R_ANAL_ESIL_ITEM_STR,
+};
+
+typedef struct r_anal_esil_item_t {
+	int type;
+	ut64 num; // value of numbers
+	const char *str; // word as pushed, NULL for computed numbers
+} RAnalEsilItem;
+
 typedef struct r_anal_esil_t {
 	RAnal *anal;
-	char **stack;
+	RAnalEsilItem *stack;
 	ut64 addrmask;
 	int stacksize;
 	int stackptr;
@@ -1131,13 +1171,17 @@ typedef struct r_anal_esil_t {
 	ut8 lastsz;	//in bits //used for signature-flag
 	/* native ops and custom ops */
 	Sdb *ops;
+	HtPP *code; // compiled expressions, keyed by esil string
+	bool nocompile; // run every expression through the interpreter
+	HtPP *words; // interned strings referenced by the stack
+	int parse_depth;
 	RIDStorage *sources;
 	SdbMini *interrupts;
 	//this is a disgusting workaround, because we have no ht-like storage without magic keys, that you cannot use, with int-keys
 	RAnalEsilInterrupt *intr0;
 	/* deep esil parsing fills this */
 	Sdb *stats;
-	Sdb *db_trace;
+	RAnalEsilTrace *trace;
 	int trace_idx;
 	RAnalEsilCallbacks cb;
 	RAnalReil *Reil;
@@ -1356,6 +1400,17 @@ R_API RAnalEsil *r_anal_esil_new(int stacksize, int iotrap, unsigned int addrsiz
 R_API void r_anal_esil_trace(RAnalEsil *esil, RAnalOp *op);
 R_API void r_anal_esil_trace_list(RAnalEsil *esil);
 R_API void r_anal_esil_trace_show(RAnalEsil *esil, int idx);
+R_API RAnalEsilTrace *r_anal_esil_trace_new(ut64 max);
+R_API void r_anal_esil_trace_free(RAnalEsilTrace *trace);
+R_API void r_anal_esil_trace_reset(RAnalEsilTrace *trace);
+R_API const RAnalEsilTraceStep *r_anal_esil_trace_step(RAnalEsilTrace *trace, int idx);
+R_API const RAnalEsilTraceAccess *r_anal_esil_trace_access(RAnalEsilTrace *trace, const RAnalEsilTraceStep *step, ut32 n);
+R_API const char *r_anal_esil_trace_regname(RAnalEsilTrace *trace, const RAnalEsilTraceAccess *a);
+R_API int r_anal_esil_trace_data(RAnalEsilTrace *trace, const RAnalEsilTraceStep *step, ut32 n, ut8 *buf, int len);
+R_API bool r_anal_esil_trace_reg(RAnalEsilTrace *trace, int idx, int type, const char *name, ut64 *value);
+R_API int r_anal_esil_trace_regs(RAnalEsilTrace *trace, int idx, int type, const char **names, int max);
+R_API bool r_anal_esil_trace_mem(RAnalEsilTrace *trace, int idx, int type, ut64 *addr);
+R_API Sdb *r_anal_esil_trace_sdb(RAnalEsilTrace *trace);
 R_API bool r_anal_esil_set_pc(RAnalEsil *esil, ut64 addr);
 R_API int r_anal_esil_setup(RAnalEsil *esil, RAnal *anal, int romem, int stats, int nonull);
 R_API void r_anal_esil_free(RAnalEsil *esil);
@@ -1373,6 +1428,7 @@ R_API int r_anal_esil_set_op(RAnalEsil *esil, const char *op, RAnalEsilOp code);
 R_API void r_anal_esil_stack_free(RAnalEsil *esil);
 R_API int r_anal_esil_get_parm_type(RAnalEsil *esil, const char *str);
 R_API int r_anal_esil_get_parm(RAnalEsil *esil, const char *str, ut64 *num);
+R_API int r_anal_esil_get_parm_size(RAnalEsil *esil, const char *str, ut64 *num, int *size);
 R_API int r_anal_esil_condition(RAnalEsil *esil, const char *str);
 
 // esil_interrupt.c
@@ -1477,6 +1533,8 @@ R_API int r_anal_fcn_resize (const RAnal *anal, RAnalFunction *fcn, int newsize)
 R_API bool r_anal_fcn_get_purity(RAnal *anal, RAnalFunction *fcn);
 
 typedef bool (* RAnalRefCmp)(RAnalRef *ref, void *data);
+typedef bool (* RAnalRefCb)(void *user, const RAnalRef *ref);
+typedef struct r_anal_xrefs_t RAnalXrefs;
 R_API RList *r_anal_ref_list_new(void);
 R_API int r_anal_xrefs_count(RAnal *anal);
 R_API const char *r_anal_xrefs_type_tostring(RAnalRefType type);
@@ -1484,6 +1542,9 @@ R_API RAnalRefType r_anal_xrefs_type(char ch);
 R_API RList *r_anal_xrefs_get(RAnal *anal, ut64 to);
 R_API RList *r_anal_refs_get(RAnal *anal, ut64 to);
 R_API RList *r_anal_xrefs_get_from(RAnal *anal, ut64 from);
+R_API bool r_anal_xrefs_foreach(RAnal *anal, ut64 to, RAnalRefCb cb, void *user);
+R_API bool r_anal_refs_foreach(RAnal *anal, ut64 from, RAnalRefCb cb, void *user);
+R_API bool r_anal_fcn_refs_foreach(RAnal *anal, RAnalFunction *fcn, RAnalRefCb cb, void *user);
 R_API void r_anal_xrefs_list(RAnal *anal, int rad);
 R_API RList *r_anal_fcn_get_refs(RAnal *anal, RAnalFunction *fcn);
 R_API RList *r_anal_fcn_get_xrefs(RAnal *anal, RAnalFunction *fcn);
@@ -1540,6 +1601,7 @@ R_API char *r_anal_fcn_format_sig(R_NONNULL RAnal *anal, R_NONNULL RAnalFunction
 
 /* project */
 R_API bool r_anal_xrefs_init (RAnal *anal);
+R_API void r_anal_xrefs_fini (RAnal *anal);
 
 #define R_ANAL_THRESHOLDFCN 0.7F
 #define R_ANAL_THRESHOLDBB 0.7F
@@ -1624,6 +1686,7 @@ R_API char *r_meta_get_var_comment (RAnal *a, int type, ut64 idx, ut64 addr);
 R_API int r_meta_set_string(RAnal *m, int type, ut64 addr, const char *s);
 R_API int r_meta_set_var_comment (RAnal *a, int type, ut64 idx, ut64 addr, const char *s);
 R_API int r_meta_del(RAnal *m, int type, ut64 from, ut64 size);
+R_API int r_meta_del_range(RAnal *m, int type, ut64 from, ut64 to);
 R_API int r_meta_var_comment_del(RAnal *a, int type, ut64 idx, ut64 addr);
 R_API int r_meta_add(RAnal *m, int type, ut64 from, ut64 size, const char *str);
 R_API int r_meta_add_with_subtype(RAnal *m, int type, int subtype, ut64 from, ut64 size, const char *str);
@@ -1643,6 +1706,7 @@ R_API bool r_meta_deserialize_val(RAnal *a, RAnalMetaItem *it, int type, ut64 fr
 R_API void r_meta_print(RAnal *a, RAnalMetaItem *d, int rad, bool show_full);
 
 /* hints */
+typedef bool (* RAnalHintCb)(void *user, const RAnalHint *hint);
 
 R_API void r_anal_build_range_on_hints (RAnal *a, ut64 addr, int bits);
 R_API void r_anal_merge_hint_ranges(RAnal *a);
@@ -1650,10 +1714,11 @@ R_API void r_anal_merge_hint_ranges(RAnal *a);
 R_API void r_anal_hint_del (RAnal *anal, ut64 addr, int size);
 R_API void r_anal_hint_clear (RAnal *a);
 R_API RAnalHint *r_anal_hint_from_string(RAnal *a, ut64 addr, const char *str);
+R_API char *r_anal_hint_to_string(const RAnalHint *hint);
 R_API RAnalHint *r_anal_hint_at (RAnal *a, ut64 from);
-R_API RAnalHint *r_anal_hint_add (RAnal *a, ut64 from, int size);
 R_API void r_anal_hint_free (RAnalHint *h);
 R_API RAnalHint *r_anal_hint_get(RAnal *anal, ut64 addr);
+R_API void r_anal_hint_foreach(RAnal *a, RAnalHintCb cb, void *user);
 R_API void r_anal_hint_set_syntax (RAnal *a, ut64 addr, const char *syn);
 R_API void r_anal_hint_set_type (RAnal *a, ut64 addr, int type);
 R_API void r_anal_hint_set_jump (RAnal *a, ut64 addr, ut64 ptr);
@@ -60,6 +60,10 @@ typedef struct r_bp_item_t {
 	char *data;
 	char *cond; /* used for conditional breakpoints */
 	char *expr; /* to be used for named breakpoints (see r_debug_bp_update) */
+	ut64 rb_max_addr; // maximum of addr + size - 1 in the subtree, for interval tree
+	RBNode rb;
+	int idx; // slot in bps_idx
+	ut64 seq; // link order, sorts the bps at the same address in the tree
 } RBreakpointItem;
 
 struct r_bp_t;
@@ -80,8 +84,12 @@ typedef struct r_bp_t {
 	int nbps;
 	int nhwbps;
 	RList *bps; // list of breakpoints
+	RBNode *bps_tree; // interval tree of the bps by address range
+	HtUP *bps_at; // first bp added at every address, for the trap handlers
 	RBreakpointItem **bps_idx;
 	int bps_idx_count;
+	int bps_idx_free; // no empty slot below this index
+	ut64 bps_seq; // seq of the last linked bp
 	st64 delta;
 } RBreakpoint;
 
@@ -132,6 +140,8 @@ R_API int r_bp_del_index(RBreakpoint *bp, int idx);
 R_API RBreakpointItem *r_bp_get_index(RBreakpoint *bp, int idx);
 R_API int r_bp_get_index_at (RBreakpoint *bp, ut64 addr);
 R_API RBreakpointItem *r_bp_item_new (RBreakpoint *bp);
+R_API void r_bp_item_link(RBreakpoint *bp, RBreakpointItem *b);
+R_API void r_bp_move(RBreakpoint *bp, RBreakpointItem *b, ut64 addr);
 
 R_API RBreakpointItem *r_bp_get_at (RBreakpoint *bp, ut64 addr);
 R_API RBreakpointItem *r_bp_get_in (RBreakpoint *bp, ut64 addr, int perm);
@@ -18,6 +18,7 @@ extern "C" {
 #include <r_util/r_sys.h>
 #include <r_util/r_file.h>
 #include <sdb.h>
+#include <sdb/ht_up.h>
 
 #include <stdio.h>
 #include <sys/types.h>
@@ -386,6 +387,7 @@ typedef void (*RConsBreakCallback)(void *core);
 typedef void *(*RConsSleepBeginCallback)(void *core);
 typedef void (*RConsSleepEndCallback)(void *core, void *user);
 typedef void (*RConsQueueTaskOneshot)(void *core, void *task, void *user);
+typedef void (*RConsStreamCallback)(void *user, const char *buf, int len);
 
 typedef enum { COLOR_MODE_DISABLED = 0, COLOR_MODE_16, COLOR_MODE_256, COLOR_MODE_16M } RConsColorMode;
 
@@ -409,6 +411,7 @@ typedef struct r_cons_context_t {
 	bool lastMode;
 	bool lastEnabled;
 	bool pageable;
+	ut64 streamed; // bytes of the output already written
 
 	RConsColorMode color;
 	RConsPalette cpal;
@@ -481,6 +484,9 @@ typedef struct r_cons_t {
 	bool grep_highlight;
 	bool use_tts;
 	bool filter;
+	int stream; // write the output every this many bytes when nothing needs it whole
+	RConsStreamCallback cb_stream; // where the output goes instead of fdout
+	void *stream_user;
 	char* (*rgbstr)(char *str, size_t sz, ut64 addr);
 	// TODO: move into instance? + avoid unnecessary copies
 } RCons;
@@ -732,6 +738,8 @@ R_API void r_cons_chop(void);
 R_API void r_cons_set_raw(bool b);
 R_API void r_cons_set_interactive(bool b);
 R_API void r_cons_set_last_interactive(void);
+R_API void r_cons_set_stream(RConsStreamCallback cb, void *user);
+R_API ut64 r_cons_get_streamed(void);
 
 /* output */
 R_API int r_cons_printf(const char *format, ...);
@@ -982,6 +990,7 @@ typedef struct r_ascii_graph_t {
 	Sdb *nodes; // Sdb with title(key)=RANode*(value)
 
 	int layout;
+	int sweeps; // max crossing minimization sweeps, 0 for the default
 	int is_instep;
 	bool is_tiny;
 	bool is_dis;
@@ -1011,7 +1020,7 @@ typedef struct r_ascii_graph_t {
 	RList *long_edges;
 	struct layer_t *layers;
 	int n_layers;
-	RList *dists; /* RList<struct dist_t> */
+	HtUP *dists; /* distances between nodes of a layer, keyed by their idx */
 	RList *edges; /* RList<AEdge> */
 } RAGraph;
 
@@ -374,6 +374,7 @@ R_API int r_core_visual_classes(RCore *core);
 R_API int r_core_visual_types(RCore *core);
 R_API int r_core_visual(RCore *core, const char *input);
 R_API int r_core_visual_graph(RCore *core, RAGraph *g, RAnalFunction *_fcn, int is_interactive);
+R_API bool r_core_agraph_bench(RCore *core, RAGraph *g, RAnalFunction *fcn);
 R_API int r_core_visual_panels(RCore *core, RPanels *panels);
 R_API RPanels *r_core_panels_new(RCore *core);
 R_API void r_core_panels_refresh(RCore *core);
@@ -166,7 +166,7 @@ typedef struct r_page_data_t {
 	struct r_debug_snap_diff_t *diff; // Pointing SnapDiff that has this pagedata.
 	ut32 page_off;
 	ut8 *data;
-	ut8 hash[128];
+	ut64 hash;
 } RPageData;
 
 struct r_debug_snap_t;
@@ -183,8 +183,8 @@ typedef struct r_debug_snap_t {
 	ut32 size;
 	ut32 page_num;
 	ut64 timestamp;
-	RHash *hash_ctx;
-	ut8 **hashes; // Hash of each pages
+	ut64 *hashes; // Fingerprint of each page
+	RBitmap *dirty; // Pages written since the last diff, NULL if not tracked
 	RList *history; // <RDebugSnapDiff*>
 	int perm;
 	char *comment;
@@ -277,6 +277,7 @@ typedef struct r_debug_t {
 	char *glob_unlibs; /* stop on lib unload */
 	bool consbreak; /* SIGINT handle for attached processes */
 	bool continue_all_threads;
+	bool softdirty; /* diff snapshots reading only the written pages (linux) */
 
 	/* tracking debugger state */
 	int steps; /* counter of steps done */
@@ -45,6 +45,7 @@ typedef struct r_flag_item_t {
 	char *color;    /* item color */
 	char *comment;  /* item comment */
 	char *alias;    /* used to define a flag based on a math expression (e.g. foo + 3) */
+	bool pooled;    /* name and realname live in the names pool of the RFlag */
 } RFlagItem;
 
 typedef struct r_flag_t {
@@ -55,6 +56,7 @@ typedef struct r_flag_t {
 	RNum *num;
 	RSkipList *by_off; /* flags sorted by offset, value=RFlagsAtOffset */
 	HtPP *ht_name; /* hashmap key=item name, value=RList of items */
+	RList *pools; /* RStrpool holding the names of the flags set in bulk */
 	PrintfCallback cb_printf;
 #if R_FLAG_ZONE_USE_SDB
 	Sdb *zones;
@@ -78,6 +80,8 @@ typedef bool (*RFlagPushSpace)(RFlag *f, const char *name);
 
 typedef bool (*RFlagItemCb)(RFlagItem *fi, void *user);
 
+typedef struct r_flag_bulk_t RFlagBulk;
+
 typedef struct r_flag_bind_t {
 	int init;
 	RFlag *f;
@@ -114,6 +118,9 @@ R_API bool r_flag_unset_off(RFlag *f, ut64 addr);
 R_API void r_flag_unset_all (RFlag *f);
 R_API RFlagItem *r_flag_set(RFlag *fo, const char *name, ut64 addr, ut32 size);
 R_API RFlagItem *r_flag_set_next(RFlag *fo, const char *name, ut64 addr, ut32 size);
+R_API RFlagBulk *r_flag_bulk_new(RFlag *f);
+R_API bool r_flag_bulk_add(RFlagBulk *b, const char *name, const char *realname, ut64 addr, ut32 size);
+R_API int r_flag_bulk_commit(RFlagBulk *b);
 R_API void r_flag_item_set_alias(RFlagItem *item, const char *alias);
 R_API void r_flag_item_free (RFlagItem *item);
 R_API void r_flag_item_set_comment(RFlagItem *item, const char *comment);
@@ -175,6 +175,8 @@ struct r_hash_t {
 	ut8 R_ALIGNED(8) digest[128];
 };
 
+typedef struct r_hash_roll_t RHashRoll;
+
 typedef struct r_hash_seed_t {
 	int prefix;
 	ut8 *buf;
@@ -495,6 +497,14 @@ R_API ut8 r_hash_mod255(const ut8 *b, ut64 len);
 R_API ut64 r_hash_luhn(const ut8 *buf, ut64 len);
 R_API utcrc r_hash_crc_preset (const ut8 *data, ut32 size, enum CRC_PRESETS preset);
 
+/* rolling checksums */
+R_API RHashRoll *r_hash_roll_new(ut64 algo, ut32 len);
+R_API void r_hash_roll_free(RHashRoll *roll);
+R_API void r_hash_roll_begin(RHashRoll *roll, const ut8 *buf);
+R_API void r_hash_roll_next(RHashRoll *roll, ut8 out, ut8 in);
+R_API int r_hash_roll_digest(RHashRoll *roll, ut8 *digest);
+R_API int r_hash_roll_find(RHashRoll *roll, const ut8 *buf, int len, const ut8 *digest);
+
 /* analysis */
 R_API ut8  r_hash_hamdist(const ut8 *buf, int len);
 R_API double r_hash_entropy(const ut8 *data, ut64 len);
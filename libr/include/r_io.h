@@ -85,19 +85,21 @@ typedef struct r_io_t {
 	int addrbytes;
 	int aslr;
 	int autofd;
+	bool gzip_index; // save the inflate index of gzip files next to them
 	int cached;
 	bool cachemode; // write in cache all the read operations (EXPERIMENTAL)
 	int p_cache;
 	int debug;
 //#warning remove debug from RIO
 	RIDPool *map_ids;
+	HtUP *map_by_id; // io->maps by id
 	SdbList *maps; //from tail backwards maps with higher priority are found
-	RPVector map_skyline; // map parts that are not covered by others
-	RPVector map_skyline_shadow; // map parts that are not covered by others
+	RBTree map_tree; // io->maps by address, augmented with the max address of each subtree
+	RBTree map_skyline; // RIOMapSkyline map parts that are not covered by others, by address
+	bool map_skyline_dirty; // maps were added without updating the skyline
 	RIDStorage *files;
 	RCache *buffer;
-	RList *cache;	//sdblist?
-	RBNode cacheTree;
+	RBTree cache; // RIOCache items, sorted by address
 	ut8 *write_mask;
 	int write_mask_len;
 	RIOUndo undo;
@@ -189,18 +191,29 @@ typedef struct r_io_map_t {
 	RInterval itv;
 	ut64 delta; //this delta means paddr when talking about section
 	char *name;
+	st64 prio; // follows the order of io->maps, higher is on top
+	RBNode rb;
+	ut64 rb_max_addr;
 } RIOMap;
 
 typedef struct r_io_map_skyline_t {
 	RIOMap *map;
 	RInterval itv;
+	RBNode rb;
 } RIOMapSkyline;
 
+// parts never overlap, so they are sorted by their start and end alike
+#define r_io_skyline_foreach(io, it, part) \
+	r_rbtree_foreach ((io)->map_skyline, it, part, RIOMapSkyline, rb)
+
 typedef struct r_io_cache_t {
 	RInterval itv;
 	ut8 *data;
 	ut8 *odata;
+	ut64 cap; // allocated bytes of data and odata
 	int written;
+	RBNode rb;
+	ut64 rb_max_addr;
 } RIOCache;
 
 #define R_IO_DESC_CACHE_SIZE (sizeof(ut64) * 8)
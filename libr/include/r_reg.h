@@ -117,6 +117,9 @@ typedef struct r_reg_t {
 	char *name[R_REG_NAME_LAST]; // aliases
 	RRegSet regset[R_REG_TYPE_LAST];
 	RList *allregs;
+	HtPP *regnames; // name -> RRegItem, rebuilt by r_reg_reindex
+	RRegItem **regindex; // RRegItem.index -> RRegItem
+	int regcount;
 	int iters;
 	int arch;
 	int bits;
@@ -158,6 +161,7 @@ R_API RRegItem *r_reg_next_diff(RReg *reg, int type, const ut8 *buf, int buflen,
 
 R_API void r_reg_reindex(RReg *reg);
 R_API RRegItem *r_reg_index_get(RReg *reg, int idx);
+R_API int r_reg_get_index(RReg *reg, const char *name);
 
 /* Item */
 R_API void r_reg_item_free(RRegItem *item);
@@ -178,6 +182,8 @@ R_API ut64 r_reg_get_value_big(RReg *reg, RRegItem *item, utX *val);
 R_API ut64 r_reg_get_value_by_role(RReg *reg, RRegisterId role);
 R_API bool r_reg_set_value(RReg *reg, RRegItem *item, ut64 value);
 R_API bool r_reg_set_value_by_role(RReg *reg, RRegisterId role, ut64 value);
+R_API ut64 r_reg_get_value_by_index(RReg *reg, int idx);
+R_API bool r_reg_set_value_by_index(RReg *reg, int idx, ut64 value);
 
 /* float */
 R_API float r_reg_get_float(RReg *reg, RRegItem *item);
@@ -50,6 +50,9 @@ typedef struct r_search_hit_t {
 
 typedef int (*RSearchCallback)(RSearchKeyword *kw, void *user, ut64 where);
 
+typedef struct r_search_ac_t RSearchAC;
+typedef bool (*RSearchACCallback)(void *user, int kw, int at);
+
 typedef struct r_search_t {
 	int n_kws; // hit${n_kws}_${count}
 	int mode;
@@ -69,6 +72,8 @@ typedef struct r_search_t {
 	int align;
 	int (*update)(struct r_search_t *s, ut64 from, const ut8 *buf, int len);
 	RList *kws; // TODO: Use r_search_kw_new ()
+	RSearchAC *ac; // keyword automaton, built on demand
+	bool noac; // always brute force the keywords, for benchmarking
 	RIOBind iob;
 	char bckwrds;
 } RSearch;
@@ -105,6 +110,10 @@ R_API int r_search_range_set(RSearch *s, ut64 from, ut64 to);
 R_API int r_search_range_reset(RSearch *s);
 R_API int r_search_set_blocksize(RSearch *s, ut32 bsize);
 
+R_API RSearchAC *r_search_ac_new(RList *kws);
+R_API void r_search_ac_free(RSearchAC *ac);
+R_API bool r_search_ac_scan(RSearchAC *ac, const ut8 *buf, int len, RSearchACCallback cb, void *user);
+
 R_API int r_search_bmh(const RSearchKeyword *kw, const ut64 from, const ut8 *buf, const int len, ut64 *out);
 
 // TODO: is this an internal API?
@@ -150,6 +150,8 @@ typedef struct r_socket_http_request {
 
 R_API RSocketHTTPRequest *r_socket_http_accept(RSocket *s, RSocketHTTPOptions *so);
 R_API void r_socket_http_response(RSocketHTTPRequest *rs, int code, const char *out, int x, const char *headers);
+R_API void r_socket_http_response_chunked(RSocketHTTPRequest *rs, int code, const char *headers);
+R_API void r_socket_http_chunk(RSocketHTTPRequest *rs, const char *buf, int len);
 R_API void r_socket_http_close(RSocketHTTPRequest *rs);
 R_API ut8 *r_socket_http_handle_upload(const ut8 *str, int len, int *olen);
 
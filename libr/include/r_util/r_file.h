@@ -7,6 +7,8 @@ extern "C" {
 
 #include <r_util/r_mem.h>
 
+typedef struct r_inflate_index_t RInflateIndex;
+
 R_API int r_file_is_abspath(const char *file);
 R_API bool r_file_truncate(const char *filename, ut64 newsize);
 R_API ut64 r_file_size(const char *str);
@@ -24,6 +26,14 @@ R_API const char *r_file_basename(const char *path);
 R_API char *r_file_dirname(const char *path);
 R_API char *r_file_abspath(const char *file);
 R_API ut8 *r_inflate(const ut8 *src, int srcLen, int *srcConsumed, int *dstLen);
+R_API RInflateIndex *r_inflate_index_new(const char *file, ut64 span);
+R_API RInflateIndex *r_inflate_index_load(const char *file, const char *index);
+R_API void r_inflate_index_free(RInflateIndex *idx);
+R_API bool r_inflate_index_build(RInflateIndex *idx, ut64 upto);
+R_API ut64 r_inflate_index_size(RInflateIndex *idx);
+R_API ut64 r_inflate_index_built(RInflateIndex *idx);
+R_API int r_inflate_index_read(RInflateIndex *idx, ut64 off, ut8 *buf, int len);
+R_API bool r_inflate_index_save(RInflateIndex *idx, const char *file);
 R_API ut8 *r_file_gzslurp(const char *str, int *outlen, int origonfail);
 R_API char *r_stdin_slurp(int *sz);
 R_API char *r_file_slurp(const char *str, int *usz);
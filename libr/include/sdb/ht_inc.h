@@ -26,7 +26,7 @@
 #define HT_(name) HtUP##name
 #define KEY_TYPE ut64
 #define VALUE_TYPE void *
-#define KEY_TO_HASH(x) ((ut32)(x))
+#define KEY_TO_HASH(x) ht_hash_ut64 (x)
 #define HT_NULL_VALUE 0
 #else
 #define HtName_(name) name##UU
@@ -34,13 +34,23 @@
 #define HT_(name) HtUU##name
 #define KEY_TYPE ut64
 #define VALUE_TYPE ut64
-#define KEY_TO_HASH(x) ((ut32)(x))
+#define KEY_TO_HASH(x) ht_hash_ut64 (x)
 #define HT_NULL_VALUE 0
 #endif
 
 #include "ls.h"
 #include "types.h"
 
+#ifndef SDB_HT_HASH_UT64
+#define SDB_HT_HASH_UT64
+// fold the upper half of integer keys into the hash, truncating made all
+// the addresses sharing the lower 32 bits land in the same bucket. the
+// lower half is kept as is, so nearby addresses still spread evenly
+static inline ut32 ht_hash_ut64(ut64 k) {
+	return (ut32)k + (ut32)(k >> 32) * 0x9e3779b1U;
+}
+#endif
+
 /* Kv represents a single key/value element in the hashtable */
 typedef struct Ht_(kv) {
 	KEY_TYPE key;
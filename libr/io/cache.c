@@ -1,16 +1,14 @@
-/* radare - LGPL - Copyright 2008-2018 - pancake */
-
-// TODO: implement a more inteligent way to store cached memory
+/* radare - LGPL - Copyright 2008-2019 - pancake */
 
 #include "r_io.h"
 
-#if 0
-#define CACHE_CONTAINER(x) container_of ((RBNode*)x, RCache, rb)
+// Cached writes are kept in an interval tree (augmented with the max address
+// of each subtree) of non-overlapping RIOCache items. Overlapping and adjacent
+// writes are coalesced into a single item, so lookups are O(log n + overlaps).
 
-static void _fcn_tree_calc_max_addr(RBNode *node) {
-	RIOCache *c = CACHE_CONTAINER (node);
-}
-#endif // 0
+#define CACHE_CONTAINER(x) container_of ((RBNode*)(x), RIOCache, rb)
+#define cache_tree_foreach_intersect(root, it, c, from, last) \
+	for ((c) = _cache_tree_probe (&(it), root, from, last); (c); (c) = _cache_tree_next (&(it), last))
 
 static void cache_item_free(RIOCache *cache) {
 	if (!cache) {
@@ -21,25 +19,173 @@ static void cache_item_free(RIOCache *cache) {
 	free (cache);
 }
 
-R_API bool r_io_cache_at(RIO *io, ut64 addr) {
-	RIOCache *c;
-	RListIter *iter;
-	r_list_foreach (io->cache, iter, c) {
-		if (r_itv_contain (c->itv, addr)) {
-			return true;
+static inline ut64 cache_item_last(RIOCache *c) {
+	return c->itv.addr + c->itv.size - 1;
+}
+
+static int _cache_tree_cmp(const void *a_, const RBNode *b_) {
+	const RIOCache *a = (const RIOCache *)a_;
+	const RIOCache *b = CACHE_CONTAINER (b_);
+	if (a->itv.addr != b->itv.addr) {
+		return a->itv.addr < b->itv.addr ? -1 : 1;
+	}
+	return 0;
+}
+
+static void _cache_tree_calc_max_addr(RBNode *node) {
+	int i;
+	RIOCache *c = CACHE_CONTAINER (node);
+	c->rb_max_addr = cache_item_last (c);
+	for (i = 0; i < 2; i++) {
+		if (node->child[i]) {
+			RIOCache *c1 = CACHE_CONTAINER (node->child[i]);
+			if (c1->rb_max_addr > c->rb_max_addr) {
+				c->rb_max_addr = c1->rb_max_addr;
+			}
 		}
 	}
-	return false;
+}
+
+static void _cache_tree_free(RBNode *node) {
+	cache_item_free (CACHE_CONTAINER (node));
+}
+
+// Descent x_ to find the first item intersecting [from, last], filling `it`
+// with the path needed to continue the in-order walk with r_rbtree_iter_next
+static RIOCache *_cache_tree_probe(RBIter *it, RBNode *x_, ut64 from, ut64 last) {
+	RBNode *y_;
+	it->len = 0;
+	while (x_) {
+		RIOCache *x = CACHE_CONTAINER (x_);
+		if ((y_ = x_->child[0]) && from <= CACHE_CONTAINER (y_)->rb_max_addr) {
+			it->path[it->len++] = x_;
+			x_ = y_;
+			continue;
+		}
+		if (x->itv.addr > last) {
+			break;
+		}
+		if (from <= cache_item_last (x)) {
+			it->path[it->len++] = x_;
+			return x;
+		}
+		x_ = x_->child[1];
+		if (x_ && from > CACHE_CONTAINER (x_)->rb_max_addr) {
+			break;
+		}
+	}
+	it->len = 0;
+	return NULL;
+}
+
+// Items never overlap, so the in-order successor is the next intersecting one
+static RIOCache *_cache_tree_next(RBIter *it, ut64 last) {
+	r_rbtree_iter_next (it);
+	if (it->len) {
+		RIOCache *c = CACHE_CONTAINER (it->path[it->len - 1]);
+		if (c->itv.addr <= last) {
+			return c;
+		}
+	}
+	return NULL;
+}
+
+static inline RIOCache *cache_tree_find(RIO *io, ut64 from, ut64 last) {
+	RBIter it;
+	return _cache_tree_probe (&it, io->cache, from, last);
+}
+
+static void cache_tree_insert(RIO *io, RIOCache *c) {
+	r_rbtree_aug_insert (&io->cache, c, &c->rb, _cache_tree_cmp, _cache_tree_calc_max_addr);
+}
+
+static void cache_tree_delete(RIO *io, RIOCache *c) {
+	r_rbtree_aug_delete (&io->cache, c, _cache_tree_cmp, _cache_tree_free, _cache_tree_calc_max_addr);
+}
+
+static RIOCache *cache_item_new(ut64 addr, ut64 size) {
+	RIOCache *c = R_NEW0 (RIOCache);
+	if (!c) {
+		return NULL;
+	}
+	c->itv = (RInterval){addr, size};
+	c->cap = size;
+	c->odata = malloc (size);
+	c->data = malloc (size);
+	if (!c->odata || !c->data) {
+		cache_item_free (c);
+		return NULL;
+	}
+	return c;
+}
+
+// grows the buffers of c geometrically so appending writes stay linear
+static bool cache_item_reserve(RIOCache *c, ut64 size) {
+	if (size <= c->cap) {
+		return true;
+	}
+	const ut64 cap = R_MAX (size, c->cap * 2);
+	ut8 *data = realloc (c->data, cap);
+	if (!data) {
+		return false;
+	}
+	c->data = data;
+	ut8 *odata = realloc (c->odata, cap);
+	if (!odata) {
+		return false;
+	}
+	c->odata = odata;
+	c->cap = cap;
+	return true;
+}
+
+// Splits the item containing `at` (if any) so no item crosses that address
+static bool cache_split_at(RIO *io, ut64 at) {
+	RIOCache *c = cache_tree_find (io, at, at);
+	if (!c || c->itv.addr == at) {
+		return true;
+	}
+	const ut64 delta = at - c->itv.addr;
+	RIOCache *r = cache_item_new (at, c->itv.size - delta);
+	if (!r) {
+		return false;
+	}
+	memcpy (r->data, c->data + delta, r->itv.size);
+	memcpy (r->odata, c->odata + delta, r->itv.size);
+	r->written = c->written;
+	c->itv.size = delta;
+	r_rbtree_aug_update_sum (io->cache, c, &c->rb, _cache_tree_cmp, _cache_tree_calc_max_addr);
+	cache_tree_insert (io, r);
+	return true;
+}
+
+// splits the items at the ends of [from, to), where a 'to' of UT64_MAX
+// stands for the end of the address space, and returns the last address
+static bool cache_split_range(RIO *io, ut64 from, ut64 to, ut64 *last) {
+	*last = to == UT64_MAX? UT64_MAX: to - 1;
+	return cache_split_at (io, from) && (*last == UT64_MAX || cache_split_at (io, to));
+}
+
+static void cache_read_underlying(RIO *io, ut64 addr, ut8 *buf, ut64 len) {
+	bool cm = io->cachemode;
+	io->cachemode = false;
+	r_io_read_at (io, addr, buf, (int)len);
+	io->cachemode = cm;
+}
+
+R_API bool r_io_cache_at(RIO *io, ut64 addr) {
+	r_return_val_if_fail (io, false);
+	return cache_tree_find (io, addr, addr) != NULL;
 }
 
 R_API void r_io_cache_init(RIO *io) {
-	io->cache = r_list_newf ((RListFree)cache_item_free);
+	io->cache = NULL;
 	io->buffer = r_cache_new ();
 	io->cached = 0;
 }
 
 R_API void r_io_cache_fini (RIO *io) {
-	r_list_free (io->cache);
+	r_rbtree_free (io->cache, _cache_tree_free);
 	r_cache_free (io->buffer);
 	io->cache = NULL;
 	io->buffer = NULL;
@@ -47,57 +193,58 @@ R_API void r_io_cache_fini (RIO *io) {
 }
 
 R_API void r_io_cache_commit(RIO *io, ut64 from, ut64 to) {
-	RListIter *iter;
+	RBIter it;
 	RIOCache *c;
-	RInterval range = (RInterval){from, to - from};
-	r_list_foreach (io->cache, iter, c) {
-		// if (from <= c->to - 1 && c->from <= to - 1) {
-		if (r_itv_overlap (c->itv, range)) {
-			int cached = io->cached;
-			io->cached = 0;
-			if (r_io_write_at (io, r_itv_begin (c->itv), c->data, r_itv_size (c->itv))) {
-				c->written = true;
-			} else {
-				eprintf ("Error writing change at 0x%08"PFMT64x"\n", r_itv_begin (c->itv));
-			}
-			io->cached = cached;
-			break; // XXX old behavior, revisit this
+	ut64 last;
+	if (from >= to || !cache_split_range (io, from, to, &last)) {
+		return;
+	}
+	int cached = io->cached;
+	io->cached = 0;
+	cache_tree_foreach_intersect (io->cache, it, c, from, last) {
+		if (r_io_write_at (io, r_itv_begin (c->itv), c->data, r_itv_size (c->itv))) {
+			c->written = true;
+		} else {
+			eprintf ("Error writing change at 0x%08"PFMT64x"\n", r_itv_begin (c->itv));
 		}
 	}
+	io->cached = cached;
 }
 
 R_API void r_io_cache_reset(RIO *io, int set) {
 	io->cached = set;
-	r_list_purge (io->cache);
+	r_rbtree_free (io->cache, _cache_tree_free);
+	io->cache = NULL;
 }
 
 R_API int r_io_cache_invalidate(RIO *io, ut64 from, ut64 to) {
 	int invalidated = 0;
-	RListIter *iter, *tmp;
 	RIOCache *c;
-	RInterval range = (RInterval){from, to - from};
-	r_list_foreach_prev_safe (io->cache, iter, tmp, c) {
-		if (r_itv_overlap (c->itv, range)) {
+	ut64 last;
+	if (from >= to || !cache_split_range (io, from, to, &last)) {
+		return 0;
+	}
+	while ((c = cache_tree_find (io, from, last))) {
+		if (c->written) {
 			int cached = io->cached;
 			io->cached = 0;
 			r_io_write_at (io, r_itv_begin (c->itv), c->odata, r_itv_size (c->itv));
 			io->cached = cached;
-			c->written = false;
-			r_list_delete (io->cache, iter);
-			invalidated++;
 		}
+		cache_tree_delete (io, c);
+		invalidated++;
 	}
 	return invalidated;
 }
 
 R_API int r_io_cache_list(RIO *io, int rad) {
 	int i, j = 0;
-	RListIter *iter;
+	RBIter iter;
 	RIOCache *c;
 	if (rad == 2) {
 		io->cb_printf ("[");
 	}
-	r_list_foreach (io->cache, iter, c) {
+	r_rbtree_foreach (io->cache, iter, c, RIOCache, rb) {
 		const int dataSize = r_itv_size (c->itv);
 		if (rad == 1) {
 			io->cb_printf ("wx ");
@@ -111,8 +258,8 @@ R_API int r_io_cache_list(RIO *io, int rad) {
 			}
 			io->cb_printf ("\n");
 		} else if (rad == 2) {
-			io->cb_printf ("{\"idx\":%"PFMT64d",\"addr\":%"PFMT64d",\"size\":%d,",
-				j, r_itv_begin (c->itv), dataSize);
+			io->cb_printf ("%s{\"idx\":%d,\"addr\":%"PFMT64d",\"size\":%d,",
+				j? ",": "", j, r_itv_begin (c->itv), dataSize);
 			io->cb_printf ("\"before\":\"");
 		  	for (i = 0; i < dataSize; i++) {
 				io->cb_printf ("%02x", c->odata[i]);
@@ -121,8 +268,7 @@ R_API int r_io_cache_list(RIO *io, int rad) {
 		  	for (i = 0; i < dataSize; i++) {
 				io->cb_printf ("%02x", c->data[i]);
 			}
-			io->cb_printf ("\",\"written\":%s}%s", c->written
-				? "true": "false", iter->n? ",": "");
+			io->cb_printf ("\",\"written\":%s}", c->written? "true": "false");
 		} else if (rad == 0) {
 			io->cb_printf ("idx=%d addr=0x%08"PFMT64x" size=%d ", j, r_itv_begin (c->itv), dataSize);
 			for (i = 0; i < dataSize; i++) {
@@ -143,65 +289,105 @@ R_API int r_io_cache_list(RIO *io, int rad) {
 }
 
 R_API bool r_io_cache_write(RIO *io, ut64 addr, const ut8 *buf, int len) {
-	RIOCache *ch;
-	ch = R_NEW0 (RIOCache);
-	if (!ch) {
+	RBIter it;
+	RIOCache *c, *ch, *head = NULL;
+	r_return_val_if_fail (io && buf, false);
+	if (len < 1) {
 		return false;
 	}
-	ch->itv = (RInterval){addr, len};
-	ch->odata = (ut8*)calloc (1, len + 1);
-	if (!ch->odata) {
-		free (ch);
-		return false;
+	if (addr + len - 1 < addr) {
+		len = UT64_MAX - addr + 1;
+	}
+	const ut64 last = addr + len - 1;
+	// rewriting bytes of a single item is the common case for patches
+	c = cache_tree_find (io, addr, last);
+	if (c && c->itv.addr <= addr && last <= cache_item_last (c)) {
+		// written stays set, invalidating must still restore the committed bytes
+		memcpy (c->data + (addr - c->itv.addr), buf, len);
+		return true;
 	}
-	ch->data = (ut8*)calloc (1, len + 1);
-	if (!ch->data) {
-		free (ch->odata);
-		free (ch);
+	// coalesce with every item overlapping or adjacent to the new write
+	const ut64 from = addr? addr - 1: addr;
+	const ut64 to = last < UT64_MAX? last + 1: last;
+	ut64 begin = addr, end = last;
+	cache_tree_foreach_intersect (io->cache, it, c, from, to) {
+		if (!head && c->itv.addr <= addr) {
+			head = c;
+		}
+		begin = R_MIN (begin, c->itv.addr);
+		end = R_MAX (end, cache_item_last (c));
+	}
+	// an item starting at or before the write is grown in place, so
+	// sequential patches only copy the new bytes
+	if (head) {
+		if (!cache_item_reserve (head, end - begin + 1)) {
+			return false;
+		}
+		ch = head;
+	} else if (!(ch = cache_item_new (begin, end - begin + 1))) {
 		return false;
 	}
-	ch->written = false;
-	{
-		bool cm = io->cachemode;
-		io->cachemode = false;
-		r_io_read_at (io, addr, ch->odata, len);
-		io->cachemode = cm;
+	// only the gaps between coalesced items need to be read from the io
+	ut64 cur = begin;
+	bool tail = true;
+	cache_tree_foreach_intersect (io->cache, it, c, from, to) {
+		const ut64 delta = c->itv.addr - begin;
+		if (c->itv.addr > cur) {
+			cache_read_underlying (io, cur, ch->odata + cur - begin, c->itv.addr - cur);
+			memcpy (ch->data + cur - begin, ch->odata + cur - begin, c->itv.addr - cur);
+		}
+		if (c != ch) {
+			memcpy (ch->odata + delta, c->odata, c->itv.size);
+			memcpy (ch->data + delta, c->data, c->itv.size);
+			ch->written |= c->written;
+		}
+		if (cache_item_last (c) >= end) {
+			tail = false;
+		} else {
+			cur = cache_item_last (c) + 1;
+		}
+	}
+	if (tail) {
+		cache_read_underlying (io, cur, ch->odata + cur - begin, end - cur + 1);
+		memcpy (ch->data + cur - begin, ch->odata + cur - begin, end - cur + 1);
+	}
+	memcpy (ch->data + addr - begin, buf, len);
+	if (head) {
+		// the items after the head are merged in and its key is unchanged
+		const ut64 hlast = cache_item_last (head);
+		while (hlast < to && (c = cache_tree_find (io, hlast + 1, to))) {
+			cache_tree_delete (io, c);
+		}
+		head->itv.size = end - begin + 1;
+		r_rbtree_aug_update_sum (io->cache, head, &head->rb, _cache_tree_cmp, _cache_tree_calc_max_addr);
+		return true;
+	}
+	while ((c = cache_tree_find (io, from, to))) {
+		cache_tree_delete (io, c);
 	}
-	memcpy (ch->data, buf, len);
-	r_list_append (io->cache, ch);
+	cache_tree_insert (io, ch);
 	return true;
 }
 
 R_API bool r_io_cache_read(RIO *io, ut64 addr, ut8 *buf, int len) {
-	int l, covered = 0;
-	RListIter *iter;
+	RBIter it;
 	RIOCache *c;
-	RInterval range = (RInterval){ addr, len };
-	r_list_foreach (io->cache, iter, c) {
-		if (r_itv_overlap (c->itv, range)) {
-			const ut64 begin = r_itv_begin (c->itv);
-			if (addr < begin) {
-				l = R_MIN (addr + len - begin, r_itv_size (c->itv));
-				memcpy (buf + begin - addr, c->data, l);
-			} else {
-				l = R_MIN (r_itv_end (c->itv) - addr, len);
-				memcpy (buf, c->data + addr - begin, l);
-			}
-			covered += l;
+	bool covered = false;
+	r_return_val_if_fail (io && buf, false);
+	if (len < 1) {
+		return false;
+	}
+	const ut64 last = addr + len - 1 < addr? UT64_MAX: addr + len - 1;
+	cache_tree_foreach_intersect (io->cache, it, c, addr, last) {
+		const ut64 begin = r_itv_begin (c->itv);
+		if (addr < begin) {
+			const ut64 l = R_MIN (last - begin + 1, r_itv_size (c->itv));
+			memcpy (buf + begin - addr, c->data, l);
+		} else {
+			const ut64 l = R_MIN (cache_item_last (c) - addr + 1, last - addr + 1);
+			memcpy (buf, c->data + addr - begin, l);
 		}
+		covered = true;
 	}
-	return (covered == 0) ? false: true;
-}
-
-////////////////////////////////////////////////////////////////////
-#if 0
-R_API bool r_io_cache_ll_read(RIO *io, ut64 addr, ut8 *buf, int len) {
-//	UnownedRList *list = r
-}
-
-R_API bool r_io_cache_ll_write(RIO *io, ut64 addr, ut8 *buf, int len) {
-}
-
-R_API bool r_io_cache_ll_invalidate(RIO *io, ut64 addr, int len) {
+	return covered;
 }
-#endif
@@ -20,32 +20,26 @@ typedef int (*cbOnIterMap)(RIO *io, int fd, ut64 addr, ut8 *buf, int len, RIOMap
 // If prefix_mode is true, returns the number of bytes of operated prefix; returns < 0 on error.
 // If prefix_mode is false, operates in non-stop mode and returns true iff all IO operations on overlapped maps are complete.
 static st64 on_map_skyline(RIO *io, ut64 vaddr, ut8 *buf, int len, int match_flg, cbOnIterMap op, bool prefix_mode) {
-	const RPVector *skyline = &io->map_skyline;
 	ut64 addr = vaddr;
-	size_t i;
+	RBIter it = {0};
 	bool ret = true, wrap = !prefix_mode && vaddr + len < vaddr;
-#define CMP(addr, part) ((addr) < r_itv_end (((RIOMapSkyline *)(part))->itv) - 1 ? -1 : \
-			(addr) > r_itv_end (((RIOMapSkyline *)(part))->itv) - 1 ? 1 : 0)
-	// Let i be the first skyline part whose right endpoint > addr
-	if (!len) {
-		i = r_pvector_len (skyline);
-	} else {
-		r_pvector_lower_bound (skyline, addr, i, CMP);
-		if (i == r_pvector_len (skyline) && wrap) {
+	// Let it be the first skyline part whose right endpoint > addr
+	if (len) {
+		it = io_map_skyline_lower_bound (io, addr);
+		if (!it.len && wrap) {
 			wrap = false;
-			i = 0;
+			it = r_rbtree_first (io->map_skyline);
 			addr = 0;
 		}
 	}
-#undef CMP
-	while (i < r_pvector_len (skyline)) {
-		const RIOMapSkyline *part = r_pvector_at (skyline, i);
+	while (it.len) {
+		const RIOMapSkyline *part = IO_SKYLINE_PART (it);
 		// Right endpoint <= addr
 		if (r_itv_end (part->itv) - 1 < addr) {
-			i++;
-			if (wrap && i == r_pvector_len (skyline)) {
+			r_rbtree_iter_next (&it);
+			if (wrap && !it.len) {
 				wrap = false;
-				i = 0;
+				it = r_rbtree_first (io->map_skyline);
 				addr = 0;
 			}
 			continue;
@@ -89,7 +83,7 @@ static st64 on_map_skyline(RIO *io, ut64 vaddr, ut8 *buf, int len, int match_flg
 		}
 		// Wrap to the beginning of skyline if address wraps
 		if (!addr) {
-			i = 0;
+			it = r_rbtree_first (io->map_skyline);
 		}
 	}
 	return prefix_mode ? addr - vaddr : ret;
@@ -103,8 +97,7 @@ R_API RIO* r_io_init(RIO* io) {
 	r_return_val_if_fail (io, NULL);
 	io->addrbytes = 1;
 	r_io_desc_init (io);
-	r_pvector_init (&io->map_skyline, free);
-	r_pvector_init (&io->map_skyline_shadow, free);
+	io->map_skyline = NULL;
 	r_io_map_init (io);
 	r_io_cache_init (io);
 	r_io_plugin_init (io);
@@ -657,7 +650,7 @@ R_API int r_io_fini(RIO* io) {
 	r_io_desc_fini (io);
 	r_io_map_fini (io);
 	ls_free (io->plugins);
-	r_list_free (io->cache);
+	r_io_cache_fini (io);
 	r_list_free (io->undo.w_list);
 	if (io->runprofile) {
 		R_FREE (io->runprofile);
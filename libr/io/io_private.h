@@ -4,5 +4,8 @@
 RIOMap *io_map_new(RIO *io, int fd, int flags, ut64 delta, ut64 addr, ut64 size, bool do_skyline);
 RIOMap *io_map_add(RIO *io, int fd, int flags, ut64 delta, ut64 addr, ut64 size, bool do_skyline);
 void io_map_calculate_skyline(RIO *io);
+RBIter io_map_skyline_lower_bound(RIO *io, ut64 addr);
+
+#define IO_SKYLINE_PART(it) container_of ((it).path[(it).len - 1], RIOMapSkyline, rb)
 
 #endif
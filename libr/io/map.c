@@ -6,13 +6,13 @@
 #include "r_binheap.h"
 #include "r_util.h"
 #include "r_vector.h"
+#include "io_private.h"
 
 #define END_OF_MAP_IDS UT32_MAX
 
 #define MAP_USE_HALF_CLOSED 0
 
-#define CMP_END_GT(addr, itv) \
-	(((addr) < r_itv_end (*(RInterval *)(itv))) ? -1 : (((addr) > r_itv_end (*(RInterval *)(itv))) ? 1 : 0))
+#define MAP_CONTAINER(x) container_of ((RBNode*)(x), RIOMap, rb)
 
 struct map_event_t {
 	RIOMap *map;
@@ -64,31 +64,39 @@ static bool _map_skyline_push(RPVector *map_skyline, ut64 from, ut64 to, RIOMap
 	return true;
 }
 
-// Store map parts that are not covered by others into io->map_skyline
-void io_map_calculate_skyline(RIO *io) {
-	SdbListIter *iter;
+static inline ut64 _itv_last(RInterval itv) {
+	return itv.addr + itv.size - 1;
+}
+
+// Computes the skyline of `maps` (sorted from highest to lowest priority)
+// restricted to [from, last], appending its parts to `skyline`
+static void _map_skyline_compute(RPVector *skyline, RPVector *maps, ut64 from, ut64 last) {
 	RIOMap *map;
 	RPVector events;
 	RBinHeap heap;
 	struct map_event_t *ev;
 	bool *deleted = NULL;
-	r_pvector_clear (&io->map_skyline);
-	r_pvector_clear (&io->map_skyline_shadow);
+	const RInterval window = { from, last - from + 1 };
 	r_pvector_init (&events, free);
-	if (!r_pvector_reserve (&events, ls_length (io->maps) * 2) ||
-			!(deleted = calloc (ls_length (io->maps), 1))) {
+	if (!r_pvector_reserve (&events, r_pvector_len (maps) * 2) ||
+			!(deleted = calloc (r_pvector_len (maps) + 1, 1))) {
 		goto out;
 	}
 
-	int i = 0;
+	int i;
 	// Last map has highest priority (it shadows previous maps),
 	// we assign 0 to its event id.
-	ls_foreach_prev (io->maps, iter, map) {
+	for (i = 0; i < r_pvector_len (maps); i++) {
+		map = r_pvector_at (maps, i);
+		if (!r_itv_overlap (map->itv, window)) {
+			continue;
+		}
+		const RInterval itv = r_itv_intersect (map->itv, window);
 		if (!(ev = R_NEW (struct map_event_t))) {
 			goto out;
 		}
 		ev->map = map;
-		ev->addr = map->itv.addr;
+		ev->addr = itv.addr;
 		ev->is_to = false;
 		ev->id = i;
 		r_pvector_push (&events, ev);
@@ -96,18 +104,17 @@ void io_map_calculate_skyline(RIO *io) {
 			goto out;
 		}
 		ev->map = map;
-		ev->addr = r_itv_end (map->itv);
+		ev->addr = r_itv_end (itv);
 		ev->is_to = true;
 		ev->id = i;
 		r_pvector_push (&events, ev);
-		i++;
 	}
 	r_pvector_sort (&events, _cmp_map_event);
 
 	// A min heap whose elements represents active events.
 	// The element with the smallest id is at the top.
 	r_binheap_init (&heap, _cmp_map_event_by_id);
-	ut64 last;
+	ut64 prev = 0;
 	RIOMap *last_map = NULL;
 	for (i = 0; i < r_pvector_len (&events); i++) {
 		ev = r_pvector_at (&events, i);
@@ -122,71 +129,249 @@ void io_map_calculate_skyline(RIO *io) {
 		ut64 to = ev->addr;
 		map = r_binheap_empty (&heap) ? NULL : ((struct map_event_t *)r_binheap_top (&heap))->map;
 		if (!i) {
-			last = to;
+			prev = to;
 			last_map = map;
-		} else if (last != to || (!to && ev->is_to)) {
+		} else if (!to && ev->is_to) {
+			// This is a to == 2**64 event. Every active map ends here,
+			// so there are no more skyline parts.
+			if (last_map) {
+				(void)_map_skyline_push (skyline, prev, to, last_map);
+			}
+			break;
+		} else if (prev != to) {
 			if (last_map != map) {
-				if (last_map && !_map_skyline_push (&io->map_skyline, last, to, last_map)) {
+				if (last_map && !_map_skyline_push (skyline, prev, to, last_map)) {
 					break;
 				}
-				last = to;
+				prev = to;
 				last_map = map;
 			}
-			if (!to && ev->is_to) {
-				if (map) {
-					(void)_map_skyline_push (&io->map_skyline, last, to, map);
-				}
-				// This is a to == 2**64 event. There are no more skyline parts.
-				break;
-			}
-		} else if (map && (!last_map || map->id > last_map->id)) {
+		} else {
+			// several events at the same address, the heap top wins
 			last_map = map;
 		}
 	}
 	r_binheap_clear (&heap);
+out:
+	r_pvector_clear (&events);
+	free (deleted);
+}
 
-	const RPVector *skyline = &io->map_skyline;
-	RPVector *shadow = &io->map_skyline_shadow;
-	RInterval *cur_itv = NULL;
+// io->map_tree is sorted by address and id, maps may overlap each other
+static int _map_tree_cmp(const void *a_, const RBNode *b_) {
+	const RIOMap *a = (const RIOMap *)a_;
+	const RIOMap *b = MAP_CONTAINER (b_);
+	if (a->itv.addr != b->itv.addr) {
+		return a->itv.addr < b->itv.addr ? -1 : 1;
+	}
+	return a->id < b->id ? -1 : a->id > b->id;
+}
 
-	for (i = 0; i < r_pvector_len (skyline); i++) {
-		const RIOMapSkyline *part = r_pvector_at (skyline, i);
-		if (!part) {
-			continue;
+static void _map_tree_calc_max_addr(RBNode *node) {
+	int i;
+	RIOMap *map = MAP_CONTAINER (node);
+	map->rb_max_addr = _itv_last (map->itv);
+	for (i = 0; i < 2; i++) {
+		if (node->child[i]) {
+			RIOMap *map1 = MAP_CONTAINER (node->child[i]);
+			if (map1->rb_max_addr > map->rb_max_addr) {
+				map->rb_max_addr = map1->rb_max_addr;
+			}
 		}
+	}
+}
 
-		ut64 part_from = part->itv.addr;
-		ut64 part_size = part->itv.size;
+static void _map_tree_insert(RIO *io, RIOMap *map) {
+	r_rbtree_aug_insert (&io->map_tree, map, &map->rb, _map_tree_cmp, _map_tree_calc_max_addr);
+}
 
-		if (!cur_itv) {
-			cur_itv = r_itv_new (part_from, part_size);
-			if (!cur_itv) {
-				break;
-			}
-			continue;
+// the map itself is owned by io->maps
+static void _map_tree_delete(RIO *io, RIOMap *map) {
+	r_rbtree_aug_delete (&io->map_tree, map, _map_tree_cmp, NULL, _map_tree_calc_max_addr);
+}
+
+// Pushes the maps of the subtree overlapping [from, last], skipping the
+// subtrees ending before from and stopping at the first map after last
+static void _map_tree_collect(RBNode *node, RPVector *maps, ut64 from, ut64 last) {
+	while (node && from <= MAP_CONTAINER (node)->rb_max_addr) {
+		RIOMap *map = MAP_CONTAINER (node);
+		_map_tree_collect (node->child[0], maps, from, last);
+		if (map->itv.addr > last) {
+			break;
 		}
+		if (from <= _itv_last (map->itv)) {
+			r_pvector_push (maps, map);
+		}
+		node = node->child[1];
+	}
+}
 
-		if (part_from == r_itv_end (*cur_itv)) {
-			cur_itv->size += part_size;
-		} else {
-			if (!r_pvector_push (shadow, cur_itv)) {
-				R_FREE (cur_itv);
-				break;
-			}
-			cur_itv = r_itv_new (part_from, part_size);
-			if (!cur_itv) {
-				break;
-			}
+static int _cmp_map_prio(const void *a, const void *b) {
+	const RIOMap *ma = a, *mb = b;
+	return ma->prio < mb->prio ? 1 : ma->prio > mb->prio ? -1 : 0;
+}
+
+// Collects the maps overlapping [from, last] from highest to lowest priority
+static void _map_collect(RIO *io, RPVector *maps, ut64 from, ut64 last) {
+	_map_tree_collect (io->map_tree, maps, from, last);
+	r_pvector_sort (maps, _cmp_map_prio);
+}
+
+// Priority for a map about to be moved to the top or the bottom of io->maps
+static st64 _map_prio_edge(RIO *io, bool top) {
+	SdbListIter *edge = top ? io->maps->tail : io->maps->head;
+	if (!edge || !edge->data) {
+		return 0;
+	}
+	return ((RIOMap *)edge->data)->prio + (top ? 1 : -1);
+}
+
+static void _map_prio_renumber(RIO *io) {
+	SdbListIter *iter;
+	RIOMap *map;
+	st64 prio = 0;
+	ls_foreach (io->maps, iter, map) {
+		map->prio = prio++;
+	}
+}
+
+#define SKYLINE_CONTAINER(x) container_of ((RBNode*)(x), RIOMapSkyline, rb)
+
+static int _skyline_cmp(const void *a_, const RBNode *b_) {
+	const RIOMapSkyline *a = a_, *b = SKYLINE_CONTAINER (b_);
+	if (a->itv.addr != b->itv.addr) {
+		return a->itv.addr < b->itv.addr ? -1 : 1;
+	}
+	return 0;
+}
+
+// finds the first part whose last address is >= *addr
+static int _skyline_cmp_last(const void *addr_, const RBNode *b_) {
+	const ut64 addr = *(const ut64 *)addr_;
+	const ut64 last = _itv_last (SKYLINE_CONTAINER (b_)->itv);
+	return addr < last ? -1 : addr > last ? 1 : 0;
+}
+
+static void _skyline_free(RBNode *node) {
+	free (SKYLINE_CONTAINER (node));
+}
+
+RBIter io_map_skyline_lower_bound(RIO *io, ut64 addr) {
+	return r_rbtree_lower_bound_forward (io->map_skyline, &addr, _skyline_cmp_last);
+}
+
+static void _map_skyline_insert(RIO *io, RIOMapSkyline *part) {
+	r_rbtree_insert (&io->map_skyline, part, &part->rb, _skyline_cmp);
+}
+
+static RIOMapSkyline *_map_skyline_part(RIOMap *map, ut64 from, ut64 last) {
+	RIOMapSkyline *part = R_NEW0 (RIOMapSkyline);
+	if (part) {
+		part->map = map;
+		part->itv = (RInterval){ from, last - from + 1 };
+	}
+	return part;
+}
+
+// Recomputes the skyline parts covering [from, last]. If `top` is given it is the
+// highest priority map and covers the whole range, so no other map is visited.
+// Only the parts overlapping or touching the range are replaced, in O(k log n)
+static void io_map_update_skyline(RIO *io, ut64 from, ut64 last, RIOMap *top) {
+	RPVector parts, maps, old;
+	RIOMapSkyline *part, *prev = NULL;
+	RBIter it;
+	size_t i;
+	if (io->map_skyline_dirty || (!from && last == UT64_MAX)) {
+		io_map_calculate_skyline (io);
+		return;
+	}
+	r_pvector_init (&parts, free);
+	r_pvector_init (&old, NULL);
+	// parts touching the range are taken too, to merge them with the new ones
+	const ut64 tfrom = from ? from - 1 : 0;
+	const ut64 tlast = last < UT64_MAX ? last + 1 : last;
+	it = io_map_skyline_lower_bound (io, tfrom);
+	r_rbtree_iter_while (it, part, RIOMapSkyline, rb) {
+		if (part->itv.addr > tlast) {
+			break;
+		}
+		r_pvector_push (&old, part);
+	}
+	// the pieces of the old parts lying outside of the range are kept
+	if (r_pvector_len (&old)) {
+		part = r_pvector_at (&old, 0);
+		if (part->itv.addr < from) {
+			r_pvector_push (&parts, _map_skyline_part (part->map, part->itv.addr,
+				R_MIN (_itv_last (part->itv), from - 1)));
 		}
 	}
-	if (cur_itv) {
-		if (!r_pvector_push (shadow, cur_itv)) {
-			R_FREE (cur_itv);
+	if (top) {
+		r_pvector_push (&parts, _map_skyline_part (top, from, last));
+	} else {
+		r_pvector_init (&maps, NULL);
+		_map_collect (io, &maps, from, last);
+		_map_skyline_compute (&parts, &maps, from, last);
+		r_pvector_clear (&maps);
+	}
+	if (r_pvector_len (&old)) {
+		part = r_pvector_at (&old, r_pvector_len (&old) - 1);
+		if (_itv_last (part->itv) > last) {
+			r_pvector_push (&parts, _map_skyline_part (part->map,
+				R_MAX (part->itv.addr, last + 1), _itv_last (part->itv)));
 		}
 	}
-out:
-	r_pvector_clear (&events);
-	free (deleted);
+	for (i = 0; i < r_pvector_len (&old); i++) {
+		r_rbtree_delete (&io->map_skyline, r_pvector_at (&old, i), _skyline_cmp, _skyline_free);
+	}
+	r_pvector_clear (&old);
+	// adjacent parts of the same map are merged, unless the address wraps
+	for (i = 0; i < r_pvector_len (&parts); i++) {
+		part = r_pvector_at (&parts, i);
+		if (!part) {
+			continue;
+		}
+		if (prev && prev->map == part->map && r_itv_end (prev->itv) == part->itv.addr && part->itv.addr) {
+			prev->itv.size += part->itv.size;
+			continue;
+		}
+		if (prev) {
+			_map_skyline_insert (io, prev);
+		}
+		prev = part;
+		r_pvector_set (&parts, i, NULL);
+	}
+	if (prev) {
+		_map_skyline_insert (io, prev);
+	}
+	r_pvector_clear (&parts);
+}
+
+// Store map parts that are not covered by others into io->map_skyline
+void io_map_calculate_skyline(RIO *io) {
+	SdbListIter *iter;
+	RIOMap *map;
+	RPVector maps, parts;
+	size_t i;
+	r_rbtree_free (io->map_skyline, _skyline_free);
+	io->map_skyline = NULL;
+	io->map_skyline_dirty = false;
+	r_pvector_init (&maps, NULL);
+	r_pvector_init (&parts, NULL);
+	if (!r_pvector_reserve (&maps, ls_length (io->maps))) {
+		return;
+	}
+	ls_foreach_prev (io->maps, iter, map) {
+		r_pvector_push (&maps, map);
+	}
+	_map_skyline_compute (&parts, &maps, 0, UT64_MAX);
+	r_pvector_clear (&maps);
+	for (i = 0; i < r_pvector_len (&parts); i++) {
+		RIOMapSkyline *part = r_pvector_at (&parts, i);
+		if (part) {
+			_map_skyline_insert (io, part);
+		}
+	}
+	r_pvector_clear (&parts);
 }
 
 RIOMap* io_map_new(RIO* io, int fd, int perm, ut64 delta, ut64 addr, ut64 size, bool do_skyline) {
@@ -209,10 +394,15 @@ RIOMap* io_map_new(RIO* io, int fd, int perm, ut64 delta, ut64 addr, ut64 size,
 	map->itv = (RInterval){ addr, size };
 	map->perm = perm;
 	map->delta = delta;
+	map->prio = _map_prio_edge (io, true);
 	// new map lives on the top, being top the list's tail
 	ls_append (io->maps, map);
+	ht_up_insert (io->map_by_id, map->id, map);
+	_map_tree_insert (io, map);
 	if (do_skyline) {
-		io_map_calculate_skyline (io);
+		io_map_update_skyline (io, addr, _itv_last (map->itv), map);
+	} else {
+		io->map_skyline_dirty = true;
 	}
 	return map;
 }
@@ -225,13 +415,19 @@ R_API bool r_io_map_remap (RIO *io, ut32 id, ut64 addr) {
 	RIOMap *map = r_io_map_resolve (io, id);
 	if (map) {
 		ut64 size = map->itv.size;
+		const RInterval old = map->itv;
+		_map_tree_delete (io, map);
 		map->itv.addr = addr;
 		if (UT64_MAX - size + 1 < addr) {
 			map->itv.size = -addr;
+			_map_tree_insert (io, map);
 			r_io_map_new (io, map->fd, map->perm, map->delta - addr, 0, size + addr);
+			io_map_calculate_skyline (io);
 			return true;
 		}
-		io_map_calculate_skyline (io);
+		_map_tree_insert (io, map);
+		io_map_update_skyline (io, old.addr, _itv_last (old), NULL);
+		io_map_update_skyline (io, addr, _itv_last (map->itv), NULL);
 		return true;
 	}
 	return false;
@@ -263,6 +459,8 @@ static void _map_free(void* p) {
 R_API void r_io_map_init(RIO* io) {
 	if (io && !io->maps) {
 		io->maps = ls_newf ((SdbListFree)_map_free);
+		io->map_by_id = ht_up_new0 ();
+		io->map_tree = NULL;
 		if (io->map_ids) {
 			r_id_pool_free (io->map_ids);
 		}
@@ -291,17 +489,10 @@ R_API bool r_io_map_exists_for_id(RIO* io, ut32 id) {
 }
 
 R_API RIOMap* r_io_map_resolve(RIO* io, ut32 id) {
-	SdbListIter* iter;
-	RIOMap* map;
-	if (!io || !io->maps || !id) {
+	if (!io || !io->map_by_id || !id) {
 		return NULL;
 	}
-	ls_foreach (io->maps, iter, map) {
-		if (map->id == id) {
-			return map;
-		}
-	}
-	return NULL;
+	return ht_up_find (io->map_by_id, id, NULL);
 }
 
 RIOMap* io_map_add(RIO* io, int fd, int perm, ut64 delta, ut64 addr, ut64 size, bool do_skyline) {
@@ -354,17 +545,8 @@ R_API RIOMap* r_io_map_get(RIO* io, ut64 addr) {
 
 R_API bool r_io_map_is_mapped(RIO* io, ut64 addr) {
 	r_return_val_if_fail (io, false);
-	const RPVector *shadow = &io->map_skyline_shadow;
-	size_t i, len = r_pvector_len (shadow);
-	r_pvector_lower_bound (shadow, addr, i, CMP_END_GT);
-	if (i == len) {
-		return false;
-	}
-	const RInterval *itv = r_pvector_at (shadow, i);
-	if (itv->addr <= addr) {
-		return true;
-	}
-	return false;
+	RBIter it = io_map_skyline_lower_bound (io, addr);
+	return it.len && IO_SKYLINE_PART (it)->itv.addr <= addr;
 }
 
 R_API void r_io_map_reset(RIO* io) {
@@ -379,9 +561,12 @@ R_API bool r_io_map_del(RIO* io, ut32 id) {
 	SdbListIter* iter;
 	ls_foreach (io->maps, iter, map) {
 		if (map->id == id) {
+			const RInterval itv = map->itv;
+			ht_up_delete (io->map_by_id, id);
+			_map_tree_delete (io, map);
 			ls_delete (io->maps, iter);
 			r_id_pool_kick_id (io->map_ids, id);
-			io_map_calculate_skyline (io);
+			io_map_update_skyline (io, itv.addr, _itv_last (itv), NULL);
 			return true;
 		}
 	}
@@ -399,6 +584,8 @@ R_API bool r_io_map_del_for_fd(RIO* io, int fd) {
 			ls_delete (io->maps, iter);
 		} else if (map->fd == fd) {
 			r_id_pool_kick_id (io->map_ids, map->id);
+			ht_up_delete (io->map_by_id, map->id);
+			_map_tree_delete (io, map);
 			//delete iter and map
 			ls_delete (io->maps, iter);
 			ret = true;
@@ -419,9 +606,10 @@ R_API bool r_io_map_priorize(RIO* io, ut32 id) {
 	ls_foreach (io->maps, iter, map) {
 		// search for iter with the correct map
 		if (map->id == id) {
+			map->prio = _map_prio_edge (io, true);
 			ls_split_iter (io->maps, iter);
 			ls_append (io->maps, map);
-			io_map_calculate_skyline (io);
+			io_map_update_skyline (io, map->itv.addr, _itv_last (map->itv), map);
 			return true;
 		}
 	}
@@ -435,9 +623,10 @@ R_API bool r_io_map_depriorize(RIO* io, ut32 id) {
 	ls_foreach (io->maps, iter, map) {
 		// search for iter with the correct map
 		if (map->id == id) {
+			map->prio = _map_prio_edge (io, false);
 			ls_split_iter (io->maps, iter);
 			ls_prepend (io->maps, map);
-			io_map_calculate_skyline (io);
+			io_map_update_skyline (io, map->itv.addr, _itv_last (map->itv), NULL);
 			return true;
 		}
 	}
@@ -467,6 +656,7 @@ R_API bool r_io_map_priorize_for_fd(RIO* io, int fd) {
 	ls_join (io->maps, list);
 	ls_free (list);
 	io->maps->free = _map_free;
+	_map_prio_renumber (io);
 	io_map_calculate_skyline (io);
 	return true;
 }
@@ -493,6 +683,8 @@ R_API void r_io_map_cleanup(RIO* io) {
 		} else if (!r_io_desc_get (io, map->fd)) {
 			//delete map and iter if no desc exists for map->fd in io->files
 			r_id_pool_kick_id (io->map_ids, map->id);
+			ht_up_delete (io->map_by_id, map->id);
+			_map_tree_delete (io, map);
 			ls_delete (io->maps, iter);
 			del = true;
 		}
@@ -506,10 +698,13 @@ R_API void r_io_map_fini(RIO* io) {
 	r_return_if_fail (io);
 	ls_free (io->maps);
 	io->maps = NULL;
+	io->map_tree = NULL;
+	ht_up_free (io->map_by_id);
+	io->map_by_id = NULL;
 	r_id_pool_free (io->map_ids);
 	io->map_ids = NULL;
-	r_pvector_clear (&io->map_skyline);
-	r_pvector_clear (&io->map_skyline_shadow);
+	r_rbtree_free (io->map_skyline, _skyline_free);
+	io->map_skyline = NULL;
 }
 
 R_API void r_io_map_set_name(RIOMap* map, const char* name) {
@@ -588,12 +783,17 @@ R_API bool r_io_map_resize(RIO *io, ut32 id, ut64 newsize) {
 		return false;
 	}
 	ut64 addr = map->itv.addr;
+	_map_tree_delete (io, map);
 	if (UT64_MAX - newsize + 1 < addr) {
 		map->itv.size = -addr;
+		_map_tree_insert (io, map);
 		r_io_map_new (io, map->fd, map->perm, map->delta - addr, 0, newsize + addr);
+		io_map_calculate_skyline (io);
 		return true;
 	}
+	const ut64 size = R_MAX (map->itv.size, newsize);
 	map->itv.size = newsize;
-	io_map_calculate_skyline (io);
+	_map_tree_insert (io, map);
+	io_map_update_skyline (io, addr, addr + size - 1, NULL);
 	return true;
 }
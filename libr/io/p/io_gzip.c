@@ -1,4 +1,4 @@
-/* radare - LGPL - Copyright 2008-2017 - pancake */
+/* radare - LGPL - Copyright 2008-2019 - pancake */
 
 #include "r_io.h"
 #include "r_lib.h"
@@ -6,76 +6,180 @@
 #include <stdlib.h>
 #include <sys/types.h>
 
+// The inflated data is read through an index of inflate checkpoints built
+// in the background, the recently read windows of it are kept around.
+// Writing or resizing inflates the whole file into memory.
+#define GZIP_SPAN (1024 * 1024) // inflated bytes between checkpoints
+#define GZIP_WINDOW (256 * 1024)
+#define GZIP_CACHE 64
+// deflate inflates at most 1032 bytes per compressed byte, so the trailer
+// size modulo 4G is exact for files smaller than this
+#define GZIP_ISIZE_MAX (UT32_MAX / 1032)
+
 typedef struct {
+	ut64 addr; // UT64_MAX if unused
 	ut8 *buf;
-	ut32 size;
+	int len;
+	ut64 used; // last access, for the LRU
+} RIOGzipWindow;
+
+typedef struct {
+	ut8 *buf; // the whole inflated file once written or resized
+	ut64 size;
 	ut64 offset;
+	RInflateIndex *idx;
+	char *index; // where to save the index once built
+	RThread *th;
+	RThreadLock *lock;
+	bool stop;
+	ut64 used;
+	RIOGzipWindow cache[GZIP_CACHE];
 } RIOGzip;
 
-static inline ut32 _io_malloc_sz(RIODesc *desc) {
-	if (!desc) {
-		return 0;
+// size of the inflated data from the gzip trailer, UT64_MAX if it can
+// be larger than 4G or the file is not a gzip one
+static ut64 gzip_isize(const char *file) {
+	ut8 hdr[2] = {0}, isize[4];
+	ut64 zsize = r_file_size (file);
+	if (zsize < 18 || zsize > GZIP_ISIZE_MAX) {
+		return UT64_MAX;
 	}
-	RIOGzip *mal = (RIOGzip*)desc->data;
-	return mal? mal->size: 0;
-}
-
-static inline void _io_malloc_set_sz(RIODesc *desc, ut32 sz) {
-	if (!desc) {
-		return;
+	int fd = r_sandbox_open (file, O_RDONLY | O_BINARY, 0);
+	if (fd == -1) {
+		return UT64_MAX;
 	}
-	RIOGzip *mal = (RIOGzip*)desc->data;
-	if (mal) {
-		mal->size = sz;
+	bool ok = r_sandbox_read (fd, hdr, 2) == 2 && hdr[0] == 0x1f && hdr[1] == 0x8b;
+	if (ok) {
+		r_sandbox_lseek (fd, zsize - 4, SEEK_SET);
+		ok = r_sandbox_read (fd, isize, 4) == 4;
 	}
+	r_sandbox_close (fd);
+	return ok? r_read_le32 (isize): UT64_MAX;
 }
 
-static inline ut8* _io_malloc_buf(RIODesc *desc) {
-	if (!desc) {
-		return NULL;
+static RThreadFunctionRet gzip_index_th(RThread *th) {
+	RIOGzip *gz = th->user;
+	for (;;) {
+		r_th_lock_enter (gz->lock);
+		ut64 built = r_inflate_index_built (gz->idx);
+		bool more = !gz->stop && r_inflate_index_size (gz->idx) == UT64_MAX
+			&& r_inflate_index_build (gz->idx, built + GZIP_SPAN);
+		if (!more && !gz->stop) {
+			// the trailer is only right for single member files below 4G,
+			// and is garbage for truncated ones
+			ut64 size = r_inflate_index_size (gz->idx);
+			if (size == UT64_MAX) {
+				gz->size = r_inflate_index_built (gz->idx);
+			} else {
+				gz->size = size;
+				if (gz->index) {
+					r_inflate_index_save (gz->idx, gz->index);
+				}
+			}
+		}
+		r_th_lock_leave (gz->lock);
+		if (!more) {
+			break;
+		}
 	}
-	RIOGzip *mal = (RIOGzip*)desc->data;
-	return mal->buf;
+	return R_TH_STOP;
 }
 
+static void gzip_stop(RIOGzip *gz) {
+	if (gz->th) {
+		r_th_lock_enter (gz->lock);
+		gz->stop = true;
+		r_th_lock_leave (gz->lock);
+		r_th_wait (gz->th);
+		r_th_free (gz->th);
+		gz->th = NULL;
+	}
+}
 
-static inline ut8* _io_malloc_set_buf(RIODesc *desc, ut8* buf) {
-	if (!desc) {
+static RIOGzipWindow *gzip_window(RIOGzip *gz, ut64 addr) {
+	RIOGzipWindow *w = gz->cache, *lru = gz->cache;
+	int i;
+	for (i = 0; i < GZIP_CACHE; i++, w++) {
+		if (w->addr == addr) {
+			w->used = ++gz->used;
+			return w;
+		}
+		if (w->used < lru->used) {
+			lru = w;
+		}
+	}
+	if (!lru->buf && !(lru->buf = malloc (GZIP_WINDOW))) {
+		return NULL;
+	}
+	lru->len = r_inflate_index_read (gz->idx, addr, lru->buf, GZIP_WINDOW);
+	if (lru->len < 0) {
+		lru->addr = UT64_MAX;
 		return NULL;
 	}
-	RIOGzip *mal = (RIOGzip*)desc->data;
-	return mal->buf = buf;
+	lru->addr = addr;
+	lru->used = ++gz->used;
+	return lru;
 }
 
-static inline ut64 _io_malloc_off(RIODesc *desc) {
-	if (!desc) {
-		return 0;
+static int gzip_read_at(RIOGzip *gz, ut64 off, ut8 *buf, int count) {
+	int done = 0;
+	while (done < count) {
+		ut64 addr = off + done;
+		RIOGzipWindow *w = gzip_window (gz, addr - addr % GZIP_WINDOW);
+		int delta = addr % GZIP_WINDOW;
+		if (!w || w->len <= delta) {
+			break;
+		}
+		int n = R_MIN (w->len - delta, count - done);
+		memcpy (buf + done, w->buf + delta, n);
+		done += n;
 	}
-	RIOGzip *mal = (RIOGzip*)desc->data;
-	return mal->offset;
+	return done;
 }
 
-static inline void _io_malloc_set_off(RIODesc *desc, ut64 off) {
-	if (!desc) {
-		return;
+// writes and resizes work on the whole inflated file as before
+static bool gzip_load(RIOGzip *gz) {
+	int i;
+	if (gz->buf) {
+		return true;
+	}
+	gzip_stop (gz);
+	if (!r_inflate_index_build (gz->idx, UT64_MAX)) {
+		return false;
+	}
+	ut64 size = r_inflate_index_size (gz->idx);
+	if (size > ST32_MAX || !(gz->buf = malloc (R_MAX (size, 1)))) {
+		eprintf ("Cannot allocate %"PFMT64d" byte(s)\n", size);
+		return false;
+	}
+	if (r_inflate_index_read (gz->idx, 0, gz->buf, size) != size) {
+		R_FREE (gz->buf);
+		return false;
 	}
-	RIOGzip *mal = (RIOGzip*)desc->data;
-	mal->offset = off;
+	gz->size = size;
+	r_inflate_index_free (gz->idx);
+	gz->idx = NULL;
+	for (i = 0; i < GZIP_CACHE; i++) {
+		R_FREE (gz->cache[i].buf);
+		gz->cache[i].addr = UT64_MAX;
+	}
+	return true;
 }
 
 static int __write(RIO *io, RIODesc *fd, const ut8 *buf, int count) {
 	if (!fd || !buf || count < 0 || !fd->data) {
 		return -1;
 	}
-	if (_io_malloc_off (fd) > _io_malloc_sz (fd)) {
+	RIOGzip *gz = fd->data;
+	if (!gzip_load (gz) || gz->offset > gz->size) {
 		return -1;
 	}
-	if (_io_malloc_off (fd) + count > _io_malloc_sz (fd)) {
-		count -= (_io_malloc_off (fd) + count -_io_malloc_sz (fd));
+	if (gz->offset + count > gz->size) {
+		count -= (gz->offset + count - gz->size);
 	}
 	if (count > 0) {
-		memcpy (_io_malloc_buf (fd) + _io_malloc_off (fd), buf, count);
-		_io_malloc_set_off (fd, _io_malloc_off (fd) + count);
+		memcpy (gz->buf + gz->offset, buf, count);
+		gz->offset += count;
 		return count;
 	}
 	return -1;
@@ -86,21 +190,21 @@ static bool __resize(RIO *io, RIODesc *fd, ut64 count) {
 	if (!fd || !fd->data || count == 0) {
 		return false;
 	}
-	ut32 mallocsz = _io_malloc_sz (fd);
-	if (_io_malloc_off (fd) > mallocsz) {
+	RIOGzip *gz = fd->data;
+	if (!gzip_load (gz) || gz->offset > gz->size) {
 		return false;
 	}
 	new_buf = malloc (count);
 	if (!new_buf) {
-		return -1;
+		return false;
 	}
-	memcpy (new_buf, _io_malloc_buf (fd), R_MIN (count, mallocsz));
-	if (count > mallocsz) {
-		memset (new_buf + mallocsz, 0, count - mallocsz);
+	memcpy (new_buf, gz->buf, R_MIN (count, gz->size));
+	if (count > gz->size) {
+		memset (new_buf + gz->size, 0, count - gz->size);
 	}
-	free (_io_malloc_buf (fd));
-	_io_malloc_set_buf (fd, new_buf);
-	_io_malloc_set_sz (fd, count);
+	free (gz->buf);
+	gz->buf = new_buf;
+	gz->size = count;
 	return true;
 }
 
@@ -109,26 +213,47 @@ static int __read(RIO *io, RIODesc *fd, ut8 *buf, int count) {
 	if (!fd || !fd->data) {
 		return -1;
 	}
-	ut32 mallocsz = _io_malloc_sz (fd);
-	if (_io_malloc_off (fd) > mallocsz) {
+	RIOGzip *gz = fd->data;
+	r_th_lock_enter (gz->lock);
+	if (gz->offset > gz->size) {
+		r_th_lock_leave (gz->lock);
 		return -1;
 	}
-	if (_io_malloc_off (fd) + count >= mallocsz) {
-		count = mallocsz - _io_malloc_off (fd);
+	if (gz->offset + count >= gz->size) {
+		count = gz->size - gz->offset;
+	}
+	if (gz->buf) {
+		memcpy (buf, gz->buf + gz->offset, count);
+	} else {
+		count = gzip_read_at (gz, gz->offset, buf, count);
 	}
-	memcpy (buf, _io_malloc_buf (fd) + _io_malloc_off (fd), count);
+	r_th_lock_leave (gz->lock);
 	return count;
 }
 
+static void gzip_free(RIOGzip *gz) {
+	int i;
+	gzip_stop (gz);
+	for (i = 0; i < GZIP_CACHE; i++) {
+		free (gz->cache[i].buf);
+	}
+	r_inflate_index_free (gz->idx);
+	r_th_lock_free (gz->lock);
+	free (gz->index);
+	free (gz->buf);
+	free (gz);
+}
+
 static int __close(RIODesc *fd) {
-	RIOGzip *riom;
 	if (!fd || !fd->data) {
 		return -1;
 	}
-	riom = fd->data;
-	R_FREE (riom->buf);
-	R_FREE (fd->data);
-	eprintf ("TODO: Writing changes into gzipped files is not yet supported\n");
+	RIOGzip *gz = fd->data;
+	if (gz->buf) {
+		eprintf ("TODO: Writing changes into gzipped files is not yet supported\n");
+	}
+	gzip_free (gz);
+	fd->data = NULL;
 	return 0;
 }
 
@@ -137,19 +262,21 @@ static ut64 __lseek(RIO* io, RIODesc *fd, ut64 offset, int whence) {
 	if (!fd || !fd->data) {
 		return offset;
 	}
-	ut32 mallocsz = _io_malloc_sz (fd);
+	RIOGzip *gz = fd->data;
+	r_th_lock_enter (gz->lock);
 	switch (whence) {
 	case SEEK_SET:
-		r_offset = (offset <= mallocsz) ? offset : mallocsz;
+		r_offset = (offset <= gz->size) ? offset : gz->size;
 		break;
 	case SEEK_CUR:
-		r_offset = (_io_malloc_off (fd) + offset <= mallocsz ) ? _io_malloc_off (fd) + offset : mallocsz;
+		r_offset = (gz->offset + offset <= gz->size) ? gz->offset + offset : gz->size;
 		break;
 	case SEEK_END:
-		r_offset = _io_malloc_sz (fd);
+		r_offset = gz->size;
 		break;
 	}
-	_io_malloc_set_off (fd, r_offset);
+	gz->offset = r_offset;
+	r_th_lock_leave (gz->lock);
 	return r_offset;
 }
 
@@ -158,23 +285,53 @@ static bool __plugin_open(RIO *io, const char *pathname, bool many) {
 }
 
 static RIODesc *__open(RIO *io, const char *pathname, int rw, int mode) {
-	if (__plugin_open (io, pathname, 0)) {
-		RIOGzip *mal = R_NEW0 (RIOGzip);
-		if (!mal) {
-			return NULL;
-		}
-		int len;
-		ut8 *data = (ut8*)r_file_slurp (pathname+7, &len);	//memleak here?
-		int *size = (int*)&mal->size;
-		mal->buf = r_inflate (data, len, NULL, size);
-		if (mal->buf) {
-			return r_io_desc_new (io, &r_io_plugin_gzip, pathname, rw, mode, mal);
+	if (!__plugin_open (io, pathname, 0)) {
+		return NULL;
+	}
+	const char *file = pathname + 7;
+	int i;
+	RIOGzip *gz = R_NEW0 (RIOGzip);
+	if (!gz) {
+		return NULL;
+	}
+	for (i = 0; i < GZIP_CACHE; i++) {
+		gz->cache[i].addr = UT64_MAX;
+	}
+	gz->lock = r_th_lock_new (false);
+	if (!gz->lock) {
+		free (gz);
+		return NULL;
+	}
+	// the index is saved next to the file with io.gzip.index, and reused
+	char *index = r_str_newf ("%s.r2idx", file);
+	gz->idx = r_inflate_index_load (file, index);
+	if (io->gzip_index) {
+		gz->index = index;
+	} else {
+		free (index);
+	}
+	if (gz->idx) {
+		gz->size = r_inflate_index_size (gz->idx);
+		return r_io_desc_new (io, &r_io_plugin_gzip, pathname, rw, mode, gz);
+	}
+	gz->idx = r_inflate_index_new (file, GZIP_SPAN);
+	gz->size = gzip_isize (file);
+	// the maps are sized at open, zlib streams do not store their size and
+	// the gzip one is modulo 4G, so those are indexed now
+	if (!gz->idx || !r_inflate_index_build (gz->idx, gz->size == UT64_MAX? UT64_MAX: 1)) {
+		eprintf ("Cannot inflate %s\n", file);
+		gzip_free (gz);
+		return NULL;
+	}
+	if (gz->size == UT64_MAX) {
+		gz->size = r_inflate_index_size (gz->idx);
+		if (gz->index) {
+			r_inflate_index_save (gz->idx, gz->index);
 		}
-		free (data);
-		eprintf ("Cannot allocate (%s) %d byte(s)\n", pathname+9, mal->size);
-		free (mal);
+	} else {
+		gz->th = r_th_new (gzip_index_th, gz, 0);
 	}
-	return NULL;
+	return r_io_desc_new (io, &r_io_plugin_gzip, pathname, rw, mode, gz);
 }
 
 RIOPlugin r_io_plugin_gzip = {
@@ -1,4 +1,4 @@
-/* radare - LGPL - Copyright 2008-2017 - pancake */
+/* radare - LGPL - Copyright 2008-2019 - pancake */
 
 #include <r_userconf.h>
 #include <r_util.h>
@@ -13,12 +13,41 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <errno.h>
+#if __linux__
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#if defined(__NR_process_vm_readv) && defined(__NR_process_vm_writev)
+#define USE_PROCESS_VM 1
+#endif
+#endif
+#ifndef USE_PROCESS_VM
+#define USE_PROCESS_VM 0
+#endif
+
+// ways to access the memory of the target, from the fastest one. Reads
+// fall back to ptrace when process_vm_readv is not available
+enum {
+	PTRACE_IO_VM, // process_vm_readv/writev
+	PTRACE_IO_MEM, // /proc/pid/mem, only when picked with =!mem
+	PTRACE_IO_RAW, // PTRACE_PEEKTEXT/POKEDATA one word at a time
+};
+
+#if 0
+procpidmem is buggy.. running this sometimes results in ffff
+
+	while : ; do r2 -qc 'oo;x' -d ls ; done
+#endif
+
+static const char *ptrace_io_names[] = { "vm", "mem", "ptrace" };
+
+#define PTRACE_PAGE 0x1000
 
 typedef struct {
 	int pid;
 	int tid;
 	int fd;
 	int opid;
+	int io;
 } RIOPtrace;
 #define RIOPTRACE_OPID(x) (((RIOPtrace*)(x)->data)->opid)
 #define RIOPTRACE_PID(x) (((RIOPtrace*)(x)->data)->pid)
@@ -31,13 +60,6 @@ static void open_pidmem (RIOPtrace *iop);
 extern int errno;
 #endif
 
-#if 0
-procpidmem is buggy.. running this sometimes results in ffff
-
-	while : ; do r2 -qc 'oo;x' -d ls ; done
-#endif
-#define USE_PROC_PID_MEM 0
-
 static int __waitpid(int pid) {
 	int st = 0;
 	return (waitpid (pid, &st, 0) != -1);
@@ -70,37 +92,119 @@ static int debug_os_read_at(RIO *io, int pid, ut32 *buf, int sz, ut64 addr) {
 	return sz;
 }
 
-static int __read(RIO *io, RIODesc *desc, ut8 *buf, int len) {
-#if USE_PROC_PID_MEM
-	int ret, fd;
+// length of the piece of [addr, addr + len) that lays in the page of addr
+static int page_chunk(ut64 addr, int len) {
+	return R_MIN (PTRACE_PAGE - (addr % PTRACE_PAGE), len);
+}
+
+#if USE_PROCESS_VM
+// the kernel copies page by page and stops at the first one that is not
+// mapped (EFAULT), which is skipped. Returns -1 with errno set on any
+// other error
+static int vm_read_at(int pid, ut8 *buf, int len, ut64 addr) {
+	int done = 0;
+	while (done < len) {
+		struct iovec local = { buf + done, len - done };
+		struct iovec remote = { (void *)(size_t)(addr + done), len - done };
+		long ret = syscall (__NR_process_vm_readv, pid, &local, 1, &remote, 1, 0);
+		if (ret < 0) {
+			if (errno != EFAULT) {
+				return -1;
+			}
+			ret = 0;
+		}
+		done += ret;
+		if (done < len) {
+			int skip = page_chunk (addr + done, len - done);
+			memset (buf + done, 0xff, skip);
+			done += skip;
+		}
+	}
+	return len;
+}
+
+static int vm_write_at(int pid, const ut8 *buf, int len, ut64 addr) {
+	struct iovec local = { (void *)buf, len };
+	struct iovec remote = { (void *)(size_t)addr, len };
+	long ret = syscall (__NR_process_vm_writev, pid, &local, 1, &remote, 1, 0);
+	return ret < 0? 0: ret;
+}
 #endif
-	ut64 addr = io->off;
-	if (!desc || !desc->data) {
-		return -1;
+
+static int mem_read_at(int fd, ut8 *buf, int len, ut64 addr) {
+	int done = 0;
+	while (done < len) {
+		int ret = -1;
+		if (lseek (fd, addr + done, SEEK_SET) != -1) {
+			ret = read (fd, buf + done, len - done);
+		}
+		if (ret > 0) {
+			done += ret;
+		} else {
+			int skip = page_chunk (addr + done, len - done);
+			memset (buf + done, 0xff, skip);
+			done += skip;
+		}
+	}
+	return len;
+}
+
+static int mem_write_at(int fd, const ut8 *buf, int len, ut64 addr) {
+	if (lseek (fd, addr, SEEK_SET) == -1) {
+		return 0;
 	}
-	memset (buf, '\xff', len); // TODO: only memset the non-readed bytes
+	int ret = write (fd, buf, len);
+	return ret < 0? 0: ret;
+}
+
+static void check_pidmem(RIOPtrace *iop) {
 	/* reopen procpidmem if necessary */
-#if USE_PROC_PID_MEM
-	fd = RIOPTRACE_FD (desc);
-	if (RIOPTRACE_PID (desc) != RIOPTRACE_OPID (desc)) {
-		if (fd != -1) {
-			close (fd);
+	if (iop->pid != iop->opid) {
+		if (iop->fd != -1) {
+			close (iop->fd);
 		}
-		open_pidmem ((RIOPtrace*)desc->data);
-		fd = RIOPTRACE_FD (desc);
-		RIOPTRACE_OPID(desc) = RIOPTRACE_PID(desc);
+		open_pidmem (iop);
+		iop->opid = iop->pid;
 	}
-	// /proc/pid/mem fails on latest linux
-	if (fd != -1) {
-		ret = lseek (fd, addr, SEEK_SET);
-		if (ret >=0) {
-			ret = read (fd, buf, len);
-			// Workaround for the buggy Debian Wheeze's /proc/pid/mem
-			if (ret != -1) return ret;
+}
+
+static int ptrace_read_at(RIO *io, RIOPtrace *iop, ut8 *buf, int len, ut64 addr) {
+	switch (iop->io) {
+#if USE_PROCESS_VM
+	case PTRACE_IO_VM: {
+		int ret = vm_read_at (iop->pid, buf, len, addr);
+		if (ret != -1) {
+			return ret;
+		}
+		if (errno == ESRCH) {
+			return -1; // the process is gone
 		}
+		if (errno == ENOSYS || errno == EPERM) {
+			iop->io = PTRACE_IO_RAW;
+		}
+		break;
 	}
 #endif
-	return debug_os_read_at (io, RIOPTRACE_PID (desc), (ut32*)buf, len, addr);
+	case PTRACE_IO_MEM:
+		check_pidmem (iop);
+		if (iop->fd != -1) {
+			return mem_read_at (iop->fd, buf, len, addr);
+		}
+		iop->io = PTRACE_IO_RAW;
+		break;
+	}
+	return debug_os_read_at (io, iop->pid, (ut32*)buf, len, addr);
+}
+
+static int __read(RIO *io, RIODesc *desc, ut8 *buf, int len) {
+	if (!desc || !desc->data) {
+		return -1;
+	}
+	memset (buf, '\xff', len);
+	if (len < 1 || io->off == UT64_MAX) {
+		return -1;
+	}
+	return ptrace_read_at (io, desc->data, buf, len, io->off);
 }
 
 static int ptrace_write_at(RIO *io, int pid, const ut8 *pbuf, int sz, ut64 addr) {
@@ -132,25 +236,38 @@ static int __write(RIO *io, RIODesc *fd, const ut8 *buf, int len) {
 	if (!fd || !fd->data) {
 		return -1;
 	}
-	return ptrace_write_at (io, RIOPTRACE_PID (fd), buf, len, io->off);
+	RIOPtrace *iop = fd->data;
+	ut64 addr = io->off;
+	int done = 0;
+	// process_vm_writev cannot write to read-only pages, unlike the others
+#if USE_PROCESS_VM
+	if (iop->io == PTRACE_IO_VM) {
+		done = vm_write_at (iop->pid, buf, len, addr);
+	}
+#endif
+	if (done < len && iop->io == PTRACE_IO_MEM) {
+		check_pidmem (iop);
+		if (iop->fd != -1) {
+			done += mem_write_at (iop->fd, buf + done, len - done, addr + done);
+		}
+	}
+	if (done < len) {
+		int ret = ptrace_write_at (io, iop->pid, buf + done, len - done, addr + done);
+		if (ret < 0) {
+			return done? done: -1;
+		}
+		done += ret;
+	}
+	return done;
 }
 
 static void open_pidmem (RIOPtrace *iop) {
-#if USE_PROC_PID_MEM
 	char pidmem[32];
 	snprintf (pidmem, sizeof (pidmem), "/proc/%d/mem", iop->pid);
 	iop->fd = open (pidmem, O_RDWR);
 	if (iop->fd == -1) {
 		iop->fd = open (pidmem, O_RDONLY);
 	}
-#if 0
-	if (iop->fd == -1)
-		eprintf ("Warning: Cannot open /proc/%d/mem. "
-			"Fallback to ptrace io.\n", iop->pid);
-#endif
-#else
-	iop->fd = -1;
-#endif
 }
 
 static void close_pidmem(RIOPtrace *iop) {
@@ -160,6 +277,32 @@ static void close_pidmem(RIOPtrace *iop) {
 	}
 }
 
+static void ptrace_bench(RIO *io, RIOPtrace *iop, int len) {
+	ut8 *buf = malloc (len);
+	int old = iop->io, i;
+	if (!buf) {
+		return;
+	}
+	memset (buf, 0, len); // do not time the page faults
+	if (iop->fd == -1) {
+		open_pidmem (iop);
+	}
+	for (i = USE_PROCESS_VM? PTRACE_IO_VM: PTRACE_IO_MEM; i <= PTRACE_IO_RAW; i++) {
+		iop->io = i;
+		ut64 t = r_sys_now ();
+		ptrace_read_at (io, iop, buf, len, io->off);
+		t = r_sys_now () - t;
+		if (iop->io != i) {
+			io->cb_printf ("%-6s unavailable\n", ptrace_io_names[i]);
+			continue;
+		}
+		io->cb_printf ("%-6s %.2f MB/s\n", ptrace_io_names[i],
+			t? (double)len / t: 0.0);
+	}
+	iop->io = old;
+	free (buf);
+}
+
 static bool __plugin_open(RIO *io, const char *file, bool many) {
 	if (!strncmp (file, "ptrace://", 9)) {
 		return true;
@@ -205,7 +348,8 @@ static RIODesc *__open(RIO *io, const char *file, int rw, int mode) {
 			if (!riop) {
 				return NULL;
 			}
-			riop->pid = riop->tid = pid;
+			riop->pid = riop->tid = riop->opid = pid;
+			riop->io = USE_PROCESS_VM? PTRACE_IO_VM: PTRACE_IO_RAW;
 			open_pidmem (riop);
 			desc = r_io_desc_new (io, &r_io_plugin_ptrace, file, rw | R_PERM_X, mode, riop);
 			desc->name = r_sys_pid_to_path (pid);
@@ -253,15 +397,31 @@ static char *__system(RIO *io, RIODesc *fd, const char *cmd) {
 	if (!strcmp (cmd, "help")) {
 		eprintf ("Usage: =!cmd args\n"
 			" =!ptrace   - use ptrace io\n"
-			" =!mem      - use /proc/pid/mem io if possible\n"
+			" =!mem      - use /proc/pid/mem io if possible (may read ffff)\n"
+			" =!vm       - use process_vm_readv io if possible (default)\n"
+			" =!io       - show the io in use\n"
+			" =!bench [len] - measure the read speed of each io at the current offset\n"
 			" =!pid      - show targeted pid\n"
 			" =!pid <#>  - select new pid\n");
 	} else
 	if (!strcmp (cmd, "ptrace")) {
 		close_pidmem (iop);
+		iop->io = PTRACE_IO_RAW;
 	} else
 	if (!strcmp (cmd, "mem")) {
+		close_pidmem (iop);
 		open_pidmem (iop);
+		iop->io = PTRACE_IO_MEM;
+	} else
+	if (!strcmp (cmd, "vm")) {
+		iop->io = USE_PROCESS_VM? PTRACE_IO_VM: PTRACE_IO_RAW;
+	} else
+	if (!strcmp (cmd, "io")) {
+		io->cb_printf ("%s\n", ptrace_io_names[iop->io]);
+	} else
+	if (!strncmp (cmd, "bench", 5)) {
+		int len = cmd[5] == ' '? (int)r_num_math (NULL, cmd + 6): 0;
+		ptrace_bench (io, iop, len > 0? len: 0x100000);
 	} else
 	if (!strncmp (cmd, "pid", 3)) {
 		if (iop) {
@@ -294,7 +454,7 @@ static int __getpid (RIODesc *fd) {
 // TODO: rename ptrace to io_ptrace .. err io.ptrace ??
 RIOPlugin r_io_plugin_ptrace = {
 	.name = "ptrace",
-	.desc = "ptrace and /proc/pid/mem (if available) io",
+	.desc = "ptrace, process_vm_readv and /proc/pid/mem (if available) io",
 	.license = "LGPL3",
 	.open = __open,
 	.close = __close,
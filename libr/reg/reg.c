@@ -183,10 +183,13 @@ R_API void r_reg_free_internal(RReg *reg, bool init) {
 			reg->regset[i].pool = NULL;
 		}
 	}
-	if (!init) {
-		r_list_free (reg->allregs);
-		reg->allregs = NULL;
-	}
+	// the items are gone, so are the indexes pointing to them
+	r_list_free (reg->allregs);
+	reg->allregs = NULL;
+	ht_pp_free (reg->regnames);
+	reg->regnames = NULL;
+	R_FREE (reg->regindex);
+	reg->regcount = 0;
 	reg->size = 0;
 }
 
@@ -201,37 +204,52 @@ R_API void r_reg_reindex(RReg *reg) {
 	RListIter *iter;
 	RRegItem *r;
 	RList *all = r_list_newf (NULL);
+	HtPP *names = ht_pp_new0 ();
 	for (i = 0; i < R_REG_TYPE_LAST; i++) {
 		r_list_foreach (reg->regset[i].regs, iter, r) {
 			r_list_append (all, r);
+			if (r->name) {
+				// keep the first one, like the linear lookup did
+				ht_pp_insert (names, r->name, r);
+			}
 		}
 	}
 	r_list_sort (all, (RListComparator)regcmp);
+	free (reg->regindex);
+	reg->regcount = r_list_length (all);
+	reg->regindex = calloc (reg->regcount + 1, sizeof (RRegItem *));
 	index = 0;
 	r_list_foreach (all, iter, r) {
+		if (reg->regindex) {
+			reg->regindex[index] = r;
+		}
 		r->index = index++;
 	}
 	r_list_free (reg->allregs);
 	reg->allregs = all;
+	ht_pp_free (reg->regnames);
+	reg->regnames = names;
 }
 
 R_API RRegItem *r_reg_index_get(RReg *reg, int idx) {
-	RRegItem *r;
-	RListIter *iter;
 	if (idx < 0) {
 		return NULL;
 	}
 	if (!reg->allregs) {
 		r_reg_reindex (reg);
 	}
-	r_list_foreach (reg->allregs, iter, r) {
-		if (r->index == idx) {
-			return r;
-		}
+	if (reg->regindex && idx < reg->regcount) {
+		return reg->regindex[idx];
 	}
 	return NULL;
 }
 
+/* resolve a register name once, then use the index to access it */
+R_API int r_reg_get_index(RReg *reg, const char *name) {
+	RRegItem *r = r_reg_get (reg, name, -1);
+	return r? r->index: -1;
+}
+
 R_API void r_reg_free(RReg *reg) {
 	if (reg) {
 		r_reg_free_internal (reg, false);
@@ -296,6 +314,13 @@ R_API RRegItem *r_reg_get(RReg *reg, const char *name, int type) {
 		i = type;
 		e = type + 1;
 	}
+	if (reg->regnames) {
+		r = ht_pp_find (reg->regnames, name, NULL);
+		if (r && (type == -1 || r->arena == type)) {
+			return r;
+		}
+		return NULL;
+	}
 	for (; i < e; i++) {
 		r_list_foreach (reg->regset[i].regs, iter, r) {
 			if (r->name && !strcmp (r->name, name)) {
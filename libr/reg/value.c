@@ -123,6 +123,10 @@ R_API ut64 r_reg_get_value_by_role(RReg *reg, RRegisterId role) {
 	return r_reg_get_value (reg, r_reg_get (reg, r_reg_get_name (reg, role), -1));
 }
 
+R_API ut64 r_reg_get_value_by_index(RReg *reg, int idx) {
+	return r_reg_get_value (reg, r_reg_index_get (reg, idx));
+}
+
 R_API bool r_reg_set_value(RReg *reg, RRegItem *item, ut64 value) {
 	int fits_in_arena;
 	ut8 bytes[12];
@@ -198,6 +202,10 @@ R_API bool r_reg_set_value_by_role(RReg *reg, RRegisterId role, ut64 val) {
 	return r_reg_set_value (reg, r, val);
 }
 
+R_API bool r_reg_set_value_by_index(RReg *reg, int idx, ut64 val) {
+	return r_reg_set_value (reg, r_reg_index_get (reg, idx), val);
+}
+
 R_API ut64 r_reg_set_bvalue(RReg *reg, RRegItem *item, const char *str) {
 	ut64 num = UT64_MAX;
 	if (item && item->flags && str) {
@@ -0,0 +1,277 @@
+/* radare - LGPL - Copyright 2019 - pancake */
+
+#include <r_search.h>
+#include <ctype.h>
+
+// Aho-Corasick automaton used to find all the keywords of a search in a
+// single pass over each block. Only the longest run of fully masked bytes
+// (the anchor) of every keyword goes into the trie, the candidates it
+// reports must still be verified against the whole keyword and binmask.
+// Case insensitive keywords live in a second trie fed with lowercase bytes.
+
+#define AC_DENSE_MIN 8
+
+typedef struct {
+	int to;
+	int next;
+	ut8 c;
+} ACEdge;
+
+typedef struct {
+	int edges; // first edge, -1 if none
+	int nedges;
+	int fail;
+	int dict; // closest state in the fail chain having outputs
+	int out; // first output of this state
+	int *dense; // full transition table for states with many edges
+} ACNode;
+
+typedef struct {
+	int kw;
+	int off; // distance from the keyword start to the end of the anchor
+	int next;
+} ACOut;
+
+typedef struct {
+	RVector nodes;
+	RVector edges;
+	RVector outs;
+} ACTrie;
+
+struct r_search_ac_t {
+	ACTrie trie[2];
+	RSearchKeyword **kws;
+	int nkws;
+	int *slow; // keywords without any fully masked byte
+	int nslow;
+};
+
+static void ac_trie_init(ACTrie *t) {
+	ACNode root = { -1, 0, 0, -1, -1, NULL };
+	r_vector_init (&t->nodes, sizeof (ACNode), NULL, NULL);
+	r_vector_init (&t->edges, sizeof (ACEdge), NULL, NULL);
+	r_vector_init (&t->outs, sizeof (ACOut), NULL, NULL);
+	r_vector_push (&t->nodes, &root);
+}
+
+static void ac_trie_fini(ACTrie *t) {
+	size_t i;
+	for (i = 0; i < t->nodes.len; i++) {
+		free (((ACNode *)t->nodes.a)[i].dense);
+	}
+	r_vector_clear (&t->nodes);
+	r_vector_clear (&t->edges);
+	r_vector_clear (&t->outs);
+}
+
+static inline int ac_goto(ACTrie *t, int state, ut8 c) {
+	ACNode *n = (ACNode *)t->nodes.a + state;
+	if (n->dense) {
+		return n->dense[c];
+	}
+	ACEdge *edges = t->edges.a;
+	int e;
+	for (e = n->edges; e >= 0; e = edges[e].next) {
+		if (edges[e].c == c) {
+			return edges[e].to;
+		}
+	}
+	return -1;
+}
+
+static bool ac_trie_add(ACTrie *t, const ut8 *s, int len, int kw, int off) {
+	int state = 0, i;
+	for (i = 0; i < len; i++) {
+		int to = ac_goto (t, state, s[i]);
+		if (to < 0) {
+			ACNode node = { -1, 0, 0, -1, -1, NULL };
+			to = t->nodes.len;
+			if (!r_vector_push (&t->nodes, &node)) {
+				return false;
+			}
+			ACNode *n = (ACNode *)t->nodes.a + state;
+			ACEdge edge = { to, n->edges, s[i] };
+			n->edges = t->edges.len;
+			n->nedges++;
+			if (!r_vector_push (&t->edges, &edge)) {
+				return false;
+			}
+		}
+		state = to;
+	}
+	ACNode *n = (ACNode *)t->nodes.a + state;
+	ACOut out = { kw, off, n->out };
+	n->out = t->outs.len;
+	return r_vector_push (&t->outs, &out) != NULL;
+}
+
+// breadth first pass computing the fail and dictionary links
+static bool ac_trie_build(ACTrie *t) {
+	ACNode *nodes = t->nodes.a;
+	ACEdge *edges = t->edges.a;
+	int *queue = malloc (sizeof (int) * t->nodes.len);
+	int head = 0, tail = 0, e;
+	if (!queue) {
+		return false;
+	}
+	for (e = nodes[0].edges; e >= 0; e = edges[e].next) {
+		nodes[edges[e].to].fail = 0;
+		queue[tail++] = edges[e].to;
+	}
+	while (head < tail) {
+		int state = queue[head++];
+		for (e = nodes[state].edges; e >= 0; e = edges[e].next) {
+			int to = edges[e].to;
+			int f = nodes[state].fail;
+			int g;
+			while ((g = ac_goto (t, f, edges[e].c)) < 0 && f) {
+				f = nodes[f].fail;
+			}
+			nodes[to].fail = g < 0? 0: g;
+			f = nodes[to].fail;
+			nodes[to].dict = nodes[f].out >= 0? f: nodes[f].dict;
+			queue[tail++] = to;
+		}
+	}
+	free (queue);
+	// root transitions never fail, wide states get a lookup table
+	size_t i;
+	for (i = 0; i < t->nodes.len; i++) {
+		if (i && nodes[i].nedges < AC_DENSE_MIN) {
+			continue;
+		}
+		int *dense = malloc (sizeof (int) * 256);
+		if (!dense) {
+			return false;
+		}
+		memset (dense, i? 0xff: 0, sizeof (int) * 256);
+		for (e = nodes[i].edges; e >= 0; e = edges[e].next) {
+			dense[edges[e].c] = edges[e].to;
+		}
+		nodes[i].dense = dense;
+	}
+	return true;
+}
+
+static bool kw_fixed(RSearchKeyword *kw, int j) {
+	return !kw->binmask_length || kw->bin_binmask[j % kw->binmask_length] == 0xff;
+}
+
+R_API RSearchAC *r_search_ac_new(RList *kws) {
+	RListIter *iter;
+	RSearchKeyword *kw;
+	RSearchAC *ac = R_NEW0 (RSearchAC);
+	if (!ac) {
+		return NULL;
+	}
+	ac_trie_init (&ac->trie[0]);
+	ac_trie_init (&ac->trie[1]);
+	ac->kws = calloc (r_list_length (kws) + 1, sizeof (RSearchKeyword *));
+	ac->slow = calloc (r_list_length (kws) + 1, sizeof (int));
+	if (!ac->kws || !ac->slow) {
+		goto fail;
+	}
+	r_list_foreach (kws, iter, kw) {
+		int j, start = 0, best = 0, best_len = 0;
+		for (j = 0; j <= (int)kw->keyword_length; j++) {
+			if (j < kw->keyword_length && kw_fixed (kw, j)) {
+				continue;
+			}
+			if (j - start > best_len) {
+				best = start;
+				best_len = j - start;
+			}
+			start = j + 1;
+		}
+		int idx = ac->nkws++;
+		ac->kws[idx] = kw;
+		if (!best_len) {
+			ac->slow[ac->nslow++] = idx;
+			continue;
+		}
+		ut8 *anchor = kw->bin_keyword + best;
+		ut8 *low = NULL;
+		if (kw->icase) {
+			low = malloc (best_len);
+			if (!low) {
+				goto fail;
+			}
+			for (j = 0; j < best_len; j++) {
+				low[j] = tolower (anchor[j]);
+			}
+			anchor = low;
+		}
+		bool ok = ac_trie_add (&ac->trie[kw->icase? 1: 0], anchor, best_len, idx, best + best_len);
+		free (low);
+		if (!ok) {
+			goto fail;
+		}
+	}
+	if (!ac_trie_build (&ac->trie[0]) || !ac_trie_build (&ac->trie[1])) {
+		goto fail;
+	}
+	return ac;
+fail:
+	r_search_ac_free (ac);
+	return NULL;
+}
+
+R_API void r_search_ac_free(RSearchAC *ac) {
+	if (ac) {
+		ac_trie_fini (&ac->trie[0]);
+		ac_trie_fini (&ac->trie[1]);
+		free (ac->kws);
+		free (ac->slow);
+		free (ac);
+	}
+}
+
+static bool ac_trie_scan(RSearchAC *ac, ACTrie *t, bool icase, const ut8 *buf, int len, RSearchACCallback cb, void *user) {
+	if (!t->outs.len) {
+		return true;
+	}
+	ACNode *nodes = t->nodes.a;
+	ACOut *outs = t->outs.a;
+	int state = 0, i;
+	for (i = 0; i < len; i++) {
+		ut8 c = icase? tolower (buf[i]): buf[i];
+		int to;
+		while ((to = ac_goto (t, state, c)) < 0) {
+			state = nodes[state].fail;
+		}
+		state = to;
+		int s = nodes[state].out >= 0? state: nodes[state].dict;
+		for (; s >= 0; s = nodes[s].dict) {
+			int o;
+			for (o = nodes[s].out; o >= 0; o = outs[o].next) {
+				int at = i + 1 - outs[o].off;
+				if (at >= 0 && at + (int)ac->kws[outs[o].kw]->keyword_length <= len) {
+					if (!cb (user, outs[o].kw, at)) {
+						return false;
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
+// report every offset of buf where a keyword may start, the keywords are
+// identified by their position in the list given to r_search_ac_new and
+// the offsets of each one come in increasing order
+R_API bool r_search_ac_scan(RSearchAC *ac, const ut8 *buf, int len, RSearchACCallback cb, void *user) {
+	int i, j;
+	if (!ac_trie_scan (ac, &ac->trie[0], false, buf, len, cb, user)
+			|| !ac_trie_scan (ac, &ac->trie[1], true, buf, len, cb, user)) {
+		return false;
+	}
+	for (i = 0; i < ac->nslow; i++) {
+		int kwlen = ac->kws[ac->slow[i]]->keyword_length;
+		for (j = 0; j + kwlen <= len; j++) {
+			if (!cb (user, ac->slow[i], j)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
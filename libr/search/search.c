@@ -3,9 +3,15 @@
 #include <r_search.h>
 #include <r_list.h>
 #include <ctype.h>
+#if __SSE2__
+#include <emmintrin.h>
+#endif
 
 // Experimental search engine (fails, because stops at first hit of every block read
 #define USE_BMH 0
+// use the Aho-Corasick automaton when searching for this many keywords,
+// below it the per keyword byte probes are faster (see /xB)
+#define AC_MIN_KWS 256
 
 R_LIB_VERSION (r_search);
 
@@ -54,6 +60,7 @@ R_API RSearch *r_search_free(RSearch *s) {
 	}
 	r_list_free (s->hits);
 	r_list_free (s->kws);
+	r_search_ac_free (s->ac);
 	//r_io_free(s->iob.io); this is suposed to be a weak reference
 	free (s->data);
 	free (s);
@@ -95,6 +102,8 @@ R_API int r_search_set_mode(RSearch *s, int mode) {
 R_API int r_search_begin(RSearch *s) {
 	RListIter *iter;
 	RSearchKeyword *kw;
+	r_search_ac_free (s->ac);
+	s->ac = NULL;
 	r_list_foreach (s->kws, iter, kw) {
 		kw->count = 0;
 		kw->last = 0;
@@ -354,16 +363,218 @@ static bool brute_force_match(RSearch *s, RSearchKeyword *kw, const ut8 *buf, in
 	return j == kw->keyword_length;
 }
 
+// Up to two bytes of the keyword, picked among the least common ones,
+// are used to skip offsets that cannot match before brute_force_match
+typedef struct {
+	int n;
+	int off[2];
+	ut8 mask[2];
+	ut8 val[2][2]; // both cases for icase letters
+} SearchProbe;
+
+// rough frequency class of a byte in binaries, lower is rarer
+static int byte_class(ut8 c) {
+	if (!c || c == 0xff) {
+		return 3;
+	}
+	if (c == ' ' || isdigit (c) || islower (c)) {
+		return 2;
+	}
+	if (c < 0x10 || isprint (c)) {
+		return 1;
+	}
+	return 0;
+}
+
+static void probe_init(SearchProbe *p, RSearchKeyword *kw) {
+	int j, k, best[2] = { -1, -1 };
+	for (j = 0; j < kw->keyword_length; j++) {
+		ut8 m = kw->binmask_length? kw->bin_binmask[j % kw->binmask_length]: 0xff;
+		if (!m || (kw->icase && m != 0xff)) {
+			continue;
+		}
+		int c = byte_class (kw->bin_keyword[j]);
+		if (best[0] < 0 || c < byte_class (kw->bin_keyword[best[0]])) {
+			best[1] = best[0];
+			best[0] = j;
+		} else if (best[1] < 0 || c <= byte_class (kw->bin_keyword[best[1]])) {
+			best[1] = j;
+		}
+	}
+	p->n = 0;
+	for (k = 0; k < 2 && best[k] >= 0; k++) {
+		ut8 b = kw->bin_keyword[best[k]];
+		p->off[k] = best[k];
+		p->mask[k] = kw->binmask_length? kw->bin_binmask[best[k] % kw->binmask_length]: 0xff;
+		p->val[k][0] = p->val[k][1] = b & p->mask[k];
+		if (kw->icase) {
+			p->val[k][0] = tolower (b);
+			p->val[k][1] = toupper (b);
+		}
+		p->n++;
+	}
+}
+
+static inline bool probe_at(const SearchProbe *p, const ut8 *buf, int i) {
+	int k;
+	for (k = 0; k < p->n; k++) {
+		ut8 c = buf[i + p->off[k]] & p->mask[k];
+		if (c != p->val[k][0] && c != p->val[k][1]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// first offset in [i, last] where the probed bytes are there, -1 if none
+static int probe_next(const SearchProbe *p, const ut8 *buf, int i, int last) {
+	if (p->mask[0] == 0xff && p->val[0][0] == p->val[0][1]) {
+		// libc memchr is vectorized already and dispatched at runtime
+		const ut8 *d = buf + p->off[0];
+		while (i <= last) {
+			const ut8 *r = memchr (d + i, p->val[0][0], last - i + 1);
+			if (!r) {
+				return -1;
+			}
+			i = r - d;
+			if (probe_at (p, buf, i)) {
+				return i;
+			}
+			i++;
+		}
+		return -1;
+	}
+#if __SSE2__
+	// masked and icase probes, 16 offsets at a time
+	const __m128i m0 = _mm_set1_epi8 ((char)p->mask[0]);
+	const __m128i a0 = _mm_set1_epi8 ((char)p->val[0][0]);
+	const __m128i b0 = _mm_set1_epi8 ((char)p->val[0][1]);
+	const __m128i m1 = _mm_set1_epi8 ((char)p->mask[p->n - 1]);
+	const __m128i a1 = _mm_set1_epi8 ((char)p->val[p->n - 1][0]);
+	const __m128i b1 = _mm_set1_epi8 ((char)p->val[p->n - 1][1]);
+	const ut8 *d0 = buf + p->off[0];
+	const ut8 *d1 = buf + p->off[p->n - 1];
+	for (; i + 15 <= last; i += 16) {
+		__m128i x = _mm_and_si128 (_mm_loadu_si128 ((const __m128i *)(d0 + i)), m0);
+		__m128i y = _mm_and_si128 (_mm_loadu_si128 ((const __m128i *)(d1 + i)), m1);
+		__m128i e = _mm_and_si128 (
+			_mm_or_si128 (_mm_cmpeq_epi8 (x, a0), _mm_cmpeq_epi8 (x, b0)),
+			_mm_or_si128 (_mm_cmpeq_epi8 (y, a1), _mm_cmpeq_epi8 (y, b1)));
+		int bits = _mm_movemask_epi8 (e);
+		if (bits) {
+			int j = 0;
+			while (!(bits & (1 << j))) {
+				j++;
+			}
+			return i + j;
+		}
+	}
+#endif
+	for (; i <= last; i++) {
+		if (probe_at (p, buf, i)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// candidate offsets of every keyword, grouped by keyword index
+typedef struct {
+	RVector pairs; // (kw, at) as reported by the automaton
+	int *at;
+	int *start; // at[start[k]..start[k+1]) belongs to keyword k
+} SearchCands;
+
+static bool cands_push(void *user, int kw, int at) {
+	SearchCands *c = user;
+	int pair[2] = { kw, at };
+	return r_vector_push (&c->pairs, pair) != NULL;
+}
+
+static bool cands_scan(SearchCands *c, RSearchAC *ac, int nkws, const ut8 *buf, int len) {
+	int k;
+	size_t i;
+	r_vector_clear (&c->pairs);
+	free (c->at);
+	c->at = NULL;
+	if (!r_search_ac_scan (ac, buf, len, cands_push, c)) {
+		return false;
+	}
+	// counting sort keeps the offsets of each keyword in increasing order
+	int *pairs = c->pairs.a;
+	memset (c->start, 0, sizeof (int) * (nkws + 1));
+	for (i = 0; i < c->pairs.len; i++) {
+		c->start[pairs[i * 2] + 1]++;
+	}
+	for (k = 0; k < nkws; k++) {
+		c->start[k + 1] += c->start[k];
+	}
+	c->at = malloc (sizeof (int) * (c->pairs.len + 1));
+	int *fill = calloc (nkws + 1, sizeof (int));
+	if (!c->at || !fill) {
+		free (fill);
+		return false;
+	}
+	for (i = 0; i < c->pairs.len; i++) {
+		k = pairs[i * 2];
+		c->at[c->start[k] + fill[k]++] = pairs[i * 2 + 1];
+	}
+	free (fill);
+	return true;
+}
+
+// Walks the offsets of data where kw may start. When at is NULL these
+// are the ones passing the probe, otherwise the n automaton candidates.
+// Returns the r_search_hit_new value that stopped the walk or 1
+static int search_kw(RSearch *s, RSearchKeyword *kw, ut64 from, const ut8 *data, int len, int i, int end, int delta, const int *at, int n) {
+	SearchProbe probe = {0};
+	int c = 0;
+	if (!at && !s->distance && !s->inverse) {
+		probe_init (&probe, kw);
+	}
+	for (; i + kw->keyword_length <= len && i < end; i++) {
+		if (probe.n) {
+			i = probe_next (&probe, data, i, R_MIN (end - 1, len - (int)kw->keyword_length));
+			if (i < 0) {
+				break;
+			}
+		} else if (at) {
+			while (c < n && at[c] < i) {
+				c++;
+			}
+			if (c == n) {
+				break;
+			}
+			i = at[c];
+			if (i + kw->keyword_length > len || i >= end) {
+				break;
+			}
+		}
+		if (brute_force_match (s, kw, data, i) != s->inverse) {
+			int t = r_search_hit_new (s, kw, s->bckwrds ? from - kw->keyword_length - i + delta : from + i - delta);
+			if (t != 1) {
+				return t;
+			}
+			if (!s->overlap) {
+				i += kw->keyword_length - 1;
+			}
+		}
+	}
+	return 1;
+}
+
 // Supported search variants: backward, binmask, icase, inverse, overlap
 R_API int r_search_mybinparse_update(RSearch *s, ut64 from, const ut8 *buf, int len) {
 	RSearchKeyword *kw;
 	RListIter *iter;
 	RSearchLeftover *left;
-	int longest = 0, i;
+	SearchCands lc = {{0}}, bc = {{0}};
+	int longest = 0, nkws = 0, i, k, t = 1;
 	const int old_nhits = s->nhits;
 
 	r_list_foreach (s->kws, iter, kw) {
 		longest = R_MAX (longest, kw->keyword_length);
+		nkws++;
 	}
 	if (!longest) {
 		return 0;
@@ -393,43 +604,49 @@ R_API int r_search_mybinparse_update(RSearch *s, ut64 from, const ut8 *buf, int
 
 	ut64 len1 = left->len + R_MIN (longest - 1, len);
 	memcpy (left->data + left->len, buf, len1 - left->len);
+	// with many keywords scan the block once and only check the
+	// offsets where the automaton saw a keyword anchor
+	bool use_ac = nkws >= AC_MIN_KWS && !s->distance && !s->inverse && !s->noac;
+	if (use_ac && !s->ac) {
+		s->ac = r_search_ac_new (s->kws);
+	}
+	if (use_ac && s->ac) {
+		r_vector_init (&lc.pairs, sizeof (int) * 2, NULL, NULL);
+		r_vector_init (&bc.pairs, sizeof (int) * 2, NULL, NULL);
+		lc.start = calloc (nkws + 1, sizeof (int));
+		bc.start = calloc (nkws + 1, sizeof (int));
+		if (!lc.start || !bc.start
+				|| !cands_scan (&lc, s->ac, nkws, left->data, len1)
+				|| !cands_scan (&bc, s->ac, nkws, buf, len)) {
+			t = 0;
+			goto beach;
+		}
+	}
+	k = 0;
 	r_list_foreach (s->kws, iter, kw) {
 		i = s->overlap || !kw->count ? 0 :
 				s->bckwrds
 				? kw->last - from < left->len ? from + left->len - kw->last : 0
 				: from - kw->last < left->len ? kw->last + left->len - from : 0;
-		for (; i + kw->keyword_length <= len1 && i < left->len; i++) {
-			if (brute_force_match (s, kw, left->data, i) != s->inverse) {
-				int t = r_search_hit_new (s, kw, s->bckwrds ? from - kw->keyword_length - i + left->len : from + i - left->len);
-				if (!t) {
-					return -1;
-				}
-				if (t > 1) {
-					return s->nhits - old_nhits;
-				}
-				if (!s->overlap) {
-					i += kw->keyword_length - 1;
-				}
-			}
+		t = lc.at
+			? search_kw (s, kw, from, left->data, len1, i, left->len, left->len,
+				lc.at + lc.start[k], lc.start[k + 1] - lc.start[k])
+			: search_kw (s, kw, from, left->data, len1, i, left->len, left->len, NULL, 0);
+		if (t != 1) {
+			goto beach;
 		}
 		i = s->overlap || !kw->count ? 0 :
 				s->bckwrds
 				? from > kw->last ? from - kw->last : 0
 				: from < kw->last ? kw->last - from : 0;
-		for (; i + kw->keyword_length <= len; i++) {
-			if (brute_force_match (s, kw, buf, i) != s->inverse) {
-				int t = r_search_hit_new (s, kw, s->bckwrds ? from - kw->keyword_length - i : from + i);
-				if (!t) {
-					return -1;
-				}
-				if (t > 1) {
-					return s->nhits - old_nhits;
-				}
-				if (!s->overlap) {
-					i += kw->keyword_length - 1;
-				}
-			}
+		t = bc.at
+			? search_kw (s, kw, from, buf, len, i, len, 0,
+				bc.at + bc.start[k], bc.start[k + 1] - bc.start[k])
+			: search_kw (s, kw, from, buf, len, i, len, 0, NULL, 0);
+		if (t != 1) {
+			goto beach;
 		}
+		k++;
 	}
 	if (len < longest - 1) {
 		if (len1 < longest) {
@@ -444,6 +661,16 @@ R_API int r_search_mybinparse_update(RSearch *s, ut64 from, const ut8 *buf, int
 	}
 	left->end = s->bckwrds ? from - len : from + len;
 
+beach:
+	r_vector_clear (&lc.pairs);
+	r_vector_clear (&bc.pairs);
+	free (lc.at);
+	free (lc.start);
+	free (bc.at);
+	free (bc.start);
+	if (!t) {
+		return -1;
+	}
 	return s->nhits - old_nhits;
 }
 
@@ -513,6 +740,8 @@ R_API int r_search_kw_add(RSearch *s, RSearchKeyword *kw) {
 	}
 	kw->kwidx = s->n_kws++;
 	r_list_append (s->kws, kw);
+	r_search_ac_free (s->ac);
+	s->ac = NULL;
 	return true;
 }
 
@@ -521,6 +750,8 @@ R_API void r_search_string_prepare_backward(RSearch *s) {
 	RListIter *iter;
 	RSearchKeyword *kw;
 	// Precondition: !kw->binmask_length || kw->keyword_length % kw->binmask_length == 0
+	r_search_ac_free (s->ac);
+	s->ac = NULL;
 	r_list_foreach (s->kws, iter, kw) {
 		ut8 *i = kw->bin_keyword, *j = kw->bin_keyword + kw->keyword_length;
 		while (i < j) {
@@ -549,4 +780,6 @@ R_API void r_search_kw_reset(RSearch *s) {
 	r_list_purge (s->kws);
 	r_list_purge (s->hits);
 	R_FREE (s->data);
+	r_search_ac_free (s->ac);
+	s->ac = NULL;
 }
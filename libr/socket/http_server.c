@@ -111,15 +111,18 @@ R_API RSocketHTTPRequest *r_socket_http_accept (RSocket *s, RSocketHTTPOptions *
 	return hr;
 }
 
-R_API void r_socket_http_response (RSocketHTTPRequest *rs, int code, const char *out, int len, const char *headers) {
-	const char *strcode = \
-		code==200?"ok":
+static const char *http_code(int code) {
+	return code==200?"ok":
 		code==301?"Moved permanently":
 		code==302?"Found":
 		code==401?"Unauthorized":
 		code==403?"Permission denied":
 		code==404?"not found":
 		"UNKNOWN";
+}
+
+R_API void r_socket_http_response (RSocketHTTPRequest *rs, int code, const char *out, int len, const char *headers) {
+	const char *strcode = http_code (code);
 	if (len < 1) {
 		len = out ? strlen (out) : 0;
 	}
@@ -134,6 +137,24 @@ R_API void r_socket_http_response (RSocketHTTPRequest *rs, int code, const char
 	}
 }
 
+/* the body follows in r_socket_http_chunk calls, ended by an empty one */
+R_API void r_socket_http_response_chunked(RSocketHTTPRequest *rs, int code, const char *headers) {
+	if (!headers) {
+		headers = "";
+	}
+	r_socket_printf (rs->s, "HTTP/1.1 %d %s\r\n%s"
+		"Connection: close\r\nTransfer-Encoding: chunked\r\n\r\n",
+		code, http_code (code), headers);
+}
+
+R_API void r_socket_http_chunk(RSocketHTTPRequest *rs, const char *buf, int len) {
+	r_socket_printf (rs->s, "%x\r\n", R_MAX (len, 0));
+	if (buf && len > 0) {
+		r_socket_write (rs->s, (void *)buf, len);
+	}
+	r_socket_write (rs->s, (void *)"\r\n", 2);
+}
+
 R_API ut8 *r_socket_http_handle_upload(const ut8 *str, int len, int *retlen) {
 	if (retlen) {
 		*retlen = 0;
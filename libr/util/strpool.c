@@ -34,11 +34,9 @@ R_API char *r_strpool_alloc (RStrpool *p, int l) {
 	char *ret = p->str + p->len;
 	if ((p->len + l) >= p->size) {
 		ut64 osize = p->size;
-		if (l >= R_STRPOOL_INC) {
-			p->size += l + R_STRPOOL_INC;
-		} else {
-			p->size += R_STRPOOL_INC;
-		}
+		// grow geometrically, pools holding millions of names must not
+		// be copied over and over
+		p->size += R_MAX (p->size, l + R_STRPOOL_INC);
 		if (p->size < osize) {
 			eprintf ("Underflow!\n");
 			p->size = osize;
@@ -57,6 +57,20 @@ R_API R_TH_TID r_th_self(void) {
 #endif
 }
 
+// number of online cpus, at least one
+R_API int r_th_ncpus(void) {
+#if __WINDOWS__ && !defined(__CYGWIN__)
+	SYSTEM_INFO info;
+	GetSystemInfo (&info);
+	return R_MAX (1, (int)info.dwNumberOfProcessors);
+#elif __UNIX__ && defined(_SC_NPROCESSORS_ONLN)
+	long n = sysconf (_SC_NPROCESSORS_ONLN);
+	return n > 0? (int)n: 1;
+#else
+	return 1;
+#endif
+}
+
 R_API RThread *r_th_new(R_TH_FUNCTION(fun), void *user, int delay) {
 	RThread *th = R_NEW0 (RThread);
 	if (th) {
@@ -70,9 +84,18 @@ R_API RThread *r_th_new(R_TH_FUNCTION(fun), void *user, int delay) {
 #if HAVE_PTHREAD
 		pthread_cond_init (&th->_cond, NULL);
 		pthread_mutex_init (&th->_mutex, NULL);
-		pthread_create (&th->tid, NULL, _r_th_launcher, th);
+		if (pthread_create (&th->tid, NULL, _r_th_launcher, th)) {
+			pthread_cond_destroy (&th->_cond);
+			pthread_mutex_destroy (&th->_mutex);
+			r_th_lock_free (th->lock);
+			R_FREE (th);
+		}
 #elif __WINDOWS__ && !defined(__CYGWIN__)
 		th->tid = CreateThread (NULL, 0, _r_th_launcher, th, 0, 0);
+		if (!th->tid) {
+			r_th_lock_free (th->lock);
+			R_FREE (th);
+		}
 #endif
 	}
 	return th;
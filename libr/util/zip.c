@@ -84,3 +84,377 @@ R_API ut8 *r_inflate(const ut8 *src, int srcLen, int *srcConsumed, int *dstLen)
 	free (dst);
 	return NULL;
 }
+
+// Random access to deflate streams, based on the zran.c zlib example. The
+// index keeps an inflate checkpoint every span bytes of output: the position
+// of a block boundary in the compressed file and the last 32K of output,
+// which is all that inflate needs to resume from there.
+
+#define WINSIZE 32768
+#define CHUNK 16384
+#define INDEX_MAGIC "R2GZIDX2"
+
+typedef struct {
+	ut64 out; // offset in the inflated data
+	ut64 in; // offset of the first full byte in the compressed file
+	int bits; // bits of the previous byte used by this block, 0 to 7
+	ut8 *window; // inflated data before out
+} RInflatePoint;
+
+typedef struct {
+	z_stream strm;
+	int fd;
+	ut64 in; // next offset to read from the compressed file
+	bool active;
+	ut8 input[CHUNK];
+} RInflateStream;
+
+struct r_inflate_index_t {
+	ut64 span;
+	ut64 zsize; // size of the compressed file
+	ut64 mtime; // modification time of the compressed file
+	ut64 trailer; // last 8 bytes of the file, crc32 and isize for gzip
+	ut64 size; // size of the inflated data, UT64_MAX until fully indexed
+	bool error;
+	RInflatePoint *points;
+	int npoints;
+	int maxpoints;
+	// build state, the index grows as far as it was needed
+	RInflateStream build;
+	ut64 totin;
+	ut64 totout;
+	ut64 last;
+	ut8 window[WINSIZE];
+	// read state, resumed when reads are sequential
+	RInflateStream read;
+	ut64 rpos;
+};
+
+// refill the input once consumed, inflate may still have pending output at
+// the end of the file
+static void stream_fill(RInflateStream *s) {
+	if (s->strm.avail_in) {
+		return;
+	}
+	r_sandbox_lseek (s->fd, s->in, SEEK_SET);
+	int len = r_sandbox_read (s->fd, s->input, CHUNK);
+	if (len > 0) {
+		s->in += len;
+		s->strm.avail_in = len;
+		s->strm.next_in = s->input;
+	}
+}
+
+static void stream_end(RInflateStream *s) {
+	if (s->active) {
+		inflateEnd (&s->strm);
+		s->active = false;
+	}
+}
+
+static bool add_point(RInflateIndex *idx, int bits, ut64 in, ut64 out, unsigned left, ut8 *window) {
+	if (idx->npoints == idx->maxpoints) {
+		int max = idx->maxpoints? idx->maxpoints * 2: 64;
+		RInflatePoint *points = realloc (idx->points, max * sizeof (RInflatePoint));
+		if (!points) {
+			return false;
+		}
+		idx->points = points;
+		idx->maxpoints = max;
+	}
+	RInflatePoint *p = idx->points + idx->npoints;
+	p->window = malloc (WINSIZE);
+	if (!p->window) {
+		return false;
+	}
+	// the window is circular, left is the free space at its end
+	if (left) {
+		memcpy (p->window, window + WINSIZE - left, left);
+	}
+	if (left < WINSIZE) {
+		memcpy (p->window + left, window, WINSIZE - left);
+	}
+	p->bits = bits;
+	p->in = in;
+	p->out = out;
+	idx->npoints++;
+	return true;
+}
+
+static RInflateIndex *index_new(const char *file, ut64 span) {
+	RInflateIndex *idx = R_NEW0 (RInflateIndex);
+	if (!idx) {
+		return NULL;
+	}
+	idx->span = span;
+	idx->size = UT64_MAX;
+	idx->rpos = UT64_MAX;
+	idx->zsize = r_file_size (file);
+	idx->build.fd = r_sandbox_open (file, O_RDONLY | O_BINARY, 0);
+	idx->read.fd = r_sandbox_open (file, O_RDONLY | O_BINARY, 0);
+	if (idx->build.fd == -1 || idx->read.fd == -1) {
+		r_inflate_index_free (idx);
+		return NULL;
+	}
+	// identify the file a saved index belongs to
+	struct stat st = {0};
+	if (!fstat (idx->build.fd, &st)) {
+		idx->mtime = (ut64)st.st_mtime;
+	}
+	if (idx->zsize >= 8) {
+		ut8 tail[8] = {0};
+		r_sandbox_lseek (idx->build.fd, idx->zsize - 8, SEEK_SET);
+		if (r_sandbox_read (idx->build.fd, tail, 8) == 8) {
+			idx->trailer = r_read_le64 (tail);
+		}
+	}
+	return idx;
+}
+
+/* index the zlib or gzip compressed file with a checkpoint every span bytes
+ * of inflated data. Nothing is inflated until r_inflate_index_build */
+R_API RInflateIndex *r_inflate_index_new(const char *file, ut64 span) {
+	r_return_val_if_fail (file && span, NULL);
+	RInflateIndex *idx = index_new (file, span);
+	if (!idx) {
+		return NULL;
+	}
+	// + 32 tells zlib not to care whether the stream is a zlib or gzip stream
+	if (inflateInit2 (&idx->build.strm, MAX_WBITS + 32) != Z_OK) {
+		r_inflate_index_free (idx);
+		return NULL;
+	}
+	idx->build.active = true;
+	return idx;
+}
+
+R_API void r_inflate_index_free(RInflateIndex *idx) {
+	int i;
+	if (!idx) {
+		return;
+	}
+	stream_end (&idx->build);
+	stream_end (&idx->read);
+	if (idx->build.fd != -1) {
+		r_sandbox_close (idx->build.fd);
+	}
+	if (idx->read.fd != -1) {
+		r_sandbox_close (idx->read.fd);
+	}
+	for (i = 0; i < idx->npoints; i++) {
+		free (idx->points[i].window);
+	}
+	free (idx->points);
+	free (idx);
+}
+
+/* inflate until the index covers the data before upto or the end of the
+ * stream is reached. Returns false on corrupted or truncated input */
+R_API bool r_inflate_index_build(RInflateIndex *idx, ut64 upto) {
+	r_return_val_if_fail (idx, false);
+	z_stream *strm = &idx->build.strm;
+	while (!idx->error && idx->size == UT64_MAX && idx->totout < upto) {
+		stream_fill (&idx->build);
+		if (!strm->avail_out) {
+			strm->avail_out = WINSIZE;
+			strm->next_out = idx->window;
+		}
+		// return at the end of each block, where checkpoints can be made
+		ut64 totin = idx->totin, totout = idx->totout;
+		idx->totin += strm->avail_in;
+		idx->totout += strm->avail_out;
+		int ret = inflate (strm, Z_BLOCK);
+		idx->totin -= strm->avail_in;
+		idx->totout -= strm->avail_out;
+		if (ret == Z_STREAM_END) {
+			idx->size = idx->totout;
+			stream_end (&idx->build);
+			break;
+		}
+		if ((ret != Z_OK && ret != Z_BUF_ERROR)
+				|| (ret == Z_BUF_ERROR && totin == idx->totin && totout == idx->totout)) {
+			eprintf ("inflate error: %d %s\n", ret, ret == Z_BUF_ERROR? "truncated input": gzerr (-ret));
+			idx->error = true;
+			break;
+		}
+		// data_type has bit 7 set at the end of a block which is not the last
+		if ((strm->data_type & 128) && !(strm->data_type & 64)
+				&& (!idx->npoints || idx->totout - idx->last > idx->span)) {
+			if (!add_point (idx, strm->data_type & 7, idx->totin, idx->totout, strm->avail_out, idx->window)) {
+				idx->error = true;
+				break;
+			}
+			idx->last = idx->totout;
+		}
+	}
+	return !idx->error;
+}
+
+/* size of the inflated data or UT64_MAX until the whole file is indexed */
+R_API ut64 r_inflate_index_size(RInflateIndex *idx) {
+	r_return_val_if_fail (idx, UT64_MAX);
+	return idx->size;
+}
+
+/* amount of inflated data covered by the index so far */
+R_API ut64 r_inflate_index_built(RInflateIndex *idx) {
+	r_return_val_if_fail (idx, 0);
+	return idx->size != UT64_MAX? idx->size: idx->totout;
+}
+
+static bool read_seek(RInflateIndex *idx, ut64 off) {
+	RInflateStream *s = &idx->read;
+	int lo = 0, hi = idx->npoints - 1;
+	while (lo < hi) {
+		int mid = (lo + hi + 1) / 2;
+		if (idx->points[mid].out <= off) {
+			lo = mid;
+		} else {
+			hi = mid - 1;
+		}
+	}
+	RInflatePoint *p = idx->points + lo;
+	stream_end (s);
+	memset (&s->strm, 0, sizeof (z_stream));
+	// the checkpoints are in the middle of the raw deflate data
+	if (inflateInit2 (&s->strm, -MAX_WBITS) != Z_OK) {
+		return false;
+	}
+	s->active = true;
+	s->in = p->bits? p->in - 1: p->in;
+	if (p->bits) {
+		ut8 c;
+		r_sandbox_lseek (s->fd, s->in++, SEEK_SET);
+		if (r_sandbox_read (s->fd, &c, 1) != 1) {
+			return false;
+		}
+		inflatePrime (&s->strm, p->bits, c >> (8 - p->bits));
+	}
+	inflateSetDictionary (&s->strm, p->window, WINSIZE);
+	idx->rpos = p->out;
+	return true;
+}
+
+/* read len bytes of inflated data at off, inflating from the closest
+ * checkpoint. Returns the number of bytes read, -1 on error */
+R_API int r_inflate_index_read(RInflateIndex *idx, ut64 off, ut8 *buf, int len) {
+	r_return_val_if_fail (idx && buf && len >= 0, -1);
+	ut8 discard[WINSIZE];
+	if (idx->size == UT64_MAX && idx->totout <= off && !r_inflate_index_build (idx, off + 1)) {
+		return -1;
+	}
+	if (off >= r_inflate_index_built (idx) || !len) {
+		return 0;
+	}
+	// continue the previous read if it ended before off and a closer
+	// checkpoint does not exist
+	RInflateStream *s = &idx->read;
+	bool resume = s->active && idx->rpos <= off;
+	if (resume) {
+		int i;
+		for (i = idx->npoints - 1; i >= 0 && idx->points[i].out > off; i--) {
+		}
+		resume = i < 0 || idx->points[i].out <= idx->rpos;
+	}
+	if (!resume && !read_seek (idx, off)) {
+		idx->rpos = UT64_MAX;
+		stream_end (s);
+		return -1;
+	}
+	int got = 0;
+	while (got < len) {
+		bool skip = idx->rpos < off;
+		s->strm.next_out = skip? discard: buf + got;
+		s->strm.avail_out = skip? (uInt)R_MIN (off - idx->rpos, WINSIZE): (uInt)(len - got);
+		stream_fill (s);
+		unsigned before = s->strm.avail_out;
+		int ret = inflate (&s->strm, Z_NO_FLUSH);
+		unsigned n = before - s->strm.avail_out;
+		idx->rpos += n;
+		if (!skip) {
+			got += n;
+		}
+		if (ret == Z_STREAM_END) {
+			stream_end (s);
+			break;
+		}
+		if ((ret != Z_OK && ret != Z_BUF_ERROR) || (ret == Z_BUF_ERROR && !n)) {
+			stream_end (s);
+			idx->rpos = UT64_MAX;
+			return got? got: -1;
+		}
+	}
+	return got;
+}
+
+/* store the complete index in a file, to open the data later without
+ * inflating everything again */
+R_API bool r_inflate_index_save(RInflateIndex *idx, const char *file) {
+	r_return_val_if_fail (idx && file, false);
+	int i;
+	if (idx->size == UT64_MAX) {
+		return false;
+	}
+	FILE *fd = r_sandbox_fopen (file, "wb");
+	if (!fd) {
+		return false;
+	}
+	ut64 hdr[6] = { idx->zsize, idx->span, idx->size, idx->npoints, idx->mtime, idx->trailer };
+	bool ok = fwrite (INDEX_MAGIC, 8, 1, fd) == 1 && fwrite (hdr, sizeof (hdr), 1, fd) == 1;
+	for (i = 0; ok && i < idx->npoints; i++) {
+		RInflatePoint *p = idx->points + i;
+		ut64 pt[3] = { p->out, p->in, p->bits };
+		ok = fwrite (pt, sizeof (pt), 1, fd) == 1 && fwrite (p->window, WINSIZE, 1, fd) == 1;
+	}
+	fclose (fd);
+	if (!ok) {
+		r_file_rm (file);
+	}
+	return ok;
+}
+
+/* load an index saved for the compressed file, NULL if it does not match */
+R_API RInflateIndex *r_inflate_index_load(const char *file, const char *index) {
+	r_return_val_if_fail (file && index, NULL);
+	char magic[8];
+	ut64 hdr[6], pt[3];
+	FILE *fd = r_sandbox_fopen (index, "rb");
+	if (!fd) {
+		return NULL;
+	}
+	RInflateIndex *idx = NULL;
+	if (fread (magic, 8, 1, fd) != 1 || memcmp (magic, INDEX_MAGIC, 8)
+			|| fread (hdr, sizeof (hdr), 1, fd) != 1
+			|| hdr[0] != r_file_size (file) || !hdr[1] || !hdr[3] || hdr[3] > INT_MAX) {
+		goto fail;
+	}
+	idx = index_new (file, hdr[1]);
+	if (!idx || hdr[4] != idx->mtime || hdr[5] != idx->trailer) {
+		goto fail;
+	}
+	idx->points = calloc (hdr[3], sizeof (RInflatePoint));
+	if (!idx->points) {
+		goto fail;
+	}
+	idx->maxpoints = hdr[3];
+	while (idx->npoints < hdr[3]) {
+		RInflatePoint *p = idx->points + idx->npoints;
+		if (fread (pt, sizeof (pt), 1, fd) != 1 || pt[2] > 7 || !(p->window = malloc (WINSIZE))) {
+			goto fail;
+		}
+		idx->npoints++;
+		if (fread (p->window, WINSIZE, 1, fd) != 1) {
+			goto fail;
+		}
+		p->out = pt[0];
+		p->in = pt[1];
+		p->bits = pt[2];
+	}
+	idx->size = idx->totout = hdr[2];
+	fclose (fd);
+	return idx;
+fail:
+	r_inflate_index_free (idx);
+	fclose (fd);
+	return NULL;
+}